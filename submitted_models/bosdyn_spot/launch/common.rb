@@ -9,7 +9,7 @@ def _spawner(_name, _modelURI, _worldName, _x, _y, _z, _roll, _pitch, _yaw, _add
 
   actuators = ""
   state_publisher_joints = ""
-  multi_joint_command_joints = ""
+  controlled_joints = ""
 
   # the PID values for the position controller system are taken from config/ros_control/ros_control.yaml
   # and are used just to keep the robot standing until the user starts commanding it from the
@@ -22,20 +22,12 @@ def _spawner(_name, _modelURI, _worldName, _x, _y, _z, _roll, _pitch, _yaw, _add
         name="ignition::gazebo::systems::ApplyJointForce">
       <joint_name>#{joint}</joint_name>
     </plugin>
-    <plugin filename="configurable-joint-position-controller-system"
-        name="subt::ConfigurableJointPositionController">
-      <joint_name>#{joint}</joint_name>
-      <keep_initial_pos />
-      <p_gain>#{_pid[0]}</p_gain>
-      <i_gain>#{_pid[1]}</i_gain>
-      <d_gain>#{_pid[2]}</d_gain>
-    </plugin>
     HEREDOC
     actuators += actuator
 
     state_publisher_joints += "<joint_name>" + joint + "</joint_name>\n"
 
-    multi_joint_command_joints += "<joint name=\"" + joint + "\" />\n"
+    controlled_joints += "<joint name=\"" + joint + "\" />\n"
   end
 
   logical_contact_collisions = ""
@@ -91,8 +83,12 @@ def _spawner(_name, _modelURI, _worldName, _x, _y, _z, _roll, _pitch, _yaw, _add
         #{state_publisher_joints}
       </plugin>
       #{actuators}
-      <plugin filename="libmulti-joint-command-system.so" name="subt::MultiJointCommandSystem">
-        #{multi_joint_command_joints}
+      <plugin filename="multi-joint-position-controller-system" name="subt::MultiJointPositionController">
+        <keep_initial_pos />
+        <p_gain>#{_pid[0]}</p_gain>
+        <i_gain>#{_pid[1]}</i_gain>
+        <d_gain>#{_pid[2]}</d_gain>
+        #{controlled_joints}
       </plugin>
       <plugin filename="logical-contact-system" name="subt::LogicalContactSystem">
         #{logical_contact_collisions}
@@ -0,0 +1,566 @@
+#include "image_conversion.h"
+
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SUBT_IMAGE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace subt
+{
+namespace image
+{
+
+namespace
+{
+
+/// \brief Row kernels of one instruction set. Each kernel processes a single row of _n pixels.
+struct Kernels
+{
+  /// \brief Luminance of interleaved RGB (or BGR) pixels.
+  void (*lumaRgb)(const uint8_t* _rgb, uint8_t* _out, size_t _n, bool _bgr);
+
+  /// \brief Luminance of planar RGB pixels.
+  void (*lumaPlanar)(const uint8_t* _r, const uint8_t* _g, const uint8_t* _b, uint8_t* _out, size_t _n);
+
+  /// \brief Rounded average of two rows.
+  void (*average)(const uint8_t* _a, const uint8_t* _b, uint8_t* _out, size_t _n);
+
+  /// \brief Bilinear demosaicing of one Bayer row. _cur and _vert have to be readable at [-1] and [_n].
+  /// _own is the color sampled in this row besides green, _other is the color sampled in the rows around.
+  void (*bayerPlanes)(const uint8_t* _cur, const uint8_t* _vert, size_t _n, size_t _siteParity,
+                      uint8_t* _own, uint8_t* _green, uint8_t* _other);
+
+  /// \brief Interleave planar RGB pixels.
+  void (*interleave)(const uint8_t* _r, const uint8_t* _g, const uint8_t* _b, uint8_t* _out, size_t _n);
+
+  /// \brief Average 2x2 blocks of two rows into _n pixels.
+  void (*downscaleRow)(const uint8_t* _row0, const uint8_t* _row1, uint8_t* _out, size_t _n);
+};
+
+inline uint8_t luma(unsigned int _r, unsigned int _g, unsigned int _b)
+{
+  return static_cast<uint8_t>((77 * _r + 150 * _g + 29 * _b + 128) >> 8);
+}
+
+inline uint8_t avg(unsigned int _a, unsigned int _b)
+{
+  return static_cast<uint8_t>((_a + _b + 1) >> 1);
+}
+
+void lumaRgbScalar(const uint8_t* _rgb, uint8_t* _out, size_t _n, bool _bgr)
+{
+  const size_t r = _bgr ? 2 : 0;
+  const size_t b = _bgr ? 0 : 2;
+  for (size_t i = 0; i < _n; ++i, _rgb += 3)
+    _out[i] = luma(_rgb[r], _rgb[1], _rgb[b]);
+}
+
+void lumaPlanarScalar(const uint8_t* _r, const uint8_t* _g, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  for (size_t i = 0; i < _n; ++i)
+    _out[i] = luma(_r[i], _g[i], _b[i]);
+}
+
+void averageScalar(const uint8_t* _a, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  for (size_t i = 0; i < _n; ++i)
+    _out[i] = avg(_a[i], _b[i]);
+}
+
+void bayerPlanesScalar(const uint8_t* _cur, const uint8_t* _vert, size_t _n, size_t _siteParity,
+                       uint8_t* _own, uint8_t* _green, uint8_t* _other)
+{
+  for (size_t x = 0; x < _n; ++x)
+  {
+    const uint8_t horz = avg(_cur[x - 1], _cur[x + 1]);
+    if ((x & 1u) == _siteParity)
+    {
+      _own[x] = _cur[x];
+      _green[x] = avg(_vert[x], horz);
+      _other[x] = avg(_vert[x - 1], _vert[x + 1]);
+    }
+    else
+    {
+      _own[x] = horz;
+      _green[x] = _cur[x];
+      _other[x] = _vert[x];
+    }
+  }
+}
+
+void interleaveScalar(const uint8_t* _r, const uint8_t* _g, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  for (size_t i = 0; i < _n; ++i, _out += 3)
+  {
+    _out[0] = _r[i];
+    _out[1] = _g[i];
+    _out[2] = _b[i];
+  }
+}
+
+void downscaleRowScalar(const uint8_t* _row0, const uint8_t* _row1, uint8_t* _out, size_t _n)
+{
+  for (size_t i = 0; i < _n; ++i)
+  {
+    const unsigned int sum = _row0[2 * i] + _row0[2 * i + 1] + _row1[2 * i] + _row1[2 * i + 1];
+    _out[i] = static_cast<uint8_t>((sum + 2) >> 2);
+  }
+}
+
+const Kernels scalarKernels {
+  lumaRgbScalar, lumaPlanarScalar, averageScalar, bayerPlanesScalar, interleaveScalar, downscaleRowScalar};
+
+#ifdef SUBT_IMAGE_X86
+
+#define SUBT_SSSE3 __attribute__((target("ssse3")))
+#define SUBT_AVX2 __attribute__((target("avx2")))
+
+/// \brief pshufb masks converting between 16 interleaved RGB pixels (3 blocks of 16 bytes) and 3 planes.
+struct ShuffleMasks
+{
+  ShuffleMasks()
+  {
+    for (size_t c = 0; c < 3; ++c)
+    {
+      for (size_t k = 0; k < 3; ++k)
+      {
+        for (size_t i = 0; i < 16; ++i)
+        {
+          // Byte i of plane c comes from interleaved byte 3 * i + c.
+          const size_t src = 3 * i + c;
+          this->deinterleave[c][k][i] = src / 16 == k ? static_cast<uint8_t>(src % 16) : 0x80;
+
+          // Interleaved byte 16 * k + i comes from plane (16 * k + i) % 3.
+          const size_t dst = 16 * k + i;
+          this->interleave[c][k][i] = dst % 3 == c ? static_cast<uint8_t>(dst / 3) : 0x80;
+        }
+      }
+    }
+  }
+
+  /// \brief Masks indexed by plane and block.
+  alignas(16) uint8_t deinterleave[3][3][16];
+
+  /// \brief Masks indexed by plane and block.
+  alignas(16) uint8_t interleave[3][3][16];
+};
+
+const ShuffleMasks shuffleMasks;
+
+SUBT_SSSE3 inline __m128i loadMask(const uint8_t* _mask)
+{
+  return _mm_load_si128(reinterpret_cast<const __m128i*>(_mask));
+}
+
+/// \brief Split 16 interleaved RGB pixels into planes.
+SUBT_SSSE3 inline void deinterleave16(const uint8_t* _rgb, __m128i& _p0, __m128i& _p1, __m128i& _p2)
+{
+  const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_rgb));
+  const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_rgb + 16));
+  const __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_rgb + 32));
+  __m128i* planes[3] = {&_p0, &_p1, &_p2};
+  for (size_t c = 0; c < 3; ++c)
+  {
+    const auto& masks = shuffleMasks.deinterleave[c];
+    *planes[c] = _mm_or_si128(
+      _mm_or_si128(_mm_shuffle_epi8(b0, loadMask(masks[0])), _mm_shuffle_epi8(b1, loadMask(masks[1]))),
+      _mm_shuffle_epi8(b2, loadMask(masks[2])));
+  }
+}
+
+/// \brief Luminance of 8 pixels stored as 16-bit integers.
+SUBT_SSSE3 inline __m128i luma8x16(__m128i _r, __m128i _g, __m128i _b)
+{
+  // The sum is at most 255 * 256 + 128, so it doesn't overflow 16 bits.
+  __m128i sum = _mm_mullo_epi16(_r, _mm_set1_epi16(77));
+  sum = _mm_add_epi16(sum, _mm_mullo_epi16(_g, _mm_set1_epi16(150)));
+  sum = _mm_add_epi16(sum, _mm_mullo_epi16(_b, _mm_set1_epi16(29)));
+  sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+  return _mm_srli_epi16(sum, 8);
+}
+
+/// \brief Luminance of 16 pixels stored as bytes.
+SUBT_SSSE3 inline __m128i luma16Ssse3(__m128i _r, __m128i _g, __m128i _b)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo = luma8x16(
+    _mm_unpacklo_epi8(_r, zero), _mm_unpacklo_epi8(_g, zero), _mm_unpacklo_epi8(_b, zero));
+  const __m128i hi = luma8x16(
+    _mm_unpackhi_epi8(_r, zero), _mm_unpackhi_epi8(_g, zero), _mm_unpackhi_epi8(_b, zero));
+  return _mm_packus_epi16(lo, hi);
+}
+
+/// \brief Select bytes of _green where _mask is set, and bytes of _site elsewhere.
+SUBT_SSSE3 inline __m128i select(__m128i _mask, __m128i _site, __m128i _green)
+{
+  return _mm_or_si128(_mm_andnot_si128(_mask, _site), _mm_and_si128(_mask, _green));
+}
+
+SUBT_SSSE3 void lumaRgbSsse3(const uint8_t* _rgb, uint8_t* _out, size_t _n, bool _bgr)
+{
+  size_t i = 0;
+  for (; i + 16 <= _n; i += 16)
+  {
+    __m128i p0, p1, p2;
+    deinterleave16(_rgb + 3 * i, p0, p1, p2);
+    const __m128i y = _bgr ? luma16Ssse3(p2, p1, p0) : luma16Ssse3(p0, p1, p2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), y);
+  }
+  lumaRgbScalar(_rgb + 3 * i, _out + i, _n - i, _bgr);
+}
+
+SUBT_SSSE3 void lumaPlanarSsse3(const uint8_t* _r, const uint8_t* _g, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  size_t i = 0;
+  for (; i + 16 <= _n; i += 16)
+  {
+    const __m128i y = luma16Ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_r + i)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(_g + i)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(_b + i)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), y);
+  }
+  lumaPlanarScalar(_r + i, _g + i, _b + i, _out + i, _n - i);
+}
+
+SUBT_SSSE3 void averageSsse3(const uint8_t* _a, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  size_t i = 0;
+  for (; i + 16 <= _n; i += 16)
+  {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_a + i));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_b + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), _mm_avg_epu8(a, b));
+  }
+  averageScalar(_a + i, _b + i, _out + i, _n - i);
+}
+
+SUBT_SSSE3 void bayerPlanesSsse3(const uint8_t* _cur, const uint8_t* _vert, size_t _n, size_t _siteParity,
+                                 uint8_t* _own, uint8_t* _green, uint8_t* _other)
+{
+  // Blocks start at even columns, so the green columns are the same in every block.
+  const __m128i greenMask = _siteParity == 0 ? _mm_set1_epi16(static_cast<int16_t>(0xFF00)) : _mm_set1_epi16(0x00FF);
+  size_t x = 0;
+  for (; x + 16 <= _n; x += 16)
+  {
+    const __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_cur + x));
+    const __m128i vert = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_vert + x));
+    const __m128i horz = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_cur + x - 1)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(_cur + x + 1)));
+    const __m128i diag = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_vert + x - 1)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(_vert + x + 1)));
+    const __m128i cross = _mm_avg_epu8(vert, horz);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_own + x), select(greenMask, cur, horz));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_green + x), select(greenMask, cross, cur));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_other + x), select(greenMask, diag, vert));
+  }
+  bayerPlanesScalar(_cur + x, _vert + x, _n - x, _siteParity, _own + x, _green + x, _other + x);
+}
+
+SUBT_SSSE3 void interleaveSsse3(const uint8_t* _r, const uint8_t* _g, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  size_t i = 0;
+  for (; i + 16 <= _n; i += 16)
+  {
+    const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_r + i));
+    const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_g + i));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_b + i));
+    for (size_t k = 0; k < 3; ++k)
+    {
+      const __m128i block = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(r, loadMask(shuffleMasks.interleave[0][k])),
+                     _mm_shuffle_epi8(g, loadMask(shuffleMasks.interleave[1][k]))),
+        _mm_shuffle_epi8(b, loadMask(shuffleMasks.interleave[2][k])));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + 3 * i + 16 * k), block);
+    }
+  }
+  interleaveScalar(_r + i, _g + i, _b + i, _out + 3 * i, _n - i);
+}
+
+SUBT_SSSE3 void downscaleRowSsse3(const uint8_t* _row0, const uint8_t* _row1, uint8_t* _out, size_t _n)
+{
+  const __m128i ones = _mm_set1_epi8(1);
+  const __m128i two = _mm_set1_epi16(2);
+  size_t i = 0;
+  for (; i + 16 <= _n; i += 16)
+  {
+    __m128i sums[2];
+    for (size_t k = 0; k < 2; ++k)
+    {
+      const size_t offset = 2 * i + 16 * k;
+      const __m128i top = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_row0 + offset)), ones);
+      const __m128i bot = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_row1 + offset)), ones);
+      sums[k] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(top, bot), two), 2);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), _mm_packus_epi16(sums[0], sums[1]));
+  }
+  downscaleRowScalar(_row0 + 2 * i, _row1 + 2 * i, _out + i, _n - i);
+}
+
+const Kernels ssse3Kernels {
+  lumaRgbSsse3, lumaPlanarSsse3, averageSsse3, bayerPlanesSsse3, interleaveSsse3, downscaleRowSsse3};
+
+/// \brief Luminance of 16 pixels stored as bytes, as 16-bit integers.
+SUBT_AVX2 inline __m256i luma16Avx2(__m128i _r, __m128i _g, __m128i _b)
+{
+  __m256i sum = _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_r), _mm256_set1_epi16(77));
+  sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_g), _mm256_set1_epi16(150)));
+  sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_b), _mm256_set1_epi16(29)));
+  sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(sum, 8);
+}
+
+/// \brief Pack two vectors of 16-bit integers to bytes, keeping their order.
+SUBT_AVX2 inline __m256i packOrdered(__m256i _lo, __m256i _hi)
+{
+  // packus works within 128-bit lanes, which interleaves the quarters of the result.
+  return _mm256_permute4x64_epi64(_mm256_packus_epi16(_lo, _hi), 0xD8);
+}
+
+SUBT_AVX2 inline __m256i select(__m256i _mask, __m256i _site, __m256i _green)
+{
+  return _mm256_blendv_epi8(_site, _green, _mask);
+}
+
+SUBT_AVX2 void lumaRgbAvx2(const uint8_t* _rgb, uint8_t* _out, size_t _n, bool _bgr)
+{
+  size_t i = 0;
+  for (; i + 32 <= _n; i += 32)
+  {
+    __m256i y[2];
+    for (size_t k = 0; k < 2; ++k)
+    {
+      // AVX2 shuffles don't cross 128-bit lanes, so the pixels are split with SSSE3.
+      __m128i p0, p1, p2;
+      deinterleave16(_rgb + 3 * (i + 16 * k), p0, p1, p2);
+      y[k] = _bgr ? luma16Avx2(p2, p1, p0) : luma16Avx2(p0, p1, p2);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), packOrdered(y[0], y[1]));
+  }
+  lumaRgbSsse3(_rgb + 3 * i, _out + i, _n - i, _bgr);
+}
+
+SUBT_AVX2 void lumaPlanarAvx2(const uint8_t* _r, const uint8_t* _g, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  size_t i = 0;
+  for (; i + 32 <= _n; i += 32)
+  {
+    __m256i y[2];
+    for (size_t k = 0; k < 2; ++k)
+    {
+      const size_t offset = i + 16 * k;
+      y[k] = luma16Avx2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_r + offset)),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(_g + offset)),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(_b + offset)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), packOrdered(y[0], y[1]));
+  }
+  lumaPlanarSsse3(_r + i, _g + i, _b + i, _out + i, _n - i);
+}
+
+SUBT_AVX2 void averageAvx2(const uint8_t* _a, const uint8_t* _b, uint8_t* _out, size_t _n)
+{
+  size_t i = 0;
+  for (; i + 32 <= _n; i += 32)
+  {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_a + i));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_b + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), _mm256_avg_epu8(a, b));
+  }
+  averageSsse3(_a + i, _b + i, _out + i, _n - i);
+}
+
+SUBT_AVX2 void bayerPlanesAvx2(const uint8_t* _cur, const uint8_t* _vert, size_t _n, size_t _siteParity,
+                               uint8_t* _own, uint8_t* _green, uint8_t* _other)
+{
+  const __m256i greenMask =
+    _siteParity == 0 ? _mm256_set1_epi16(static_cast<int16_t>(0xFF00)) : _mm256_set1_epi16(0x00FF);
+  size_t x = 0;
+  for (; x + 32 <= _n; x += 32)
+  {
+    const __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_cur + x));
+    const __m256i vert = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_vert + x));
+    const __m256i horz = _mm256_avg_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_cur + x - 1)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_cur + x + 1)));
+    const __m256i diag = _mm256_avg_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_vert + x - 1)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_vert + x + 1)));
+    const __m256i cross = _mm256_avg_epu8(vert, horz);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_own + x), select(greenMask, cur, horz));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_green + x), select(greenMask, cross, cur));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_other + x), select(greenMask, diag, vert));
+  }
+  bayerPlanesSsse3(_cur + x, _vert + x, _n - x, _siteParity, _own + x, _green + x, _other + x);
+}
+
+SUBT_AVX2 void downscaleRowAvx2(const uint8_t* _row0, const uint8_t* _row1, uint8_t* _out, size_t _n)
+{
+  const __m256i ones = _mm256_set1_epi8(1);
+  const __m256i two = _mm256_set1_epi16(2);
+  size_t i = 0;
+  for (; i + 32 <= _n; i += 32)
+  {
+    __m256i sums[2];
+    for (size_t k = 0; k < 2; ++k)
+    {
+      const size_t offset = 2 * i + 32 * k;
+      const __m256i top =
+        _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_row0 + offset)), ones);
+      const __m256i bot =
+        _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_row1 + offset)), ones);
+      sums[k] = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(top, bot), two), 2);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), packOrdered(sums[0], sums[1]));
+  }
+  downscaleRowSsse3(_row0 + 2 * i, _row1 + 2 * i, _out + i, _n - i);
+}
+
+// Interleaving needs lane-crossing shuffles in AVX2, so the SSSE3 kernel is used.
+const Kernels avx2Kernels {
+  lumaRgbAvx2, lumaPlanarAvx2, averageAvx2, bayerPlanesAvx2, interleaveSsse3, downscaleRowAvx2};
+
+#endif
+
+const Kernels& kernels(Isa _isa)
+{
+#ifdef SUBT_IMAGE_X86
+  if (isaSupported(_isa))
+  {
+    switch (_isa)
+    {
+      case Isa::AVX2:
+        return avx2Kernels;
+      case Isa::SSSE3:
+        return ssse3Kernels;
+      default:
+        break;
+    }
+  }
+#endif
+  return scalarKernels;
+}
+
+/// \brief Demosaic a Bayer image row by row.
+/// \param[in] _rowCallback Called with the row index and the red, green and blue planes of the row.
+template<typename Callback>
+bool demosaic(const uint8_t* _src, size_t _srcStep, uint32_t _width, uint32_t _height, BayerPattern _pattern,
+              const Kernels& _kernels, Callback _rowCallback)
+{
+  if (_width < 2 || _height < 2)
+    return false;
+
+  // Position of the red sample in the top-left 2x2 block.
+  size_t redX {0}, redY {0};
+  switch (_pattern)
+  {
+    case BayerPattern::RGGB: redX = 0; redY = 0; break;
+    case BayerPattern::BGGR: redX = 1; redY = 1; break;
+    case BayerPattern::GRBG: redX = 1; redY = 0; break;
+    case BayerPattern::GBRG: redX = 0; redY = 1; break;
+  }
+
+  // The current row and the average of the rows around it, both padded by one pixel on each side, and the planes.
+  const size_t width = _width;
+  std::vector<uint8_t> buffer(2 * (width + 2) + 3 * width);
+  uint8_t* cur = buffer.data() + 1;
+  uint8_t* vert = cur + width + 2;
+  uint8_t* own = vert + width + 1;
+  uint8_t* green = own + width;
+  uint8_t* other = green + width;
+
+  for (size_t y = 0; y < _height; ++y)
+  {
+    const uint8_t* row = _src + y * _srcStep;
+    const uint8_t* up = _src + (y > 0 ? y - 1 : 1) * _srcStep;
+    const uint8_t* down = _src + (y + 1 < _height ? y + 1 : _height - 2) * _srcStep;
+
+    std::memcpy(cur, row, width);
+    cur[-1] = row[1];
+    cur[width] = row[width - 2];
+
+    _kernels.average(up, down, vert, width);
+    vert[-1] = vert[1];
+    vert[width] = vert[width - 2];
+
+    const bool redRow = (y & 1u) == redY;
+    _kernels.bayerPlanes(cur, vert, width, redRow ? redX : 1 - redX, own, green, other);
+    if (redRow)
+      _rowCallback(y, own, green, other);
+    else
+      _rowCallback(y, other, green, own);
+  }
+  return true;
+}
+
+}
+
+//////////////////////////////////////////////////
+bool isaSupported(Isa _isa)
+{
+  switch (_isa)
+  {
+    case Isa::Scalar:
+      return true;
+#ifdef SUBT_IMAGE_X86
+    case Isa::SSSE3:
+      return __builtin_cpu_supports("ssse3");
+    case Isa::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+//////////////////////////////////////////////////
+Isa bestIsa()
+{
+  static const Isa isa = isaSupported(Isa::AVX2) ? Isa::AVX2 : isaSupported(Isa::SSSE3) ? Isa::SSSE3 : Isa::Scalar;
+  return isa;
+}
+
+//////////////////////////////////////////////////
+void rgbToMono(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+               uint32_t _width, uint32_t _height, bool _bgr, Isa _isa)
+{
+  const Kernels& k = kernels(_isa);
+  for (size_t y = 0; y < _height; ++y)
+    k.lumaRgb(_src + y * _srcStep, _dst + y * _dstStep, _width, _bgr);
+}
+
+//////////////////////////////////////////////////
+bool bayerToMono(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+                 uint32_t _width, uint32_t _height, BayerPattern _pattern, Isa _isa)
+{
+  const Kernels& k = kernels(_isa);
+  return demosaic(_src, _srcStep, _width, _height, _pattern, k,
+    [&](size_t _y, const uint8_t* _r, const uint8_t* _g, const uint8_t* _b)
+    {
+      k.lumaPlanar(_r, _g, _b, _dst + _y * _dstStep, _width);
+    });
+}
+
+//////////////////////////////////////////////////
+bool bayerToRgb(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+                uint32_t _width, uint32_t _height, BayerPattern _pattern, Isa _isa)
+{
+  const Kernels& k = kernels(_isa);
+  return demosaic(_src, _srcStep, _width, _height, _pattern, k,
+    [&](size_t _y, const uint8_t* _r, const uint8_t* _g, const uint8_t* _b)
+    {
+      k.interleave(_r, _g, _b, _dst + _y * _dstStep, _width);
+    });
+}
+
+//////////////////////////////////////////////////
+void downscale2x(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+                 uint32_t _width, uint32_t _height, Isa _isa)
+{
+  const Kernels& k = kernels(_isa);
+  for (size_t y = 0; y < _height / 2; ++y)
+    k.downscaleRow(_src + 2 * y * _srcStep, _src + (2 * y + 1) * _srcStep, _dst + y * _dstStep, _width / 2);
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace subt
+{
+namespace image
+{
+
+/// \brief Instruction sets the conversion kernels are implemented for.
+/// All of them produce bit-exact results, so they can be used interchangeably.
+enum class Isa
+{
+  Scalar,
+  SSSE3,
+  AVX2,
+};
+
+/// \brief Layout of the 2x2 color filter of a Bayer image, starting from its top-left pixel.
+enum class BayerPattern
+{
+  RGGB,
+  BGGR,
+  GRBG,
+  GBRG,
+};
+
+/// \brief Tell whether the kernels for the given instruction set can run on this CPU.
+bool isaSupported(Isa _isa);
+
+/// \brief The fastest instruction set supported by this CPU.
+Isa bestIsa();
+
+/// \brief Convert an 8-bit RGB or BGR image to mono.
+/// The luminance is the fixed-point BT.601 combination (77 R + 150 G + 29 B + 128) >> 8.
+/// \param[in] _src The input image.
+/// \param[in] _srcStep Length of an input row in bytes.
+/// \param[out] _dst The output image, _width x _height bytes with the given step.
+/// \param[in] _dstStep Length of an output row in bytes.
+/// \param[in] _bgr True if the input is BGR, false if it is RGB.
+/// \param[in] _isa The instruction set to use.
+void rgbToMono(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+               uint32_t _width, uint32_t _height, bool _bgr, Isa _isa = bestIsa());
+
+/// \brief Demosaic an 8-bit Bayer image and convert it to mono.
+/// The result is the luminance of the image produced by bayerToRgb().
+/// \param[in] _src The input image. Both dimensions have to be at least 2.
+/// \param[in] _srcStep Length of an input row in bytes.
+/// \param[out] _dst The output image, _width x _height bytes with the given step.
+/// \param[in] _dstStep Length of an output row in bytes.
+/// \param[in] _pattern The color filter layout.
+/// \param[in] _isa The instruction set to use.
+/// \return False if the image is too small to demosaic.
+bool bayerToMono(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+                 uint32_t _width, uint32_t _height, BayerPattern _pattern, Isa _isa = bestIsa());
+
+/// \brief Demosaic an 8-bit Bayer image to RGB using bilinear interpolation.
+/// Missing values are rounded averages of the 2 or 4 nearest samples of the same color. Borders are mirrored
+/// without repeating the edge pixel, which keeps the color filter layout.
+/// \param[in] _src The input image. Both dimensions have to be at least 2.
+/// \param[in] _srcStep Length of an input row in bytes.
+/// \param[out] _dst The output image, _width x _height x 3 bytes with the given step.
+/// \param[in] _dstStep Length of an output row in bytes.
+/// \param[in] _pattern The color filter layout.
+/// \param[in] _isa The instruction set to use.
+/// \return False if the image is too small to demosaic.
+bool bayerToRgb(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+                uint32_t _width, uint32_t _height, BayerPattern _pattern, Isa _isa = bestIsa());
+
+/// \brief Downscale an 8-bit mono image to half of its size by averaging 2x2 blocks.
+/// An odd last row or column is dropped.
+/// \param[in] _src The input image.
+/// \param[in] _srcStep Length of an input row in bytes.
+/// \param[out] _dst The output image, (_width / 2) x (_height / 2) bytes with the given step.
+/// \param[in] _dstStep Length of an output row in bytes.
+/// \param[in] _width Width of the input image.
+/// \param[in] _height Height of the input image.
+/// \param[in] _isa The instruction set to use.
+void downscale2x(const uint8_t* _src, size_t _srcStep, uint8_t* _dst, size_t _dstStep,
+                 uint32_t _width, uint32_t _height, Isa _isa = bestIsa());
+
+}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace subt
+{
+
+/// \brief PID parameters of a joint, with the same defaults as in ConfigurableJointPositionController.
+struct JointPidGains
+{
+  double p {1};
+  double i {0.1};
+  double d {0.01};
+  double iMax {1};
+  double iMin {-1};
+  double cmdMax {1000};
+  double cmdMin {-1000};
+  double cmdOffset {0};
+};
+
+/// \brief Position PID controllers of several joints, one entry per joint in each array.
+/// Update() has the same update rule as ignition::math::PID.
+struct JointPidStates
+{
+  std::vector<double> target;
+  std::vector<double> position;
+  std::vector<double> feedForward;
+  std::vector<double> pGain, iGain, dGain;
+  std::vector<double> iMax, iMin, cmdMax, cmdMin, cmdOffset;
+  std::vector<double> iErr, pErrLast;
+  std::vector<double> force;
+
+  /// \brief 1 if the joint is controlled in this step, 0 otherwise.
+  std::vector<uint8_t> active;
+
+  /// \brief Resize all arrays.
+  /// \param[in] _n Number of joints.
+  void Resize(size_t _n)
+  {
+    for (auto* array : {&this->target, &this->position, &this->feedForward, &this->pGain, &this->iGain, &this->dGain,
+                        &this->iMax, &this->iMin, &this->cmdMax, &this->cmdMin, &this->cmdOffset, &this->iErr,
+                        &this->pErrLast, &this->force})
+    {
+      array->assign(_n, 0.0);
+    }
+    this->active.assign(_n, 0);
+  }
+
+  /// \brief Set the PID parameters of a joint.
+  /// \param[in] _joint Index of the joint.
+  /// \param[in] _gains The parameters.
+  void SetGains(size_t _joint, const JointPidGains& _gains)
+  {
+    this->pGain[_joint] = _gains.p;
+    this->iGain[_joint] = _gains.i;
+    this->dGain[_joint] = _gains.d;
+    this->iMax[_joint] = _gains.iMax;
+    this->iMin[_joint] = _gains.iMin;
+    this->cmdMax[_joint] = _gains.cmdMax;
+    this->cmdMin[_joint] = _gains.cmdMin;
+    this->cmdOffset[_joint] = _gains.cmdOffset;
+  }
+
+  /// \brief Compute the forces of all active joints.
+  /// \param[in] _dt Time step in seconds, has to be positive.
+  void Update(double _dt)
+  {
+    const size_t n = this->target.size();
+    const double invDt = 1.0 / _dt;
+
+    // Plain loops over contiguous arrays, so that the compiler can vectorize them. Inactive joints are computed too
+    // and only skipped when writing the output.
+    for (size_t i = 0; i < n; ++i)
+    {
+      const double error = this->position[i] - this->target[i];
+
+      double iErr = this->iErr[i] + this->iGain[i] * _dt * error;
+      if (this->iMax[i] >= this->iMin[i])
+        iErr = std::min(std::max(iErr, this->iMin[i]), this->iMax[i]);
+
+      const double dErr = (error - this->pErrLast[i]) * invDt;
+
+      double cmd = -this->pGain[i] * error - iErr - this->dGain[i] * dErr + this->cmdOffset[i];
+      if (this->cmdMax[i] >= this->cmdMin[i])
+        cmd = std::min(std::max(cmd, this->cmdMin[i]), this->cmdMax[i]);
+
+      // The state of a disabled controller stays frozen, like a math::PID that is not updated.
+      const bool active = this->active[i] != 0;
+      this->iErr[i] = active ? iErr : this->iErr[i];
+      this->pErrLast[i] = active ? error : this->pErrLast[i];
+      this->force[i] = cmd + this->feedForward[i];
+    }
+  }
+};
+
+}
@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 #include <ignition/msgs/int32_v.pb.h>
 #include <ignition/plugin/Register.hh>
@@ -16,6 +22,21 @@ using namespace gazebo;
 namespace subt
 {
 
+/// \brief Publishes which groups of collisions are in contact with something. A group is in contact if any of its
+/// collisions is.
+///
+/// # Parameters
+///
+/// `<group name="...">`: A group of `<collision>` elements with names of collisions of this model. Can be repeated.
+///
+/// `<topic>`: The topic to publish on. Default is `/model/{name_of_model}/logical_contacts`.
+///
+/// `<publish_rate>`: The contacts are published whenever they change, and also at this rate (in simulation time) even
+/// if they don't change. Set to 0 to only publish the changes. Default is 10 Hz.
+///
+/// # Publications
+///
+/// `{topic}` (`ignition::msgs::Int32_V`): 1 for each group in contact, 0 otherwise. The groups are ordered by name.
 class LogicalContactSystem : public System, public ISystemConfigure, public ISystemPostUpdate
 {
   public: void Configure(const Entity& _entity, const std::shared_ptr<const sdf::Element>& _sdf,
@@ -34,6 +55,8 @@ class LogicalContactSystem : public System, public ISystemConfigure, public ISys
       return;
     }
 
+    // The groups are published in the order of their names.
+    std::map<std::string, std::vector<std::string>> collisionNames;
     auto sdf = _sdf->Clone();
     for (auto group = sdf->GetElement("group"); group; group = group->GetNextElement("group"))
     {
@@ -44,7 +67,7 @@ class LogicalContactSystem : public System, public ISystemConfigure, public ISys
       }
 
       const auto name = group->GetAttribute("name")->GetAsString();
-      this->collisionNames[name].clear();  // initialize the map key
+      collisionNames[name].clear();  // initialize the map key
 
       for (auto collision = group->GetElement("collision"); collision; collision = collision->GetNextElement("collision"))
       {
@@ -54,11 +77,33 @@ class LogicalContactSystem : public System, public ISystemConfigure, public ISys
           ignerr << "LogicalContactSystem found empty <collision> tag in group [" << name << "], it will be ignored." << std::endl;
           continue;
         }
-        this->collisions[collName] = kNullEntity;
-        this->collisionNames[name].push_back(collName);
+        collisionNames[name].push_back(collName);
       }
     }
 
+    for (const auto& groupPair : collisionNames)
+    {
+      for (const auto& collName : groupPair.second)
+      {
+        this->slotsByName[collName].push_back(this->slots.size());
+        this->slots.push_back({this->groupNames.size()});
+      }
+      this->groupNames.push_back(groupPair.first);
+    }
+    this->modelEntity = _entity;
+
+    this->state.resize((this->groupNames.size() + 63) / 64);
+    this->publishedState.resize(this->state.size());
+    this->msg.mutable_data()->Resize(this->groupNames.size(), 0);
+
+    const auto publishRate = _sdf->Get<double>("publish_rate", 10.0).first;
+    this->publishPeriod = std::chrono::steady_clock::duration::zero();
+    if (publishRate > 0)
+    {
+      this->publishPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / publishRate));
+    }
+
     std::string topic {"/model/" + model.Name(_ecm) + "/logical_contacts"};
     if (_sdf->HasElement("topic"))
       topic = _sdf->Get<std::string>("topic");
@@ -66,7 +111,7 @@ class LogicalContactSystem : public System, public ISystemConfigure, public ISys
     this->pub = this->node.Advertise<ignition::msgs::Int32_V>(topic);
 
     std::stringstream ss;
-    for (const auto& groupPair : this->collisionNames)
+    for (const auto& groupPair : collisionNames)
     {
       ss << " - '" << groupPair.first << "' with collisions [";
       for (size_t i = 0;  i < groupPair.second.size(); ++i)
@@ -82,45 +127,113 @@ class LogicalContactSystem : public System, public ISystemConfigure, public ISys
 
   public: void PostUpdate(const UpdateInfo& _info, const EntityComponentManager& _ecm) override
   {
-    ignition::msgs::Int32_V msg;
-    size_t i = 0;
-    msg.mutable_header()->mutable_stamp()->CopyFrom(convert<msgs::Time>(_info.simTime));
-    msg.mutable_data()->Resize(this->collisionNames.size(), -1);
-    for (const auto& groupPair : this->collisionNames)
+    if (this->groupNames.empty())
+      return;
+
+    if (_info.dt < std::chrono::steady_clock::duration::zero())
+      this->lastPublishTime.reset();
+
+    this->ResolveCollisions(_ecm);
+
+    // Each group is one bit, set if any of its collisions has a contact.
+    std::fill(this->state.begin(), this->state.end(), 0);
+    for (const auto& slot : this->slots)
     {
-      msg.mutable_data()->Set(i, false);
-      for (const auto& name : groupPair.second)
-      {
-        auto& entity = this->collisions.at(name);
-        if (entity == kNullEntity)
-        {
-          auto collisionEntities = _ecm.EntitiesByComponents(
-            components::Collision(), components::Name(name));
-          if (!collisionEntities.empty())
-            entity = collisionEntities[0];
-        }
+      if (slot.entity == kNullEntity || this->IsSet(this->state, slot.group))
+        continue;
 
-        if (entity != kNullEntity)
+      const auto& contacts = _ecm.Component<components::ContactSensorData>(slot.entity);
+      if (contacts != nullptr && contacts->Data().contact_size() > 0)
+        this->state[slot.group / 64] |= uint64_t{1} << (slot.group % 64);
+    }
+
+    const bool changed = this->state != this->publishedState || !this->lastPublishTime.has_value();
+    const bool heartbeat = this->publishPeriod > std::chrono::steady_clock::duration::zero() &&
+      this->lastPublishTime.has_value() && _info.simTime - *this->lastPublishTime >= this->publishPeriod;
+    if (!changed && !heartbeat)
+      return;
+
+    this->msg.mutable_header()->mutable_stamp()->CopyFrom(convert<msgs::Time>(_info.simTime));
+    for (size_t i = 0; i < this->groupNames.size(); ++i)
+      this->msg.mutable_data()->Set(i, this->IsSet(this->state, i));
+    this->pub.Publish(this->msg);
+
+    this->publishedState = this->state;
+    this->lastPublishTime = _info.simTime;
+  }
+
+  /// \brief Find the entities of the configured collisions. All existing collisions are searched only once, after
+  /// that only the newly created ones are checked.
+  protected: void ResolveCollisions(const EntityComponentManager& _ecm)
+  {
+    auto resolve = [this, &_ecm](const Entity& _entity, const components::Collision*, const components::Name* _name)
+    {
+      const auto it = this->slotsByName.find(_name->Data());
+      if (it == this->slotsByName.end())
+        return true;
+
+      // Other robots have collisions of the same name.
+      const auto link = _ecm.Component<components::ParentEntity>(_entity);
+      if (link == nullptr)
+        return true;
+      const auto model = _ecm.Component<components::ParentEntity>(link->Data());
+      if (model == nullptr || model->Data() != this->modelEntity)
+        return true;
+
+      for (const auto slot : it->second)
+        this->slots[slot].entity = _entity;
+      return true;
+    };
+
+    if (!this->searchedAll)
+    {
+      _ecm.Each<components::Collision, components::Name>(resolve);
+      this->searchedAll = true;
+    }
+    else if (_ecm.HasNewEntities())
+    {
+      _ecm.EachNew<components::Collision, components::Name>(resolve);
+    }
+
+    if (_ecm.HasEntitiesMarkedForRemoval())
+    {
+      _ecm.EachRemoved<components::Collision>([this](const Entity& _entity, const components::Collision*)
+      {
+        for (auto& slot : this->slots)
         {
-          const auto& contacts = _ecm.Component<components::ContactSensorData>(entity);
-          if (contacts != nullptr && contacts->Data().contact_size() > 0)
-          {
-            msg.mutable_data()->Set(i,true);
-            break;
-          }
+          if (slot.entity == _entity)
+            slot.entity = kNullEntity;
         }
-      }
-
-      i += 1;
+        return true;
+      });
     }
+  }
 
-    this->pub.Publish(msg);
+  protected: static bool IsSet(const std::vector<uint64_t>& _bits, const size_t _index)
+  {
+    return (_bits[_index / 64] >> (_index % 64)) & 1u;
   }
 
+  /// \brief One configured collision.
+  protected: struct Slot
+  {
+    size_t group;  //!< Index of the group the collision belongs to.
+    Entity entity {kNullEntity};
+  };
+
   protected: transport::Node node;
   protected: transport::Node::Publisher pub;
-  protected: std::map<std::string, std::vector<std::string>> collisionNames;
-  protected: std::unordered_map<std::string, Entity> collisions;
+  protected: Entity modelEntity {kNullEntity};
+  protected: std::vector<std::string> groupNames;  //!< Sorted by name, which is the order of the published data.
+  protected: std::vector<Slot> slots;
+  protected: std::unordered_map<std::string, std::vector<size_t>> slotsByName;  //!< Only used to resolve the entities.
+  protected: bool searchedAll {false};
+
+  protected: std::vector<uint64_t> state;  //!< Bitset of the groups in contact.
+  protected: std::vector<uint64_t> publishedState;
+  protected: std::optional<std::chrono::steady_clock::duration> lastPublishTime;
+  protected: std::chrono::steady_clock::duration publishPeriod {std::chrono::milliseconds(100)};
+  protected: ignition::msgs::Int32_V msg;
 };
 
 }
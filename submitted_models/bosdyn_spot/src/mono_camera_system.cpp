@@ -1,4 +1,5 @@
 #include <memory>
+#include <string>
 
 #include <ignition/msgs/double.pb.h>
 #include <ignition/msgs/camera_info.pb.h>
@@ -13,6 +14,8 @@
 
 #include <ignition/gazebo/Util.hh>
 
+#include "image_conversion.h"
+
 using namespace ignition;
 using namespace gazebo;
 
@@ -21,12 +24,17 @@ namespace subt
 
 /// \brief Attach this plugin inside a <sensor> tag to make it publish mono images in a sub-namespace 'mono'
 /// The conversion to mono is a simple one with perceptually good results (non-uniform linear combination of RGB).
+/// Bayer images are demosaiced before the conversion.
+/// Optional parameter <downscale> sets how many times the mono image is downscaled to half of its size (default 0).
 class MonoCameraSystem : public System, public ISystemConfigure, public ISystemPostUpdate
 {
   public: void Configure(const Entity& _entity, const std::shared_ptr<const sdf::Element>& _sdf,
                          EntityComponentManager& _ecm, EventManager& _eventMgr) override
   {
     this->sensor = _entity;
+
+    if (_sdf->HasElement("downscale"))
+      this->downscale = _sdf->Get<unsigned int>("downscale");
   }
 
   protected: void PostUpdate(const UpdateInfo& _info, const EntityComponentManager& _ecm) override
@@ -66,38 +74,30 @@ class MonoCameraSystem : public System, public ISystemConfigure, public ISystemP
 
   protected: void OnMsg(const ignition::msgs::Image& msg)
   {
-    ignition::msgs::Image outMsg;
-    switch (msg.pixel_format_type())
+    const auto width = msg.width();
+    const auto height = msg.height();
+    const auto format = msg.pixel_format_type();
+
+    size_t channels = 1;
+    image::BayerPattern pattern {image::BayerPattern::RGGB};
+    switch (format)
     {
       case ignition::msgs::PixelFormatType::BAYER_BGGR8:
+        pattern = image::BayerPattern::BGGR;
+        break;
       case ignition::msgs::PixelFormatType::BAYER_GBRG8:
+        pattern = image::BayerPattern::GBRG;
+        break;
       case ignition::msgs::PixelFormatType::BAYER_GRBG8:
+        pattern = image::BayerPattern::GRBG;
+        break;
       case ignition::msgs::PixelFormatType::BAYER_RGGB8:
-      {
-        outMsg.CopyFrom(msg);
-        outMsg.set_pixel_format_type(ignition::msgs::PixelFormatType::L_INT8);
+        pattern = image::BayerPattern::RGGB;
         break;
-      }
       case ignition::msgs::PixelFormatType::RGB_INT8:
       case ignition::msgs::PixelFormatType::BGR_INT8:
-      {
-        outMsg.mutable_header()->CopyFrom(msg.header());
-        outMsg.set_pixel_format_type(ignition::msgs::PixelFormatType::L_INT8);
-        outMsg.set_width(msg.width());
-        outMsg.set_height(msg.height());
-        outMsg.set_step(msg.width());
-
-        const auto length = msg.width() * msg.height();
-        if (this->data == nullptr)
-          this->data = new char[length];
-
-        const auto& inData = msg.data();
-        for (size_t i = 0; i < length; ++i)
-          this->data[i] = static_cast<char>((30 * inData[i*3] + 59 * inData[i*3+1] + 11 * inData[i*3+2]) / 100);
-
-        outMsg.set_data(this->data, length);
+        channels = 3;
         break;
-      }
       default:
       {
         static bool warned = false;
@@ -105,17 +105,101 @@ class MonoCameraSystem : public System, public ISystemConfigure, public ISystemP
         {
           ignwarn << "MonoCameraSystem: Unsupported pixel format [" << msg.pixel_format_type() << "]" << std::endl;
           warned = true;
-          return;
         }
+        return;
       }
     }
 
+    // The resolution may change between frames, so everything is sized from the current message.
+    const size_t srcStep = msg.step() > 0 ? msg.step() : width * channels;
+    const auto& inData = msg.data();
+    if (width == 0 || height == 0 || srcStep < width * channels ||
+        inData.size() < srcStep * (height - 1) + width * channels)
+    {
+      ignerr << "MonoCameraSystem: Image data of size [" << inData.size() << "] does not match its dimensions ["
+             << width << "x" << height << ", step " << srcStep << "]" << std::endl;
+      return;
+    }
+
+    // Without downscaling, the image is converted directly into the output message.
+    ignition::msgs::Image outMsg;
+    std::string& outData = *outMsg.mutable_data();
+    std::string& monoData = this->downscale > 0 ? this->buffer : outData;
+    monoData.resize(static_cast<size_t>(width) * height);
+
+    const auto src = reinterpret_cast<const uint8_t*>(inData.data());
+    auto mono = reinterpret_cast<uint8_t*>(&monoData[0]);
+    if (channels == 3)
+    {
+      const bool bgr = format == ignition::msgs::PixelFormatType::BGR_INT8;
+      image::rgbToMono(src, srcStep, mono, width, width, height, bgr);
+    }
+    else if (!image::bayerToMono(src, srcStep, mono, width, width, height, pattern))
+    {
+      ignerr << "MonoCameraSystem: Bayer image [" << width << "x" << height << "] is too small" << std::endl;
+      return;
+    }
+
+    // Downscale by swapping the buffers after each step, then copy the small result into the message.
+    auto outWidth = width;
+    auto outHeight = height;
+    for (unsigned int i = 0; i < this->downscale && outWidth >= 2 && outHeight >= 2; ++i)
+    {
+      this->scratch.resize(static_cast<size_t>(outWidth / 2) * (outHeight / 2));
+      image::downscale2x(reinterpret_cast<const uint8_t*>(this->buffer.data()), outWidth,
+                         reinterpret_cast<uint8_t*>(&this->scratch[0]), outWidth / 2, outWidth, outHeight);
+      this->buffer.swap(this->scratch);
+      outWidth /= 2;
+      outHeight /= 2;
+    }
+    if (this->downscale > 0)
+      outData = this->buffer;
+
+    outMsg.mutable_header()->CopyFrom(msg.header());
+    outMsg.set_pixel_format_type(ignition::msgs::PixelFormatType::L_INT8);
+    outMsg.set_width(outWidth);
+    outMsg.set_height(outHeight);
+    outMsg.set_step(outWidth);
+
     this->pub.Publish(outMsg);
   }
 
   protected: void OnInfoMsg(const ignition::msgs::CameraInfo& msg)
   {
-    this->pubInfo.Publish(msg);
+    if (this->downscale == 0)
+    {
+      this->pubInfo.Publish(msg);
+      return;
+    }
+
+    // Scale the intrinsics the same way as the image. A pixel of the downscaled image covers a 2x2 block, so the
+    // principal point moves by half a pixel.
+    ignition::msgs::CameraInfo outMsg(msg);
+    for (unsigned int i = 0; i < this->downscale && outMsg.width() >= 2 && outMsg.height() >= 2; ++i)
+    {
+      outMsg.set_width(outMsg.width() / 2);
+      outMsg.set_height(outMsg.height() / 2);
+
+      auto& k = *outMsg.mutable_intrinsics()->mutable_k();
+      if (k.size() == 9)
+      {
+        k[0] *= 0.5;
+        k[2] = (k[2] + 0.5) * 0.5 - 0.5;
+        k[4] *= 0.5;
+        k[5] = (k[5] + 0.5) * 0.5 - 0.5;
+      }
+
+      auto& p = *outMsg.mutable_projection()->mutable_p();
+      if (p.size() == 12)
+      {
+        p[0] *= 0.5;
+        p[2] = (p[2] + 0.5) * 0.5 - 0.5;
+        p[3] *= 0.5;
+        p[5] *= 0.5;
+        p[6] = (p[6] + 0.5) * 0.5 - 0.5;
+      }
+    }
+    this->pubInfo.Publish(outMsg);
   }
 
   protected: void OnSetRate(const ignition::msgs::Double &_rate)
@@ -123,17 +207,13 @@ class MonoCameraSystem : public System, public ISystemConfigure, public ISystemP
     this->node.Request(this->reqSetRateTopic, _rate);
   }
 
-  public: ~MonoCameraSystem() override
-  {
-    delete[] this->data;
-    this->data = nullptr;
-  }
-
   protected: transport::Node node;
   protected: transport::Node::Publisher pub, pubInfo;
   protected: Entity sensor {kNullEntity};
   protected: bool initialized {false};
-  protected: char* data {nullptr};
+  protected: unsigned int downscale {0};
+  protected: std::string buffer;
+  protected: std::string scratch;
   protected: std::string reqSetRateTopic;
 };
 
@@ -0,0 +1,538 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <ignition/msgs/double.pb.h>
+#include <ignition/msgs/joint_trajectory.pb.h>
+#include <ignition/msgs/model.pb.h>
+#include <ignition/msgs/pid.pb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ignition/common/Profiler.hh>
+#include <ignition/math/Helpers.hh>
+#include <ignition/plugin/Register.hh>
+#include <ignition/transport/Node.hh>
+
+#include "ignition/gazebo/components/JointForceCmd.hh"
+#include "ignition/gazebo/components/JointPosition.hh"
+#include "ignition/gazebo/Model.hh"
+
+#include <ignition/gazebo/System.hh>
+
+#include "joint_pid_states.h"
+
+using namespace ignition;
+using namespace gazebo;
+
+namespace subt
+{
+/// \brief Position controller of all joints of a model. It does the same as one
+/// ConfigurableJointPositionController per joint plus a MultiJointCommandSystem,
+/// but the batched commands are applied directly and all joints are updated by
+/// a single loop over arrays of controller states in PreUpdate, without any
+/// transport messages between the command and the force output.
+///
+/// Every joint is controlled by a PID with the same update rule as
+/// ignition::math::PID. The force is written to the JointForceCmd component.
+///
+/// ## Subscriptions
+///
+/// `{topic}` (`ignition::msgs::Model`): Batched commands. Finite positions set
+/// the targets of the joints, finite forces are added to the PID output as a
+/// feed-forward term. Velocities are ignored. Defaults to
+/// `/model/${MODEL_NAME}/joint_commands`.
+///
+/// `{trajectory_topic}` (`ignition::msgs::JointTrajectory`): The same as
+/// `{topic}`, only the first trajectory point is executed. Defaults to
+/// `/model/${MODEL_NAME}/joint_trajectory`.
+///
+/// `/model/${MODEL_NAME}/joint/${JOINT_NAME}/${JOINT_INDEX}/cmd_pos`
+/// (`ignition::msgs::Double`): Target position of a single joint, compatible
+/// with ConfigurableJointPositionController. Sending NaN disables the
+/// controller of the joint until another finite command is issued.
+///
+/// ## Services
+///
+/// `/model/${MODEL_NAME}/joint/${JOINT_NAME}/${JOINT_INDEX}/set_pos_pid`
+/// (`ignition::msgs::PID`): Reconfigure the PID of a single joint. Only the
+/// _optional fields of the message are read.
+///
+/// ## System Parameters
+///
+/// `<topic>`, `<trajectory_topic>` Change the batched command topics.
+///
+/// `<p_gain>`, `<i_gain>`, `<d_gain>`, `<i_max>`, `<i_min>`, `<cmd_max>`,
+/// `<cmd_min>`, `<cmd_offset>` Default PID parameters of all joints, with the
+/// same defaults as in ConfigurableJointPositionController.
+///
+/// `<keep_initial_pos>` Control all joints to keep their initial positions
+/// until commanded otherwise.
+///
+/// `<joint name="...">` One element per controlled joint. It can contain
+/// `<joint_index>`, `<initial_target_pos>`, `<keep_initial_pos>` and any of
+/// the PID parameters, which then override the defaults for this joint.
+class MultiJointPositionController : public System, public ISystemConfigure, public ISystemPreUpdate
+{
+  public: void Configure(
+    const Entity& _entity, const std::shared_ptr<const sdf::Element>& _sdf,
+    EntityComponentManager& _ecm, EventManager& _eventMgr) override;
+
+  public: void PreUpdate(
+    const ignition::gazebo::UpdateInfo& _info,
+    ignition::gazebo::EntityComponentManager& _ecm) override;
+
+  /// \brief Callback for batched commands.
+  /// \param[in] _msg The command.
+  protected: void OnCmd(const msgs::Model& _msg);
+
+  /// \brief Callback for batched trajectory commands.
+  /// \param[in] _msg The command.
+  protected: void OnTrajectoryCmd(const msgs::JointTrajectory& _msg);
+
+  /// \brief Callback for the position command of one joint.
+  /// \param[in] _joint Index of the joint.
+  /// \param[in] _msg Position message.
+  protected: void OnCmdPos(size_t _joint, const msgs::Double& _msg);
+
+  /// \brief Callback for the PID config of one joint.
+  /// \param[in] _joint Index of the joint.
+  /// \param[in] _msg PID message.
+  protected: void OnCmdPID(size_t _joint, const msgs::PID& _msg);
+
+  /// \brief Store a batched command of a joint. Call with cmdMutex locked.
+  /// \param[in] _name Name of the joint.
+  /// \param[in] _position Target position, ignored if not finite.
+  /// \param[in] _force Feed-forward force, ignored if not finite.
+  protected: void SetCommand(const std::string& _name, double _position, double _force);
+
+  /// \brief Commands received since the last update.
+  protected: struct PendingCommand
+  {
+    bool hasTarget {false};
+    double target {0};
+    bool hasForce {false};
+    double force {0};
+    bool hasGains {false};
+    JointPidGains gains;
+  };
+
+  protected: transport::Node node;
+  protected: Model model{kNullEntity};
+  protected: std::string modelName;
+
+  protected: std::vector<std::string> jointNames;
+  protected: std::vector<unsigned int> jointIndices;
+  protected: std::vector<Entity> jointEntities;
+  protected: std::vector<uint8_t> keepInitialPos;
+  protected: std::vector<uint8_t> hasTarget;
+  protected: std::unordered_map<std::string, size_t> jointIndexByName;
+  protected: size_t unresolvedJoints {0};
+
+  /// \brief Controller states, one entry per joint in each array.
+  protected: JointPidStates states;
+
+  protected: std::mutex cmdMutex;
+  protected: std::vector<PendingCommand> pending;
+  protected: std::atomic<bool> hasPending {false};
+};
+
+//////////////////////////////////////////////////
+void MultiJointPositionController::Configure(
+  const Entity& _entity, const std::shared_ptr<const sdf::Element>& _sdf,
+  EntityComponentManager& _ecm, EventManager&/*_eventMgr*/)
+{
+  this->model = Model(_entity);
+
+  if (!this->model.Valid(_ecm))
+  {
+    ignerr << "MultiJointPositionController plugin should be attached to a model "
+           << "entity. Failed to initialize." << std::endl;
+    return;
+  }
+
+  this->modelName = this->model.Name(_ecm);
+
+  if (!_sdf->HasElement("joint"))
+  {
+    ignerr << "MultiJointPositionController doesn't have any <joint> element. It will not do anything." << std::endl;
+    return;
+  }
+
+  auto readGains = [](const sdf::ElementPtr& _elem, JointPidGains& _gains)
+  {
+    if (_elem->HasElement("p_gain"))
+      _gains.p = _elem->Get<double>("p_gain");
+    if (_elem->HasElement("i_gain"))
+      _gains.i = _elem->Get<double>("i_gain");
+    if (_elem->HasElement("d_gain"))
+      _gains.d = _elem->Get<double>("d_gain");
+    if (_elem->HasElement("i_max"))
+      _gains.iMax = _elem->Get<double>("i_max");
+    if (_elem->HasElement("i_min"))
+      _gains.iMin = _elem->Get<double>("i_min");
+    if (_elem->HasElement("cmd_max"))
+      _gains.cmdMax = _elem->Get<double>("cmd_max");
+    if (_elem->HasElement("cmd_min"))
+      _gains.cmdMin = _elem->Get<double>("cmd_min");
+    if (_elem->HasElement("cmd_offset"))
+      _gains.cmdOffset = _elem->Get<double>("cmd_offset");
+  };
+
+  auto sdf = _sdf->Clone();
+  JointPidGains defaultGains;
+  readGains(sdf, defaultGains);
+  const bool defaultKeepInitialPos = sdf->HasElement("keep_initial_pos");
+
+  std::vector<JointPidGains> gains;
+  std::vector<double> initialTargets;
+  for (auto joint = sdf->GetElement("joint"); joint; joint = joint->GetNextElement("joint"))
+  {
+    if (!joint->HasAttribute("name"))
+    {
+      ignerr << "MultiJointPositionController found a <joint> element with no `name` attribute. "
+             << "This element will be ignored." << std::endl;
+      continue;
+    }
+
+    const auto name = joint->GetAttribute("name")->GetAsString();
+    if (name.empty() || this->jointIndexByName.find(name) != this->jointIndexByName.end())
+    {
+      ignerr << "MultiJointPositionController found an empty or duplicate joint name [" << name << "]. "
+             << "This element will be ignored." << std::endl;
+      continue;
+    }
+
+    JointPidGains jointGains = defaultGains;
+    readGains(joint, jointGains);
+
+    this->jointIndexByName[name] = this->jointNames.size();
+    this->jointNames.push_back(name);
+    this->jointIndices.push_back(joint->HasElement("joint_index") ? joint->Get<unsigned int>("joint_index") : 0u);
+    this->keepInitialPos.push_back(defaultKeepInitialPos || joint->HasElement("keep_initial_pos"));
+    this->hasTarget.push_back(joint->HasElement("initial_target_pos"));
+    initialTargets.push_back(this->hasTarget.back() ? joint->Get<double>("initial_target_pos") : 0.0);
+    gains.push_back(jointGains);
+  }
+
+  const size_t n = this->jointNames.size();
+  this->jointEntities.assign(n, kNullEntity);
+  this->unresolvedJoints = n;
+  this->pending.resize(n);
+  this->states.Resize(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    this->states.SetGains(i, gains[i]);
+    this->states.target[i] = initialTargets[i];
+  }
+
+  // Per-joint topics for compatibility with ConfigurableJointPositionController.
+  for (size_t i = 0; i < n; ++i)
+  {
+    const auto prefix = "/model/" + this->modelName + "/joint/" + this->jointNames[i] + "/" +
+      std::to_string(this->jointIndices[i]);
+    const auto topic = transport::TopicUtils::AsValidTopic(prefix + "/cmd_pos");
+    const auto pidTopic = transport::TopicUtils::AsValidTopic(prefix + "/set_pos_pid");
+    if (topic.empty() || pidTopic.empty())
+    {
+      ignerr << "Failed to create topics for joint [" << this->jointNames[i] << "]" << std::endl;
+      continue;
+    }
+
+    std::function<void(const msgs::Double&)> posCb = [this, i](const msgs::Double& _msg)
+    {
+      this->OnCmdPos(i, _msg);
+    };
+    this->node.Subscribe(topic, posCb);
+
+    std::function<void(const msgs::PID&)> pidCb = [this, i](const msgs::PID& _msg)
+    {
+      this->OnCmdPID(i, _msg);
+    };
+    this->node.Advertise(pidTopic, pidCb);
+  }
+
+  std::string topic {"/model/" + this->modelName + "/joint_commands"};
+  if (sdf->HasElement("topic"))
+    topic = sdf->Get<std::string>("topic");
+  this->node.Subscribe(topic, &MultiJointPositionController::OnCmd, this);
+
+  std::string trajectoryTopic {"/model/" + this->modelName + "/joint_trajectory"};
+  if (sdf->HasElement("trajectory_topic"))
+    trajectoryTopic = sdf->Get<std::string>("trajectory_topic");
+  this->node.Subscribe(trajectoryTopic, &MultiJointPositionController::OnTrajectoryCmd, this);
+
+  ignmsg << "MultiJointPositionController controlling " << n << " joints, subscribing to JointState commands on ["
+         << topic << "] and JointTrajectory commands on [" << trajectoryTopic << "]" << std::endl;
+}
+
+//////////////////////////////////////////////////
+void MultiJointPositionController::PreUpdate(
+  const UpdateInfo& _info, EntityComponentManager& _ecm)
+{
+  IGN_PROFILE("MultiJointPositionController::PreUpdate");
+
+  // \TODO(anyone) Support rewind
+  if (_info.dt < std::chrono::steady_clock::duration::zero())
+  {
+    ignwarn << "Detected jump back in time ["
+            << std::chrono::duration_cast<std::chrono::seconds>(_info.dt).count()
+            << "s]. System may not work properly." << std::endl;
+  }
+
+  const size_t n = this->jointNames.size();
+
+  // Look for the joints that haven't been identified yet, and make sure they have the components used below.
+  if (this->unresolvedJoints > 0)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (this->jointEntities[i] != kNullEntity)
+        continue;
+
+      const auto entity = this->model.JointByName(_ecm, this->jointNames[i]);
+      if (entity == kNullEntity)
+        continue;
+
+      this->jointEntities[i] = entity;
+      --this->unresolvedJoints;
+      if (!_ecm.Component<components::JointPosition>(entity))
+        _ecm.CreateComponent(entity, components::JointPosition());
+      if (!_ecm.Component<components::JointForceCmd>(entity))
+        _ecm.CreateComponent(entity, components::JointForceCmd());
+    }
+  }
+
+  if (this->hasPending)
+  {
+    std::lock_guard<std::mutex> lock(this->cmdMutex);
+    for (size_t i = 0; i < n; ++i)
+    {
+      auto& cmd = this->pending[i];
+      if (cmd.hasTarget)
+      {
+        this->states.target[i] = cmd.target;
+        this->hasTarget[i] = true;
+      }
+      if (cmd.hasForce)
+        this->states.feedForward[i] = cmd.force;
+      if (cmd.hasGains)
+        this->states.SetGains(i, cmd.gains);
+      cmd.hasTarget = cmd.hasForce = cmd.hasGains = false;
+    }
+    this->hasPending = false;
+  }
+
+  // Nothing left to do if paused. math::PID doesn't update with zero time step either.
+  const double dt = std::chrono::duration<double>(_info.dt).count();
+  if (_info.paused || dt <= 0)
+    return;
+
+  // Gather the joint positions.
+  for (size_t i = 0; i < n; ++i)
+  {
+    this->states.active[i] = 0;
+    if (this->jointEntities[i] == kNullEntity)
+      continue;
+
+    // The position component is filled in by the physics system after the first step.
+    const auto* posComp = _ecm.Component<components::JointPosition>(this->jointEntities[i]);
+    if (posComp == nullptr || this->jointIndices[i] >= posComp->Data().size())
+      continue;
+
+    const double position = posComp->Data()[this->jointIndices[i]];
+    this->states.position[i] = position;
+
+    // Read the initial joint position if we should keep it.
+    if (!this->hasTarget[i] && this->keepInitialPos[i])
+    {
+      this->states.target[i] = position;
+      this->hasTarget[i] = true;
+    }
+
+    // Sending NaN disables the controller.
+    this->states.active[i] = this->hasTarget[i] && std::isfinite(this->states.target[i]);
+  }
+
+  this->states.Update(dt);
+
+  // Write the forces.
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (!this->states.active[i])
+      continue;
+
+    // Set through the ECM, so that the change is marked for the state and the logs.
+    auto forces = _ecm.ComponentDefault<components::JointForceCmd>(this->jointEntities[i])->Data();
+    forces.resize(std::max(forces.size(), static_cast<size_t>(this->jointIndices[i] + 1)));
+    forces[this->jointIndices[i]] = this->states.force[i];
+
+    _ecm.SetComponentData<components::JointForceCmd>(this->jointEntities[i], forces);
+  }
+}
+
+//////////////////////////////////////////////////
+void MultiJointPositionController::SetCommand(const std::string& _name, double _position, double _force)
+{
+  const auto it = this->jointIndexByName.find(_name);
+  if (it == this->jointIndexByName.end())
+  {
+    ignwarn << "Received command for joint " << _name << " which is not controlled by this system." << std::endl;
+    return;
+  }
+
+  auto& cmd = this->pending[it->second];
+  if (std::isfinite(_position))
+  {
+    cmd.hasTarget = true;
+    cmd.target = _position;
+  }
+  if (std::isfinite(_force))
+  {
+    cmd.hasForce = true;
+    cmd.force = _force;
+  }
+}
+
+//////////////////////////////////////////////////
+void MultiJointPositionController::OnCmd(const msgs::Model& _msg)
+{
+  std::lock_guard<std::mutex> lock(this->cmdMutex);
+  for (const auto& joint : _msg.joint())
+  {
+    if (joint.name().empty())
+    {
+      ignwarn << "Received command with empty joint name." << std::endl;
+      continue;
+    }
+
+    if (!joint.has_axis1())
+    {
+      ignwarn << "Received command for joint " << joint.name() << " without axis1." << std::endl;
+      continue;
+    }
+
+    this->SetCommand(joint.name(), joint.axis1().position(), joint.axis1().force());
+  }
+  this->hasPending = true;
+}
+
+//////////////////////////////////////////////////
+void MultiJointPositionController::OnTrajectoryCmd(const msgs::JointTrajectory& _msg)
+{
+  if (_msg.points().empty())
+  {
+    ignwarn << "Received empty trajectory command." << std::endl;
+    return;
+  }
+
+  if (_msg.points().size() > 1)
+    ignwarn << "Received trajectory command with >1 points, this is not supported. Executing only the first one."
+            << std::endl;
+
+  const auto& point = *_msg.points().begin();
+  const auto nan = std::numeric_limits<double>::quiet_NaN();
+
+  std::lock_guard<std::mutex> lock(this->cmdMutex);
+  for (int i = 0; i < _msg.joint_names_size(); ++i)
+  {
+    if (_msg.joint_names(i).empty())
+    {
+      ignwarn << "Received command with empty joint name." << std::endl;
+      continue;
+    }
+
+    this->SetCommand(_msg.joint_names(i),
+                     i < point.positions_size() ? point.positions(i) : nan,
+                     i < point.effort_size() ? point.effort(i) : nan);
+  }
+  this->hasPending = true;
+}
+
+//////////////////////////////////////////////////
+void MultiJointPositionController::OnCmdPos(size_t _joint, const msgs::Double& _msg)
+{
+  std::lock_guard<std::mutex> lock(this->cmdMutex);
+  // Unlike the batched commands, NaN is stored and disables the controller.
+  this->pending[_joint].hasTarget = true;
+  this->pending[_joint].target = _msg.data();
+  this->hasPending = true;
+}
+
+//////////////////////////////////////////////////
+void MultiJointPositionController::OnCmdPID(size_t _joint, const msgs::PID& _msg)
+{
+  std::lock_guard<std::mutex> lock(this->cmdMutex);
+
+  auto& cmd = this->pending[_joint];
+  if (!cmd.hasGains)
+  {
+    // Start from the gains currently in use. The arrays are only written in PreUpdate while holding the lock.
+    cmd.gains.p = this->states.pGain[_joint];
+    cmd.gains.i = this->states.iGain[_joint];
+    cmd.gains.d = this->states.dGain[_joint];
+    cmd.gains.iMax = this->states.iMax[_joint];
+    cmd.gains.iMin = this->states.iMin[_joint];
+    cmd.gains.cmdMax = this->states.cmdMax[_joint];
+    cmd.gains.cmdMin = this->states.cmdMin[_joint];
+    cmd.gains.cmdOffset = this->states.cmdOffset[_joint];
+    cmd.hasGains = true;
+  }
+
+  if (_msg.has_p_gain_optional())
+    cmd.gains.p = _msg.p_gain_optional().data();
+  if (_msg.has_i_gain_optional())
+    cmd.gains.i = _msg.i_gain_optional().data();
+  if (_msg.has_d_gain_optional())
+    cmd.gains.d = _msg.d_gain_optional().data();
+  if (_msg.has_i_max_optional())
+    cmd.gains.iMax = _msg.i_max_optional().data();
+  if (_msg.has_i_min_optional())
+    cmd.gains.iMin = _msg.i_min_optional().data();
+  if (_msg.has_limit_optional())
+  {
+    cmd.gains.cmdMax = _msg.limit_optional().data();
+    cmd.gains.cmdMin = -_msg.limit_optional().data();
+  }
+  this->hasPending = true;
+
+  const auto& stamp = _msg.header().stamp();
+  const auto now = std::chrono::duration_cast<std::chrono::duration<float>>(
+    math::secNsecToDuration(stamp.sec(), stamp.nsec()));
+  igndbg << "[" << std::fixed << std::setprecision(3) << now.count() << "]: "
+         << "Updated PID properties of joint ["
+         << this->modelName << "/" << this->jointNames[_joint] << "]" << std::endl;
+}
+
+}
+
+IGNITION_ADD_PLUGIN(subt::MultiJointPositionController,
+                    ignition::gazebo::System,
+                    ignition::gazebo::ISystemConfigure,
+                    ignition::gazebo::ISystemPreUpdate)
+
+IGNITION_ADD_PLUGIN_ALIAS(subt::MultiJointPositionController,
+                         "subt::MultiJointPositionController")
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "../src/image_conversion.h"
+
+using namespace subt::image;
+
+namespace
+{
+
+std::vector<uint8_t> randomImage(size_t _size, unsigned int _seed)
+{
+  std::mt19937 gen(_seed);
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<uint8_t> image(_size);
+  for (auto& value : image)
+    value = static_cast<uint8_t>(dist(gen));
+  return image;
+}
+
+/// \brief The accelerated instruction sets this CPU supports.
+std::vector<Isa> acceleratedIsas()
+{
+  std::vector<Isa> isas;
+  for (const auto isa : {Isa::SSSE3, Isa::AVX2})
+  {
+    if (isaSupported(isa))
+      isas.push_back(isa);
+  }
+  return isas;
+}
+
+// Widths covering empty vector loops, exact multiples of the vector length and scalar tails.
+const std::vector<uint32_t> widths {2, 3, 15, 16, 17, 31, 32, 33, 47, 64, 101, 640};
+
+const std::vector<BayerPattern> patterns {
+  BayerPattern::RGGB, BayerPattern::BGGR, BayerPattern::GRBG, BayerPattern::GBRG};
+
+}
+
+//////////////////////////////////////////////////
+TEST(ImageConversion, RgbToMonoValues)
+{
+  const std::vector<uint8_t> rgb {255, 0, 0, 0, 255, 0, 0, 0, 255, 255, 255, 255, 0, 0, 0, 10, 20, 30};
+  std::vector<uint8_t> mono(6);
+  rgbToMono(rgb.data(), rgb.size(), mono.data(), mono.size(), 6, 1, false, Isa::Scalar);
+  EXPECT_EQ((std::vector<uint8_t> {77, 149, 29, 255, 0, 18}), mono);
+
+  rgbToMono(rgb.data(), rgb.size(), mono.data(), mono.size(), 6, 1, true, Isa::Scalar);
+  EXPECT_EQ((std::vector<uint8_t> {29, 149, 77, 255, 0, 22}), mono);
+}
+
+//////////////////////////////////////////////////
+TEST(ImageConversion, RgbToMonoBitExact)
+{
+  const uint32_t height = 3;
+  for (const auto width : widths)
+  {
+    // Padded rows check that the step is respected.
+    const size_t srcStep = 3 * width + 5;
+    const auto rgb = randomImage(srcStep * height, width);
+    for (const bool bgr : {false, true})
+    {
+      std::vector<uint8_t> expected(width * height);
+      rgbToMono(rgb.data(), srcStep, expected.data(), width, width, height, bgr, Isa::Scalar);
+      for (const auto isa : acceleratedIsas())
+      {
+        std::vector<uint8_t> actual(width * height);
+        rgbToMono(rgb.data(), srcStep, actual.data(), width, width, height, bgr, isa);
+        EXPECT_EQ(expected, actual) << "width " << width << " isa " << static_cast<int>(isa);
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(ImageConversion, BayerUniformColor)
+{
+  // A uniformly colored scene is reconstructed exactly, borders included.
+  const uint8_t color[3] {200, 100, 50};
+  const uint32_t width = 37;
+  const uint32_t height = 6;
+  for (const auto pattern : patterns)
+  {
+    size_t redX {0}, redY {0};
+    if (pattern == BayerPattern::BGGR || pattern == BayerPattern::GRBG)
+      redX = 1;
+    if (pattern == BayerPattern::BGGR || pattern == BayerPattern::GBRG)
+      redY = 1;
+
+    std::vector<uint8_t> bayer(width * height);
+    for (size_t y = 0; y < height; ++y)
+    {
+      for (size_t x = 0; x < width; ++x)
+      {
+        size_t channel = 1;
+        if (x % 2 == redX && y % 2 == redY)
+          channel = 0;
+        else if (x % 2 != redX && y % 2 != redY)
+          channel = 2;
+        bayer[y * width + x] = color[channel];
+      }
+    }
+
+    std::vector<uint8_t> rgb(3 * width * height);
+    ASSERT_TRUE(bayerToRgb(bayer.data(), width, rgb.data(), 3 * width, width, height, pattern, Isa::Scalar));
+    for (size_t i = 0; i < width * height; ++i)
+    {
+      ASSERT_EQ(color[0], rgb[3 * i]) << i;
+      ASSERT_EQ(color[1], rgb[3 * i + 1]) << i;
+      ASSERT_EQ(color[2], rgb[3 * i + 2]) << i;
+    }
+
+    std::vector<uint8_t> mono(width * height);
+    ASSERT_TRUE(bayerToMono(bayer.data(), width, mono.data(), width, width, height, pattern, Isa::Scalar));
+    for (const auto value : mono)
+      ASSERT_EQ(124, value);
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(ImageConversion, BayerBitExact)
+{
+  const uint32_t height = 5;
+  for (const auto width : widths)
+  {
+    const size_t srcStep = width + 3;
+    const auto bayer = randomImage(srcStep * height, width);
+    for (const auto pattern : patterns)
+    {
+      std::vector<uint8_t> expectedRgb(3 * width * height);
+      std::vector<uint8_t> expectedMono(width * height);
+      ASSERT_TRUE(bayerToRgb(bayer.data(), srcStep, expectedRgb.data(), 3 * width, width, height, pattern,
+                             Isa::Scalar));
+      ASSERT_TRUE(bayerToMono(bayer.data(), srcStep, expectedMono.data(), width, width, height, pattern,
+                              Isa::Scalar));
+
+      // Mono is the luminance of the demosaiced image.
+      std::vector<uint8_t> luminance(width * height);
+      rgbToMono(expectedRgb.data(), 3 * width, luminance.data(), width, width, height, false, Isa::Scalar);
+      EXPECT_EQ(luminance, expectedMono);
+
+      for (const auto isa : acceleratedIsas())
+      {
+        std::vector<uint8_t> rgb(3 * width * height);
+        std::vector<uint8_t> mono(width * height);
+        ASSERT_TRUE(bayerToRgb(bayer.data(), srcStep, rgb.data(), 3 * width, width, height, pattern, isa));
+        ASSERT_TRUE(bayerToMono(bayer.data(), srcStep, mono.data(), width, width, height, pattern, isa));
+        EXPECT_EQ(expectedRgb, rgb) << "width " << width << " isa " << static_cast<int>(isa);
+        EXPECT_EQ(expectedMono, mono) << "width " << width << " isa " << static_cast<int>(isa);
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(ImageConversion, BayerTooSmall)
+{
+  const std::vector<uint8_t> bayer(4);
+  std::vector<uint8_t> out(12);
+  EXPECT_FALSE(bayerToMono(bayer.data(), 4, out.data(), 4, 4, 1, BayerPattern::RGGB));
+  EXPECT_FALSE(bayerToRgb(bayer.data(), 1, out.data(), 3, 1, 4, BayerPattern::RGGB));
+}
+
+//////////////////////////////////////////////////
+TEST(ImageConversion, Downscale)
+{
+  const std::vector<uint8_t> image {
+    0, 1, 10, 20, 255,
+    2, 3, 30, 41, 255,
+    9, 9, 9, 9, 9};
+  std::vector<uint8_t> out(2);
+  downscale2x(image.data(), 5, out.data(), 2, 5, 3, Isa::Scalar);
+  EXPECT_EQ((std::vector<uint8_t> {2, 25}), out);
+
+  const uint32_t height = 4;
+  for (const auto width : widths)
+  {
+    const auto mono = randomImage(width * height, width);
+    std::vector<uint8_t> expected((width / 2) * (height / 2));
+    downscale2x(mono.data(), width, expected.data(), width / 2, width, height, Isa::Scalar);
+    for (const auto isa : acceleratedIsas())
+    {
+      std::vector<uint8_t> actual(expected.size());
+      downscale2x(mono.data(), width, actual.data(), width / 2, width, height, isa);
+      EXPECT_EQ(expected, actual) << "width " << width << " isa " << static_cast<int>(isa);
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <ignition/math/PID.hh>
+
+#include "../src/joint_pid_states.h"
+
+using namespace subt;
+
+namespace
+{
+
+ignition::math::PID makePid(const JointPidGains& _gains)
+{
+  return ignition::math::PID(_gains.p, _gains.i, _gains.d, _gains.iMax, _gains.iMin, _gains.cmdMax, _gains.cmdMin,
+                             _gains.cmdOffset);
+}
+
+}
+
+//////////////////////////////////////////////////
+TEST(JointPidStates, MatchesMathPid)
+{
+  // Default gains, a saturated output, a clamped integral and a command offset.
+  std::vector<JointPidGains> gains(4);
+  gains[1].p = 5000;
+  gains[1].cmdMax = 50;
+  gains[1].cmdMin = -50;
+  gains[2].i = 20;
+  gains[2].iMax = 0.5;
+  gains[2].iMin = -0.5;
+  gains[3].p = 30;
+  gains[3].d = 2;
+  gains[3].cmdOffset = 3;
+
+  JointPidStates states;
+  states.Resize(gains.size());
+  std::vector<ignition::math::PID> pids;
+  for (size_t i = 0; i < gains.size(); ++i)
+  {
+    states.SetGains(i, gains[i]);
+    states.target[i] = 0.1 * i;
+    states.active[i] = 1;
+    pids.push_back(makePid(gains[i]));
+  }
+
+  const double dt = 0.001;
+  for (int step = 0; step < 100; ++step)
+  {
+    for (size_t i = 0; i < gains.size(); ++i)
+      states.position[i] = 0.3 * std::sin(0.05 * step + i);
+    states.Update(dt);
+
+    for (size_t i = 0; i < gains.size(); ++i)
+    {
+      const double expected = pids[i].Update(states.position[i] - states.target[i], std::chrono::duration<double>(dt));
+      EXPECT_NEAR(expected, states.force[i], 1e-9) << "joint " << i << ", step " << step;
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(JointPidStates, InactiveAndFeedForward)
+{
+  JointPidGains gains;
+  gains.d = 0;
+
+  JointPidStates states;
+  states.Resize(2);
+  states.SetGains(0, gains);
+  states.SetGains(1, gains);
+  states.position = {1, 1};
+  states.active = {1, 0};
+  states.feedForward = {0, 2};
+  auto pid = makePid(gains);
+  auto feedForwardPid = makePid(gains);
+
+  states.Update(0.01);
+  EXPECT_NEAR(pid.Update(1, std::chrono::duration<double>(0.01)), states.force[0], 1e-9);
+
+  // The state of the inactive joint stays frozen.
+  EXPECT_DOUBLE_EQ(0, states.iErr[1]);
+  EXPECT_DOUBLE_EQ(0, states.pErrLast[1]);
+
+  // The feed-forward term is added to the PID output.
+  states.active[1] = 1;
+  states.Update(0.01);
+  EXPECT_NEAR(feedForwardPid.Update(1, std::chrono::duration<double>(0.01)) + 2, states.force[1], 1e-9);
+}
@@ -74,6 +74,8 @@ namespace systems
   ///
   /// `<odom_publish_frequency>`: Odometry publication frequency. This
   /// element is optional, and the default value is 50Hz.
+  /// The odometry is integrated along exact arcs every simulation step, and
+  /// the published velocities are averaged since the previous publication.
   ///
   /// '<min_velocity>': Minimum velocity [m/s], usually <= 0.
   /// '<max_velocity>': Maximum velocity [m/s], usually >= 0.
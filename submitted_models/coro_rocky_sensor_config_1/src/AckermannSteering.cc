@@ -21,13 +21,12 @@
 
 #include <limits>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <string>
 #include <vector>
 
 #include <ignition/common/Profiler.hh>
-#include <ignition/math/Quaternion.hh>
-#include <ignition/math/Angle.hh>
 #include <ignition/plugin/Register.hh>
 #include <ignition/transport/Node.hh>
 
@@ -38,6 +37,9 @@
 #include "ignition/gazebo/Model.hh"
 #include "ignition/gazebo/Util.hh"
 
+#include <subt_odometry/OdometryMessage.hh>
+#include <subt_odometry/WheelOdometry.hh>
+
 #include "SpeedLimiter.hh"
 
 using namespace ignition;
@@ -115,20 +117,9 @@ class ignition::gazebo::systems::AckermannSteeringPrivate
   /// \brief Calculated speed of right joint
   public: double rightSteeringJointSpeed{0};
 
-  /// \brief Distance between left and right wheels
-  public: double wheelSeparation{1.0};
-
-  /// \brief Distance between left and right wheel kingpins
-  public: double kingpinWidth{0.8};
-
-  /// \brief Distance between front and back wheels
-  public: double wheelBase{1.0};
-
-  /// \brief Maximum turning angle to limit steering to
-  public: double steeringLimit{0.5};
-
-  /// \brief Wheel radius
-  public: double wheelRadius{0.2};
+  /// \brief Wheel separation, kingpin width, wheel base, steering limit and
+  /// wheel radius.
+  public: subt::odometry::AckermannGeometry geometry;
 
   /// \brief Model interface
   public: Model model{kNullEntity};
@@ -136,32 +127,18 @@ class ignition::gazebo::systems::AckermannSteeringPrivate
   /// \brief The model's canonical link.
   public: Link canonicalLink{kNullEntity};
 
-  /// \brief Update period calculated from <odom__publish_frequency>.
-  public: std::chrono::steady_clock::duration odomPubPeriod{0};
-
-  /// \brief Last sim time odom was published.
-  public: std::chrono::steady_clock::duration lastOdomPubTime{0};
+  /// \brief Triggers odometry publishing at <odom_publish_frequency>.
+  public: subt::odometry::FixedRateTrigger odomPubTrigger;
 
   /// \brief Ackermann steering odometry message publisher.
   public: transport::Node::Publisher odomPub;
 
-  /// \brief Odometry X value
-  public: double odomX{0.0};
-
-  /// \brief Odometry Y value
-  public: double odomY{0.0};
+  /// \brief Odometry integrated from the wheels.
+  public: subt::odometry::WheelOdometry odometry;
 
-  /// \brief Odometry yaw value
-  public: double odomYaw{0.0};
-
-  /// \brief Odometry old left value
-  public: double odomOldLeft{0.0};
-
-  /// \brief Odometry old right value
-  public: double odomOldRight{0.0};
-
-  /// \brief Odometry last time value
-  public: std::chrono::steady_clock::duration lastOdomTime{0};
+  /// \brief Odometry message reused for every publication, with the frame
+  /// ids already filled in.
+  public: subt::odometry::OdometryMessage odomMsg;
 
   /// \brief Linear velocity limiter.
   public: std::unique_ptr<SpeedLimiter> limiterLin;
@@ -180,12 +157,6 @@ class ignition::gazebo::systems::AckermannSteeringPrivate
 
   /// \brief A mutex to protect the target velocity command.
   public: std::mutex mutex;
-
-  /// \brief frame_id from sdf.
-  public: std::string sdfFrameId;
-
-  /// \brief child_frame_id from sdf.
-  public: std::string sdfChildFrameId;
 };
 
 //////////////////////////////////////////////////
@@ -247,16 +218,17 @@ void AckermannSteering::Configure(const Entity &_entity,
     sdfElem = sdfElem->GetNextElement("right_steering_joint");
   }
 
-  this->dataPtr->wheelSeparation = _sdf->Get<double>("wheel_separation",
-      this->dataPtr->wheelSeparation).first;
-  this->dataPtr->kingpinWidth = _sdf->Get<double>("kingpin_width",
-      this->dataPtr->kingpinWidth).first;
-  this->dataPtr->wheelBase = _sdf->Get<double>("wheel_base",
-      this->dataPtr->wheelBase).first;
-  this->dataPtr->steeringLimit = _sdf->Get<double>("steering_limit",
-      this->dataPtr->steeringLimit).first;
-  this->dataPtr->wheelRadius = _sdf->Get<double>("wheel_radius",
-      this->dataPtr->wheelRadius).first;
+  auto &geometry = this->dataPtr->geometry;
+  geometry.wheelSeparation = _sdf->Get<double>("wheel_separation",
+      geometry.wheelSeparation).first;
+  geometry.kingpinWidth = _sdf->Get<double>("kingpin_width",
+      geometry.kingpinWidth).first;
+  geometry.wheelBase = _sdf->Get<double>("wheel_base",
+      geometry.wheelBase).first;
+  geometry.steeringLimit = _sdf->Get<double>("steering_limit",
+      geometry.steeringLimit).first;
+  geometry.wheelRadius = _sdf->Get<double>("wheel_radius",
+      geometry.wheelRadius).first;
 
   // Parse speed limiter parameters.
   bool hasVelocityLimits     = false;
@@ -310,12 +282,7 @@ void AckermannSteering::Configure(const Entity &_entity,
     minVel, maxVel, minAccel, maxAccel, minJerk, maxJerk);
 
   double odomFreq = _sdf->Get<double>("odom_publish_frequency", 50).first;
-  if (odomFreq > 0)
-  {
-    std::chrono::duration<double> odomPer{1 / odomFreq};
-    this->dataPtr->odomPubPeriod =
-      std::chrono::duration_cast<std::chrono::steady_clock::duration>(odomPer);
-  }
+  this->dataPtr->odomPubTrigger.SetRate(odomFreq);
 
   // Subscribe to commands
   std::vector<std::string> topics;
@@ -353,11 +320,25 @@ void AckermannSteering::Configure(const Entity &_entity,
   this->dataPtr->odomPub = this->dataPtr->node.Advertise<msgs::Odometry>(
       odomTopic);
 
+  // The frame ids don't change, so they are stored in the message once.
+  const std::string modelName = this->dataPtr->model.Name(_ecm);
+  std::string frameId = modelName + "/odom";
   if (_sdf->HasElement("frame_id"))
-    this->dataPtr->sdfFrameId = _sdf->Get<std::string>("frame_id");
+    frameId = _sdf->Get<std::string>("frame_id");
 
+  std::string childFrameId;
   if (_sdf->HasElement("child_frame_id"))
-    this->dataPtr->sdfChildFrameId = _sdf->Get<std::string>("child_frame_id");
+  {
+    childFrameId = _sdf->Get<std::string>("child_frame_id");
+  }
+  else
+  {
+    std::optional<std::string> linkName =
+      this->dataPtr->canonicalLink.Name(_ecm);
+    if (linkName)
+      childFrameId = modelName + "/" + *linkName;
+  }
+  this->dataPtr->odomMsg.SetFrames(frameId, childFrameId);
 
   ignmsg << "AckermannSteering subscribing to twist messages on [" <<
       topic << "]" << std::endl;
@@ -607,78 +588,17 @@ void AckermannSteeringPrivate::UpdateOdometry(
 
   // Calculate the odometry
   double phi = 0.5 * (leftSteeringPos->Data()[0] + rightSteeringPos->Data()[0]);
-  double radius = this->wheelBase / tan(phi);
-  double dist = 0.5 * this->wheelRadius *
-      ((leftPos->Data()[0] - this->odomOldLeft) +
-       (rightPos->Data()[0] - this->odomOldRight));
-  double deltaAngle = dist / radius;
-  this->odomYaw += deltaAngle;
-  this->odomYaw = math::Angle(this->odomYaw).Normalized().Radian();
-  this->odomX += dist * cos(this->odomYaw);
-  this->odomY += dist * sin(this->odomYaw);
-  auto odomTimeDiff = _info.simTime - this->lastOdomTime;
-  double tdiff = std::chrono::duration<double>(odomTimeDiff).count();
-  double odomLinearVelocity = dist / tdiff;
-  double odomAngularVelocity = deltaAngle / tdiff;
-  this->lastOdomTime = _info.simTime;
-  this->odomOldLeft = leftPos->Data()[0];
-  this->odomOldRight = rightPos->Data()[0];
+  this->odometry.UpdateAckermann(_info.simTime, leftPos->Data()[0],
+      rightPos->Data()[0], phi, this->geometry.wheelRadius,
+      this->geometry.wheelBase);
 
   // Throttle odometry publishing
-  auto diff = _info.simTime - this->lastOdomPubTime;
-  if (diff > std::chrono::steady_clock::duration::zero() &&
-      diff < this->odomPubPeriod)
-  {
+  if (!this->odomPubTrigger.Check(_info.simTime))
     return;
-  }
-  this->lastOdomPubTime = _info.simTime;
-
-  // Construct the odometry message and publish it.
-  msgs::Odometry msg;
-  msg.mutable_pose()->mutable_position()->set_x(this->odomX);
-  msg.mutable_pose()->mutable_position()->set_y(this->odomY);
-
-  math::Quaterniond orientation(0, 0, this->odomYaw);
-  msgs::Set(msg.mutable_pose()->mutable_orientation(), orientation);
-
-  msg.mutable_twist()->mutable_linear()->set_x(odomLinearVelocity);
-  msg.mutable_twist()->mutable_angular()->set_z(odomAngularVelocity);
 
-  // Set the time stamp in the header
-  msg.mutable_header()->mutable_stamp()->CopyFrom(
-      convert<msgs::Time>(_info.simTime));
-
-  // Set the frame id.
-  auto frame = msg.mutable_header()->add_data();
-  frame->set_key("frame_id");
-  if (this->sdfFrameId.empty())
-  {
-    frame->add_value(this->model.Name(_ecm) + "/odom");
-  }
-  else
-  {
-    frame->add_value(this->sdfFrameId);
-  }
-
-  std::optional<std::string> linkName = this->canonicalLink.Name(_ecm);
-  if (this->sdfChildFrameId.empty())
-  {
-    if (linkName)
-    {
-      auto childFrame = msg.mutable_header()->add_data();
-      childFrame->set_key("child_frame_id");
-      childFrame->add_value(this->model.Name(_ecm) + "/" + *linkName);
-    }
-  }
-  else
-  {
-    auto childFrame = msg.mutable_header()->add_data();
-    childFrame->set_key("child_frame_id");
-    childFrame->add_value(this->sdfChildFrameId);
-  }
-
-  // Publish the message
-  this->odomPub.Publish(msg);
+  // Publish the message. The velocities are averaged since the last one.
+  this->odomPub.Publish(this->odomMsg.Fill(_info.simTime, this->odometry));
+  this->odometry.ResetVelocityWindow();
 }
 
 //////////////////////////////////////////////////
@@ -708,35 +628,10 @@ void AckermannSteeringPrivate::UpdateVelocity(
   this->last0Cmd.ang = angVel;
 
   // Convert the target velocities to joint velocities and angles
-  double turningRadius = linVel / angVel;
-  double minimumTurningRadius = this->wheelBase / sin(this->steeringLimit);
-  if ((turningRadius >= 0.0) && (turningRadius < minimumTurningRadius))
-  {
-    turningRadius = minimumTurningRadius;
-  }
-  if ((turningRadius <= 0.0) && (turningRadius > -minimumTurningRadius))
-  {
-    turningRadius = -minimumTurningRadius;
-  }
-  // special case for angVel of zero
-  if (fabs(angVel) < 0.001)
-  {
-    turningRadius = 1000000000.0;
-  }
-
-  double leftSteeringJointAngle =
-      atan(this->wheelBase / (turningRadius - (this->kingpinWidth / 2.0)));
-  double rightSteeringJointAngle =
-      atan(this->wheelBase / (turningRadius + (this->kingpinWidth / 2.0)));
-  double phi = atan(this->wheelBase / turningRadius);
-
-  // Partially simulate a simple differential
-  this->rightJointSpeed =
-      (linVel * (1.0 + (this->wheelSeparation * tan(phi)) /
-                 (2.0 * this->wheelBase))) / this->wheelRadius;
-  this->leftJointSpeed =
-      (linVel * (1.0 - (this->wheelSeparation * tan(phi)) /
-                 (2.0 * this->wheelBase))) / this->wheelRadius;
+  const auto cmd = subt::odometry::AckermannInverseKinematics(this->geometry,
+      linVel, angVel);
+  this->leftJointSpeed = cmd.leftWheelSpeed;
+  this->rightJointSpeed = cmd.rightWheelSpeed;
 
   auto leftSteeringPos = _ecm.Component<components::JointPosition>(
       this->leftSteeringJoints[0]);
@@ -751,8 +646,8 @@ void AckermannSteeringPrivate::UpdateVelocity(
     return;
   }
 
-  double leftDelta = leftSteeringJointAngle - leftSteeringPos->Data()[0];
-  double rightDelta = rightSteeringJointAngle - rightSteeringPos->Data()[0];
+  double leftDelta = cmd.leftSteeringAngle - leftSteeringPos->Data()[0];
+  double rightDelta = cmd.rightSteeringAngle - rightSteeringPos->Data()[0];
 
   // Simple proportional control with a gain of 1
   // Adding programmable PID values might be a future feature.
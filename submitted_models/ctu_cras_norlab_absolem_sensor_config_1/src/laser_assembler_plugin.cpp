@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ignition/gazebo/System.hh>
+#include <ignition/gazebo/Util.hh>
+
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Quaternion.hh>
+#include <ignition/msgs/laserscan.pb.h>
+#include <ignition/msgs/pointcloud_packed.pb.h>
+#include <ignition/msgs/PointCloudPackedUtils.hh>
+#include <ignition/plugin/Register.hh>
+#include <ignition/transport/Node.hh>
+
+#include "ignition/gazebo/components/JointPosition.hh"
+#include "ignition/gazebo/components/Name.hh"
+#include "ignition/gazebo/components/ParentEntity.hh"
+#include "ignition/gazebo/components/ParentLinkName.hh"
+#include "ignition/gazebo/components/Sensor.hh"
+#include "ignition/gazebo/components/World.hh"
+#include "ignition/gazebo/Model.hh"
+
+using namespace ignition;
+using namespace gazebo;
+using namespace systems;
+
+namespace cras
+{
+/// \brief Assembles the scans of the rotating Absolem lidar into 3D point clouds. It is meant to be used together with
+/// LaserRotatePlugin. Every time the lidar reaches one end of its sweep, all points measured during the half-sweep are
+/// published as a single point cloud.
+///
+/// The clouds are deskewed: each ray is transformed using the pose the lidar had when the ray was measured, which is
+/// interpolated from the joint and body motion recorded every simulation step. All points are then expressed in the
+/// parent link of the lidar joint at the time of the last scan of the half-sweep, which is also the cloud stamp.
+/// Robot motion during the sweep is thus compensated, too.
+///
+/// Scans are processed in the transport thread and only when somebody subscribes to the cloud topic. When unused, the
+/// plugin only records the lidar pose every simulation step. The cloud is built in a buffer allocated once for `<max_scans>` scans.
+///
+/// # Parameters
+///
+/// `<joint_name>`: Name of the joint that rotates the lidar. Default is `laser_j`.
+///
+/// `<link_name>`: Name of the link the lidar sensor is attached to. Default is `laser`.
+///
+/// `<sensor_name>`: Name of the lidar sensor. Default is `laser`.
+///
+/// `<scan_topic>`: Topic with the scans of the lidar. This element is optional, and the default value is
+/// `/world/{world_name}/model/{name_of_model}/link/{link_name}/sensor/{sensor_name}/scan`.
+///
+/// `<topic>`: Topic the point clouds are published on. This element is optional, and the default value is
+/// `/world/{world_name}/model/{name_of_model}/link/{link_name}/sensor/{sensor_name}/points_deskewed`.
+///
+/// `<frame_id>`: Frame id of the published clouds. Default is `{name_of_model}/{parent_link_of_joint}`.
+///
+/// `<scan_time>`: Time it takes to measure one scan, in seconds. The rays of a scan are spread evenly over this time.
+/// The simulated lidar measures all rays at once, so the default is 0. Set it when emulating a real scanner.
+///
+/// `<max_scans>`: Maximum number of scans in one cloud. If the lidar does not rotate, a cloud is published whenever
+/// this many scans have been collected. Default is 200 (4 seconds of scans at 50 Hz).
+///
+/// # Subscriptions
+///
+/// `{scan_topic}` (`ignition::msgs::LaserScan`): The scans of the lidar.
+///
+/// # Publications
+///
+/// `{topic}` (`ignition::msgs::PointCloudPacked`): The deskewed point clouds with fields x, y, z and intensity.
+class LaserAssemblerPlugin : public System, public ISystemConfigure, public ISystemPostUpdate
+{
+  /// \brief Pose of the lidar at one simulation step.
+  protected: struct Sample
+  {
+    std::chrono::steady_clock::duration time;
+    math::Pose3d sensorPose;  //!< World pose of the lidar.
+    math::Pose3d parentPose;  //!< World pose of the parent link of the joint.
+    double jointPosition;
+  };
+
+  public: ~LaserAssemblerPlugin() override
+  {
+    // Stop the scan callbacks before the buffers they use are destroyed.
+    this->node.reset();
+  }
+
+  public: void Configure(const Entity& _entity, const std::shared_ptr<const sdf::Element>& _sdf,
+                         EntityComponentManager& _ecm, EventManager& _eventMgr) override
+  {
+    this->model = Model(_entity);
+    if (!this->model.Valid(_ecm))
+    {
+      ignerr << "LaserAssemblerPlugin should be attached to a model entity. Failed to initialize." << std::endl;
+      return;
+    }
+
+    this->jointName = _sdf->Get<std::string>("joint_name", this->jointName).first;
+    this->linkName = _sdf->Get<std::string>("link_name", this->linkName).first;
+    this->sensorName = _sdf->Get<std::string>("sensor_name", this->sensorName).first;
+    this->scanTime = std::max(0.0, _sdf->Get<double>("scan_time", this->scanTime).first);
+    this->maxScans = std::max(1, _sdf->Get<int>("max_scans", this->maxScans).first);
+    if (_sdf->HasElement("frame_id"))
+      this->frameId = _sdf->Get<std::string>("frame_id");
+
+    std::string worldName {"default"};
+    const auto worldEntity = _ecm.EntityByComponents(components::World());
+    if (worldEntity != kNullEntity)
+      worldName = _ecm.Component<components::Name>(worldEntity)->Data();
+
+    const std::string sensorPrefix {"/world/" + worldName + "/model/" + this->model.Name(_ecm) + "/link/" +
+                                    this->linkName + "/sensor/" + this->sensorName};
+
+    std::string topic {sensorPrefix + "/points_deskewed"};
+    if (_sdf->HasElement("topic"))
+      topic = _sdf->Get<std::string>("topic");
+
+    std::string scanTopic {sensorPrefix + "/scan"};
+    if (_sdf->HasElement("scan_topic"))
+      scanTopic = _sdf->Get<std::string>("scan_topic");
+
+    this->timeline.resize(this->timelineCapacity);
+
+    this->node = std::make_unique<transport::Node>();
+    this->publisher = this->node->Advertise<msgs::PointCloudPacked>(topic);
+    this->node->Subscribe(scanTopic, &LaserAssemblerPlugin::OnScan, this);
+
+    ignmsg << "LaserAssemblerPlugin assembling scans from [" << scanTopic << "] to point clouds on [" << topic << "]"
+           << std::endl;
+  }
+
+  public: void PostUpdate(const UpdateInfo& _info, const EntityComponentManager& _ecm) override
+  {
+    if (_info.dt < std::chrono::steady_clock::duration::zero())
+    {
+      ignwarn << "Detected jump back in time ["
+              << std::chrono::duration_cast<std::chrono::seconds>(_info.dt).count()
+              << "s]. Resetting LaserAssemblerPlugin." << std::endl;
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->timelineSize = 0;
+      this->pendingScans.clear();
+      this->ResetCloud();
+      return;
+    }
+
+    if (!this->FindEntities(_ecm))
+      return;
+
+    Sample sample;
+    sample.time = _info.simTime;
+    sample.sensorPose = worldPose(this->sensor, _ecm);
+    sample.parentPose = worldPose(this->parentLink, _ecm);
+    sample.jointPosition = 0.0;
+    const auto jointPosition = _ecm.Component<components::JointPosition>(this->joint);
+    if (jointPosition != nullptr && !jointPosition->Data().empty())
+      sample.jointPosition = jointPosition->Data()[0];
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    // Paused simulation does not move anything.
+    if (this->timelineSize > 0 && this->SampleAt(this->timelineSize - 1).time >= sample.time)
+      return;
+
+    if (this->timelineSize == this->timeline.size())
+    {
+      this->timelineStart = (this->timelineStart + 1) % this->timeline.size();
+      --this->timelineSize;
+    }
+    this->SampleAt(this->timelineSize++) = sample;
+
+    // Scans that arrived before their poses were recorded can be processed now.
+    this->ProcessPendingScans();
+  }
+
+  public: void OnScan(const msgs::LaserScan& _msg)
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    if (this->pendingScans.size() >= this->maxPendingScans)
+    {
+      if (!this->warnedDropping)
+        ignwarn << "LaserAssemblerPlugin is dropping scans, no lidar poses are being recorded." << std::endl;
+      this->warnedDropping = true;
+      this->spareScans.push_back(std::move(this->pendingScans.front()));
+      this->pendingScans.pop_front();
+    }
+
+    // Reuse the scan messages so that their repeated fields are not reallocated for every scan.
+    if (this->spareScans.empty())
+    {
+      this->pendingScans.emplace_back();
+    }
+    else
+    {
+      this->pendingScans.push_back(std::move(this->spareScans.back()));
+      this->spareScans.pop_back();
+    }
+    this->pendingScans.back().CopyFrom(_msg);
+
+    this->ProcessPendingScans();
+  }
+
+  /// \brief Resolve the entities the poses are read from.
+  /// \return Whether all of them were found.
+  protected: bool FindEntities(const EntityComponentManager& _ecm)
+  {
+    if (this->sensor != kNullEntity)
+      return true;
+
+    if (this->joint == kNullEntity)
+      this->joint = this->model.JointByName(_ecm, this->jointName);
+    const auto link = this->model.LinkByName(_ecm, this->linkName);
+    if (this->joint == kNullEntity || link == kNullEntity)
+      return false;
+
+    const auto parentLinkName = _ecm.Component<components::ParentLinkName>(this->joint);
+    if (parentLinkName == nullptr)
+      return false;
+
+    this->parentLink = this->model.LinkByName(_ecm, parentLinkName->Data());
+    const auto sensorEntity = _ecm.EntityByComponents(components::ParentEntity(link),
+                                                      components::Name(this->sensorName), components::Sensor());
+    if (this->parentLink == kNullEntity || sensorEntity == kNullEntity)
+      return false;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->frameId.empty())
+      this->frameId = this->model.Name(_ecm) + "/" + parentLinkName->Data();
+    this->sensor = sensorEntity;
+    return true;
+  }
+
+  protected: Sample& SampleAt(const size_t _index)
+  {
+    return this->timeline[(this->timelineStart + _index) % this->timeline.size()];
+  }
+
+  /// \brief Interpolate the recorded poses. Has to be called with the mutex locked.
+  /// \param[in] _time The simulation time to interpolate at.
+  /// \param[out] _sample The interpolated sample.
+  /// \return False if _time is not covered by the timeline.
+  protected: bool Interpolate(const std::chrono::steady_clock::duration _time, Sample& _sample)
+  {
+    if (this->timelineSize == 0 || _time < this->SampleAt(0).time ||
+        _time > this->SampleAt(this->timelineSize - 1).time)
+      return false;
+
+    // The first sample not older than _time.
+    size_t low = 0;
+    size_t high = this->timelineSize - 1;
+    while (low < high)
+    {
+      const size_t middle = (low + high) / 2;
+      if (this->SampleAt(middle).time < _time)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+    const auto& after = this->SampleAt(low);
+    if (low == 0 || after.time == _time)
+    {
+      _sample = after;
+      return true;
+    }
+
+    const auto& before = this->SampleAt(low - 1);
+    const double ratio = std::chrono::duration<double>(_time - before.time).count() /
+                         std::chrono::duration<double>(after.time - before.time).count();
+    _sample.time = _time;
+    _sample.sensorPose = Lerp(before.sensorPose, after.sensorPose, ratio);
+    _sample.parentPose = Lerp(before.parentPose, after.parentPose, ratio);
+    _sample.jointPosition = before.jointPosition + ratio * (after.jointPosition - before.jointPosition);
+    return true;
+  }
+
+  protected: static math::Pose3d Lerp(const math::Pose3d& _a, const math::Pose3d& _b, const double _ratio)
+  {
+    return {_a.Pos() + _ratio * (_b.Pos() - _a.Pos()), math::Quaterniond::Slerp(_ratio, _a.Rot(), _b.Rot(), true)};
+  }
+
+  /// \brief Add all pending scans whose poses are already recorded to the cloud. Has to be called with the mutex
+  /// locked.
+  protected: void ProcessPendingScans()
+  {
+    while (!this->pendingScans.empty())
+    {
+      const auto& scan = this->pendingScans.front();
+      const auto stamp = std::chrono::steady_clock::duration(
+        std::chrono::seconds(scan.header().stamp().sec()) + std::chrono::nanoseconds(scan.header().stamp().nsec()));
+      const auto end = stamp + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(this->scanTime));
+
+      // Wait for the simulation to record the poses.
+      if (this->timelineSize == 0 || end > this->SampleAt(this->timelineSize - 1).time)
+        return;
+
+      Sample first, last;
+      if (this->Interpolate(stamp, first) && this->Interpolate(end, last))
+        this->AddScan(scan, first, last);
+      else
+        ignwarn << "LaserAssemblerPlugin is dropping a scan older than the recorded lidar poses." << std::endl;
+
+      this->spareScans.push_back(std::move(this->pendingScans.front()));
+      this->pendingScans.pop_front();
+    }
+  }
+
+  /// \brief Add one scan to the cloud, publishing the cloud first if the lidar has turned around.
+  /// \param[in] _scan The scan.
+  /// \param[in] _first The lidar poses when the first ray was measured.
+  /// \param[in] _last The lidar poses when the last ray was measured.
+  protected: void AddScan(const msgs::LaserScan& _scan, const Sample& _first, const Sample& _last)
+  {
+    // The sweep direction is only known once the joint has moved.
+    const double motion = _last.jointPosition - this->lastJointPosition;
+    const int direction = (std::abs(motion) < 1e-6) ? 0 : ((motion > 0) ? 1 : -1);
+    this->lastJointPosition = _last.jointPosition;
+    if (direction != 0 && this->sweepDirection != 0 && direction != this->sweepDirection)
+      this->PublishCloud();
+    if (direction != 0)
+      this->sweepDirection = direction;
+
+    const size_t horizontalCount = _scan.count();
+    const size_t verticalCount = std::max(1u, _scan.vertical_count());
+    const size_t rayCount = std::min<size_t>(horizontalCount * verticalCount, _scan.ranges_size());
+    if (rayCount == 0)
+      return;
+
+    // Nobody listens, so only the sweep boundaries are tracked.
+    if (!this->publisher.HasConnections())
+    {
+      this->ResetCloud();
+      return;
+    }
+
+    if (this->numScans == 0)
+    {
+      this->cloudOrigin = _first.parentPose;
+      if (this->cloud.data().size() < this->maxScans * rayCount * kPointStep)
+      {
+        msgs::InitPointCloudPacked(this->cloud, this->frameId, false,
+                                   {{"xyz", msgs::PointCloudPacked::Field::FLOAT32},
+                                    {"intensity", msgs::PointCloudPacked::Field::FLOAT32}});
+        this->cloud.set_height(1);
+        this->cloud.mutable_data()->resize(this->maxScans * rayCount * kPointStep);
+      }
+    }
+
+    // Rays are interpolated between the first and the last pose relative to the origin of the cloud.
+    const auto originInverse = this->cloudOrigin.Inverse();
+    const auto firstPose = _first.sensorPose + originInverse;
+    const auto lastPose = _last.sensorPose + originInverse;
+    const bool interpolateRays = _first.time != _last.time;
+
+    const bool hasIntensities = _scan.intensities_size() >= static_cast<int>(rayCount);
+    const double verticalStep = (verticalCount > 1) ? _scan.vertical_angle_step() : 0.0;
+    char* data = &(*this->cloud.mutable_data())[0];
+    const size_t capacity = this->cloud.data().size() / kPointStep;
+
+    for (size_t v = 0; v < verticalCount; ++v)
+    {
+      const double verticalAngle = _scan.vertical_angle_min() + v * verticalStep;
+      const double cosVertical = std::cos(verticalAngle);
+      const double sinVertical = std::sin(verticalAngle);
+      for (size_t h = 0; h < horizontalCount; ++h)
+      {
+        const size_t ray = v * horizontalCount + h;
+        if (ray >= rayCount || this->numPoints >= capacity)
+          break;
+
+        const double range = _scan.ranges(ray);
+        if (!std::isfinite(range) || range < _scan.range_min() || range > _scan.range_max())
+          continue;
+
+        const double horizontalAngle = _scan.angle_min() + h * _scan.angle_step();
+        const math::Vector3d point {range * cosVertical * std::cos(horizontalAngle),
+                                    range * cosVertical * std::sin(horizontalAngle),
+                                    range * sinVertical};
+
+        const auto& pose = interpolateRays ? Lerp(firstPose, lastPose, static_cast<double>(ray) / rayCount) :
+                                             firstPose;
+        const auto transformed = pose.Rot().RotateVector(point) + pose.Pos();
+
+        const float values[4] {static_cast<float>(transformed.X()), static_cast<float>(transformed.Y()),
+                               static_cast<float>(transformed.Z()),
+                               hasIntensities ? static_cast<float>(_scan.intensities(ray)) : 0.0f};
+        std::memcpy(data + this->numPoints * kPointStep, values, kPointStep);
+        ++this->numPoints;
+      }
+    }
+
+    ++this->numScans;
+    this->cloudEnd = _last;
+    this->cloudStamp = _scan.header().stamp();
+
+    if (this->numScans >= static_cast<size_t>(this->maxScans))
+      this->PublishCloud();
+  }
+
+  /// \brief Publish the assembled cloud in the parent link frame at the time of its last scan and start a new one.
+  protected: void PublishCloud()
+  {
+    if (this->numPoints == 0)
+    {
+      this->ResetCloud();
+      return;
+    }
+
+    // The points are relative to the origin of the cloud, move them to its end.
+    const auto correction = this->cloudOrigin + this->cloudEnd.parentPose.Inverse();
+    if (correction != math::Pose3d::Zero)
+    {
+      char* data = &(*this->cloud.mutable_data())[0];
+      for (size_t i = 0; i < this->numPoints; ++i)
+      {
+        float values[3];
+        std::memcpy(values, data + i * kPointStep, sizeof(values));
+        const auto point = correction.CoordPositionAdd(math::Vector3d(values[0], values[1], values[2]));
+        values[0] = static_cast<float>(point.X());
+        values[1] = static_cast<float>(point.Y());
+        values[2] = static_cast<float>(point.Z());
+        std::memcpy(data + i * kPointStep, values, sizeof(values));
+      }
+    }
+
+    // Shrinking and growing the data keeps its capacity, so the buffer is not reallocated.
+    const size_t capacity = this->cloud.data().size();
+    *this->cloud.mutable_header()->mutable_stamp() = this->cloudStamp;
+    this->cloud.mutable_data()->resize(this->numPoints * kPointStep);
+    this->cloud.set_width(this->numPoints);
+    this->cloud.set_row_step(this->numPoints * kPointStep);
+    this->cloud.set_is_dense(true);
+    this->publisher.Publish(this->cloud);
+    this->cloud.mutable_data()->resize(capacity);
+
+    this->ResetCloud();
+  }
+
+  protected: void ResetCloud()
+  {
+    this->numPoints = 0;
+    this->numScans = 0;
+  }
+
+  protected: static constexpr size_t kPointStep {4 * sizeof(float)};
+
+  protected: Model model{kNullEntity};
+  protected: std::string jointName {"laser_j"};
+  protected: std::string linkName {"laser"};
+  protected: std::string sensorName {"laser"};
+  protected: std::string frameId;
+  protected: double scanTime {0.0};
+  protected: int maxScans {200};
+  protected: Entity joint{kNullEntity};
+  protected: Entity parentLink{kNullEntity};
+  protected: Entity sensor{kNullEntity};
+
+  protected: std::unique_ptr<transport::Node> node;
+  protected: transport::Node::Publisher publisher;
+
+  /// \brief Protects everything below, which is shared by the simulation and transport threads.
+  protected: std::mutex mutex;
+
+  /// \brief Ring buffer of the lidar poses, long enough to cover the delay of the scans.
+  protected: std::vector<Sample> timeline;
+  protected: size_t timelineStart {0};
+  protected: size_t timelineSize {0};
+  protected: const size_t timelineCapacity {4096};
+
+  /// \brief Scans waiting for their poses to be recorded, and scan messages kept for reuse.
+  protected: std::deque<msgs::LaserScan> pendingScans;
+  protected: std::vector<msgs::LaserScan> spareScans;
+  protected: const size_t maxPendingScans {16};
+  protected: bool warnedDropping {false};
+
+  protected: msgs::PointCloudPacked cloud;
+  protected: size_t numPoints {0};
+  protected: size_t numScans {0};
+  protected: math::Pose3d cloudOrigin;  //!< World pose of the parent link when the first scan was measured.
+  protected: Sample cloudEnd;  //!< Poses when the last scan was measured.
+  protected: msgs::Time cloudStamp;
+  protected: double lastJointPosition {0.0};
+  protected: int sweepDirection {0};
+};
+
+}
+
+IGNITION_ADD_PLUGIN(cras::LaserAssemblerPlugin,
+                    System,
+                    ISystemConfigure,
+                    ISystemPostUpdate)
+
+IGNITION_ADD_PLUGIN_ALIAS(cras::LaserAssemblerPlugin, "cras::LaserAssemblerPlugin")
@@ -4,6 +4,7 @@
 /* includes() //{ */
 
 #include <Eigen/Geometry>
+#include <optional>
 #include <vector>
 
 #include <sdf/sdf.hh>
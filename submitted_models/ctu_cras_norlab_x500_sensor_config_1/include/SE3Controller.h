@@ -40,6 +40,15 @@ public:
   Eigen::VectorXd CalculateRotorVelocities(const FrameData &simulator_model_data, const EigenTwist &control_command,
                                            const SE3ControllerFeedforward &feedforward_command) const;
 
+  // the same without any heap allocation, the result is written to rotor_velocities
+  // N is the number of rotors, instantiated for 4, 6, 8 and Eigen::Dynamic (the fallback for other rotor counts)
+  // with N == Eigen::Dynamic, rotor_velocities has to have RotorCount() rows
+  template <int N>
+  void CalculateRotorVelocities(const FrameData &simulator_model_data, const EigenTwist &control_command,
+                                const SE3ControllerFeedforward &feedforward_command, Eigen::Ref<Eigen::Matrix<double, N, 1>> rotor_velocities) const;
+
+  int RotorCount() const;
+
 private:
   // | ----------------------- parameters ----------------------- |
 
@@ -55,6 +64,10 @@ private:
 
   // | -------------------- internal methods -------------------- |
 
+  // desired angular acceleration in the body frame and the desired thrust
+  Eigen::Vector4d ComputeAngularAccelerationThrust(const FrameData &simulator_model_data, const EigenTwist &control_command,
+                                                   const SE3ControllerFeedforward &feedforward_command) const;
+
   Eigen::Vector3d ComputeDesiredAcceleration(const FrameData &simulator_model_data, const Eigen::Vector3d &vel_ref, const Eigen::Vector3d &acc_ref) const;
   Eigen::Vector3d SO3Controller(const FrameData &simulator_model_data, const Eigen::Vector3d &des_acceleration, const Eigen::Vector3d &des_jerk,
                                 const double &des_yaw_rate) const;
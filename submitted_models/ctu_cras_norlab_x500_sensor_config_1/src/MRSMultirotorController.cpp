@@ -28,6 +28,7 @@
 #include <Eigen/Geometry>
 #include <memory>
 
+#include <algorithm>
 #include <limits>
 
 #include <Common.h>
@@ -92,7 +93,11 @@ private:
 
   void OnTwist(const msgs::Twist &msg);
   void OnEnable(const msgs::Boolean &msg);
-  void PublishRotorVelocities(ignition::gazebo::EntityComponentManager &ecm, const Eigen::VectorXd &vels);
+  void PublishRotorVelocities(ignition::gazebo::EntityComponentManager &ecm, const Eigen::Ref<const Eigen::VectorXd> &vels);
+
+  // runs the controller for N rotors and writes the result to rotor_velocities_, see SE3Controller::CalculateRotorVelocities()
+  template <int N>
+  void UpdateRotorVelocities(const FrameData &frame_data, const EigenTwist &cmd_vel, const SE3ControllerFeedforward &feedforward);
 
   // gazebo links and models
   Model  _gazebo_model_{kNullEntity};
@@ -103,6 +108,10 @@ private:
   Eigen::VectorXd rotor_velocities_;
   msgs::Actuators rotor_velocities_msg_;
 
+  // copies of the latest commands, kept between the updates so that the messages are not reallocated every step
+  msgs::Twist cmd_vel_copy_;
+  msgs::Twist feedforward_copy_;
+
   std::unique_ptr<multicopter_control::SE3Controller> multirotor_controller_ptr_;
 
   std::atomic<bool> is_active_{true};
@@ -356,7 +365,7 @@ void MRSMultirotorController::PreUpdate(const ignition::gazebo::UpdateInfo &_inf
     return;
   }
 
-  msgs::Twist cmd_vel;
+  msgs::Twist &cmd_vel = cmd_vel_copy_;
 
   {
     std::scoped_lock lock(mutex_cmd_vel_);
@@ -365,16 +374,18 @@ void MRSMultirotorController::PreUpdate(const ignition::gazebo::UpdateInfo &_inf
       return;
     }
 
-    cmd_vel = cmd_vel_.value();
+    cmd_vel.CopyFrom(cmd_vel_.value());
   }
 
-  msgs::Twist feedforward;
+  msgs::Twist &feedforward = feedforward_copy_;
 
   {
     std::scoped_lock lock(mutex_feedforward_);
 
     if (feedforward_.has_value()) {
-      feedforward = feedforward_.value();
+      feedforward.CopyFrom(feedforward_.value());
+    } else {
+      feedforward.Clear();
     }
   }
 
@@ -442,7 +453,21 @@ void MRSMultirotorController::PreUpdate(const ignition::gazebo::UpdateInfo &_inf
 
   // | -------------- calculate the control action -------------- |
 
-  rotor_velocities_ = multirotor_controller_ptr_->CalculateRotorVelocities(frameData.value(), cmd_vel_eigen, cmd_feedforward);
+  // the common rotor counts use the fixed-size specializations, the rest falls back to the dynamic version
+  switch (rotor_velocities_.size()) {
+    case 4:
+      UpdateRotorVelocities<4>(frameData.value(), cmd_vel_eigen, cmd_feedforward);
+      break;
+    case 6:
+      UpdateRotorVelocities<6>(frameData.value(), cmd_vel_eigen, cmd_feedforward);
+      break;
+    case 8:
+      UpdateRotorVelocities<8>(frameData.value(), cmd_vel_eigen, cmd_feedforward);
+      break;
+    default:
+      UpdateRotorVelocities<Eigen::Dynamic>(frameData.value(), cmd_vel_eigen, cmd_feedforward);
+      break;
+  }
 
   // publish the control action
   PublishRotorVelocities(ecm, rotor_velocities_);
@@ -450,6 +475,18 @@ void MRSMultirotorController::PreUpdate(const ignition::gazebo::UpdateInfo &_inf
 
 //}
 
+/* UpdateRotorVelocities() //{ */
+
+template <int N>
+void MRSMultirotorController::UpdateRotorVelocities(const FrameData &frame_data, const EigenTwist &cmd_vel, const SE3ControllerFeedforward &feedforward) {
+
+  Eigen::Map<Eigen::Matrix<double, N, 1>> rotor_velocities(rotor_velocities_.data(), rotor_velocities_.size());
+
+  multirotor_controller_ptr_->CalculateRotorVelocities<N>(frame_data, cmd_vel, feedforward, rotor_velocities);
+}
+
+//}
+
 /* OnTwist() //{ */
 
 void MRSMultirotorController::OnTwist(const msgs::Twist &msg) {
@@ -479,17 +516,15 @@ void MRSMultirotorController::OnEnable(const msgs::Boolean &msg) {
 
 /* PublishRotorVelocities() //{ */
 
-void MRSMultirotorController::PublishRotorVelocities(ignition::gazebo::EntityComponentManager &ecm, const Eigen::VectorXd &vels) {
+void MRSMultirotorController::PublishRotorVelocities(ignition::gazebo::EntityComponentManager &ecm, const Eigen::Ref<const Eigen::VectorXd> &vels) {
 
   // check the size of the message
   if (vels.size() != rotor_velocities_msg_.velocity_size()) {
     rotor_velocities_msg_.mutable_velocity()->Resize(vels.size(), 0);
   }
 
-  // fill in the velocities
-  for (int i = 0; i < vels.size(); ++i) {
-    rotor_velocities_msg_.set_velocity(i, vels(i));
-  }
+  // fill in the velocities, the repeated field keeps its capacity so nothing is allocated here
+  std::copy(vels.data(), vels.data() + vels.size(), rotor_velocities_msg_.mutable_velocity()->mutable_data());
 
   // Publish the message by setting the Actuators component on the model entity.
   // This assumes that the MulticopterMotorModel system is attached to this model
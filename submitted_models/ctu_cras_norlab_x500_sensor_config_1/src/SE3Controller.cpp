@@ -1,5 +1,7 @@
 /* includes //{ */
 
+#include <cassert>
+
 #include <SE3Controller.h>
 
 //}
@@ -34,36 +36,47 @@ SE3Controller::SE3Controller(const SE3ControllerParameters &controller_parameter
 Eigen::VectorXd SE3Controller::CalculateRotorVelocities(const FrameData &simulator_model_data, const EigenTwist &control_command,
                                                         const SE3ControllerFeedforward &feedforward_command) const {
 
-  // | ----- transform the stuff from the body to the world ----- |
+  Eigen::VectorXd rotor_velocities(RotorCount());
 
-  // rotation from the body to the world
-  Eigen::Matrix3d R = simulator_model_data.pose.linear();
+  CalculateRotorVelocities<Eigen::Dynamic>(simulator_model_data, control_command, feedforward_command, rotor_velocities);
 
-  Eigen::Vector3d vel_ref  = R * control_command.linear;
-  Eigen::Vector3d acc_ref  = R * feedforward_command.acceleration;
-  Eigen::Vector3d jerk_ref = R * feedforward_command.jerk;
-
-  // desired acceleration: proportional control of velocity + acceleration feedforward
-  Eigen::Vector3d des_acceleration = ComputeDesiredAcceleration(simulator_model_data, vel_ref, acc_ref);
+  return rotor_velocities;
+}
 
-  const double des_yaw_rate = control_command.angular[2];
+template <int N>
+void SE3Controller::CalculateRotorVelocities(const FrameData &simulator_model_data, const EigenTwist &control_command,
+                                             const SE3ControllerFeedforward &feedforward_command,
+                                             Eigen::Ref<Eigen::Matrix<double, N, 1>> rotor_velocities) const {
 
-  Eigen::Vector3d des_angular_acceleration = SO3Controller(simulator_model_data, des_acceleration, jerk_ref, des_yaw_rate);
+  const Eigen::Vector4d angularAccelerationThrust = ComputeAngularAccelerationThrust(simulator_model_data, control_command, feedforward_command);
 
-  // project thrust onto body z axis.
-  double thrust = _vehicle_parameters_.mass * des_acceleration.dot(simulator_model_data.pose.linear().col(2));
+  if constexpr (N == Eigen::Dynamic) {
+    assert(rotor_velocities.rows() == angular_acc_to_rotor_velocities_.rows());
+    rotor_velocities.noalias() = angular_acc_to_rotor_velocities_ * angularAccelerationThrust;
+  } else {
+    assert(N == angular_acc_to_rotor_velocities_.rows());
+    // the block has compile-time size, so the product is unrolled and evaluated on the stack
+    rotor_velocities.noalias() = angular_acc_to_rotor_velocities_.template topRows<N>() * angularAccelerationThrust;
+  }
 
-  Eigen::Vector4d angularAccelerationThrust;
+  rotor_velocities = rotor_velocities.cwiseMax(0.0).cwiseSqrt();
+}
 
-  angularAccelerationThrust.block<3, 1>(0, 0) = des_angular_acceleration;
-  angularAccelerationThrust(3)                = thrust;
+template void SE3Controller::CalculateRotorVelocities<4>(const FrameData &, const EigenTwist &, const SE3ControllerFeedforward &,
+                                                         Eigen::Ref<Eigen::Matrix<double, 4, 1>>) const;
+template void SE3Controller::CalculateRotorVelocities<6>(const FrameData &, const EigenTwist &, const SE3ControllerFeedforward &,
+                                                         Eigen::Ref<Eigen::Matrix<double, 6, 1>>) const;
+template void SE3Controller::CalculateRotorVelocities<8>(const FrameData &, const EigenTwist &, const SE3ControllerFeedforward &,
+                                                         Eigen::Ref<Eigen::Matrix<double, 8, 1>>) const;
+template void SE3Controller::CalculateRotorVelocities<Eigen::Dynamic>(const FrameData &, const EigenTwist &, const SE3ControllerFeedforward &,
+                                                                      Eigen::Ref<Eigen::VectorXd>) const;
 
-  Eigen::VectorXd rotor_velocities = angular_acc_to_rotor_velocities_ * angularAccelerationThrust;
+//}
 
-  rotor_velocities = rotor_velocities.cwiseMax(Eigen::VectorXd::Zero(rotor_velocities.rows()));
-  rotor_velocities = rotor_velocities.cwiseSqrt();
+/* RotorCount() //{ */
 
-  return rotor_velocities;
+int SE3Controller::RotorCount() const {
+  return static_cast<int>(angular_acc_to_rotor_velocities_.rows());
 }
 
 //}
@@ -108,6 +121,37 @@ bool SE3Controller::InitializeParameters() {
 
 //}
 
+/* ComputeAngularAccelerationThrust() //{ */
+
+Eigen::Vector4d SE3Controller::ComputeAngularAccelerationThrust(const FrameData &simulator_model_data, const EigenTwist &control_command,
+                                                                const SE3ControllerFeedforward &feedforward_command) const {
+
+  // | ----- transform the stuff from the body to the world ----- |
+
+  // rotation from the body to the world
+  const Eigen::Matrix3d R = simulator_model_data.pose.linear();
+
+  const Eigen::Vector3d vel_ref  = R * control_command.linear;
+  const Eigen::Vector3d acc_ref  = R * feedforward_command.acceleration;
+  const Eigen::Vector3d jerk_ref = R * feedforward_command.jerk;
+
+  // desired acceleration: proportional control of velocity + acceleration feedforward
+  const Eigen::Vector3d des_acceleration = ComputeDesiredAcceleration(simulator_model_data, vel_ref, acc_ref);
+
+  const double des_yaw_rate = control_command.angular[2];
+
+  Eigen::Vector4d angularAccelerationThrust;
+
+  angularAccelerationThrust.block<3, 1>(0, 0) = SO3Controller(simulator_model_data, des_acceleration, jerk_ref, des_yaw_rate);
+
+  // project thrust onto body z axis.
+  angularAccelerationThrust(3) = _vehicle_parameters_.mass * des_acceleration.dot(R.col(2));
+
+  return angularAccelerationThrust;
+}
+
+//}
+
 /* ComputeDesiredAcceleration() //{ */
 
 Eigen::Vector3d SE3Controller::ComputeDesiredAcceleration(const FrameData &simulator_model_data, const Eigen::Vector3d &vel_ref,
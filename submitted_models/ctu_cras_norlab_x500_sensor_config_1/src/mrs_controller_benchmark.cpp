@@ -0,0 +1,175 @@
+/* includes //{ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <SE3Controller.h>
+
+//}
+
+// Measures the time per control step of the SE3 controller and the number of heap allocations it makes.
+// Eigen allocates with malloc() directly, so the allocations are counted by wrapping the glibc allocator rather than
+// operator new (which ends up in malloc() too). This has to stay a standalone executable.
+
+/* allocation counting //{ */
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+static std::atomic<size_t> allocation_count{0};
+
+extern "C" void *malloc(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+
+//}
+
+using namespace ignition::gazebo::systems::multicopter_control;
+
+/* vehicleParameters() //{ */
+
+// a symmetric multirotor with the x500 mass and inertia
+static VehicleParameters vehicleParameters(const int rotor_count) {
+
+  VehicleParameters params;
+
+  params.mass    = 2.0;
+  params.inertia = Eigen::Vector3d(0.022, 0.022, 0.04).asDiagonal();
+  params.gravity = Eigen::Vector3d(0, 0, -9.81);
+
+  for (int i = 0; i < rotor_count; ++i) {
+    Rotor rotor;
+    rotor.angle          = M_PI / rotor_count + 2 * M_PI * i / rotor_count;
+    rotor.armLength      = 0.25;
+    rotor.forceConstant  = 8.54858e-06;
+    rotor.momentConstant = 0.016;
+    rotor.direction      = i % 2 == 0 ? 1 : -1;
+    params.rotorConfiguration.push_back(rotor);
+  }
+
+  return params;
+}
+
+//}
+
+/* measure() //{ */
+
+// runs the controller with the given step function and prints the time and the allocations per tick
+template <typename StepFunction>
+static void measure(const char *name, const int rotor_count, const int ticks, StepFunction step) {
+
+  SE3ControllerParameters controller_params;
+
+  controller_params.velocity_gain           = Eigen::Vector3d(2.7, 2.7, 2.7);
+  controller_params.attitude_gain           = Eigen::Vector3d(2, 3, 0.15);
+  controller_params.angular_rate_gain       = Eigen::Vector3d(0.4, 0.52, 0.18);
+  controller_params.max_linear_acceleration = Eigen::Vector3d(100, 100, 100);
+
+  const SE3Controller controller(controller_params, vehicleParameters(rotor_count));
+
+  FrameData frame_data;
+  frame_data.pose                = Eigen::Translation3d(1, 2, 3) * Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitZ());
+  frame_data.linearVelocityWorld = Eigen::Vector3d(0.5, 0.1, 0);
+  frame_data.angularVelocityBody = Eigen::Vector3d(0, 0, 0.05);
+
+  EigenTwist cmd_vel;
+  cmd_vel.linear  = Eigen::Vector3d(1, 0, 0.2);
+  cmd_vel.angular = Eigen::Vector3d(0, 0, 0.3);
+
+  SE3ControllerFeedforward feedforward;
+  feedforward.acceleration = Eigen::Vector3d(0.1, 0, 0);
+  feedforward.jerk         = Eigen::Vector3d::Zero();
+
+  Eigen::VectorXd rotor_velocities(rotor_count);
+  double          checksum = 0;
+
+  const size_t allocations_before = allocation_count.load();
+  const auto   start              = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < ticks; ++i) {
+
+    // vary the input so that the work can not be hoisted out of the loop
+    frame_data.linearVelocityWorld.x() = 0.5 + 1e-6 * i;
+
+    step(controller, frame_data, cmd_vel, feedforward, rotor_velocities);
+    checksum += rotor_velocities(0);
+  }
+
+  const auto   end         = std::chrono::steady_clock::now();
+  const size_t allocations = allocation_count.load() - allocations_before;
+
+  const double us_per_tick = std::chrono::duration<double, std::micro>(end - start).count() / ticks;
+
+  std::printf("%-22s rotors: %d  %8.3f us/tick  %6.3f allocations/tick  (checksum %g)\n", name, rotor_count, us_per_tick,
+              static_cast<double>(allocations) / ticks, checksum);
+}
+
+//}
+
+/* runBenchmarks() //{ */
+
+template <int N>
+static void runBenchmarks(const int rotor_count, const int ticks) {
+
+  if constexpr (N != Eigen::Dynamic) {
+    measure("fixed size", rotor_count, ticks, [](const auto &controller, const auto &frame, const auto &cmd, const auto &ff, Eigen::VectorXd &out) {
+      Eigen::Map<Eigen::Matrix<double, N, 1>> rotor_velocities(out.data(), out.size());
+      controller.template CalculateRotorVelocities<N>(frame, cmd, ff, rotor_velocities);
+    });
+  }
+
+  measure("dynamic", rotor_count, ticks, [](const auto &controller, const auto &frame, const auto &cmd, const auto &ff, Eigen::VectorXd &out) {
+    controller.template CalculateRotorVelocities<Eigen::Dynamic>(frame, cmd, ff, out);
+  });
+
+  // the allocating interface, for comparison
+  measure("VectorXd (allocating)", rotor_count, ticks, [](const auto &controller, const auto &frame, const auto &cmd, const auto &ff, Eigen::VectorXd &out) {
+    out = controller.CalculateRotorVelocities(frame, cmd, ff);
+  });
+}
+
+//}
+
+/* main() //{ */
+
+int main(int argc, char **argv) {
+
+  const int ticks = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+  if (ticks <= 0) {
+    std::fprintf(stderr, "usage: %s [ticks]\n", argv[0]);
+    return 1;
+  }
+
+  runBenchmarks<4>(4, ticks);
+  runBenchmarks<6>(6, ticks);
+  runBenchmarks<8>(8, ticks);
+  runBenchmarks<Eigen::Dynamic>(12, ticks);
+
+  return 0;
+}
+
+//}
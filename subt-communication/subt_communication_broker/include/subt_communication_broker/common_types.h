@@ -92,6 +92,9 @@ const std::string kEndPointRegistrationSrv = "/end_point/register";
 /// \brief Address used to receive neighbor updates.
 const std::string kNeighborsTopic = "/neighbors";
 
+/// \brief Topic used to publish the traffic counters of the broker.
+const std::string kTelemetryTopic = "/subt/comms/telemetry";
+
 /// \brief Default port.
 const uint32_t kDefaultPort = 4100u;
 
@@ -21,6 +21,7 @@
 
 #include <deque>
 #include <map>
+#include <memory>
 #include <random>
 #include <string>
 #include <vector>
@@ -30,6 +31,8 @@
 #include <subt_communication_broker/common_types.h>
 #include <subt_communication_broker/protobuf/datagram.pb.h>
 #include <subt_communication_broker/protobuf/neighbor_m.pb.h>
+#include <subt_communication_broker/subt_communication_telemetry.h>
+#include <subt_communication_broker/subt_communication_trace.h>
 #include <subt_communication_model/subt_communication_model.h>
 #include <subt_rf_interface/subt_rf_interface.h>
 
@@ -92,8 +95,8 @@ pose_update_function;
     /// \param[in] _endpoint End point requested to bind.
     /// \return True if the operation succeed or false otherwise (if the client
     /// was already bound to the same endpoint).
-    private: bool Bind(const std::string &_clientAddress,
-                       const std::string &_endpoint);
+    protected: bool Bind(const std::string &_clientAddress,
+                         const std::string &_endpoint);
 
     /// \brief Register a new client for message handling.
     /// \param[in] _id Unique ID of the client.
@@ -128,6 +131,27 @@ pose_update_function;
     /// \param[in] f Function that finds pose based on name
     public: void SetPoseUpdateFunction(pose_update_function f);
 
+    /// \brief Record the traffic to a trace file, which can be replayed
+    /// later. Recording stops when the broker is destroyed.
+    /// \param[in] _path Path of the trace file. It is overwritten.
+    /// \param[in] _payloads Whether to record the payloads of the messages.
+    /// \return True if the trace file was opened or false otherwise.
+    /// \sa TraceRecorder
+    public: bool RecordTrace(const std::string &_path, bool _payloads);
+
+    /// \brief Set how the traffic counters are published when the broker
+    /// starts. They are published on kTelemetryTopic every second by
+    /// default.
+    /// \param[in] _period Publishing period (s, wall clock), zero or less
+    /// to not publish.
+    /// \param[in] _file File to also write the counters to, in the
+    /// Prometheus text format, or empty.
+    public: void SetTelemetryOutput(double _period, const std::string &_file);
+
+    /// \brief Get the traffic counters.
+    /// \return The counters.
+    public: const Telemetry &TelemetryCounters() const;
+
     /// \brief Callback executed when a new registration request is received.
     /// \param[in] _req The address contained in the request.
     /// \param[out] _rep The result of the service. True when the registration
@@ -156,6 +180,15 @@ pose_update_function;
     /// \param[in] _req The datagram contained in the request.
     private: void OnMessage(const subt::msgs::Datagram &_req);
 
+    /// \brief Deliver a message that made it through the communication
+    /// model to a client. It is sent over Ignition Transport by default,
+    /// derived classes may override it, e.g., to run the broker headless.
+    /// \param[in] _address Address of the client.
+    /// \param[in] _msg The message.
+    /// \return True if the message was sent or false otherwise.
+    protected: virtual bool Deliver(const std::string &_address,
+                                    const subt::msgs::Datagram &_msg);
+
     /// \brief Queue to store the incoming messages received from the clients.
     protected: std::deque<msgs::Datagram> incomingMsgs;
 
@@ -185,6 +218,27 @@ pose_update_function;
 
     /// \brief Pose update function
    private: pose_update_function pose_update_f;
+
+    /// \brief Records the traffic, null if it isn't recorded.
+    private: std::unique_ptr<TraceRecorder> trace;
+
+    /// \brief Count a packet dropped outside of the communication model.
+    /// \param[in] _srcAddress Address of the sender.
+    /// \param[in] _dstAddress Address of the receiver or destination.
+    /// \param[in] _reason Why the packet was dropped.
+    /// \return Number of such drops on the link, including this one.
+    private: uint64_t CountDrop(const std::string &_srcAddress,
+                                const std::string &_dstAddress,
+                                rf_interface::drop_reason _reason);
+
+    /// \brief Traffic counters.
+    private: Telemetry telemetry;
+
+    /// \brief Publishing period of the traffic counters (s).
+    private: double telemetryPeriod = 1.0;
+
+    /// \brief File to write the traffic counters to, or empty.
+    private: std::string telemetryFile;
   };
 
 }
@@ -17,17 +17,26 @@
 #ifndef SUBT_GAZEBO_COMMSCLIENT_HH_
 #define SUBT_GAZEBO_COMMSCLIENT_HH_
 #include <ros/ros.h>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <ignition/transport/Node.hh>
 #include <subt_msgs/DatagramRos.h>
 
 #include <subt_communication_broker/common_types.h>
+#include <subt_communication_broker/subt_communication_compression.h>
+#include <subt_communication_broker/subt_communication_fragmentation.h>
 #include <subt_communication_broker/protobuf/datagram.pb.h>
 #include <subt_communication_broker/protobuf/neighbor_m.pb.h>
 
@@ -138,11 +147,68 @@ namespace subt
     /// multicast address.
     /// \param[in] _port Destination port.
     /// \return True when success or false otherwise (e.g.: if the payload was
-    /// bigger than 1500 bytes).
+    /// bigger than 1500 bytes). On ports with fragmentation enabled, true
+    /// means that the message was queued.
+    /// \sa EnableCompression()
+    /// \sa EnableFragmentation()
     public: bool SendTo(const std::string &_data,
                         const std::string &_dstAddress,
                         const uint32_t _port = communication_broker::kDefaultPort);
 
+    /// \brief Compress the payloads sent to and received on a port.
+    ///
+    /// All the clients using the port must enable compression on it with
+    /// the same dictionary. The payloads are marked, so those from clients
+    /// without compression or with another dictionary are discarded, and
+    /// the mismatch is reported once per sender. Payloads are compressed in
+    /// SendTo() and decompressed before calling the callbacks, so the port
+    /// is used as usual. Only the compressed size counts against the 1500
+    /// bytes limit and the capacity of the radio, so data of up to
+    /// PayloadCompressor::kMaxDataSize bytes can be sent if it compresses
+    /// well enough. With fragmentation also enabled on the port, data of up
+    /// to kMaxFragmentedMessageSize bytes can be sent.
+    ///
+    /// \param[in] _port The port.
+    /// \param[in] _dictionary Preset dictionary, e.g., a typical payload.
+    /// Small payloads compress much better with a dictionary.
+    /// \sa PayloadCompressor
+    public: void EnableCompression(const uint32_t _port,
+                                   const std::string &_dictionary = "");
+
+    /// \brief Split the messages sent to a port into fragments that fit in
+    /// a packet, and reassemble them on reception, so that messages of up
+    /// to kMaxFragmentedMessageSize bytes can be sent with a single call to
+    /// SendTo().
+    ///
+    /// All the clients using the port must enable fragmentation on it.
+    /// Fragments are queued and sent by a background thread, paced so that
+    /// the client doesn't exceed the capacity set with SetCapacity() over
+    /// any second, as the communication model would drop the excess. Each
+    /// burst of fragments ends with a marked fragment, and a receiver
+    /// missing fragments at that point reports them to the sender, which
+    /// sends them again. Receivers of unicast messages also acknowledge
+    /// them, and the sender sends the last fragment again when neither
+    /// arrives, in case the end of the burst was lost. To get the reports,
+    /// the sender must also be bound to the port. The sender forgets a
+    /// message, and the receivers discard an incomplete one, when the other
+    /// side stays silent for _timeout seconds.
+    ///
+    /// When compression is also enabled, messages are compressed before
+    /// being fragmented, and can be as big as the uncompressed ones.
+    ///
+    /// \param[in] _port The port.
+    /// \param[in] _timeout Time after which an incomplete message is
+    /// discarded by the receiver, and a message without reports forgotten
+    /// by the sender (s).
+    public: void EnableFragmentation(const uint32_t _port,
+                                     const double _timeout = 5.0);
+
+    /// \brief Set the capacity of the radio that fragments are paced to.
+    /// Use a value a bit below the capacity of the radio, to leave room for
+    /// the unpaced traffic of the client.
+    /// \param[in] _capacity Capacity in bits per second (default 1 Mbps).
+    public: void SetCapacity(const double _capacity);
+
     /// \brief Type for storing neighbor data
     public: typedef std::map<std::string, std::pair<double, double>> Neighbor_M;
 
@@ -178,6 +244,89 @@ namespace subt
     private: bool OnMessageRos(subt_msgs::DatagramRos::Request &_req,
                                subt_msgs::DatagramRos::Response &_res);
 
+    /// \brief Send a payload to the broker.
+    /// \param[in] _payload The payload.
+    /// \param[in] _dstAddress Destination address.
+    /// \param[in] _port Destination port.
+    /// \param[in] _lock Lock protecting the payload, if owned. It is
+    /// released once the payload is copied, before waiting for the broker.
+    /// \return True when success or false otherwise.
+    private: bool Transmit(const std::string &_payload,
+                           const std::string &_dstAddress,
+                           const uint32_t _port,
+                           std::unique_lock<std::mutex> &_lock);
+
+    /// \brief Reassemble and decompress a received payload, as enabled on
+    /// its port. The mutex must be locked.
+    /// \param[in] _srcAddress Address of the sender.
+    /// \param[in] _dstAddress Destination address of the payload.
+    /// \param[in] _port Destination port of the payload.
+    /// \param[in] _payload The payload.
+    /// \param[in] _now Current time (s).
+    /// \return The data, or null if there is no data for the callbacks yet.
+    private: const std::string *Unwrap(const std::string &_srcAddress,
+                                       const std::string &_dstAddress,
+                                       const uint32_t _port,
+                                       const std::string &_payload,
+                                       const double _now);
+
+    /// \brief Decompress a received payload if compression is enabled on its
+    /// port. The mutex must be locked.
+    /// \param[in] _srcAddress Address of the sender.
+    /// \param[in] _port Destination port of the payload.
+    /// \param[in] _payload The payload.
+    /// \return The data, or null if the payload could not be decompressed.
+    private: const std::string *Decompress(const std::string &_srcAddress,
+                                           const uint32_t _port,
+                                           const std::string &_payload);
+
+    /// \brief Queue the fragments of a message sent on a port with
+    /// fragmentation enabled. The fragmentMutex must be locked.
+    /// \param[in] _message The message.
+    /// \param[in] _dstAddress Destination address.
+    /// \param[in] _port Destination port.
+    /// \return False if the message is too big.
+    private: bool QueueFragments(const std::string &_message,
+                                 const std::string &_dstAddress,
+                                 const uint32_t _port);
+
+    /// \brief Queue a loss report ahead of the queued fragments. The
+    /// fragmentMutex must not be locked.
+    /// \param[in] _dstAddress Address of the sender of the message.
+    /// \param[in] _port Port of the message.
+    /// \param[in] _messageId Identifier of the message.
+    /// \param[in] _missing Indices of the missing fragments, or empty to
+    /// acknowledge the message.
+    private: void QueueLossReport(const std::string &_dstAddress,
+                                  const uint32_t _port,
+                                  const uint32_t _messageId,
+                                  const std::vector<uint16_t> &_missing);
+
+    /// \brief Queue the fragments a receiver reported missing, or forget an
+    /// acknowledged message.
+    /// \param[in] _srcAddress Address of the receiver.
+    /// \param[in] _port Port of the message.
+    /// \param[in] _report The loss report.
+    /// \param[in] _header Its header.
+    private: void OnLossReport(
+                 const std::string &_srcAddress,
+                 const uint32_t _port,
+                 const std::string &_report,
+                 const communication_broker::FragmentHeader &_header);
+
+    /// \brief Forget the expired messages, and queue again the last
+    /// fragment of the unicast messages whose receiver neither acknowledged
+    /// them nor reported losses in time. The fragmentMutex must be locked.
+    /// \param[in] _now Current time (s).
+    private: void CheckSentMessages(const double _now);
+
+    /// \brief Body of the thread sending the queued fragments.
+    private: void PaceLoop();
+
+    /// \brief Current simulation time.
+    /// \return The time (s).
+    private: double Now() const;
+
     /// \brief On clock message. This is used primarily/only by the
     /// BaseStation.
     private: void OnClock(const ignition::msgs::Clock &_clock);
@@ -235,6 +384,125 @@ namespace subt
     /// \brief A mutex for avoiding race conditions.
     private: mutable std::mutex mutex;
 
+    /// \brief Compressors of the ports with compression enabled. Changing it
+    /// requires locking both mutex and compressionMutex, so either of them
+    /// protects reading it.
+    private: std::map<uint32_t, std::unique_ptr<communication_broker::
+      PayloadCompressor>> compressors;
+
+    /// \brief Protects compressing payloads in SendTo(), which doesn't lock
+    /// mutex so that it can be called from the callbacks.
+    private: std::mutex compressionMutex;
+
+    /// \brief Compressed payload being sent, reused between calls.
+    private: std::string txPayload;
+
+    /// \brief Decompressed data being received, reused between calls.
+    private: std::string rxData;
+
+    /// \brief Senders and ports whose payloads could not be decompressed,
+    /// so that the mismatch is reported once. Protected by mutex.
+    private: std::set<std::pair<std::string, uint32_t>> mismatchedSenders;
+
+    /// \brief A packet waiting to be sent by the pacing thread.
+    private: struct QueuedPacket
+    {
+      /// \brief Destination address.
+      std::string dstAddress;
+
+      /// \brief Destination port.
+      uint32_t port;
+
+      /// \brief Identifier of the message of the fragment. The fragment is
+      /// made from sentMessages when sent.
+      uint32_t messageId;
+
+      /// \brief Index of the fragment.
+      uint16_t index;
+
+      /// \brief Whether the fragment ends a burst.
+      bool endOfBurst;
+
+      /// \brief A loss report to send instead of a fragment, if not empty.
+      std::string report;
+    };
+
+    /// \brief A message kept by the sender to resend lost fragments.
+    private: struct SentMessage
+    {
+      /// \brief Destination address of the message.
+      std::string dstAddress;
+
+      /// \brief Port of the message.
+      uint32_t port;
+
+      /// \brief The message.
+      std::string data;
+
+      /// \brief Time after which it is forgotten, a timeout after the end
+      /// of the last burst answered by a report (s).
+      double expiration;
+
+      /// \brief Time after which the last fragment is sent again if the
+      /// receiver didn't answer (s).
+      double probeTime;
+
+    };
+
+    /// \brief Timeouts of the ports with fragmentation enabled. Changing it
+    /// requires locking both mutex and fragmentMutex, so either of them
+    /// protects reading it.
+    private: std::map<uint32_t, double> fragmentTimeouts;
+
+    /// \brief Reassemblers of the ports with fragmentation enabled,
+    /// protected by mutex.
+    private: std::map<uint32_t, std::unique_ptr<
+      communication_broker::Reassembler>> reassemblers;
+
+    /// \brief Message being reassembled, reused between calls.
+    private: std::string rxMessage;
+
+    /// \brief Fragment indices missing from a message, reused between calls.
+    private: std::vector<uint16_t> rxMissing;
+
+    /// \brief Protects the members used to send fragments.
+    private: std::mutex fragmentMutex;
+
+    /// \brief Wakes up the pacing thread.
+    private: std::condition_variable fragmentCv;
+
+    /// \brief Packets waiting to be sent by the pacing thread.
+    private: std::deque<QueuedPacket> fragmentQueue;
+
+    /// \brief Messages kept to resend lost fragments, by message id.
+    private: std::map<uint32_t, SentMessage> sentMessages;
+
+    /// \brief Identifier of the next fragmented message. The first one is
+    /// random.
+    private: uint32_t nextMessageId = 0;
+
+    /// \brief Fragment being sent by the pacing thread, reused between
+    /// fragments.
+    private: std::string txFragment;
+
+    /// \brief Bytes sent over the last second, to pace the fragments.
+    private: communication_broker::CapacityPacer pacer;
+
+    /// \brief Sends the queued fragments, started by the first call to
+    /// EnableFragmentation().
+    private: std::thread pacingThread;
+
+    /// \brief Whether fragmentation was enabled on any port, so the packets
+    /// sent are recorded by the pacer.
+    private: std::atomic<bool> fragmenting{false};
+
+    /// \brief Whether the pacing thread should exit.
+    private: bool stopPacing = false;
+
+    /// \brief Simulation time of the last clock message (s). Used by the
+    /// base station.
+    private: std::atomic<double> clockTime{0.0};
+
     /// \brief Service that receives comms messages.
     private: ros::ServiceServer commsModelOnMessageService;
 
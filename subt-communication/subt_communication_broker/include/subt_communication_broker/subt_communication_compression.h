@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/// \file subt_communication_compression.h
+/// \brief Compression of the payloads sent by CommsClient.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace subt
+{
+namespace communication_broker
+{
+  class PayloadCompressorPrivate;
+
+  /// \brief Encodings of a compressed payload, stored in its header.
+  enum class PayloadEncoding : uint8_t
+  {
+    /// \brief The rest of the payload is the data as is.
+    kRaw = 0,
+
+    /// \brief The rest of the payload is the data compressed with raw
+    /// deflate, using the dictionary of the port.
+    kDeflate = 1
+  };
+
+  /// \brief Compresses payloads with zlib, optionally with a preset
+  /// dictionary. Small payloads such as map fragments and artifact reports
+  /// compress much better with a dictionary of typical content, as they
+  /// are too short for the compressor to learn from.
+  ///
+  /// Every compressed payload starts with a header of kHeaderSize bytes:
+  /// two magic bytes, the version of the format and the PayloadEncoding in
+  /// one byte, and a tag of the dictionary. Payloads without the magic
+  /// bytes, from another version or compressed with another dictionary are
+  /// rejected instead of being decoded into garbage. Data that doesn't
+  /// compress is sent raw, so a payload is at most kHeaderSize bytes larger
+  /// than its data. The sender and the receiver must use the same
+  /// dictionary.
+  ///
+  /// The zlib streams are reused between payloads. Compress() and
+  /// Decompress() can be called concurrently with each other, but not with
+  /// themselves.
+  class PayloadCompressor
+  {
+    /// \brief Default largest data Compress() takes and Decompress()
+    /// produces. Bigger data is rejected, so that a corrupt payload can't
+    /// make the receiver allocate without bounds.
+    /// \sa SetMaxDataSize()
+    public: static const size_t kMaxDataSize = 64 * 1024;
+
+    /// \brief Size of the header of the compressed payloads.
+    public: static const size_t kHeaderSize = 4;
+
+    /// \brief Version of the format of the compressed payloads.
+    public: static const uint8_t kVersion = 1;
+
+    /// \brief Constructor.
+    /// \param[in] _dictionary Preset dictionary, possibly empty. Only its
+    /// last 32 KiB are used.
+    /// \param[in] _level zlib compression level, from 1 (fastest) to 9
+    /// (smallest).
+    public: explicit PayloadCompressor(const std::string &_dictionary = "",
+                                       int _level = 6);
+
+    /// \brief Destructor.
+    public: ~PayloadCompressor();
+
+    /// \brief The zlib streams can't be copied.
+    public: PayloadCompressor(const PayloadCompressor &) = delete;
+
+    /// \brief The zlib streams can't be copied.
+    public: PayloadCompressor &operator=(const PayloadCompressor &) = delete;
+
+    /// \brief Set the largest data Compress() takes and Decompress()
+    /// produces. The sender and the receiver must use the same limit.
+    /// \param[in] _size The size, kMaxDataSize by default.
+    public: void SetMaxDataSize(size_t _size);
+
+    /// \brief Largest data Compress() takes and Decompress() produces.
+    /// \return The size.
+    public: size_t MaxDataSize() const;
+
+    /// \brief Compress data.
+    /// \param[in] _data The data.
+    /// \param[out] _payload The compressed payload. Its memory is reused.
+    /// \return False if the data is bigger than MaxDataSize().
+    public: bool Compress(const std::string &_data, std::string &_payload);
+
+    /// \brief Decompress a payload.
+    /// \param[in] _payload The compressed payload.
+    /// \param[out] _data The data. Its memory is reused.
+    /// \return False if the payload isn't compressed, is corrupt, was
+    /// compressed by another version or with another dictionary, or holds
+    /// more than MaxDataSize() bytes.
+    public: bool Decompress(const std::string &_payload, std::string &_data);
+
+    /// \brief Whether a payload starts with the magic bytes of the
+    /// compressed payloads, of any version.
+    /// \param[in] _payload The payload.
+    /// \return False if the sender likely didn't compress it.
+    public: static bool IsCompressed(const std::string &_payload);
+
+    /// \brief Private data pointer, hides the zlib streams.
+    private: std::unique_ptr<PayloadCompressorPrivate> dataPtr;
+  };
+}
+}
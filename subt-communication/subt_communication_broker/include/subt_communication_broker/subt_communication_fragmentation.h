@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/// \file subt_communication_fragmentation.h
+/// \brief Fragmentation of the messages sent by CommsClient.
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <subt_rf_interface/subt_rf_interface.h>
+
+namespace subt
+{
+namespace communication_broker
+{
+  /// \brief Types of the packets of a port with fragmentation enabled.
+  enum class FragmentType : uint8_t
+  {
+    /// \brief A fragment of a message.
+    kData = 1,
+
+    /// \brief The indices of the fragments of a message the receiver
+    /// misses, sent back to the sender. A report without indices
+    /// acknowledges a complete message.
+    kLossReport = 2
+  };
+
+  /// \brief Header of the packets of a port with fragmentation enabled.
+  struct FragmentHeader
+  {
+    /// \brief Size of the header in a packet.
+    static const size_t kSize = 10;
+
+    /// \brief Type of the packet.
+    FragmentType type = FragmentType::kData;
+
+    /// \brief Whether the sender won't send further fragments of the
+    /// message until it gets a loss report.
+    bool endOfBurst = false;
+
+    /// \brief Identifier of the message, unique per sender.
+    uint32_t messageId = 0;
+
+    /// \brief Index of the fragment.
+    uint16_t index = 0;
+
+    /// \brief Number of fragments of the message, or of missing fragments
+    /// in a loss report.
+    uint16_t count = 0;
+  };
+
+  /// \brief Largest packet made by the functions below, the maximum
+  /// payload accepted by CommsClient.
+  const size_t kMaxFragmentPacketSize = 1500;
+
+  /// \brief Bytes of a message carried by each fragment but the last.
+  const size_t kFragmentDataSize =
+    kMaxFragmentPacketSize - FragmentHeader::kSize;
+
+  /// \brief Largest message that can be reassembled. Bigger messages are
+  /// rejected, so that the receiver's memory stays bounded.
+  const size_t kMaxFragmentedMessageSize = 16 * 1024 * 1024;
+
+  /// \brief Number of fragments of a message.
+  /// \param[in] _size Size of the message.
+  /// \return The number of fragments, at least one.
+  size_t FragmentCount(size_t _size);
+
+  /// \brief Read the header of a packet.
+  /// \param[in] _packet The packet.
+  /// \param[out] _header The header.
+  /// \return False if the packet is too short or of an unknown type.
+  bool ReadFragmentHeader(const std::string &_packet,
+                          FragmentHeader &_header);
+
+  /// \brief Make a fragment of a message.
+  /// \param[in] _message The message.
+  /// \param[in] _messageId Identifier of the message.
+  /// \param[in] _index Index of the fragment.
+  /// \param[in] _endOfBurst Whether it's the last fragment sent until a
+  /// loss report arrives.
+  /// \param[out] _packet The fragment. Its memory is reused.
+  void MakeFragment(const std::string &_message, uint32_t _messageId,
+                    uint16_t _index, bool _endOfBurst, std::string &_packet);
+
+  /// \brief Make a loss report. Only as many indices as fit in a packet are
+  /// reported, the rest are reported after the next retransmission.
+  /// \param[in] _messageId Identifier of the message.
+  /// \param[in] _missing Indices of the missing fragments, or empty to
+  /// acknowledge the message.
+  /// \param[out] _packet The loss report.
+  void MakeLossReport(uint32_t _messageId,
+                      const std::vector<uint16_t> &_missing,
+                      std::string &_packet);
+
+  /// \brief Read the indices of a loss report.
+  /// \param[in] _packet The loss report.
+  /// \param[in] _header Its header.
+  /// \param[out] _missing Indices of the missing fragments.
+  /// \return False if the packet is truncated.
+  bool ReadLossReport(const std::string &_packet,
+                      const FragmentHeader &_header,
+                      std::vector<uint16_t> &_missing);
+
+  /// \brief Results of Reassembler::Add().
+  enum class ReassemblyResult
+  {
+    /// \brief Fragments of the message are missing.
+    kIncomplete,
+
+    /// \brief The fragment completed the message.
+    kComplete,
+
+    /// \brief The fragment belongs to a message completed recently.
+    kDuplicate,
+
+    /// \brief The fragment was malformed, or belongs to a message that is
+    /// too big.
+    kInvalid
+  };
+
+  /// \brief Reassembles the messages received on a port.
+  ///
+  /// The messages being reassembled are identified by their sender and
+  /// message id. Their buffers come from a pool and return to it when the
+  /// message is complete or given up, so receiving messages of similar
+  /// sizes doesn't allocate. A message is given up when no fragment of it
+  /// arrives for a timeout.
+  class Reassembler
+  {
+    /// \brief Maximum number of messages reassembled at once per port.
+    /// When exceeded, the message that would time out first is given up.
+    public: static const size_t kMaxPending = 16;
+
+    /// \brief Constructor.
+    /// \param[in] _timeout Time after which a message is given up if no
+    /// fragment of it arrives (s).
+    public: explicit Reassembler(double _timeout);
+
+    /// \brief Add a fragment.
+    /// \param[in] _srcAddress Address of the sender.
+    /// \param[in] _packet The fragment.
+    /// \param[in] _now Current time (s).
+    /// \param[in,out] _message Set to the message when it is complete. Its
+    /// previous memory goes to the pool.
+    /// \param[out] _missing Set to the indices of the missing fragments if
+    /// the fragment ends a burst and some are missing, to be reported to
+    /// the sender. Cleared otherwise.
+    /// \return Whether the fragment completed its message, or was a
+    /// duplicate or invalid.
+    public: ReassemblyResult Add(const std::string &_srcAddress,
+                                 const std::string &_packet,
+                                 double _now,
+                                 std::string &_message,
+                                 std::vector<uint16_t> &_missing);
+
+    /// \brief Number of messages being reassembled.
+    /// \return The number of messages.
+    public: size_t Pending() const;
+
+    /// \brief Number of messages given up so far.
+    /// \return The number of messages.
+    public: uint64_t Expired() const;
+
+    /// \brief A message being reassembled.
+    private: struct Message
+    {
+      /// \brief The message, sized for all of its fragments.
+      std::string data;
+
+      /// \brief Which fragments arrived.
+      std::vector<bool> received;
+
+      /// \brief Number of fragments that arrived.
+      size_t receivedCount = 0;
+
+      /// \brief Time at which the message is given up (s).
+      double deadline = 0;
+    };
+
+    /// \brief Give up the messages whose deadline passed.
+    /// \param[in] _now Current time (s).
+    private: void Expire(double _now);
+
+    /// \brief Return the memory of a message to the pool.
+    /// \param[in] _message The message.
+    private: void Release(Message &&_message);
+
+    /// \brief Timeout of the messages (s).
+    private: double timeout;
+
+    /// \brief Messages being reassembled, by sender and message id.
+    private: std::map<std::pair<std::string, uint32_t>, Message> pending;
+
+    /// \brief Recently completed messages, so late duplicates of their
+    /// fragments are ignored.
+    private: std::deque<std::pair<std::string, uint32_t>> completed;
+
+    /// \brief Memory of finished messages, reused by new ones.
+    private: std::vector<Message> pool;
+
+    /// \brief Number of messages given up.
+    private: uint64_t expired = 0;
+  };
+
+  /// \brief Paces transmissions so that the bytes sent over the last second
+  /// stay within the capacity of the radio, which is what the
+  /// communication model enforces.
+  class CapacityPacer
+  {
+    /// \brief Constructor.
+    /// \param[in] _capacity Capacity of the radio (bits per second).
+    public: explicit CapacityPacer(double _capacity = 1e6);
+
+    /// \brief Set the capacity of the radio.
+    /// \param[in] _capacity Capacity of the radio (bits per second).
+    public: void SetCapacity(double _capacity);
+
+    /// \brief Whether a packet can be sent now without going over capacity.
+    /// A packet is always allowed if nothing was sent over the last second.
+    /// \param[in] _now Current time (s).
+    /// \param[in] _bytes Size of the packet.
+    /// \return True if it can be sent.
+    public: bool Ready(double _now, size_t _bytes);
+
+    /// \brief Record a sent packet.
+    /// \param[in] _now Current time (s).
+    /// \param[in] _bytes Size of the packet.
+    public: void Record(double _now, size_t _bytes);
+
+    /// \brief Number of entries kept for the last second.
+    /// \return The number of entries.
+    public: size_t Entries() const;
+
+    /// \brief Capacity of the radio (bits per second).
+    private: double capacity;
+
+    /// \brief Bytes sent over the last second.
+    private: rf_interface::sliding_window_counter sent;
+  };
+}
+}
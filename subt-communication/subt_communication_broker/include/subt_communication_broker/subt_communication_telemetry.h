@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/// \file subt_communication_telemetry.h
+/// \brief Counters of the traffic handled by the broker.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <ignition/transport/Node.hh>
+
+#include <subt_communication_broker/protobuf/comms_telemetry.pb.h>
+#include <subt_rf_interface/subt_rf_interface.h>
+
+namespace subt
+{
+namespace communication_broker
+{
+  /// \brief Per link counters of sent, delivered and dropped packets, and a
+  /// histogram of the dispatch times.
+  ///
+  /// Links are identified by the radio ids of their ends (see
+  /// communication_model::radio_id()). The counters live in a fixed set of
+  /// slots, and each thread updates the slot its id hashes to with relaxed
+  /// atomic increments, so recording neither locks nor allocates and
+  /// threads normally don't share cache lines. Reading sums all the slots,
+  /// and can be done from any thread at any time, e.g., by the publisher
+  /// thread started with Start().
+  class Telemetry
+  {
+    /// \brief Number of slots.
+    public: static const size_t kSlots = 16;
+
+    /// \brief Maximum number of links counted in a slot. Packets of
+    /// further links are only counted in DroppedLinks().
+    public: static const size_t kLinksPerSlot = 1024;
+
+    /// \brief Number of buckets of the dispatch time histogram.
+    public: static const size_t kHistogramBuckets = 24;
+
+    /// \brief Constructor.
+    public: Telemetry();
+
+    /// \brief Destructor. Stops publishing.
+    public: ~Telemetry();
+
+    /// \brief Copying would break the other threads using the counters.
+    public: Telemetry(const Telemetry &) = delete;
+
+    /// \brief Copying would break the other threads using the counters.
+    public: Telemetry &operator=(const Telemetry &) = delete;
+
+    /// \brief Name a radio in the output.
+    /// \param[in] _address Address of the radio.
+    public: void AddName(const std::string &_address);
+
+    /// \brief Count a packet the communication model is asked to deliver.
+    /// \param[in] _src Radio id of the sender.
+    /// \param[in] _dst Radio id of the receiver.
+    /// \param[in] _bytes Size of the payload.
+    public: void RecordSent(uint32_t _src, uint32_t _dst, uint64_t _bytes);
+
+    /// \brief Count a delivered packet.
+    /// \param[in] _src Radio id of the sender.
+    /// \param[in] _dst Radio id of the receiver.
+    /// \param[in] _bytes Size of the payload.
+    public: void RecordDelivered(uint32_t _src, uint32_t _dst,
+                                 uint64_t _bytes);
+
+    /// \brief Count a dropped packet.
+    /// \param[in] _src Radio id of the sender.
+    /// \param[in] _dst Radio id of the receiver.
+    /// \param[in] _reason Why it was dropped.
+    /// \return Number of drops of the link for this reason counted by the
+    /// calling thread, including this one.
+    public: uint64_t RecordDrop(uint32_t _src, uint32_t _dst,
+                                rf_interface::drop_reason _reason);
+
+    /// \brief Count a dispatch.
+    /// \param[in] _stamp Simulation time of the dispatch (s).
+    /// \param[in] _duration Time taken to dispatch (s).
+    public: void RecordDispatch(double _stamp, double _duration);
+
+    /// \brief Number of packets not counted because a slot was full.
+    /// \return The number of packets.
+    public: uint64_t DroppedLinks() const;
+
+    /// \brief Get the current counters.
+    /// \param[out] _msg The counters.
+    public: void Fill(subt::msgs::CommsTelemetry &_msg) const;
+
+    /// \brief Write the current counters in the Prometheus text format.
+    /// \param[out] _out Output stream.
+    public: void WriteMetrics(std::ostream &_out) const;
+
+    /// \brief Start publishing the counters periodically.
+    /// \param[in] _topic Topic to publish subt::msgs::CommsTelemetry on.
+    /// \param[in] _period Publishing period (s, wall clock). Nothing is
+    /// published if it isn't positive.
+    /// \param[in] _file File to write the metrics to, or empty. It is
+    /// replaced atomically, so readers never see a partial file.
+    public: void Start(const std::string &_topic, double _period,
+                       const std::string &_file);
+
+    /// \brief Stop publishing.
+    public: void Stop();
+
+    /// \brief Indices of the counters of a link.
+    private: enum Counter
+    {
+      kSent = 0,
+      kDelivered,
+      kBytesSent,
+      kBytesDelivered,
+      kFirstDrop,
+      kNumCounters = kFirstDrop + rf_interface::num_drop_reasons
+    };
+
+    /// \brief Counters of a link.
+    private: struct Entry
+    {
+      /// \brief Link key plus one, zero while the entry is free.
+      std::atomic<uint64_t> key{0};
+
+      /// \brief The counters, indexed by Counter.
+      std::array<std::atomic<uint64_t>, kNumCounters> counters;
+    };
+
+    /// \brief Counters updated by a set of threads. Each slot is a separate
+    /// allocation, so slots don't share cache lines.
+    private: struct Slot
+    {
+      /// \brief Open addressing hash table of the links.
+      std::array<Entry, kLinksPerSlot> entries;
+
+      /// \brief Dispatch time histogram.
+      std::array<std::atomic<uint64_t>, kHistogramBuckets> histogram;
+    };
+
+    /// \brief Get the slot of the calling thread, allocating it if needed.
+    /// \return The slot.
+    private: Slot &ThreadSlot();
+
+    /// \brief Get the counters of a link in a slot, adding the link if
+    /// needed.
+    /// \param[in] _slot The slot.
+    /// \param[in] _src Radio id of the sender.
+    /// \param[in] _dst Radio id of the receiver.
+    /// \return The counters, or null if the slot is full.
+    private: Entry *Find(Slot &_slot, uint32_t _src, uint32_t _dst);
+
+    /// \brief Sum the counters of all the slots.
+    /// \param[out] _links Counters by link key.
+    /// \param[out] _histogram Dispatch time histogram.
+    private: void Sum(
+        std::map<uint64_t, std::array<uint64_t, kNumCounters>> &_links,
+        std::array<uint64_t, kHistogramBuckets> &_histogram) const;
+
+    /// \brief Name of a radio in the output.
+    /// \param[in] _id Radio id.
+    /// \return Its address, or its id in hexadecimal if it wasn't named.
+    private: std::string Name(uint32_t _id) const;
+
+    /// \brief Body of the publisher thread.
+    /// \param[in] _topic Topic to publish on.
+    /// \param[in] _period Publishing period (s).
+    /// \param[in] _file Metrics file, or empty.
+    private: void PublishLoop(const std::string &_topic, double _period,
+                              const std::string &_file);
+
+    /// \brief The slots, allocated on first use.
+    private: std::array<std::atomic<Slot *>, kSlots> slots;
+
+    /// \brief Packets not counted because a slot was full.
+    private: std::atomic<uint64_t> droppedLinks{0};
+
+    /// \brief Simulation time of the last dispatch.
+    private: std::atomic<double> stamp{0.0};
+
+    /// \brief Addresses of the radios, by radio id.
+    private: std::map<uint32_t, std::string> names;
+
+    /// \brief Protects names.
+    private: mutable std::mutex namesMutex;
+
+    /// \brief Publishes the counters.
+    private: std::thread publisher;
+
+    /// \brief Protects stop.
+    private: std::mutex publisherMutex;
+
+    /// \brief Wakes up the publisher thread to stop.
+    private: std::condition_variable publisherCv;
+
+    /// \brief Whether the publisher thread should exit.
+    private: bool stop = false;
+  };
+}
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/// \file subt_communication_trace.h
+/// \brief Binary trace of the traffic handled by the broker.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <ignition/math/Pose3.hh>
+
+#include <subt_communication_broker/protobuf/datagram.pb.h>
+#include <subt_rf_interface/subt_rf_interface.h>
+
+namespace subt
+{
+namespace communication_broker
+{
+  /// \brief Types of the records of a trace.
+  enum class TraceRecordType : uint8_t
+  {
+    /// \brief A client registered. Sets address.
+    kRegister = 1,
+
+    /// \brief A client unregistered. Sets address.
+    kUnregister = 2,
+
+    /// \brief A client bound an end point. Sets address and endpoint.
+    kBind = 3,
+
+    /// \brief The broker started dispatching the queued messages. Sets
+    /// stamp. It is followed by a kPose record for each member of the team.
+    kDispatch = 4,
+
+    /// \brief Pose of a member of the team. Sets address and pose.
+    kPose = 5,
+
+    /// \brief The broker took a message from the queue. Sets stamp,
+    /// address (source), dstAddress, port, size and payload, if payloads
+    /// are recorded.
+    kMessage = 6,
+
+    /// \brief The broker decided whether to deliver the last message to a
+    /// client. Sets stamp, address (source), dstAddress (client),
+    /// delivered, rssi and reason.
+    kDelivery = 7,
+
+    /// \brief Records were dropped just before this one because the disk
+    /// couldn't keep up. Sets lostBytes.
+    kGap = 8
+  };
+
+  /// \brief A record of a trace. Only the fields of its type are set.
+  struct TraceRecord
+  {
+    /// \brief Type of the record.
+    TraceRecordType type = TraceRecordType::kRegister;
+
+    /// \brief Simulation time.
+    double stamp = 0;
+
+    /// \brief Address of a client, or of the source of a message.
+    std::string address;
+
+    /// \brief Address of the destination of a message.
+    std::string dstAddress;
+
+    /// \brief End point.
+    std::string endpoint;
+
+    /// \brief Destination port of a message.
+    uint32_t port = 0;
+
+    /// \brief Size of the payload of a message.
+    uint32_t size = 0;
+
+    /// \brief Payload of a message, empty if payloads weren't recorded.
+    std::string payload;
+
+    /// \brief Pose of a member of the team.
+    ignition::math::Pose3d pose;
+
+    /// \brief Whether a message was delivered.
+    bool delivered = false;
+
+    /// \brief Received signal strength of a delivered message (dBm).
+    double rssi = 0;
+
+    /// \brief Why a message wasn't delivered.
+    rf_interface::drop_reason reason = rf_interface::drop_reason::none;
+
+    /// \brief Bytes of records dropped at a gap.
+    uint64_t lostBytes = 0;
+  };
+
+  /// \brief Records the traffic handled by a broker to a binary file.
+  ///
+  /// Records are serialized into a memory buffer by the caller, and a
+  /// background thread writes full buffers to disk, so recording never
+  /// waits for the disk. If the disk can't keep up, whole buffers are
+  /// dropped and counted instead, and a kGap record marks where they were.
+  ///
+  /// The file starts with kTraceMagic, followed by the records. Each record
+  /// is its type (one byte) followed by its fields in native byte order.
+  /// Strings are stored as their length (uint32) followed by their bytes.
+  class TraceRecorder
+  {
+    /// \brief Constructor.
+    public: TraceRecorder() = default;
+
+    /// \brief Destructor. Closes the trace.
+    public: ~TraceRecorder();
+
+    /// \brief Start recording to a file.
+    /// \param[in] _path Path of the trace file. It is overwritten.
+    /// \param[in] _payloads Whether to record the payloads of the messages.
+    /// \return True if the file was opened or false otherwise.
+    public: bool Open(const std::string &_path, bool _payloads);
+
+    /// \brief Write the pending records and close the file.
+    public: void Close();
+
+    /// \brief Record the registration of a client.
+    /// \param[in] _address Address of the client.
+    public: void RecordRegister(const std::string &_address);
+
+    /// \brief Record the unregistration of a client.
+    /// \param[in] _address Address of the client.
+    public: void RecordUnregister(const std::string &_address);
+
+    /// \brief Record the binding of an end point.
+    /// \param[in] _address Address of the client.
+    /// \param[in] _endpoint End point.
+    public: void RecordBind(const std::string &_address,
+                            const std::string &_endpoint);
+
+    /// \brief Record the start of a dispatch.
+    /// \param[in] _stamp Simulation time.
+    public: void RecordDispatch(double _stamp);
+
+    /// \brief Record the pose of a member of the team.
+    /// \param[in] _address Address of the member.
+    /// \param[in] _pose Pose.
+    public: void RecordPose(const std::string &_address,
+                            const ignition::math::Pose3d &_pose);
+
+    /// \brief Record a message taken from the queue.
+    /// \param[in] _stamp Simulation time.
+    /// \param[in] _msg The message.
+    public: void RecordMessage(double _stamp,
+                               const subt::msgs::Datagram &_msg);
+
+    /// \brief Record a delivery decision.
+    /// \param[in] _stamp Simulation time.
+    /// \param[in] _srcAddress Address of the sender.
+    /// \param[in] _dstAddress Address of the client.
+    /// \param[in] _delivered Whether the message was delivered.
+    /// \param[in] _rssi Received signal strength (dBm).
+    /// \param[in] _reason Why the message wasn't delivered.
+    public: void RecordDelivery(double _stamp,
+                                const std::string &_srcAddress,
+                                const std::string &_dstAddress,
+                                bool _delivered,
+                                double _rssi,
+                                rf_interface::drop_reason _reason);
+
+    /// \brief Number of bytes of records dropped because the disk couldn't
+    /// keep up.
+    /// \return The number of bytes.
+    public: uint64_t DroppedBytes() const;
+
+    /// \brief Append the type of a record to the buffer, and queue the
+    /// buffer for writing if it is full. Call with the mutex locked.
+    /// \param[in] _type Type of the record.
+    private: void Begin(TraceRecordType _type);
+
+    /// \brief Append a value to the buffer.
+    /// \param[in] _value The value.
+    private: template<typename T> void Put(const T &_value);
+
+    /// \brief Append a string to the buffer.
+    /// \param[in] _value The string.
+    private: void PutString(const std::string &_value);
+
+    /// \brief Body of the writer thread.
+    private: void WriteLoop();
+
+    /// \brief The trace file.
+    private: std::ofstream file;
+
+    /// \brief Whether to record payloads.
+    private: bool payloads = false;
+
+    /// \brief Buffer receiving the records.
+    private: std::string buffer;
+
+    /// \brief Full buffers waiting to be written.
+    private: std::deque<std::string> pending;
+
+    /// \brief Protects buffer, pending and stop.
+    private: std::mutex mutex;
+
+    /// \brief Wakes up the writer thread.
+    private: std::condition_variable cv;
+
+    /// \brief Whether the writer thread should exit.
+    private: bool stop = false;
+
+    /// \brief Writes the pending buffers.
+    private: std::thread writer;
+
+    /// \brief Bytes dropped because too many buffers were pending.
+    private: std::atomic<uint64_t> droppedBytes{0};
+
+    /// \brief Bytes dropped since the last buffer queued for writing, to be
+    /// recorded in a kGap record.
+    private: uint64_t gapBytes = 0;
+  };
+
+  /// \brief Reads the records of a trace written by TraceRecorder.
+  class TraceReader
+  {
+    /// \brief Open a trace.
+    /// \param[in] _path Path of the trace file.
+    /// \return True if the file is a trace or false otherwise.
+    public: bool Open(const std::string &_path);
+
+    /// \brief Read the next record.
+    /// \param[out] _record The record.
+    /// \return False at the end of the trace, or if it is truncated.
+    public: bool Next(TraceRecord &_record);
+
+    /// \brief Read a value.
+    /// \param[out] _value The value.
+    /// \return True if the value was read.
+    private: template<typename T> bool Get(T &_value);
+
+    /// \brief Read a string.
+    /// \param[out] _value The string.
+    /// \return True if the string was read.
+    private: bool GetString(std::string &_value);
+
+    /// \brief The trace file.
+    private: std::ifstream file;
+  };
+
+  /// \brief Magic number at the start of a trace, with the format version.
+  const std::string kTraceMagic = "SUBTCOMMSTRACE01";
+}
+}
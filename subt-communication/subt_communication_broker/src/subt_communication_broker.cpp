@@ -16,6 +16,7 @@
  */
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <ignition/math/Rand.hh>
@@ -24,6 +25,7 @@
 #include <subt_communication_broker/protobuf/datagram.pb.h>
 #include <subt_communication_broker/protobuf/neighbor_m.pb.h>
 #include <subt_communication_broker/subt_communication_broker.h>
+#include <subt_communication_model/link_random.h>
 
 namespace subt
 {
@@ -82,6 +84,10 @@ void Broker::Start()
               << std::endl;
     return;
   }
+
+  // Publish the traffic counters.
+  this->telemetry.Start(kTelemetryTopic, this->telemetryPeriod,
+                        this->telemetryFile);
 }
 
 //////////////////////////////////////////////////
@@ -131,6 +137,8 @@ void Broker::DispatchMessages()
   if(this->incomingMsgs.empty())
     return;
 
+  const auto dispatchStart = std::chrono::steady_clock::now();
+
   // Cannot dispatch messages if we don't have function handles for
   // pathloss and communication
   if (!communication_function)
@@ -164,22 +172,45 @@ void Broker::DispatchMessages()
     }
   }
 
+  // All the members are updated at the same simulation time.
+  const double stamp = this->team->empty() ?
+    0.0 : this->team->begin()->second->rf_state.update_stamp;
+
+  if (this->trace)
+  {
+    this->trace->RecordDispatch(stamp);
+    for (const auto &t : *(this->team))
+      this->trace->RecordPose(t.first, t.second->rf_state.pose);
+  }
+
   while (!this->incomingMsgs.empty())
   {
     // Get the next message to dispatch.
     subt::msgs::Datagram msg = this->incomingMsgs.front();
     this->incomingMsgs.pop_front();
 
+    if (this->trace)
+      this->trace->RecordMessage(stamp, msg);
+
     // Sanity check: Make sure that the sender is a member of the team.
     auto txNode = this->team->find(msg.src_address());
     if (txNode == this->team->end())
     {
-      std::cerr << "Broker::DispatchMessages(): Discarding message. Robot ["
-                << msg.src_address() << "] is not registered as a member of the"
-                << " team" << std::endl;
+      if (this->CountDrop(msg.src_address(), msg.dst_address(),
+            rf_interface::drop_reason::unregistered) == 1)
+      {
+        std::cerr << "Broker::DispatchMessages(): Discarding message. Robot ["
+                  << msg.src_address() << "] is not registered as a member "
+                  << "of the team. Further drops are only counted in the "
+                  << "telemetry" << std::endl;
+      }
       continue;
     }
 
+    // Number the packets of each sender. The random draws of the
+    // communication model are keyed by this number.
+    ++txNode->second->rf_state.sequence;
+
     std::string dstEndPoint =
         msg.dst_address() + ":" + std::to_string(msg.dst_port());
 
@@ -187,10 +218,13 @@ void Broker::DispatchMessages()
     {
       std::vector<BrokerClientInfo> clientsV = this->endpoints.at(dstEndPoint);
 
-      if (clientsV.empty())
+      if (clientsV.empty() &&
+          this->CountDrop(msg.src_address(), msg.dst_address(),
+            rf_interface::drop_reason::no_endpoint) == 1)
       {
         std::cerr << "[Broker::DispatchMessages()]: No clients for endpoint "
-          << dstEndPoint << std::endl;
+          << dstEndPoint << ". Further drops are only counted in the "
+          << "telemetry" << std::endl;
       }
 
       for (const BrokerClientInfo &client : clientsV)
@@ -198,10 +232,14 @@ void Broker::DispatchMessages()
         auto rxNode = this->team->find(client.address);
         if (rxNode == this->team->end())
         {
-          std::cerr << "Broker::DispatchMessages(): Skipping send attempt."
-            << "Robot [" << client.address
-            << "] is not registered as a member of the"
-            << " team" << std::endl;
+          if (this->CountDrop(msg.src_address(), client.address,
+                rf_interface::drop_reason::unregistered) == 1)
+          {
+            std::cerr << "Broker::DispatchMessages(): Skipping send attempt. "
+              << "Robot [" << client.address
+              << "] is not registered as a member of the team. Further "
+              << "drops are only counted in the telemetry" << std::endl;
+          }
           continue;
         }
 
@@ -209,38 +247,73 @@ void Broker::DispatchMessages()
         // forward if so
         if (!txNode->second->radio.pathloss_f)
         {
-          std::cerr << "No pathloss function defined for "
-                    << msg.src_address() << std::endl;
+          if (this->CountDrop(msg.src_address(), client.address,
+                rf_interface::drop_reason::no_pathloss) == 1)
+          {
+            std::cerr << "No pathloss function defined for "
+                      << msg.src_address() << ". Further drops are only "
+                      << "counted in the telemetry" << std::endl;
+          }
           continue;
         }
 
+        const uint32_t txId = txNode->second->rf_state.id;
+        const uint32_t rxId = rxNode->second->rf_state.id;
+        this->telemetry.RecordSent(txId, rxId, msg.data().size());
+
         bool sendPacket;
         double rssi;
+        rxNode->second->rf_state.last_drop = rf_interface::drop_reason::unknown;
         std::tie(sendPacket, rssi) =
           communication_function(txNode->second->radio,
                                  txNode->second->rf_state,
                                  rxNode->second->rf_state,
                                  msg.data().size());
 
+        if (this->trace)
+        {
+          this->trace->RecordDelivery(stamp, msg.src_address(),
+            client.address, sendPacket, rssi,
+            sendPacket ? rf_interface::drop_reason::none :
+                         rxNode->second->rf_state.last_drop);
+        }
+
         if (sendPacket)
         {
           msg.set_rssi(rssi);
 
-          if (!this->node.Request(client.address, msg))
+          if (this->Deliver(client.address, msg))
+          {
+            this->telemetry.RecordDelivered(txId, rxId, msg.data().size());
+          }
+          else if (this->telemetry.RecordDrop(txId, rxId,
+                     rf_interface::drop_reason::transport) == 1)
           {
             std::cerr << "[CommsBrokerPlugin::DispatchMessages()]: Error "
-                      << "sending message to [" << client.address << "]"
+                      << "sending message to [" << client.address << "]. "
+                      << "Further errors are only counted in the telemetry"
                       << std::endl;
           }
         }
+        else
+        {
+          this->telemetry.RecordDrop(txId, rxId,
+                                     rxNode->second->rf_state.last_drop);
+        }
       }
     }
-    else
+    else if (this->CountDrop(msg.src_address(), msg.dst_address(),
+               rf_interface::drop_reason::no_endpoint) == 1)
     {
       std::cerr << "[Broker::DispatchMessages()]: Could not find endpoint "
-        << dstEndPoint << std::endl;
+        << dstEndPoint << ". Further drops are only counted in the "
+        << "telemetry" << std::endl;
     }
   }
+
+  const std::chrono::duration<double> dispatchTime =
+    std::chrono::steady_clock::now() - dispatchStart;
+  this->telemetry.RecordDispatch(stamp, dispatchTime.count());
 }
 
 //////////////////////////////////////////////////
@@ -267,6 +340,9 @@ bool Broker::Bind(const std::string &_clientAddress,
   clientInfo.address = _clientAddress;
   this->endpoints[_endpoint].push_back(clientInfo);
 
+  if (this->trace)
+    this->trace->RecordBind(_clientAddress, _endpoint);
+
   return true;
 }
 
@@ -289,7 +365,12 @@ bool Broker::Register(const std::string &_id)
     newMember->name = _id;
 
     newMember->radio = default_radio_configuration;
+    newMember->rf_state.id = communication_model::radio_id(_id);
     (*this->team)[_id] = newMember;
+    this->telemetry.AddName(_id);
+
+    if (this->trace)
+      this->trace->RecordRegister(_id);
   }
 
   return true;
@@ -309,6 +390,9 @@ bool Broker::Unregister(const std::string &_id)
 
   this->team->erase(_id);
 
+  if (this->trace)
+    this->trace->RecordUnregister(_id);
+
   // Unbind.
   for (auto &endpointKv : this->endpoints)
   {
@@ -387,6 +471,13 @@ void Broker::OnMessage(const subt::msgs::Datagram &_req)
   this->incomingMsgs.push_back(_req);
 }
 
+//////////////////////////////////////////////////
+bool Broker::Deliver(const std::string &_address,
+                     const subt::msgs::Datagram &_msg)
+{
+  return this->node.Request(_address, _msg);
+}
+
 void Broker::SetRadioConfiguration(const std::string& address,
                                    communication_model::radio_configuration config)
 {
@@ -433,5 +524,54 @@ void Broker::SetPoseUpdateFunction(pose_update_function f)
   pose_update_f = f;
 }
 
+//////////////////////////////////////////////////
+bool Broker::RecordTrace(const std::string &_path, bool _payloads)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->trace.reset(new TraceRecorder());
+  if (!this->trace->Open(_path, _payloads))
+  {
+    this->trace.reset();
+    return false;
+  }
+
+  // Start from the current state, so that the trace can be replayed on
+  // its own.
+  for (const auto &member : *(this->team))
+    this->trace->RecordRegister(member.first);
+  for (const auto &endpoint : this->endpoints)
+  {
+    for (const auto &client : endpoint.second)
+      this->trace->RecordBind(client.address, endpoint.first);
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+void Broker::SetTelemetryOutput(double _period, const std::string &_file)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->telemetryPeriod = _period;
+  this->telemetryFile = _file;
+}
+
+//////////////////////////////////////////////////
+const Telemetry &Broker::TelemetryCounters() const
+{
+  return this->telemetry;
+}
+
+//////////////////////////////////////////////////
+uint64_t Broker::CountDrop(const std::string &_srcAddress,
+                           const std::string &_dstAddress,
+                           rf_interface::drop_reason _reason)
+{
+  // Unregistered robots aren't named yet.
+  this->telemetry.AddName(_srcAddress);
+  this->telemetry.AddName(_dstAddress);
+  return this->telemetry.RecordDrop(communication_model::radio_id(_srcAddress),
+    communication_model::radio_id(_dstAddress), _reason);
+}
+
 }
 }
@@ -17,6 +17,8 @@
 
 #include <chrono>
 #include <iostream>
+#include <limits>
+#include <random>
 #include <string>
 #include <ignition/common/Console.hh>
 #include <subt_msgs/Bind.h>
@@ -28,6 +30,11 @@
 using namespace subt;
 using namespace subt::communication_broker;
 
+/// \brief Time after the end of a burst to wait for the receiver's report
+/// before probing it. Reports go ahead of the receiver's queue, so they are
+/// delayed by the capacity window at most (s).
+static const double kProbeDelay = 1.0;
+
 //////////////////////////////////////////////////
 CommsClient::CommsClient(const std::string &_localAddress,
   const bool _isPrivate, const bool _useIgnition)
@@ -37,6 +44,11 @@ CommsClient::CommsClient(const std::string &_localAddress,
 {
   this->enabled = false;
 
+  // Receivers remember the ids of the messages they completed. Start from a
+  // random id, so that a client created again with the same address, e.g.
+  // after its node restarts, doesn't reuse them.
+  this->nextMessageId = std::random_device()();
+
   // Sanity check: Verity that local address is not empty.
   if (_localAddress.empty())
   {
@@ -87,6 +99,17 @@ CommsClient::CommsClient(const std::string &_localAddress,
 //////////////////////////////////////////////////
 CommsClient::~CommsClient()
 {
+  // Fragments still queued are not sent.
+  if (this->pacingThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> fragmentLock(this->fragmentMutex);
+      this->stopPacing = true;
+    }
+    this->fragmentCv.notify_one();
+    this->pacingThread.join();
+  }
+
   this->beaconRunning = false;
   this->Unregister();
   if (this->beaconThread)
@@ -278,22 +301,68 @@ bool CommsClient::SendTo(const std::string &_data,
   if (!this->enabled)
     return false;
 
+  // Compress the payload if enabled on the port. Only the compressed size
+  // counts against the MTU.
+  std::unique_lock<std::mutex> lock(this->compressionMutex);
+  const std::string *payload = &_data;
+  auto compressor = this->compressors.find(_port);
+  if (compressor != this->compressors.end())
+  {
+    if (!compressor->second->Compress(_data, this->txPayload))
+    {
+      std::cerr << "[" << this->Host() << "] CommsClient::SendTo() error: "
+                << "Data size (" << _data.size() << ") is greater than the "
+                << "maximum allowed for compression ("
+                << compressor->second->MaxDataSize() << ")" << std::endl;
+      return false;
+    }
+    payload = &this->txPayload;
+  }
+  else
+  {
+    lock.unlock();
+  }
+
+  // Clients that never enabled fragmentation don't pace their packets.
+  if (this->fragmenting)
+  {
+    std::lock_guard<std::mutex> fragmentLock(this->fragmentMutex);
+
+    // Queue the fragments if enabled on the port.
+    if (this->fragmentTimeouts.find(_port) != this->fragmentTimeouts.end())
+      return this->QueueFragments(*payload, _dstAddress, _port);
+
+    // Other packets take their share of the capacity too.
+    if (payload->size() <= this->kMtu)
+      this->pacer.Record(this->Now(), payload->size());
+  }
+
   // Restrict the maximum size of a message.
-  if (_data.size() > this->kMtu)
+  if (payload->size() > this->kMtu)
   {
     std::cerr << "[" << this->Host() << "] CommsClient::SendTo() error: "
-              << "Payload size (" << _data.size() << ") is greater than the "
-              << "maximum allowed (" << this->kMtu << ")" << std::endl;
+              << "Payload size (" << payload->size() << ") is greater than "
+              << "the maximum allowed (" << this->kMtu << ")" << std::endl;
     return false;
   }
 
+  return this->Transmit(*payload, _dstAddress, _port, lock);
+}
+
+//////////////////////////////////////////////////
+bool CommsClient::Transmit(const std::string &_payload,
+    const std::string &_dstAddress, const uint32_t _port,
+    std::unique_lock<std::mutex> &_lock)
+{
   if (this->useIgnition)
   {
     msgs::Datagram msg;
     msg.set_src_address(this->Host());
     msg.set_dst_address(_dstAddress);
     msg.set_dst_port(_port);
-    msg.set_data(_data);
+    msg.set_data(_payload);
+    if (_lock.owns_lock())
+      _lock.unlock();
 
     return this->node.Request(kBrokerSrv, msg);
   }
@@ -304,12 +373,56 @@ bool CommsClient::SendTo(const std::string &_data,
     req.src_address = this->Host();
     req.dst_address = _dstAddress;
     req.dst_port = _port;
-    req.data = _data;
+    req.data = _payload;
+    if (_lock.owns_lock())
+      _lock.unlock();
 
     return ros::service::call(kBrokerSrv, req, rep);
   }
 }
 
+//////////////////////////////////////////////////
+void CommsClient::EnableCompression(const uint32_t _port,
+                                    const std::string &_dictionary)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  std::lock_guard<std::mutex> compressionLock(this->compressionMutex);
+  auto &compressor = this->compressors[_port];
+  compressor.reset(new PayloadCompressor(_dictionary));
+
+  // Compressed messages are fragmented too.
+  if (this->fragmentTimeouts.find(_port) != this->fragmentTimeouts.end())
+    compressor->SetMaxDataSize(kMaxFragmentedMessageSize);
+}
+
+//////////////////////////////////////////////////
+void CommsClient::EnableFragmentation(const uint32_t _port,
+                                      const double _timeout)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  std::lock_guard<std::mutex> compressionLock(this->compressionMutex);
+  std::lock_guard<std::mutex> fragmentLock(this->fragmentMutex);
+  this->fragmentTimeouts[_port] = _timeout;
+  this->reassemblers[_port].reset(new Reassembler(_timeout));
+
+  // Messages are compressed before being fragmented, so they can be as big
+  // as the fragmented ones.
+  auto compressor = this->compressors.find(_port);
+  if (compressor != this->compressors.end())
+    compressor->second->SetMaxDataSize(kMaxFragmentedMessageSize);
+
+  if (!this->pacingThread.joinable())
+    this->pacingThread = std::thread(&CommsClient::PaceLoop, this);
+  this->fragmenting = true;
+}
+
+//////////////////////////////////////////////////
+void CommsClient::SetCapacity(const double _capacity)
+{
+  std::lock_guard<std::mutex> fragmentLock(this->fragmentMutex);
+  this->pacer.SetCapacity(_capacity);
+}
+
 //////////////////////////////////////////////////
 CommsClient::Neighbor_M CommsClient::Neighbors() const
 {
@@ -434,12 +547,18 @@ void CommsClient::OnMessage(const msgs::Datagram &_msg)
     this->clockMsg.sim().nsec() * 1e-9;
   this->neighbors[_msg.src_address()] = std::make_pair(time, _msg.rssi());
 
+  const std::string *data =
+    this->Unwrap(_msg.src_address(), _msg.dst_address(), _msg.dst_port(),
+                 _msg.data(), time);
+  if (!data)
+    return;
+
   for (auto cb : this->callbacks)
   {
     if (cb.first == endPoint && cb.second)
     {
       cb.second(_msg.src_address(), _msg.dst_address(),
-          _msg.dst_port(), _msg.data());
+          _msg.dst_port(), *data);
     }
   }
 }
@@ -452,24 +571,302 @@ bool CommsClient::OnMessageRos(subt_msgs::DatagramRos::Request &_req,
 
   std::lock_guard<std::mutex> lock(this->mutex);
 
-  this->neighbors[_req.src_address] =
-      std::make_pair(ros::Time::now().toSec(), _req.rssi);
+  const double time = ros::Time::now().toSec();
+  this->neighbors[_req.src_address] = std::make_pair(time, _req.rssi);
+
+  const std::string *data =
+    this->Unwrap(_req.src_address, _req.dst_address, _req.dst_port,
+                 _req.data, time);
+  if (!data)
+    return true;
 
   for (auto cb : this->callbacks)
   {
     if (cb.first == endPoint && cb.second)
     {
       cb.second(_req.src_address, _req.dst_address,
-                _req.dst_port, _req.data);
+                _req.dst_port, *data);
     }
   }
 
   return true;
 }
 
+//////////////////////////////////////////////////
+const std::string *CommsClient::Unwrap(const std::string &_srcAddress,
+                                       const std::string &_dstAddress,
+                                       const uint32_t _port,
+                                       const std::string &_payload,
+                                       const double _now)
+{
+  auto reassembler = this->reassemblers.find(_port);
+  if (reassembler == this->reassemblers.end())
+    return this->Decompress(_srcAddress, _port, _payload);
+
+  FragmentHeader header;
+  if (!ReadFragmentHeader(_payload, header))
+    return nullptr;
+
+  if (header.type == FragmentType::kLossReport)
+  {
+    this->OnLossReport(_srcAddress, _port, _payload, header);
+    return nullptr;
+  }
+
+  // Only the messages sent to this client are acknowledged, the senders of
+  // broadcast messages can't tell how many receivers to expect.
+  const bool acknowledge = _dstAddress == this->Host();
+  switch (reassembler->second->Add(_srcAddress, _payload, _now,
+                                   this->rxMessage, this->rxMissing))
+  {
+    case ReassemblyResult::kComplete:
+      if (acknowledge)
+      {
+        this->QueueLossReport(_srcAddress, _port, header.messageId,
+                              this->rxMissing);
+      }
+      return this->Decompress(_srcAddress, _port, this->rxMessage);
+    case ReassemblyResult::kDuplicate:
+      // The acknowledgement was lost, and the sender is probing.
+      if (acknowledge && header.endOfBurst)
+      {
+        this->QueueLossReport(_srcAddress, _port, header.messageId,
+                              this->rxMissing);
+      }
+      return nullptr;
+    case ReassemblyResult::kIncomplete:
+      if (!this->rxMissing.empty())
+      {
+        this->QueueLossReport(_srcAddress, _port, header.messageId,
+                              this->rxMissing);
+      }
+      return nullptr;
+    case ReassemblyResult::kInvalid:
+      return nullptr;
+  }
+  return nullptr;
+}
+
+//////////////////////////////////////////////////
+const std::string *CommsClient::Decompress(const std::string &_srcAddress,
+                                           const uint32_t _port,
+                                           const std::string &_payload)
+{
+  auto compressor = this->compressors.find(_port);
+  if (compressor == this->compressors.end())
+    return &_payload;
+
+  if (!compressor->second->Decompress(_payload, this->rxData))
+  {
+    // Report each sender once, not every payload.
+    if (this->mismatchedSenders.emplace(_srcAddress, _port).second)
+    {
+      std::cerr << "[" << this->Host() << "] CommsClient: Discarding the "
+                << "payloads from " << _srcAddress << " on port " << _port
+                << ", which "
+                << (PayloadCompressor::IsCompressed(_payload) ?
+                    "were compressed by another version or with another "
+                    "dictionary" :
+                    "are not compressed. Enable compression on the sender "
+                    "too")
+                << std::endl;
+    }
+    return nullptr;
+  }
+  return &this->rxData;
+}
+
 //////////////////////////////////////////////////
 void CommsClient::OnClock(const ignition::msgs::Clock &_clock)
 {
   std::scoped_lock<std::mutex> lk(this->clockMutex);
   this->clockMsg.CopyFrom(_clock);
+  this->clockTime = _clock.sim().sec() + _clock.sim().nsec() * 1e-9;
+}
+
+//////////////////////////////////////////////////
+bool CommsClient::QueueFragments(const std::string &_message,
+                                 const std::string &_dstAddress,
+                                 const uint32_t _port)
+{
+  if (_message.size() > kMaxFragmentedMessageSize)
+  {
+    std::cerr << "[" << this->Host() << "] CommsClient::SendTo() error: "
+              << "Message size (" << _message.size() << ") is greater than "
+              << "the maximum allowed (" << kMaxFragmentedMessageSize << ")"
+              << std::endl;
+    return false;
+  }
+
+  // Keep the message until its last fragment is sent, and for a timeout
+  // after that.
+  const uint32_t id = this->nextMessageId++;
+  this->sentMessages[id] = SentMessage{_dstAddress, _port, _message,
+    std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+
+  const size_t count = FragmentCount(_message.size());
+  for (size_t i = 0; i < count; ++i)
+  {
+    this->fragmentQueue.push_back(QueuedPacket{_dstAddress, _port, id,
+      static_cast<uint16_t>(i), i + 1 == count, std::string()});
+  }
+  this->fragmentCv.notify_one();
+  return true;
+}
+
+//////////////////////////////////////////////////
+void CommsClient::QueueLossReport(const std::string &_dstAddress,
+                                  const uint32_t _port,
+                                  const uint32_t _messageId,
+                                  const std::vector<uint16_t> &_missing)
+{
+  // Reports go ahead of the queued fragments, the sender is waiting.
+  std::lock_guard<std::mutex> fragmentLock(this->fragmentMutex);
+  QueuedPacket report{_dstAddress, _port, _messageId, 0, false,
+                      std::string()};
+  MakeLossReport(_messageId, _missing, report.report);
+  this->fragmentQueue.push_front(std::move(report));
+  this->fragmentCv.notify_one();
+}
+
+//////////////////////////////////////////////////
+void CommsClient::OnLossReport(const std::string &_srcAddress,
+                               const uint32_t _port,
+                               const std::string &_report,
+                               const FragmentHeader &_header)
+{
+  std::vector<uint16_t> missing;
+  if (!ReadLossReport(_report, _header, missing))
+    return;
+
+  std::lock_guard<std::mutex> fragmentLock(this->fragmentMutex);
+  auto sent = this->sentMessages.find(_header.messageId);
+  if (sent == this->sentMessages.end() || sent->second.port != _port)
+    return;
+
+  // The receiver has the whole message.
+  if (missing.empty())
+  {
+    if (sent->second.dstAddress == _srcAddress)
+      this->sentMessages.erase(sent);
+    return;
+  }
+
+  // Only the receiver that reported the losses gets the fragments. The
+  // message is kept for another timeout after they are sent.
+  const size_t count = FragmentCount(sent->second.data.size());
+  sent->second.expiration = std::numeric_limits<double>::max();
+  sent->second.probeTime = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < missing.size(); ++i)
+  {
+    if (missing[i] >= count)
+      continue;
+    this->fragmentQueue.push_back(QueuedPacket{_srcAddress, _port,
+      _header.messageId, missing[i], i + 1 == missing.size(),
+      std::string()});
+  }
+  this->fragmentCv.notify_one();
+}
+
+//////////////////////////////////////////////////
+void CommsClient::CheckSentMessages(const double _now)
+{
+  for (auto it = this->sentMessages.begin(); it != this->sentMessages.end();)
+  {
+    SentMessage &sent = it->second;
+    if (sent.expiration < _now)
+    {
+      it = this->sentMessages.erase(it);
+      continue;
+    }
+
+    // Any fragment ending a burst makes the receiver report, so the last
+    // one tells whether the message arrived. Probes don't extend the
+    // expiration, a receiver out of range is given up after the timeout.
+    if (sent.probeTime < _now)
+    {
+      sent.probeTime = std::numeric_limits<double>::max();
+      this->fragmentQueue.push_back(QueuedPacket{sent.dstAddress, sent.port,
+        it->first, static_cast<uint16_t>(FragmentCount(sent.data.size()) - 1),
+        true, std::string()});
+    }
+    ++it;
+  }
+}
+
+//////////////////////////////////////////////////
+void CommsClient::PaceLoop()
+{
+  std::unique_lock<std::mutex> lock(this->fragmentMutex);
+  while (!this->stopPacing)
+  {
+    this->CheckSentMessages(this->Now());
+    if (this->fragmentQueue.empty())
+    {
+      // Keep checking the sent messages while there are some.
+      if (this->sentMessages.empty())
+        this->fragmentCv.wait(lock);
+      else
+        this->fragmentCv.wait_for(lock, std::chrono::milliseconds(10));
+      continue;
+    }
+
+    // Loss reports are sent as they are, fragments are made from the kept
+    // message.
+    QueuedPacket &next = this->fragmentQueue.front();
+    auto sent = this->sentMessages.end();
+    if (next.report.empty())
+    {
+      sent = this->sentMessages.find(next.messageId);
+      if (sent == this->sentMessages.end())
+      {
+        this->fragmentQueue.pop_front();
+        continue;
+      }
+      MakeFragment(sent->second.data, next.messageId, next.index,
+                   next.endOfBurst, this->txFragment);
+    }
+    const std::string &packet =
+      next.report.empty() ? this->txFragment : next.report;
+
+    // Wait for earlier packets to leave the window. Simulation time can run
+    // slower than the wall clock, so check again after a short while.
+    const double now = this->Now();
+    if (!this->pacer.Ready(now, packet.size()))
+    {
+      this->fragmentCv.wait_for(lock, std::chrono::milliseconds(10));
+      continue;
+    }
+    this->pacer.Record(now, packet.size());
+
+    // Receivers report losses after the end of a burst, until the timeout.
+    if (next.endOfBurst && sent != this->sentMessages.end())
+    {
+      if (sent->second.expiration == std::numeric_limits<double>::max())
+      {
+        sent->second.expiration = now +
+          this->fragmentTimeouts[sent->second.port];
+      }
+      if (sent->second.dstAddress != kBroadcast &&
+          sent->second.dstAddress != kMulticast)
+      {
+        sent->second.probeTime = now + kProbeDelay;
+      }
+    }
+
+    const QueuedPacket item = std::move(next);
+    this->fragmentQueue.pop_front();
+    this->Transmit(item.report.empty() ? this->txFragment : item.report,
+                   item.dstAddress, item.port, lock);
+    if (!lock.owns_lock())
+      lock.lock();
+  }
+}
+
+//////////////////////////////////////////////////
+double CommsClient::Now() const
+{
+  if (this->useIgnition)
+    return this->clockTime.load();
+  return ros::Time::now().toSec();
 }
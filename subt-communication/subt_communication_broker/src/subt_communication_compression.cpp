@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <zlib.h>
+#include <algorithm>
+#include <iostream>
+
+#include <subt_communication_broker/subt_communication_compression.h>
+
+namespace subt
+{
+namespace communication_broker
+{
+
+/// \brief Largest window of raw deflate, which also bounds the dictionary.
+static const size_t kWindowSize = 32 * 1024;
+
+/// \brief Magic bytes starting the compressed payloads.
+static const char kMagic[2] = {char(0xc5), 'z'};
+
+const size_t PayloadCompressor::kMaxDataSize;
+const size_t PayloadCompressor::kHeaderSize;
+const uint8_t PayloadCompressor::kVersion;
+
+//////////////////////////////////////////////////
+class PayloadCompressorPrivate
+{
+  /// \brief Start a stream over, keeping its memory.
+  /// \param[in] _deflate True for the compression stream.
+  /// \return True on success.
+  public: bool Reset(bool _deflate);
+
+  /// \brief Write the header of a payload.
+  /// \param[in] _encoding Encoding of the payload.
+  /// \param[out] _payload The payload, at least kHeaderSize bytes long.
+  public: void WriteHeader(PayloadEncoding _encoding,
+                           std::string &_payload) const;
+
+  /// \brief Preset dictionary, at most kWindowSize bytes.
+  public: std::string dictionary;
+
+  /// \brief Tag of the dictionary stored in the payloads, so that
+  /// payloads compressed with another dictionary are rejected.
+  public: char dictionaryTag = 0;
+
+  /// \brief Largest data compressed or decompressed.
+  public: size_t maxDataSize = PayloadCompressor::kMaxDataSize;
+
+  /// \brief Compression stream.
+  public: z_stream deflateStream;
+
+  /// \brief Decompression stream.
+  public: z_stream inflateStream;
+
+  /// \brief Whether deflateStream was initialized.
+  public: bool deflateReady = false;
+
+  /// \brief Whether inflateStream was initialized.
+  public: bool inflateReady = false;
+};
+
+//////////////////////////////////////////////////
+bool PayloadCompressorPrivate::Reset(bool _deflate)
+{
+  int result;
+  if (_deflate)
+  {
+    result = deflateReset(&this->deflateStream);
+    if (result == Z_OK && !this->dictionary.empty())
+    {
+      result = deflateSetDictionary(&this->deflateStream,
+        reinterpret_cast<const Bytef *>(this->dictionary.data()),
+        this->dictionary.size());
+    }
+  }
+  else
+  {
+    // Raw inflate takes the dictionary up front, as the stream doesn't
+    // say which one was used.
+    result = inflateReset(&this->inflateStream);
+    if (result == Z_OK && !this->dictionary.empty())
+    {
+      result = inflateSetDictionary(&this->inflateStream,
+        reinterpret_cast<const Bytef *>(this->dictionary.data()),
+        this->dictionary.size());
+    }
+  }
+  return result == Z_OK;
+}
+
+//////////////////////////////////////////////////
+void PayloadCompressorPrivate::WriteHeader(PayloadEncoding _encoding,
+                                           std::string &_payload) const
+{
+  _payload[0] = kMagic[0];
+  _payload[1] = kMagic[1];
+  _payload[2] = static_cast<char>((PayloadCompressor::kVersion << 4) |
+                                  static_cast<uint8_t>(_encoding));
+  _payload[3] = this->dictionaryTag;
+}
+
+//////////////////////////////////////////////////
+PayloadCompressor::PayloadCompressor(const std::string &_dictionary,
+                                     int _level)
+  : dataPtr(new PayloadCompressorPrivate)
+{
+  this->dataPtr->dictionary = _dictionary.size() > kWindowSize ?
+    _dictionary.substr(_dictionary.size() - kWindowSize) : _dictionary;
+  this->dataPtr->dictionaryTag = static_cast<char>(adler32(
+    adler32(0, nullptr, 0),
+    reinterpret_cast<const Bytef *>(this->dataPtr->dictionary.data()),
+    this->dataPtr->dictionary.size()));
+
+  // Negative window bits select raw deflate, without the zlib header and
+  // checksum, which would cost 6 bytes per payload. The payloads are
+  // already protected by the transport.
+  this->dataPtr->deflateStream = z_stream();
+  this->dataPtr->deflateReady = deflateInit2(&this->dataPtr->deflateStream,
+    std::min(std::max(_level, 1), 9), Z_DEFLATED, -15, 9,
+    Z_DEFAULT_STRATEGY) == Z_OK;
+
+  this->dataPtr->inflateStream = z_stream();
+  this->dataPtr->inflateReady =
+    inflateInit2(&this->dataPtr->inflateStream, -15) == Z_OK;
+
+  if (!this->dataPtr->deflateReady || !this->dataPtr->inflateReady)
+  {
+    std::cerr << "[PayloadCompressor] Unable to initialize zlib, payloads "
+              << "won't be compressed" << std::endl;
+  }
+}
+
+//////////////////////////////////////////////////
+PayloadCompressor::~PayloadCompressor()
+{
+  if (this->dataPtr->deflateReady)
+    deflateEnd(&this->dataPtr->deflateStream);
+  if (this->dataPtr->inflateReady)
+    inflateEnd(&this->dataPtr->inflateStream);
+}
+
+//////////////////////////////////////////////////
+void PayloadCompressor::SetMaxDataSize(size_t _size)
+{
+  this->dataPtr->maxDataSize = _size;
+}
+
+//////////////////////////////////////////////////
+size_t PayloadCompressor::MaxDataSize() const
+{
+  return this->dataPtr->maxDataSize;
+}
+
+//////////////////////////////////////////////////
+bool PayloadCompressor::Compress(const std::string &_data,
+                                 std::string &_payload)
+{
+  if (_data.size() > this->dataPtr->maxDataSize)
+    return false;
+
+  z_stream &stream = this->dataPtr->deflateStream;
+  if (this->dataPtr->deflateReady && this->dataPtr->Reset(true))
+  {
+    // Only keep the compressed data if it is smaller, so the output never
+    // has to grow.
+    _payload.resize(kHeaderSize + _data.size());
+    stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(_data.data()));
+    stream.avail_in = _data.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&_payload[kHeaderSize]);
+    stream.avail_out = _data.size();
+
+    if (deflate(&stream, Z_FINISH) == Z_STREAM_END)
+    {
+      this->dataPtr->WriteHeader(PayloadEncoding::kDeflate, _payload);
+      _payload.resize(kHeaderSize + stream.total_out);
+      return true;
+    }
+  }
+
+  _payload.resize(kHeaderSize + _data.size());
+  this->dataPtr->WriteHeader(PayloadEncoding::kRaw, _payload);
+  std::copy(_data.begin(), _data.end(), _payload.begin() + kHeaderSize);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool PayloadCompressor::IsCompressed(const std::string &_payload)
+{
+  return _payload.size() >= kHeaderSize && _payload[0] == kMagic[0] &&
+    _payload[1] == kMagic[1];
+}
+
+//////////////////////////////////////////////////
+bool PayloadCompressor::Decompress(const std::string &_payload,
+                                   std::string &_data)
+{
+  if (!IsCompressed(_payload) ||
+      (static_cast<uint8_t>(_payload[2]) >> 4) != kVersion ||
+      _payload[3] != this->dataPtr->dictionaryTag)
+  {
+    return false;
+  }
+
+  const auto encoding = static_cast<PayloadEncoding>(_payload[2] & 0x0f);
+  if (encoding == PayloadEncoding::kRaw)
+  {
+    _data.assign(_payload.begin() + kHeaderSize, _payload.end());
+    return true;
+  }
+
+  if (encoding != PayloadEncoding::kDeflate ||
+      !this->dataPtr->inflateReady || !this->dataPtr->Reset(false))
+  {
+    return false;
+  }
+
+  z_stream &stream = this->dataPtr->inflateStream;
+  stream.next_in =
+    reinterpret_cast<Bytef *>(const_cast<char *>(_payload.data() +
+                                                 kHeaderSize));
+  stream.avail_in = _payload.size() - kHeaderSize;
+
+  // Start from the memory left by the previous payload, growing it as
+  // needed.
+  const size_t maxDataSize = this->dataPtr->maxDataSize;
+  _data.resize(std::min(maxDataSize,
+    std::max(_data.capacity(), _payload.size() * 4)));
+  int result = Z_OK;
+  while (true)
+  {
+    stream.next_out = reinterpret_cast<Bytef *>(&_data[stream.total_out]);
+    stream.avail_out = _data.size() - stream.total_out;
+    result = inflate(&stream, Z_NO_FLUSH);
+    if (result != Z_OK || stream.avail_out > 0 ||
+        _data.size() >= maxDataSize)
+    {
+      break;
+    }
+    _data.resize(std::min(maxDataSize, _data.size() * 2));
+  }
+
+  if (result != Z_STREAM_END)
+    return false;
+
+  _data.resize(stream.total_out);
+  return true;
+}
+
+}
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include <subt_communication_broker/subt_communication_fragmentation.h>
+
+namespace subt
+{
+namespace communication_broker
+{
+
+const size_t FragmentHeader::kSize;
+const size_t Reassembler::kMaxPending;
+
+/// \brief Flag of the header marking the end of a burst.
+static const uint8_t kEndOfBurstFlag = 0x01;
+
+/// \brief Number of completed messages remembered per port.
+static const size_t kMaxCompleted = 64;
+
+/// \brief Number of message buffers kept for reuse per port.
+static const size_t kMaxPooled = 4;
+
+//////////////////////////////////////////////////
+/// \brief Write an integer in little endian order.
+/// \param[in] _value The integer.
+/// \param[out] _out Where to write it.
+template<typename T>
+static void putLittleEndian(T _value, char *_out)
+{
+  for (size_t i = 0; i < sizeof(T); ++i)
+    _out[i] = static_cast<char>((_value >> (8 * i)) & 0xFF);
+}
+
+//////////////////////////////////////////////////
+/// \brief Read an integer in little endian order.
+/// \param[in] _in Where to read it.
+/// \return The integer.
+template<typename T>
+static T getLittleEndian(const char *_in)
+{
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<T>(static_cast<uint8_t>(_in[i])) << (8 * i);
+  return value;
+}
+
+//////////////////////////////////////////////////
+/// \brief Write a header at the start of a packet.
+/// \param[in] _header The header.
+/// \param[out] _packet The packet, at least FragmentHeader::kSize long.
+static void writeHeader(const FragmentHeader &_header, std::string &_packet)
+{
+  _packet[0] = static_cast<char>(_header.type);
+  _packet[1] = static_cast<char>(_header.endOfBurst ? kEndOfBurstFlag : 0);
+  putLittleEndian(_header.messageId, &_packet[2]);
+  putLittleEndian(_header.index, &_packet[6]);
+  putLittleEndian(_header.count, &_packet[8]);
+}
+
+//////////////////////////////////////////////////
+size_t FragmentCount(size_t _size)
+{
+  return std::max<size_t>(1u,
+    (_size + kFragmentDataSize - 1) / kFragmentDataSize);
+}
+
+//////////////////////////////////////////////////
+bool ReadFragmentHeader(const std::string &_packet, FragmentHeader &_header)
+{
+  if (_packet.size() < FragmentHeader::kSize)
+    return false;
+
+  _header.type = static_cast<FragmentType>(_packet[0]);
+  if (_header.type != FragmentType::kData &&
+      _header.type != FragmentType::kLossReport)
+  {
+    return false;
+  }
+
+  _header.endOfBurst = (_packet[1] & kEndOfBurstFlag) != 0;
+  _header.messageId = getLittleEndian<uint32_t>(&_packet[2]);
+  _header.index = getLittleEndian<uint16_t>(&_packet[6]);
+  _header.count = getLittleEndian<uint16_t>(&_packet[8]);
+  return true;
+}
+
+//////////////////////////////////////////////////
+void MakeFragment(const std::string &_message, uint32_t _messageId,
+                  uint16_t _index, bool _endOfBurst, std::string &_packet)
+{
+  const size_t offset = std::min(_message.size(),
+    static_cast<size_t>(_index) * kFragmentDataSize);
+  const size_t size =
+    std::min(kFragmentDataSize, _message.size() - offset);
+
+  FragmentHeader header;
+  header.type = FragmentType::kData;
+  header.endOfBurst = _endOfBurst;
+  header.messageId = _messageId;
+  header.index = _index;
+  header.count = static_cast<uint16_t>(FragmentCount(_message.size()));
+
+  _packet.resize(FragmentHeader::kSize + size);
+  writeHeader(header, _packet);
+  std::copy(_message.begin() + offset, _message.begin() + offset + size,
+            _packet.begin() + FragmentHeader::kSize);
+}
+
+//////////////////////////////////////////////////
+void MakeLossReport(uint32_t _messageId,
+                    const std::vector<uint16_t> &_missing,
+                    std::string &_packet)
+{
+  const size_t count = std::min(_missing.size(),
+    (kMaxFragmentPacketSize - FragmentHeader::kSize) / sizeof(uint16_t));
+
+  FragmentHeader header;
+  header.type = FragmentType::kLossReport;
+  header.messageId = _messageId;
+  header.count = static_cast<uint16_t>(count);
+
+  _packet.resize(FragmentHeader::kSize + count * sizeof(uint16_t));
+  writeHeader(header, _packet);
+  for (size_t i = 0; i < count; ++i)
+  {
+    putLittleEndian(_missing[i],
+      &_packet[FragmentHeader::kSize + i * sizeof(uint16_t)]);
+  }
+}
+
+//////////////////////////////////////////////////
+bool ReadLossReport(const std::string &_packet,
+                    const FragmentHeader &_header,
+                    std::vector<uint16_t> &_missing)
+{
+  _missing.clear();
+  if (_packet.size() < FragmentHeader::kSize + _header.count * sizeof(uint16_t))
+    return false;
+
+  for (size_t i = 0; i < _header.count; ++i)
+  {
+    _missing.push_back(getLittleEndian<uint16_t>(
+      &_packet[FragmentHeader::kSize + i * sizeof(uint16_t)]));
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+Reassembler::Reassembler(double _timeout)
+  : timeout(_timeout)
+{
+}
+
+//////////////////////////////////////////////////
+ReassemblyResult Reassembler::Add(const std::string &_srcAddress,
+                                  const std::string &_packet,
+                                  double _now,
+                                  std::string &_message,
+                                  std::vector<uint16_t> &_missing)
+{
+  _missing.clear();
+  this->Expire(_now);
+
+  FragmentHeader header;
+  if (!ReadFragmentHeader(_packet, header) ||
+      header.type != FragmentType::kData || header.count == 0 ||
+      header.index >= header.count ||
+      static_cast<size_t>(header.count) * kFragmentDataSize >
+        kMaxFragmentedMessageSize)
+  {
+    return ReassemblyResult::kInvalid;
+  }
+
+  // Every fragment but the last one is full.
+  const size_t size = _packet.size() - FragmentHeader::kSize;
+  const bool last = header.index + 1u == header.count;
+  if (size > kFragmentDataSize || (!last && size != kFragmentDataSize))
+    return ReassemblyResult::kInvalid;
+
+  auto key = std::make_pair(_srcAddress, header.messageId);
+  auto it = this->pending.find(key);
+  if (it == this->pending.end())
+  {
+    if (std::find(this->completed.begin(), this->completed.end(), key) !=
+        this->completed.end())
+    {
+      return ReassemblyResult::kDuplicate;
+    }
+
+    // Make room by giving up the message that would time out first.
+    if (this->pending.size() >= kMaxPending)
+    {
+      auto oldest = std::min_element(this->pending.begin(),
+        this->pending.end(), [](const auto &_a, const auto &_b)
+        {
+          return _a.second.deadline < _b.second.deadline;
+        });
+      this->Release(std::move(oldest->second));
+      this->pending.erase(oldest);
+      ++this->expired;
+    }
+
+    Message message;
+    if (!this->pool.empty())
+    {
+      message = std::move(this->pool.back());
+      this->pool.pop_back();
+    }
+    message.data.resize(header.count * kFragmentDataSize);
+    message.received.assign(header.count, false);
+    message.receivedCount = 0;
+    it = this->pending.emplace(key, std::move(message)).first;
+  }
+
+  Message &message = it->second;
+  if (message.received.size() != header.count)
+    return ReassemblyResult::kInvalid;
+
+  message.deadline = _now + this->timeout;
+  if (!message.received[header.index])
+  {
+    std::copy(_packet.begin() + FragmentHeader::kSize, _packet.end(),
+              message.data.begin() + header.index * kFragmentDataSize);
+    message.received[header.index] = true;
+    ++message.receivedCount;
+    if (last)
+      message.data.resize(header.index * kFragmentDataSize + size);
+  }
+
+  if (message.receivedCount == header.count)
+  {
+    // Hand the buffer to the caller, and keep the caller's.
+    std::swap(_message, message.data);
+    this->Release(std::move(message));
+    this->pending.erase(it);
+
+    this->completed.push_back(key);
+    if (this->completed.size() > kMaxCompleted)
+      this->completed.pop_front();
+    return ReassemblyResult::kComplete;
+  }
+
+  if (header.endOfBurst)
+  {
+    for (uint16_t i = 0; i < header.count; ++i)
+    {
+      if (!message.received[i])
+        _missing.push_back(i);
+    }
+  }
+  return ReassemblyResult::kIncomplete;
+}
+
+//////////////////////////////////////////////////
+size_t Reassembler::Pending() const
+{
+  return this->pending.size();
+}
+
+//////////////////////////////////////////////////
+uint64_t Reassembler::Expired() const
+{
+  return this->expired;
+}
+
+//////////////////////////////////////////////////
+void Reassembler::Expire(double _now)
+{
+  for (auto it = this->pending.begin(); it != this->pending.end();)
+  {
+    if (it->second.deadline < _now)
+    {
+      this->Release(std::move(it->second));
+      it = this->pending.erase(it);
+      ++this->expired;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+void Reassembler::Release(Message &&_message)
+{
+  if (this->pool.size() < kMaxPooled)
+    this->pool.push_back(std::move(_message));
+}
+
+//////////////////////////////////////////////////
+CapacityPacer::CapacityPacer(double _capacity)
+  : capacity(_capacity)
+{
+}
+
+//////////////////////////////////////////////////
+void CapacityPacer::SetCapacity(double _capacity)
+{
+  this->capacity = _capacity;
+}
+
+//////////////////////////////////////////////////
+bool CapacityPacer::Ready(double _now, size_t _bytes)
+{
+  // Same window as the communication model.
+  this->sent.expire(_now - 1.0);
+  return this->sent.total() == 0 ||
+    (this->sent.total() + _bytes) * 8.0 <= this->capacity;
+}
+
+//////////////////////////////////////////////////
+void CapacityPacer::Record(double _now, size_t _bytes)
+{
+  // Expire here too, so the window stays bounded when Ready() isn't called.
+  this->sent.expire(_now - 1.0);
+  this->sent.add(_now, _bytes);
+}
+
+//////////////////////////////////////////////////
+size_t CapacityPacer::Entries() const
+{
+  return this->sent.size();
+}
+
+}
+}
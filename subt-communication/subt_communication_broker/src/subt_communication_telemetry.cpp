@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <subt_communication_broker/subt_communication_telemetry.h>
+#include <subt_communication_model/link_random.h>
+
+namespace subt
+{
+namespace communication_broker
+{
+
+//////////////////////////////////////////////////
+Telemetry::Telemetry()
+{
+  for (auto &slot : this->slots)
+    slot.store(nullptr);
+}
+
+//////////////////////////////////////////////////
+Telemetry::~Telemetry()
+{
+  this->Stop();
+  for (auto &slot : this->slots)
+    delete slot.load();
+}
+
+//////////////////////////////////////////////////
+void Telemetry::AddName(const std::string &_address)
+{
+  const uint32_t id = communication_model::radio_id(_address);
+  std::lock_guard<std::mutex> lk(this->namesMutex);
+  if (this->names.find(id) == this->names.end())
+    this->names[id] = _address;
+}
+
+//////////////////////////////////////////////////
+void Telemetry::RecordSent(uint32_t _src, uint32_t _dst, uint64_t _bytes)
+{
+  Entry *entry = this->Find(this->ThreadSlot(), _src, _dst);
+  if (!entry)
+    return;
+  entry->counters[kSent].fetch_add(1, std::memory_order_relaxed);
+  entry->counters[kBytesSent].fetch_add(_bytes, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////
+void Telemetry::RecordDelivered(uint32_t _src, uint32_t _dst,
+                                uint64_t _bytes)
+{
+  Entry *entry = this->Find(this->ThreadSlot(), _src, _dst);
+  if (!entry)
+    return;
+  entry->counters[kDelivered].fetch_add(1, std::memory_order_relaxed);
+  entry->counters[kBytesDelivered].fetch_add(_bytes,
+      std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////
+uint64_t Telemetry::RecordDrop(uint32_t _src, uint32_t _dst,
+                               rf_interface::drop_reason _reason)
+{
+  Entry *entry = this->Find(this->ThreadSlot(), _src, _dst);
+  if (!entry)
+    return 0;
+  return entry->counters[kFirstDrop + static_cast<size_t>(_reason)].fetch_add(
+      1, std::memory_order_relaxed) + 1;
+}
+
+//////////////////////////////////////////////////
+void Telemetry::RecordDispatch(double _stamp, double _duration)
+{
+  size_t bucket = 0;
+  for (double us = _duration * 1e6; us >= 1.0 && bucket + 1 < kHistogramBuckets;
+       us /= 2.0)
+  {
+    ++bucket;
+  }
+  this->ThreadSlot().histogram[bucket].fetch_add(1,
+      std::memory_order_relaxed);
+  this->stamp.store(_stamp, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////
+uint64_t Telemetry::DroppedLinks() const
+{
+  return this->droppedLinks.load(std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////
+void Telemetry::Fill(subt::msgs::CommsTelemetry &_msg) const
+{
+  std::map<uint64_t, std::array<uint64_t, kNumCounters>> links;
+  std::array<uint64_t, kHistogramBuckets> histogram;
+  this->Sum(links, histogram);
+
+  _msg.Clear();
+  _msg.set_stamp(this->stamp.load(std::memory_order_relaxed));
+  for (const auto &link : links)
+  {
+    auto *linkMsg = _msg.add_links();
+    linkMsg->set_src_address(this->Name(link.first >> 32));
+    linkMsg->set_dst_address(this->Name(link.first & 0xFFFFFFFFu));
+    linkMsg->set_sent(link.second[kSent]);
+    linkMsg->set_delivered(link.second[kDelivered]);
+    linkMsg->set_bytes_sent(link.second[kBytesSent]);
+    linkMsg->set_bytes_delivered(link.second[kBytesDelivered]);
+    for (size_t r = 0; r < rf_interface::num_drop_reasons; ++r)
+    {
+      if (link.second[kFirstDrop + r] > 0)
+      {
+        (*linkMsg->mutable_drops())[rf_interface::drop_reason_name(
+          static_cast<rf_interface::drop_reason>(r))] =
+            link.second[kFirstDrop + r];
+      }
+    }
+  }
+  for (const uint64_t count : histogram)
+    _msg.add_dispatch_time_histogram(count);
+}
+
+//////////////////////////////////////////////////
+void Telemetry::WriteMetrics(std::ostream &_out) const
+{
+  std::map<uint64_t, std::array<uint64_t, kNumCounters>> links;
+  std::array<uint64_t, kHistogramBuckets> histogram;
+  this->Sum(links, histogram);
+
+  // Counters of one kind for all the links.
+  auto writeCounter = [&](const std::string &_name, size_t _index)
+  {
+    _out << "# TYPE subt_comms_" << _name << " counter\n";
+    for (const auto &link : links)
+    {
+      _out << "subt_comms_" << _name << "{src=\""
+           << this->Name(link.first >> 32) << "\",dst=\""
+           << this->Name(link.first & 0xFFFFFFFFu) << "\"} "
+           << link.second[_index] << "\n";
+    }
+  };
+  writeCounter("sent_total", kSent);
+  writeCounter("delivered_total", kDelivered);
+  writeCounter("sent_bytes_total", kBytesSent);
+  writeCounter("delivered_bytes_total", kBytesDelivered);
+
+  _out << "# TYPE subt_comms_dropped_total counter\n";
+  for (const auto &link : links)
+  {
+    for (size_t r = 0; r < rf_interface::num_drop_reasons; ++r)
+    {
+      if (link.second[kFirstDrop + r] == 0)
+        continue;
+      _out << "subt_comms_dropped_total{src=\""
+           << this->Name(link.first >> 32) << "\",dst=\""
+           << this->Name(link.first & 0xFFFFFFFFu) << "\",reason=\""
+           << rf_interface::drop_reason_name(
+                static_cast<rf_interface::drop_reason>(r))
+           << "\"} " << link.second[kFirstDrop + r] << "\n";
+    }
+  }
+
+  // Prometheus histograms are cumulative.
+  _out << "# TYPE subt_comms_dispatch_time_us histogram\n";
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < kHistogramBuckets; ++i)
+  {
+    cumulative += histogram[i];
+    _out << "subt_comms_dispatch_time_us_bucket{le=\"";
+    if (i + 1 < kHistogramBuckets)
+      _out << (1ull << i);
+    else
+      _out << "+Inf";
+    _out << "\"} " << cumulative << "\n";
+  }
+  _out << "subt_comms_dispatch_time_us_count " << cumulative << "\n";
+
+  _out << "# TYPE subt_comms_untracked_packets_total counter\n"
+       << "subt_comms_untracked_packets_total " << this->DroppedLinks()
+       << "\n";
+  _out << "# TYPE subt_comms_sim_time_seconds gauge\n"
+       << "subt_comms_sim_time_seconds "
+       << this->stamp.load(std::memory_order_relaxed) << "\n";
+}
+
+//////////////////////////////////////////////////
+void Telemetry::Start(const std::string &_topic, double _period,
+                      const std::string &_file)
+{
+  this->Stop();
+  if (_period <= 0)
+    return;
+
+  this->stop = false;
+  this->publisher = std::thread(&Telemetry::PublishLoop, this, _topic,
+      _period, _file);
+}
+
+//////////////////////////////////////////////////
+void Telemetry::Stop()
+{
+  if (!this->publisher.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lk(this->publisherMutex);
+    this->stop = true;
+  }
+  this->publisherCv.notify_one();
+  this->publisher.join();
+}
+
+//////////////////////////////////////////////////
+Telemetry::Slot &Telemetry::ThreadSlot()
+{
+  const size_t index =
+    std::hash<std::thread::id>()(std::this_thread::get_id()) % kSlots;
+  Slot *slot = this->slots[index].load(std::memory_order_acquire);
+  if (slot)
+    return *slot;
+
+  // Value-initialization zeroes the counters.
+  Slot *newSlot = new Slot();
+  if (this->slots[index].compare_exchange_strong(slot, newSlot,
+        std::memory_order_acq_rel))
+  {
+    return *newSlot;
+  }
+
+  // Another thread allocated it first.
+  delete newSlot;
+  return *slot;
+}
+
+//////////////////////////////////////////////////
+Telemetry::Entry *Telemetry::Find(Slot &_slot, uint32_t _src, uint32_t _dst)
+{
+  const uint64_t key = ((static_cast<uint64_t>(_src) << 32) | _dst) + 1u;
+
+  // Fibonacci hashing, then linear probing.
+  const size_t index = ((key * 11400714819323198485ull) >> 32) % kLinksPerSlot;
+  for (size_t probe = 0; probe < kLinksPerSlot; ++probe)
+  {
+    Entry &entry = _slot.entries[(index + probe) % kLinksPerSlot];
+    uint64_t current = entry.key.load(std::memory_order_acquire);
+    if (current == key)
+      return &entry;
+
+    if (current == 0u)
+    {
+      if (entry.key.compare_exchange_strong(current, key,
+            std::memory_order_acq_rel) || current == key)
+      {
+        return &entry;
+      }
+    }
+  }
+
+  this->droppedLinks.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+//////////////////////////////////////////////////
+void Telemetry::Sum(
+    std::map<uint64_t, std::array<uint64_t, kNumCounters>> &_links,
+    std::array<uint64_t, kHistogramBuckets> &_histogram) const
+{
+  _links.clear();
+  _histogram.fill(0u);
+
+  for (const auto &slotPtr : this->slots)
+  {
+    const Slot *slot = slotPtr.load(std::memory_order_acquire);
+    if (!slot)
+      continue;
+
+    for (const Entry &entry : slot->entries)
+    {
+      const uint64_t key = entry.key.load(std::memory_order_acquire);
+      if (key == 0u)
+        continue;
+
+      auto it = _links.find(key - 1u);
+      if (it == _links.end())
+      {
+        it = _links.emplace(key - 1u,
+            std::array<uint64_t, kNumCounters>()).first;
+        it->second.fill(0u);
+      }
+      for (size_t c = 0; c < kNumCounters; ++c)
+        it->second[c] += entry.counters[c].load(std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < kHistogramBuckets; ++i)
+      _histogram[i] += slot->histogram[i].load(std::memory_order_relaxed);
+  }
+}
+
+//////////////////////////////////////////////////
+std::string Telemetry::Name(uint32_t _id) const
+{
+  {
+    std::lock_guard<std::mutex> lk(this->namesMutex);
+    auto it = this->names.find(_id);
+    if (it != this->names.end())
+      return it->second;
+  }
+
+  std::ostringstream oss;
+  oss << "0x" << std::hex << std::setw(8) << std::setfill('0') << _id;
+  return oss.str();
+}
+
+//////////////////////////////////////////////////
+void Telemetry::PublishLoop(const std::string &_topic, double _period,
+                            const std::string &_file)
+{
+  ignition::transport::Node node;
+  auto pub = node.Advertise<subt::msgs::CommsTelemetry>(_topic);
+  if (!pub)
+  {
+    std::cerr << "[Telemetry] Error advertising topic [" << _topic << "]"
+              << std::endl;
+  }
+
+  const auto period = std::chrono::duration<double>(_period);
+  std::unique_lock<std::mutex> lk(this->publisherMutex);
+  while (!this->publisherCv.wait_for(lk, period, [this] {return this->stop;}))
+  {
+    lk.unlock();
+
+    if (pub)
+    {
+      subt::msgs::CommsTelemetry msg;
+      this->Fill(msg);
+      pub.Publish(msg);
+    }
+
+    if (!_file.empty())
+    {
+      // Write next to the file and rename it over, so readers never see a
+      // partial file.
+      const std::string tmp = _file + ".tmp";
+      {
+        std::ofstream out(tmp, std::ios::trunc);
+        this->WriteMetrics(out);
+      }
+      if (std::rename(tmp.c_str(), _file.c_str()) != 0)
+      {
+        std::cerr << "[Telemetry] Unable to write [" << _file << "]"
+                  << std::endl;
+      }
+    }
+
+    lk.lock();
+  }
+}
+
+}
+}
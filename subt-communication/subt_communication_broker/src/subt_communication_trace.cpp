@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <utility>
+
+#include <subt_communication_broker/subt_communication_trace.h>
+
+namespace subt
+{
+namespace communication_broker
+{
+
+/// \brief Size above which a buffer is handed to the writer thread.
+static const size_t kBufferSize = 256 * 1024;
+
+/// \brief Maximum number of buffers waiting to be written.
+static const size_t kMaxPending = 64;
+
+//////////////////////////////////////////////////
+TraceRecorder::~TraceRecorder()
+{
+  this->Close();
+}
+
+//////////////////////////////////////////////////
+bool TraceRecorder::Open(const std::string &_path, bool _payloads)
+{
+  this->Close();
+
+  this->file.open(_path, std::ios::binary | std::ios::trunc);
+  if (!this->file)
+  {
+    std::cerr << "[TraceRecorder::Open()] Unable to open [" << _path << "]"
+              << std::endl;
+    return false;
+  }
+
+  this->file.write(kTraceMagic.data(), kTraceMagic.size());
+  this->payloads = _payloads;
+  this->buffer.reserve(kBufferSize * 2);
+  this->stop = false;
+  this->droppedBytes = 0;
+  this->gapBytes = 0;
+  this->writer = std::thread(&TraceRecorder::WriteLoop, this);
+  return true;
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::Close()
+{
+  if (!this->writer.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lk(this->mutex);
+    if (!this->buffer.empty())
+    {
+      this->pending.push_back(std::move(this->buffer));
+      this->buffer.clear();
+    }
+    this->stop = true;
+  }
+  this->cv.notify_one();
+  this->writer.join();
+  this->file.close();
+
+  if (this->droppedBytes > 0)
+  {
+    std::cerr << "[TraceRecorder::Close()] " << this->droppedBytes
+              << " bytes of records were dropped because the disk couldn't "
+              << "keep up" << std::endl;
+  }
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::RecordRegister(const std::string &_address)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->Begin(TraceRecordType::kRegister);
+  this->PutString(_address);
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::RecordUnregister(const std::string &_address)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->Begin(TraceRecordType::kUnregister);
+  this->PutString(_address);
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::RecordBind(const std::string &_address,
+                               const std::string &_endpoint)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->Begin(TraceRecordType::kBind);
+  this->PutString(_address);
+  this->PutString(_endpoint);
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::RecordDispatch(double _stamp)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->Begin(TraceRecordType::kDispatch);
+  this->Put(_stamp);
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::RecordPose(const std::string &_address,
+                               const ignition::math::Pose3d &_pose)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->Begin(TraceRecordType::kPose);
+  this->PutString(_address);
+  this->Put(_pose.Pos().X());
+  this->Put(_pose.Pos().Y());
+  this->Put(_pose.Pos().Z());
+  this->Put(_pose.Rot().W());
+  this->Put(_pose.Rot().X());
+  this->Put(_pose.Rot().Y());
+  this->Put(_pose.Rot().Z());
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::RecordMessage(double _stamp,
+                                  const subt::msgs::Datagram &_msg)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->Begin(TraceRecordType::kMessage);
+  this->Put(_stamp);
+  this->PutString(_msg.src_address());
+  this->PutString(_msg.dst_address());
+  this->Put(static_cast<uint32_t>(_msg.dst_port()));
+  this->Put(static_cast<uint32_t>(_msg.data().size()));
+  this->PutString(this->payloads ? _msg.data() : std::string());
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::RecordDelivery(double _stamp,
+                                   const std::string &_srcAddress,
+                                   const std::string &_dstAddress,
+                                   bool _delivered,
+                                   double _rssi,
+                                   rf_interface::drop_reason _reason)
+{
+  std::lock_guard<std::mutex> lk(this->mutex);
+  this->Begin(TraceRecordType::kDelivery);
+  this->Put(_stamp);
+  this->PutString(_srcAddress);
+  this->PutString(_dstAddress);
+  this->Put(static_cast<uint8_t>(_delivered));
+  this->Put(_rssi);
+  this->Put(static_cast<uint8_t>(_reason));
+}
+
+//////////////////////////////////////////////////
+uint64_t TraceRecorder::DroppedBytes() const
+{
+  return this->droppedBytes.load();
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::Begin(TraceRecordType _type)
+{
+  // Hand over the buffer between records, so that a dropped buffer never
+  // leaves a partial record in the file.
+  if (this->buffer.size() >= kBufferSize)
+  {
+    if (this->pending.size() < kMaxPending)
+    {
+      this->pending.push_back(std::move(this->buffer));
+      this->cv.notify_one();
+      this->gapBytes = 0;
+    }
+    else
+    {
+      this->droppedBytes += this->buffer.size();
+      this->gapBytes += this->buffer.size();
+    }
+    this->buffer.clear();
+    this->buffer.reserve(kBufferSize * 2);
+
+    // Each buffer after a drop starts with the bytes dropped since the last
+    // buffer written, so the gap is known even if it is dropped too.
+    if (this->gapBytes > 0)
+    {
+      this->Put(static_cast<uint8_t>(TraceRecordType::kGap));
+      this->Put(this->gapBytes);
+    }
+  }
+
+  this->Put(static_cast<uint8_t>(_type));
+}
+
+//////////////////////////////////////////////////
+template<typename T>
+void TraceRecorder::Put(const T &_value)
+{
+  this->buffer.append(reinterpret_cast<const char *>(&_value), sizeof(T));
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::PutString(const std::string &_value)
+{
+  this->Put(static_cast<uint32_t>(_value.size()));
+  this->buffer.append(_value);
+}
+
+//////////////////////////////////////////////////
+void TraceRecorder::WriteLoop()
+{
+  std::unique_lock<std::mutex> lk(this->mutex);
+  while (true)
+  {
+    this->cv.wait(lk, [this]
+    {
+      return this->stop || !this->pending.empty();
+    });
+
+    while (!this->pending.empty())
+    {
+      std::string data = std::move(this->pending.front());
+      this->pending.pop_front();
+
+      // Write without holding the lock, so that recording can go on.
+      lk.unlock();
+      this->file.write(data.data(), data.size());
+      lk.lock();
+    }
+
+    if (this->stop)
+      break;
+  }
+  this->file.flush();
+}
+
+//////////////////////////////////////////////////
+bool TraceReader::Open(const std::string &_path)
+{
+  this->file.open(_path, std::ios::binary);
+  if (!this->file)
+  {
+    std::cerr << "[TraceReader::Open()] Unable to open [" << _path << "]"
+              << std::endl;
+    return false;
+  }
+
+  std::string magic(kTraceMagic.size(), '\0');
+  this->file.read(&magic[0], magic.size());
+  if (!this->file || magic != kTraceMagic)
+  {
+    std::cerr << "[TraceReader::Open()] [" << _path << "] is not a trace"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool TraceReader::Next(TraceRecord &_record)
+{
+  uint8_t type;
+  if (!this->Get(type))
+    return false;
+
+  _record = TraceRecord();
+  _record.type = static_cast<TraceRecordType>(type);
+  switch (_record.type)
+  {
+    case TraceRecordType::kRegister:
+    case TraceRecordType::kUnregister:
+      return this->GetString(_record.address);
+    case TraceRecordType::kBind:
+      return this->GetString(_record.address) &&
+             this->GetString(_record.endpoint);
+    case TraceRecordType::kDispatch:
+      return this->Get(_record.stamp);
+    case TraceRecordType::kPose:
+    {
+      double x, y, z, qw, qx, qy, qz;
+      if (!this->GetString(_record.address) || !this->Get(x) ||
+          !this->Get(y) || !this->Get(z) || !this->Get(qw) ||
+          !this->Get(qx) || !this->Get(qy) || !this->Get(qz))
+      {
+        return false;
+      }
+      _record.pose.Pos().Set(x, y, z);
+      _record.pose.Rot().Set(qw, qx, qy, qz);
+      return true;
+    }
+    case TraceRecordType::kMessage:
+      return this->Get(_record.stamp) &&
+             this->GetString(_record.address) &&
+             this->GetString(_record.dstAddress) &&
+             this->Get(_record.port) &&
+             this->Get(_record.size) &&
+             this->GetString(_record.payload);
+    case TraceRecordType::kDelivery:
+    {
+      uint8_t delivered;
+      uint8_t reason;
+      if (!this->Get(_record.stamp) || !this->GetString(_record.address) ||
+          !this->GetString(_record.dstAddress) || !this->Get(delivered) ||
+          !this->Get(_record.rssi) || !this->Get(reason))
+      {
+        return false;
+      }
+      _record.delivered = delivered != 0;
+      _record.reason = static_cast<rf_interface::drop_reason>(reason);
+      return true;
+    }
+    case TraceRecordType::kGap:
+      return this->Get(_record.lostBytes);
+  }
+
+  std::cerr << "[TraceReader::Next()] Unknown record type ["
+            << static_cast<int>(type) << "]" << std::endl;
+  return false;
+}
+
+//////////////////////////////////////////////////
+template<typename T>
+bool TraceReader::Get(T &_value)
+{
+  this->file.read(reinterpret_cast<char *>(&_value), sizeof(T));
+  return static_cast<bool>(this->file);
+}
+
+//////////////////////////////////////////////////
+bool TraceReader::GetString(std::string &_value)
+{
+  uint32_t size;
+  if (!this->Get(size))
+    return false;
+
+  _value.resize(size);
+  if (size > 0)
+    this->file.read(&_value[0], size);
+  return static_cast<bool>(this->file);
+}
+
+}
+}
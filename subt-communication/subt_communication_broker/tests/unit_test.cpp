@@ -15,11 +15,21 @@
  *
 */
 
+#include <fstream>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include <subt_communication_broker/subt_communication_broker.h>
 #include <subt_communication_broker/subt_communication_client.h>
+#include <subt_communication_broker/subt_communication_compression.h>
+#include <subt_communication_broker/subt_communication_fragmentation.h>
+#include <subt_communication_broker/subt_communication_telemetry.h>
+#include <subt_communication_broker/subt_communication_trace.h>
+#include <subt_communication_model/link_random.h>
 #include <subt_communication_model/subt_communication_model.h>
 #include <subt_rf_interface/subt_rf_interface.h>
 #include <subt_rf_interface/subt_rf_model.h>
@@ -119,6 +129,393 @@ TEST(broker, communicate)
   //             );
 }
 
+TEST(trace, round_trip)
+{
+  const std::string path = testing::TempDir() + "broker_trace_test.bin";
+
+  subt::msgs::Datagram msg;
+  msg.set_src_address("1");
+  msg.set_dst_address("2");
+  msg.set_dst_port(4100);
+  msg.set_data(std::string(1000, 'x'));
+
+  // Enough records to fill several buffers of the writer.
+  const int kMessages = 2000;
+  {
+    TraceRecorder recorder;
+    ASSERT_TRUE(recorder.Open(path, true));
+    recorder.RecordRegister("1");
+    recorder.RecordBind("2", "2:4100");
+    for (int i = 0; i < kMessages; ++i)
+    {
+      recorder.RecordDispatch(i);
+      recorder.RecordPose("1", ignition::math::Pose3d(i, 2, 3, 0, 0, 0));
+      recorder.RecordMessage(i, msg);
+      recorder.RecordDelivery(i, "1", "2", i % 2 == 0, -50.0,
+          i % 2 == 0 ? drop_reason::none : drop_reason::packet_error);
+    }
+    EXPECT_EQ(0u, recorder.DroppedBytes());
+  }
+
+  TraceReader reader;
+  ASSERT_TRUE(reader.Open(path));
+
+  TraceRecord record;
+  ASSERT_TRUE(reader.Next(record));
+  EXPECT_EQ(TraceRecordType::kRegister, record.type);
+  EXPECT_EQ("1", record.address);
+
+  ASSERT_TRUE(reader.Next(record));
+  EXPECT_EQ(TraceRecordType::kBind, record.type);
+  EXPECT_EQ("2", record.address);
+  EXPECT_EQ("2:4100", record.endpoint);
+
+  for (int i = 0; i < kMessages; ++i)
+  {
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(TraceRecordType::kDispatch, record.type);
+    EXPECT_DOUBLE_EQ(i, record.stamp);
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(TraceRecordType::kPose, record.type);
+    EXPECT_EQ(ignition::math::Pose3d(i, 2, 3, 0, 0, 0), record.pose);
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(TraceRecordType::kMessage, record.type);
+    EXPECT_EQ("1", record.address);
+    EXPECT_EQ("2", record.dstAddress);
+    EXPECT_EQ(4100u, record.port);
+    EXPECT_EQ(1000u, record.size);
+    EXPECT_EQ(msg.data(), record.payload);
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(TraceRecordType::kDelivery, record.type);
+    EXPECT_EQ(i % 2 == 0, record.delivered);
+    EXPECT_EQ(i % 2 == 0 ? drop_reason::none : drop_reason::packet_error,
+              record.reason);
+  }
+  EXPECT_FALSE(reader.Next(record));
+}
+
+TEST(trace, gap)
+{
+  // A gap left by the recorder when the disk falls behind.
+  const std::string path = testing::TempDir() + "broker_trace_gap_test.bin";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(kTraceMagic.data(), kTraceMagic.size());
+    const uint8_t type = static_cast<uint8_t>(TraceRecordType::kGap);
+    const uint64_t lostBytes = 262144;
+    file.write(reinterpret_cast<const char *>(&type), sizeof(type));
+    file.write(reinterpret_cast<const char *>(&lostBytes), sizeof(lostBytes));
+  }
+
+  TraceReader reader;
+  ASSERT_TRUE(reader.Open(path));
+
+  TraceRecord record;
+  ASSERT_TRUE(reader.Next(record));
+  EXPECT_EQ(TraceRecordType::kGap, record.type);
+  EXPECT_EQ(262144u, record.lostBytes);
+  EXPECT_FALSE(reader.Next(record));
+}
+
+TEST(telemetry, counters)
+{
+  Telemetry telemetry;
+  telemetry.AddName("1");
+  telemetry.AddName("2");
+  const uint32_t a = radio_id("1");
+  const uint32_t b = radio_id("2");
+
+  // Count from several threads at once.
+  const int kThreads = 8;
+  const int kPackets = 10000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads.emplace_back([&]()
+    {
+      for (int i = 0; i < kPackets; ++i)
+      {
+        telemetry.RecordSent(a, b, 100);
+        if (i % 4 == 0)
+          telemetry.RecordDrop(a, b, drop_reason::packet_error);
+        else
+          telemetry.RecordDelivered(a, b, 100);
+      }
+      telemetry.RecordDispatch(1.5, 3e-6);
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  subt::msgs::CommsTelemetry msg;
+  telemetry.Fill(msg);
+  EXPECT_DOUBLE_EQ(1.5, msg.stamp());
+  ASSERT_EQ(1, msg.links_size());
+  const auto &link = msg.links(0);
+  EXPECT_EQ("1", link.src_address());
+  EXPECT_EQ("2", link.dst_address());
+  EXPECT_EQ(uint64_t(kThreads * kPackets), link.sent());
+  EXPECT_EQ(uint64_t(kThreads * kPackets * 3 / 4), link.delivered());
+  EXPECT_EQ(uint64_t(kThreads * kPackets * 100), link.bytes_sent());
+  EXPECT_EQ(uint64_t(kThreads * kPackets * 3 / 4 * 100),
+            link.bytes_delivered());
+  ASSERT_EQ(1u, link.drops().count("packet_error"));
+  EXPECT_EQ(uint64_t(kThreads * kPackets / 4),
+            link.drops().at("packet_error"));
+
+  // 3 us falls in the bucket of [2, 4) us.
+  ASSERT_EQ(int(Telemetry::kHistogramBuckets),
+            msg.dispatch_time_histogram_size());
+  EXPECT_EQ(uint64_t(kThreads), msg.dispatch_time_histogram(2));
+
+  std::ostringstream metrics;
+  telemetry.WriteMetrics(metrics);
+  EXPECT_NE(std::string::npos, metrics.str().find(
+    "subt_comms_sent_total{src=\"1\",dst=\"2\"} 80000\n"));
+  EXPECT_NE(std::string::npos, metrics.str().find(
+    "subt_comms_dropped_total{src=\"1\",dst=\"2\",reason=\"packet_error\"}"
+    " 20000\n"));
+  EXPECT_NE(std::string::npos, metrics.str().find(
+    "subt_comms_dispatch_time_us_bucket{le=\"+Inf\"} 8\n"));
+  EXPECT_EQ(0u, telemetry.DroppedLinks());
+}
+
+TEST(compression, round_trip)
+{
+  // An occupancy grid row: unknown, wall, free space, wall, unknown.
+  std::string grid;
+  for (int i = 0; i < 40; ++i)
+  {
+    grid += std::string(10, char(-1)) + char(100) + std::string(20, char(0)) +
+      char(100) + std::string(10, char(-1));
+  }
+
+  PayloadCompressor compressor;
+  std::string payload;
+  std::string data;
+  ASSERT_TRUE(compressor.Compress(grid, payload));
+  EXPECT_EQ(char(PayloadEncoding::kDeflate), payload[2] & 0x0f);
+  EXPECT_LT(payload.size(), grid.size() / 10);
+  ASSERT_TRUE(compressor.Decompress(payload, data));
+  EXPECT_EQ(grid, data);
+
+  // The streams and buffers are reused.
+  ASSERT_TRUE(compressor.Compress(grid.substr(42), payload));
+  ASSERT_TRUE(compressor.Decompress(payload, data));
+  EXPECT_EQ(grid.substr(42), data);
+
+  // Data that doesn't compress is sent as is.
+  std::string noise;
+  for (int i = 0; i < 256; ++i)
+    noise += char((i * 2654435761u) >> 13);
+  ASSERT_TRUE(compressor.Compress(noise, payload));
+  EXPECT_EQ(char(PayloadEncoding::kRaw), payload[2] & 0x0f);
+  EXPECT_EQ(noise.size() + PayloadCompressor::kHeaderSize, payload.size());
+  ASSERT_TRUE(compressor.Decompress(payload, data));
+  EXPECT_EQ(noise, data);
+
+  // A dictionary helps short payloads.
+  PayloadCompressor withDictionary(grid);
+  std::string shortPayload;
+  ASSERT_TRUE(withDictionary.Compress(grid.substr(0, 126), shortPayload));
+  ASSERT_TRUE(compressor.Compress(grid.substr(0, 126), payload));
+  EXPECT_LT(shortPayload.size(), payload.size());
+  ASSERT_TRUE(withDictionary.Decompress(shortPayload, data));
+  EXPECT_EQ(grid.substr(0, 126), data);
+
+  // Both ends need the same dictionary.
+  EXPECT_FALSE(compressor.Decompress(shortPayload, data));
+
+  // Corrupt and oversized data is rejected.
+  ASSERT_TRUE(compressor.Compress(grid, payload));
+  EXPECT_FALSE(compressor.Decompress(payload.substr(0, payload.size() / 2),
+                                     data));
+  EXPECT_FALSE(compressor.Decompress("", data));
+  EXPECT_FALSE(compressor.Compress(std::string(100 * 1024, 'x'), payload));
+}
+
+TEST(compression, mismatch)
+{
+  // The receiver has compression enabled, the sender doesn't. Payloads
+  // starting with the bytes of the encodings are rejected too.
+  PayloadCompressor compressor;
+  std::string data;
+  for (const std::string &plain : {std::string("\0abc", 4),
+                                   std::string("\1abc", 4),
+                                   std::string("report")})
+  {
+    EXPECT_FALSE(PayloadCompressor::IsCompressed(plain));
+    EXPECT_FALSE(compressor.Decompress(plain, data));
+  }
+
+  // The sender has compression enabled, the receiver doesn't. The receiver
+  // can tell from the magic bytes.
+  std::string payload;
+  ASSERT_TRUE(compressor.Compress("report", payload));
+  EXPECT_TRUE(PayloadCompressor::IsCompressed(payload));
+  ASSERT_TRUE(compressor.Decompress(payload, data));
+  EXPECT_EQ("report", data);
+
+  // Another version of the format.
+  std::string other = payload;
+  other[2] = static_cast<char>(((PayloadCompressor::kVersion + 1) << 4) |
+                               (payload[2] & 0x0f));
+  EXPECT_TRUE(PayloadCompressor::IsCompressed(other));
+  EXPECT_FALSE(compressor.Decompress(other, data));
+
+  // Raw payloads compressed with another dictionary are rejected too.
+  PayloadCompressor withDictionary("a dictionary");
+  ASSERT_TRUE(withDictionary.Compress("x", payload));
+  EXPECT_EQ(char(PayloadEncoding::kRaw), payload[2] & 0x0f);
+  EXPECT_FALSE(compressor.Decompress(payload, data));
+}
+
+TEST(fragmentation, reassembly)
+{
+  std::string message;
+  for (size_t i = 0; i < 3 * kFragmentDataSize + 100; ++i)
+    message += char(i * 7);
+  ASSERT_EQ(4u, FragmentCount(message.size()));
+
+  std::vector<std::string> fragments(4);
+  for (uint16_t i = 0; i < 4; ++i)
+    MakeFragment(message, 42, i, i == 3, fragments[i]);
+  EXPECT_EQ(kMaxFragmentPacketSize, fragments[0].size());
+  EXPECT_EQ(FragmentHeader::kSize + 100, fragments[3].size());
+
+  FragmentHeader header;
+  ASSERT_TRUE(ReadFragmentHeader(fragments[3], header));
+  EXPECT_EQ(FragmentType::kData, header.type);
+  EXPECT_TRUE(header.endOfBurst);
+  EXPECT_EQ(42u, header.messageId);
+  EXPECT_EQ(3u, header.index);
+  EXPECT_EQ(4u, header.count);
+
+  // Fragments arrive out of order, and one is lost.
+  Reassembler reassembler(5.0);
+  std::string received;
+  std::vector<uint16_t> missing;
+  EXPECT_EQ(ReassemblyResult::kIncomplete,
+    reassembler.Add("a", fragments[2], 0.0, received, missing));
+  EXPECT_EQ(ReassemblyResult::kIncomplete,
+    reassembler.Add("a", fragments[0], 0.1, received, missing));
+  EXPECT_TRUE(missing.empty());
+
+  // The end of the burst makes the receiver report the lost fragment.
+  EXPECT_EQ(ReassemblyResult::kIncomplete,
+    reassembler.Add("a", fragments[3], 0.2, received, missing));
+  ASSERT_EQ(1u, missing.size());
+  EXPECT_EQ(1u, missing[0]);
+
+  std::string report;
+  MakeLossReport(42, missing, report);
+  ASSERT_TRUE(ReadFragmentHeader(report, header));
+  EXPECT_EQ(FragmentType::kLossReport, header.type);
+  std::vector<uint16_t> reported;
+  ASSERT_TRUE(ReadLossReport(report, header, reported));
+  EXPECT_EQ(missing, reported);
+  EXPECT_FALSE(ReadLossReport(report.substr(0, report.size() - 1), header,
+                              reported));
+
+  // Fragments of another sender don't mix with these.
+  EXPECT_EQ(ReassemblyResult::kIncomplete,
+    reassembler.Add("b", fragments[1], 0.3, received, missing));
+  EXPECT_EQ(2u, reassembler.Pending());
+
+  // The retransmission completes the message.
+  MakeFragment(message, 42, 1, true, fragments[1]);
+  EXPECT_EQ(ReassemblyResult::kComplete,
+    reassembler.Add("a", fragments[1], 0.4, received, missing));
+  EXPECT_EQ(message, received);
+  EXPECT_TRUE(missing.empty());
+  EXPECT_EQ(1u, reassembler.Pending());
+
+  // Late duplicates are recognized, so the receiver can acknowledge again.
+  EXPECT_EQ(ReassemblyResult::kDuplicate,
+    reassembler.Add("a", fragments[3], 0.5, received, missing));
+  EXPECT_EQ(1u, reassembler.Pending());
+
+  // Malformed fragments are rejected.
+  EXPECT_EQ(ReassemblyResult::kInvalid,
+    reassembler.Add("a", fragments[0].substr(0, 100), 0.5, received,
+                    missing));
+  EXPECT_EQ(ReassemblyResult::kInvalid,
+    reassembler.Add("a", report, 0.5, received, missing));
+
+  // Incomplete messages are given up after the timeout.
+  EXPECT_EQ(0u, reassembler.Expired());
+  MakeFragment(message, 43, 0, false, fragments[0]);
+  EXPECT_EQ(ReassemblyResult::kIncomplete,
+    reassembler.Add("a", fragments[0], 6.0, received, missing));
+  EXPECT_EQ(1u, reassembler.Expired());
+  EXPECT_EQ(1u, reassembler.Pending());
+}
+
+TEST(fragmentation, compressed)
+{
+  // A message bigger than the default limit of the compressor, which
+  // doesn't compress below it.
+  std::mt19937 random(42);
+  std::string message;
+  for (size_t i = 0; i < 300 * 1024; ++i)
+    message += char(random());
+
+  PayloadCompressor compressor;
+  std::string payload;
+  EXPECT_FALSE(compressor.Compress(message, payload));
+
+  compressor.SetMaxDataSize(kMaxFragmentedMessageSize);
+  ASSERT_TRUE(compressor.Compress(message, payload));
+  ASSERT_GT(payload.size(), PayloadCompressor::kMaxDataSize);
+
+  const size_t count = FragmentCount(payload.size());
+  Reassembler reassembler(5.0);
+  std::string fragment;
+  std::string received;
+  std::vector<uint16_t> missing;
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    MakeFragment(payload, 7, i, i + 1u == count, fragment);
+    EXPECT_EQ(i + 1u == count ? ReassemblyResult::kComplete :
+                               ReassemblyResult::kIncomplete,
+              reassembler.Add("a", fragment, 0.0, received, missing));
+  }
+
+  std::string data;
+  ASSERT_TRUE(compressor.Decompress(received, data));
+  EXPECT_EQ(message, data);
+}
+
+TEST(fragmentation, pacing)
+{
+  // 12 kbit over any second.
+  CapacityPacer pacer(12000);
+  EXPECT_TRUE(pacer.Ready(0.0, 1000));
+  pacer.Record(0.0, 1000);
+  EXPECT_TRUE(pacer.Ready(0.5, 500));
+  pacer.Record(0.5, 500);
+  EXPECT_FALSE(pacer.Ready(0.6, 100));
+
+  // The first packet leaves the window.
+  EXPECT_TRUE(pacer.Ready(1.1, 1000));
+
+  // A packet bigger than the capacity can still be sent alone.
+  EXPECT_TRUE(pacer.Ready(3.0, 2000));
+}
+
+TEST(fragmentation, pacing_window)
+{
+  // Recording alone, without asking whether it's ready, keeps only the last
+  // second.
+  CapacityPacer pacer(12000);
+  for (int i = 0; i < 100000; ++i)
+    pacer.Record(i * 0.001, 10);
+  EXPECT_LE(pacer.Entries(), 1001u);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SUBT_COMMUNICATION_MODEL__LINK_RANDOM_H_
+#define SUBT_COMMUNICATION_MODEL__LINK_RANDOM_H_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+namespace subt
+{
+namespace communication_model
+{
+
+/// Philox4x32-10 counter-based random number generator (Salmon et al.,
+/// "Parallel Random Numbers: As Easy as 1, 2, 3", SC'11).
+///
+/// Maps a 128 bit counter and a 64 bit key to 128 random bits. Unlike a
+/// sequential engine it has no state, so any number can be computed
+/// independently, in any order and on any thread.
+///
+/// @param counter Counter
+/// @param key Key
+/// @return Random bits
+inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter,
+                                          std::array<uint32_t, 2> key)
+{
+  for(int round = 0; round < 10; ++round)
+  {
+    if(round > 0)
+    {
+      key[0] += 0x9E3779B9u;
+      key[1] += 0xBB67AE85u;
+    }
+
+    const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * counter[0];
+    const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * counter[2];
+    counter = {{static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+                static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+                static_cast<uint32_t>(p0)}};
+  }
+  return counter;
+}
+
+/// Identifier of a radio for keying random numbers (32 bit FNV-1a hash of
+/// its address). Unlike std::hash, it is the same on every platform and
+/// run.
+///
+/// @param address Address of the radio
+/// @return Identifier
+inline uint32_t radio_id(const std::string& address)
+{
+  uint32_t hash = 2166136261u;
+  for(const char c : address)
+  {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/// \class link_random
+/// \brief Random numbers of one packet sent over one link
+///
+/// The numbers are a deterministic function of the run seed, the
+/// transmitter, the receiver and the sequence number of the packet, and
+/// of nothing else. Links can thus be evaluated in any order, or in
+/// parallel, and a run with the same seed and traffic draws the same
+/// numbers.
+class link_random
+{
+ public:
+  /// Constructor.
+  ///
+  /// @param seed Seed of the run
+  /// @param tx_id Identifier of the transmitter, see radio_id()
+  /// @param rx_id Identifier of the receiver, see radio_id()
+  /// @param sequence Sequence number of the packet
+  link_random(uint64_t seed, uint32_t tx_id, uint32_t rx_id,
+              uint32_t sequence) :
+      counter_{{sequence, 0u, tx_id, rx_id}},
+      key_{{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}}
+  {}
+
+  /// @return Uniformly distributed number in [0, 1), with 53 random bits
+  double uniform()
+  {
+    const uint32_t a = next() >> 5;
+    const uint32_t b = next() >> 6;
+    return (a * 67108864.0 + b) / 9007199254740992.0;
+  }
+
+  /// @return Normally distributed number with zero mean and unit variance
+  double normal()
+  {
+    // Box-Muller transform, 1 - uniform() is in (0, 1].
+    const double radius = std::sqrt(-2.0 * std::log(1.0 - uniform()));
+    return radius * std::cos(2.0 * M_PI * uniform());
+  }
+
+ private:
+  /// @return Next 32 random bits
+  uint32_t next()
+  {
+    if(used_ == bits_.size())
+    {
+      bits_ = philox4x32(counter_, key_);
+      ++counter_[1];
+      used_ = 0;
+    }
+    return bits_[used_++];
+  }
+
+  std::array<uint32_t, 4> counter_; ///< Counter of the next block
+  std::array<uint32_t, 2> key_;     ///< Key, the run seed
+  std::array<uint32_t, 4> bits_{};  ///< Current block of random bits
+  size_t used_ = 4;                 ///< Number of used words of bits_
+};
+
+}
+}
+#endif
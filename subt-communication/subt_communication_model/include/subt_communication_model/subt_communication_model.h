@@ -39,12 +39,14 @@ struct radio_configuration
   double noise_floor;      ///< Noise floor of the radio in dBm
   rf_interface::pathloss_function pathloss_f; ///< Function handle for
                                               ///computing pathloss
+  uint64_t seed;           ///< Seed of the random fading and packet drops
 
   radio_configuration() :
       capacity(54000000),   // 54Mbps
       default_tx_power(27), // 27dBm or 500mW
       modulation("QPSK"),   // Quadrature Phase Shift Keyring
-      noise_floor(-90)      // dBm
+      noise_floor(-90),     // dBm
+      seed(0)
   {}
 };
 
@@ -58,7 +60,8 @@ inline std::ostream& operator<<(std::ostream& oss,
       << "-- capacity: " << config.capacity << std::endl
       << "-- default_tx_power: " << config.default_tx_power << std::endl
       << "-- noise_floor: " << config.noise_floor << std::endl
-      << "-- modulation: " << config.modulation << std::endl;
+      << "-- modulation: " << config.modulation << std::endl
+      << "-- seed: " << config.seed << std::endl;
 
   return oss;
 }
@@ -71,6 +74,12 @@ inline std::ostream& operator<<(std::ostream& oss,
 /// limitations). This probability is then used to determine if the
 /// packet is successfully communicated.
 ///
+/// The random draws are keyed by radio.seed, the ids of the radios and
+/// tx_state.sequence, so the outcome of a given packet on a given link is
+/// reproducible and independent of other links.
+///
+/// The reason of a drop is stored in rx_state.last_drop.
+///
 /// @param radio Static configuration for the radio
 /// @param tx_state Current state of the transmitter (pose)
 /// @param rx_state Current state of the receiver (pose)
@@ -17,9 +17,10 @@
 
 #include <ignition/common/Console.hh>
 #include <subt_communication_model/subt_communication_model.h>
+#include <subt_communication_model/link_random.h>
 
+#include <cmath>
 #include <math.h>
-#include <random>
 #include <limits>
 
 namespace subt
@@ -47,20 +48,15 @@ attempt_send(const radio_configuration& radio,
 
   // Maintain running window of bytes sent over the last epoch, e.g.,
   // 1s
-  while(!tx_state.bytes_sent.empty() &&
-        tx_state.bytes_sent.front().first < now - epoch_duration)
-  {
-    tx_state.bytes_sent_this_epoch -= tx_state.bytes_sent.front().second;
-    tx_state.bytes_sent.pop_front();
-  }
+  tx_state.bytes_sent.expire(now - epoch_duration);
 
-  // ignmsg << "bytes sent: " <<  tx_state.bytes_sent_this_epoch << " + "
+  // ignmsg << "bytes sent: " <<  tx_state.bytes_sent.total() << " + "
   //        << num_bytes << " = "
-  //        << tx_state.bytes_sent_this_epoch + num_bytes << std::endl;
+  //        << tx_state.bytes_sent.total() + num_bytes << std::endl;
 
   // Compute prospective accumulated bits along with time window
   // (including this packet)
-  double bits_sent = (tx_state.bytes_sent_this_epoch + num_bytes)*8;
+  double bits_sent = (tx_state.bytes_sent.total() + num_bytes)*8;
 
   // Check current epoch bitrate vs capacity and fail to send
   // accordingly
@@ -68,25 +64,24 @@ attempt_send(const radio_configuration& radio,
   {
     // ignwarn << "Bitrate limited: " << bits_sent << "bits sent (limit: "
     // << radio.capacity  * epoch_duration.toSec() << std::endl;
+    rx_state.last_drop = rf_interface::drop_reason::tx_bitrate;
     return std::make_tuple(false, std::numeric_limits<double>::lowest());
   }
 
   // Record these bytes
-  tx_state.bytes_sent.push_back(std::make_pair(now, num_bytes));
-  tx_state.bytes_sent_this_epoch += num_bytes;
+  tx_state.bytes_sent.add(now, num_bytes);
 
   // Get the received power based on TX power and position of each node
   auto rx_power_dist = radio.pathloss_f(radio.default_tx_power,
                                         tx_state,
                                         rx_state);
 
+  link_random random(radio.seed, tx_state.id, rx_state.id,
+                     tx_state.sequence);
+
   double rx_power = rx_power_dist.mean;
   if(rx_power_dist.variance > 0.0) {
-
-    static std::default_random_engine rndEngine;
-    std::normal_distribution<> d{rx_power_dist.mean, sqrt(rx_power_dist.variance)};
-
-    rx_power = d(rndEngine);
+    rx_power += sqrt(rx_power_dist.variance) * random.normal();
   }
 
   // Based on rx_power, noise value, and modulation, compute the bit
@@ -108,30 +103,30 @@ attempt_send(const radio_configuration& radio,
   //           "# Bytes: " << num_bytes << "\n" <<
   //           "PER: " << packet_drop_prob << std::endl;
 
-  double rand_draw = (rand() % 1000) / 1000.0;
-
-  bool packet_received = rand_draw > packet_drop_prob;
+  bool packet_received = random.uniform() >= packet_drop_prob;
 
   if(!packet_received)
+  {
+    if(rx_power_dist.cost_limited)
+      rx_state.last_drop = rf_interface::drop_reason::comms_cost;
+    else if(std::isinf(rx_power_dist.mean))
+      rx_state.last_drop = rf_interface::drop_reason::out_of_range;
+    else
+      rx_state.last_drop = rf_interface::drop_reason::packet_error;
     return std::make_tuple(false, std::numeric_limits<double>::lowest());
+  }
 
   // Maintain running window of bytes received over the last epoch, e.g.,
   // 1s
-  while(!rx_state.bytes_received.empty() &&
-        rx_state.bytes_received.front().first < now - epoch_duration)
-  {
-    rx_state.bytes_received_this_epoch -=
-      rx_state.bytes_received.front().second;
-    rx_state.bytes_received.pop_front();
-  }
+  rx_state.bytes_received.expire(now - epoch_duration);
 
-  // ignmsg << "bytes received: " << rx_state.bytes_received_this_epoch
+  // ignmsg << "bytes received: " << rx_state.bytes_received.total()
   // << " + " << num_bytes
-  // << " = " << rx_state.bytes_received_this_epoch + num_bytes << std::endl;
+  // << " = " << rx_state.bytes_received.total() + num_bytes << std::endl;
 
   // Compute prospective accumulated bits along with time window
   // (including this packet)
-  double bits_received = (rx_state.bytes_received_this_epoch + num_bytes)*8;
+  double bits_received = (rx_state.bytes_received.total() + num_bytes)*8;
 
   // Check current epoch bitrate vs capacity and fail to send
   // accordingly
@@ -140,13 +135,14 @@ attempt_send(const radio_configuration& radio,
     // ignwarn < <"Bitrate limited: " <<  bits_received
     // << "bits received (limit: " << radio.capacity * epoch_duration.toSec()
     // << )\n";
+    rx_state.last_drop = rf_interface::drop_reason::rx_bitrate;
     return std::make_tuple(false, std::numeric_limits<double>::lowest());
   }
 
   // Record these bytes
-  rx_state.bytes_received.push_back(std::make_pair(now, num_bytes));
-  rx_state.bytes_received_this_epoch += num_bytes;
+  rx_state.bytes_received.add(now, num_bytes);
 
+  rx_state.last_drop = rf_interface::drop_reason::none;
   return std::make_tuple(true, rx_power);
 }
 
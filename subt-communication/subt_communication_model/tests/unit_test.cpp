@@ -15,12 +15,16 @@
  *
 */
 
+#include <algorithm>
+#include <limits>
 #include <string>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include <subt_rf_interface/subt_rf_interface.h>
 #include <subt_rf_interface/subt_rf_model.h>
 
+#include <subt_communication_model/link_random.h>
 #include <subt_communication_model/subt_communication_model.h>
 
 using namespace subt;
@@ -59,6 +63,159 @@ TEST(range_based, co_located)
   ASSERT_TRUE(send_packet);
 }
 
+TEST(range_based, drop_reasons)
+{
+  struct rf_configuration rf_config;
+  rf_config.max_range = 10.0;
+  auto rf_func = std::bind(&distance_based_received_power,
+                           std::placeholders::_1,
+                           std::placeholders::_2,
+                           std::placeholders::_3,
+                           rf_config);
+
+  struct radio_configuration radio;
+  radio.capacity = 8000;
+  radio.pathloss_f = rf_func;
+
+  rf_interface::radio_state tx, rx;
+  tx.update_stamp = rx.update_stamp = 0.0;
+  EXPECT_TRUE(std::get<0>(attempt_send(radio, tx, rx, 600)));
+  EXPECT_EQ(drop_reason::none, rx.last_drop);
+
+  // 1200 bytes in the same second exceed 8000 bits/s.
+  EXPECT_FALSE(std::get<0>(attempt_send(radio, tx, rx, 600)));
+  EXPECT_EQ(drop_reason::tx_bitrate, rx.last_drop);
+
+  tx.update_stamp = rx.update_stamp = 10.0;
+  rx.pose.Set(20, 0, 0, 0, 0, 0);
+  EXPECT_FALSE(std::get<0>(attempt_send(radio, tx, rx, 600)));
+  EXPECT_EQ(drop_reason::out_of_range, rx.last_drop);
+
+  // A second transmitter fills the receiver.
+  rf_interface::radio_state tx2;
+  tx.update_stamp = tx2.update_stamp = rx.update_stamp = 20.0;
+  rx.pose = ignition::math::Pose3d::Zero;
+  EXPECT_TRUE(std::get<0>(attempt_send(radio, tx, rx, 600)));
+  EXPECT_FALSE(std::get<0>(attempt_send(radio, tx2, rx, 600)));
+  EXPECT_EQ(drop_reason::rx_bitrate, rx.last_drop);
+}
+
+TEST(range_based, comms_cost_drop)
+{
+  // A link cut by the cost of the environment isn't out of range.
+  struct radio_configuration radio;
+  radio.pathloss_f = [](const double &, radio_state &, radio_state &)
+  {
+    return rf_power{-std::numeric_limits<double>::infinity(), 0.0, true};
+  };
+
+  rf_interface::radio_state tx, rx;
+  tx.update_stamp = rx.update_stamp = 0.0;
+  EXPECT_FALSE(std::get<0>(attempt_send(radio, tx, rx, 600)));
+  EXPECT_EQ(drop_reason::comms_cost, rx.last_drop);
+  EXPECT_STREQ("comms_cost", drop_reason_name(rx.last_drop));
+}
+
+TEST(link_random, philox_known_answers)
+{
+  // Known answer tests of Random123.
+  std::array<uint32_t, 4> zero =
+    philox4x32({{0u, 0u, 0u, 0u}}, {{0u, 0u}});
+  EXPECT_EQ(0x6627e8d5u, zero[0]);
+  EXPECT_EQ(0xe169c58du, zero[1]);
+  EXPECT_EQ(0xbc57ac4cu, zero[2]);
+  EXPECT_EQ(0x9b00dbd8u, zero[3]);
+
+  std::array<uint32_t, 4> pi =
+    philox4x32({{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}},
+               {{0xa4093822u, 0x299f31d0u}});
+  EXPECT_EQ(0xd16cfe09u, pi[0]);
+  EXPECT_EQ(0x94fdccebu, pi[1]);
+  EXPECT_EQ(0x5001e420u, pi[2]);
+  EXPECT_EQ(0x24126ea1u, pi[3]);
+}
+
+TEST(link_random, keyed_and_distributed)
+{
+  const uint32_t x1 = radio_id("X1");
+  const uint32_t x2 = radio_id("X2");
+  EXPECT_NE(x1, x2);
+
+  // The same key gives the same numbers, any other key different ones.
+  link_random a(7, x1, x2, 3), b(7, x1, x2, 3);
+  link_random seed(8, x1, x2, 3), rx(7, x1, x1, 3), seq(7, x1, x2, 4);
+  const double first = a.uniform();
+  EXPECT_EQ(first, b.uniform());
+  EXPECT_NE(first, seed.uniform());
+  EXPECT_NE(first, rx.uniform());
+  EXPECT_NE(first, seq.uniform());
+
+  // Moments over many packets.
+  const int n = 100000;
+  double sum_u = 0.0, sum_n = 0.0, sum_n2 = 0.0;
+  for(int i = 0; i < n; ++i)
+  {
+    link_random random(7, x1, x2, i);
+    const double u = random.uniform();
+    ASSERT_GE(u, 0.0);
+    ASSERT_LT(u, 1.0);
+    sum_u += u;
+    const double v = random.normal();
+    sum_n += v;
+    sum_n2 += v * v;
+  }
+  EXPECT_NEAR(0.5, sum_u / n, 0.01);
+  EXPECT_NEAR(0.0, sum_n / n, 0.01);
+  EXPECT_NEAR(1.0, sum_n2 / n, 0.02);
+}
+
+TEST(range_based, reproducible)
+{
+  // A link at the edge of the range, where fading decides which packets
+  // get through.
+  struct rf_configuration rf_config;
+  rf_config.max_range = 1000.0;
+  rf_config.sigma = 10.0;
+  auto rf_func = std::bind(&log_normal_received_power,
+                           std::placeholders::_1,
+                           std::placeholders::_2,
+                           std::placeholders::_3,
+                           rf_config);
+
+  struct radio_configuration radio;
+  radio.default_tx_power = 20;
+  radio.pathloss_f = rf_func;
+
+  auto run = [&](uint64_t seed)
+  {
+    radio.seed = seed;
+    rf_interface::radio_state tx, rx;
+    tx.id = radio_id("X1");
+    rx.id = radio_id("X2");
+    rx.pose.Set(360, 0, 0, 0, 0, 0);
+
+    std::vector<double> rssi;
+    for(int i = 0; i < 1000; ++i)
+    {
+      tx.update_stamp = rx.update_stamp = i;
+      ++tx.sequence;
+      bool received;
+      double power;
+      std::tie(received, power) = attempt_send(radio, tx, rx, 100);
+      rssi.push_back(received ? power : 0.0);
+    }
+    return rssi;
+  };
+
+  const auto first = run(42);
+  EXPECT_EQ(first, run(42));
+  EXPECT_NE(first, run(43));
+
+  // Fading made some packets pass and others not.
+  const auto dropped = std::count(first.begin(), first.end(), 0.0);
+  EXPECT_GT(dropped, 0);
+  EXPECT_LT(dropped, 1000);
+}
 
 int main(int argc, char **argv)
 {
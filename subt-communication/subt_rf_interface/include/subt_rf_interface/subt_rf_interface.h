@@ -18,8 +18,11 @@
 #ifndef SUBT_RF_INTERFACE__SUBT_RF_INTERFACE_H_
 #define SUBT_RF_INTERFACE__SUBT_RF_INTERFACE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
-#include <list>
+#include <utility>
+#include <vector>
 #include <ignition/math/Pose3.hh>
 
 namespace subt
@@ -28,6 +31,123 @@ namespace subt
 namespace rf_interface
 {
 
+/// \class sliding_window_counter
+/// \brief Count bytes transferred over a sliding time window
+///
+/// Transfers are stored in order in a ring buffer and expire from its
+/// front, as a packet history would. Transfers with the same time stamp
+/// as the previous one are merged, so the number of entries is bounded by
+/// the number of distinct time stamps (i.e., simulation updates) in the
+/// window instead of by the number of packets. Once the buffer has grown
+/// to that size, accounting is O(1) and does not allocate.
+class sliding_window_counter
+{
+ public:
+  /// Forget the transfers made before a time.
+  ///
+  /// @param before Transfers with an earlier time stamp are expired
+  void expire(double before)
+  {
+    while(count_ > 0 && entries_[head_].first < before)
+    {
+      total_ -= entries_[head_].second;
+      head_ = (head_ + 1) & (entries_.size() - 1);
+      --count_;
+    }
+  }
+
+  /// Record a transfer.
+  ///
+  /// @param stamp Time of the transfer
+  /// @param bytes Number of bytes transferred
+  void add(double stamp, uint64_t bytes)
+  {
+    total_ += bytes;
+
+    if(count_ > 0)
+    {
+      auto& last = entries_[(head_ + count_ - 1) & (entries_.size() - 1)];
+      if(last.first == stamp)
+      {
+        last.second += bytes;
+        return;
+      }
+    }
+
+    if(count_ == entries_.size())
+      grow();
+
+    entries_[(head_ + count_) & (entries_.size() - 1)] =
+      std::make_pair(stamp, bytes);
+    ++count_;
+  }
+
+  /// @return Number of bytes transferred in the window
+  uint64_t total() const { return total_; }
+
+  /// @return Number of stored entries
+  size_t size() const { return count_; }
+
+ private:
+  /// Double the capacity of the ring buffer, keeping the entries in order.
+  void grow()
+  {
+    std::vector<std::pair<double, uint64_t>> entries(
+        entries_.empty() ? 64 : entries_.size() * 2);
+    for(size_t i = 0; i < count_; ++i)
+      entries[i] = entries_[(head_ + i) & (entries_.size() - 1)];
+    entries_.swap(entries);
+    head_ = 0;
+  }
+
+  /// Ring buffer of (time stamp, bytes), its size is a power of two
+  std::vector<std::pair<double, uint64_t>> entries_;
+  size_t head_ = 0;    ///< Index of the oldest entry
+  size_t count_ = 0;   ///< Number of entries
+  uint64_t total_ = 0; ///< Sum of the bytes of the entries
+};
+
+/// \enum drop_reason
+/// \brief Why a packet was not delivered to a radio
+enum class drop_reason : uint8_t
+{
+  none = 0,         ///< The packet was delivered
+  unknown = 1,      ///< The communication model gave no reason
+  tx_bitrate = 2,   ///< The transmitter was over its capacity
+  rx_bitrate = 3,   ///< The receiver was over its capacity
+  out_of_range = 4, ///< No signal reached the receiver
+  packet_error = 5, ///< The packet was received with errors
+  unregistered = 6, ///< The sender or the receiver is not registered
+  no_endpoint = 7,  ///< No radio is bound to the destination
+  no_pathloss = 8,  ///< The sender has no pathloss function
+  transport = 9,    ///< The packet could not be handed to the receiver
+  comms_cost = 10   ///< The cost of the link exceeds the maximum
+};
+
+/// Number of values of drop_reason.
+const size_t num_drop_reasons = 11;
+
+/// @param reason Drop reason
+/// @return Name of the drop reason, e.g., "tx_bitrate"
+inline const char* drop_reason_name(drop_reason reason)
+{
+  switch(reason)
+  {
+    case drop_reason::none: return "none";
+    case drop_reason::unknown: return "unknown";
+    case drop_reason::tx_bitrate: return "tx_bitrate";
+    case drop_reason::rx_bitrate: return "rx_bitrate";
+    case drop_reason::out_of_range: return "out_of_range";
+    case drop_reason::packet_error: return "packet_error";
+    case drop_reason::unregistered: return "unregistered";
+    case drop_reason::no_endpoint: return "no_endpoint";
+    case drop_reason::no_pathloss: return "no_pathloss";
+    case drop_reason::transport: return "transport";
+    case drop_reason::comms_cost: return "comms_cost";
+  }
+  return "invalid";
+}
+
 /// \struct radio_state
 /// \brief Store radio state
 ///
@@ -37,19 +157,18 @@ struct radio_state
 {
   double update_stamp;      ///< Timestamp of last update
   ignition::math::Pose3<double> pose;  ///< Pose of the radio
-  std::list<std::pair<double, uint64_t>> bytes_sent; ///< Recent
-                                                        ///sent packet
-                                                        ///history
-  uint64_t bytes_sent_this_epoch = 0; ///< Accumulation of bytes sent
-                                      /// in an epoch
-  std::list<std::pair<double, uint64_t>> bytes_received; ///<
-                                                            ///Recent
-                                                            ///received
-                                                            ///packet
-                                                            ///history
-  uint64_t bytes_received_this_epoch = 0;  ///< Accumulation of bytes
-                                           /// received in an epoch
+  sliding_window_counter bytes_sent; ///< Bytes sent in the last
+                                     /// epoch
+  sliding_window_counter bytes_received; ///< Bytes received in the
+                                         /// last epoch
   double antenna_gain;      ///< Isotropic antenna gain
+  uint32_t id = 0;          ///< Identifier keying the random draws
+                            /// of the radio's links
+  uint32_t sequence = 0;    ///< Sequence number of the packet being
+                            /// sent
+  drop_reason last_drop = drop_reason::none; ///< Why the last packet
+                                             /// sent to the radio was
+                                             /// dropped
 };
 /// \struct rf_power
 ///
@@ -59,6 +178,9 @@ struct rf_power
 {
   double mean; ///< Expected value of RF power
   double variance; ///< Variance of RF power
+  bool cost_limited; ///< True if the link is cut by the cost of the
+                     /// environment rather than by range. Left
+                     /// false by {mean, variance}.
   operator double() { return mean; }
 };
 
@@ -36,10 +36,10 @@ rf_power distance_based_received_power(const double& tx_power,
 
   if(config.max_range > 0.0 &&
      range > config.max_range) {
-    return {-std::numeric_limits<double>::infinity(), 0.0};
+    return {-std::numeric_limits<double>::infinity(), 0.0, false};
   }
 
-  return {tx_power, 0.0};
+  return {tx_power, 0.0, false};
 }
 
 /////////////////////////////////////////////
@@ -52,12 +52,12 @@ rf_power log_normal_received_power(const double& tx_power,
 
   if(config.max_range > 0.0 &&
      range > config.max_range) {
-    return {-std::numeric_limits<double>::infinity(), 0.0};
+    return {-std::numeric_limits<double>::infinity(), 0.0, false};
   }
 
   double PL = config.L0 + 10 * config.fading_exponent * log10(range);
 
-  return {tx_power - PL, config.sigma};
+  return {tx_power - PL, config.sigma, false};
 }
 
 /////////////////////////////////////////////
@@ -68,7 +68,7 @@ rf_power log_normal_v2_received_power(const double& tx_power,
 {
   if(config.max_range > 0.0 &&
      range > config.max_range) {
-    return {-std::numeric_limits<double>::infinity(), 0.0};
+    return {-std::numeric_limits<double>::infinity(), 0.0, false};
   }
 
   double adjusted_range = config.scaling_factor *
@@ -76,7 +76,7 @@ rf_power log_normal_v2_received_power(const double& tx_power,
 
   double PL = config.L0 + 10 * config.fading_exponent * log10(adjusted_range);
 
-  return {tx_power - PL, config.sigma};
+  return {tx_power - PL, config.sigma, false};
 }
 
 /////////////////////////////////////////////
@@ -85,7 +85,7 @@ rf_power visibility_only_received_power(const double& tx_power,
 {
   double PL = config.L0 + 10 * config.fading_exponent;
 
-  return {tx_power - PL, config.sigma};
+  return {tx_power - PL, config.sigma, false};
 }
 
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <gtest/gtest.h>
 
@@ -5,6 +6,10 @@
 #include <subt_rf_interface/subt_rf_model.h>
 
 #include <limits>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
 
 using namespace subt;
 using namespace subt::rf_interface;
@@ -55,6 +60,85 @@ TEST(range_based, over_range)
       -std::numeric_limits<double>::infinity());
 }
 
+/// Capacity check of attempt_send() as it was done with a packet history
+/// list, used as the reference for sliding_window_counter.
+struct list_history
+{
+  std::list<std::pair<double, uint64_t>> history;
+  uint64_t bytes_this_epoch = 0;
+
+  bool accept(double now, uint64_t num_bytes, double capacity)
+  {
+    while(!history.empty() && history.front().first < now - 1.0)
+    {
+      bytes_this_epoch -= history.front().second;
+      history.pop_front();
+    }
+    if((bytes_this_epoch + num_bytes)*8.0 > capacity)
+      return false;
+    history.push_back(std::make_pair(now, num_bytes));
+    bytes_this_epoch += num_bytes;
+    return true;
+  }
+};
+
+bool accept(sliding_window_counter& counter, double now, uint64_t num_bytes,
+            double capacity)
+{
+  counter.expire(now - 1.0);
+  if((counter.total() + num_bytes)*8.0 > capacity)
+    return false;
+  counter.add(now, num_bytes);
+  return true;
+}
+
+TEST(sliding_window_counter, matches_packet_history)
+{
+  // Traffic of a robot sharing a point cloud map: small status messages
+  // every step and 64 kB map chunks, split in 1400 byte packets, bursting
+  // every 0.5s, updated at 1kHz. Time jumps back once, as on a reset.
+  const double capacity = 2e6;
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> small_size(20, 200);
+  std::uniform_int_distribution<int> small_count(0, 3);
+
+  list_history reference;
+  sliding_window_counter counter;
+  std::vector<bool> expected, actual;
+  size_t max_size = 0;
+
+  double now = 0.0;
+  for(int step = 0; step < 20000; ++step)
+  {
+    now = step == 10000 ? now - 5.0 : now + 0.001;
+
+    std::vector<uint64_t> packets;
+    for(int i = small_count(rng); i > 0; --i)
+      packets.push_back(small_size(rng));
+    if(step % 500 == 0)
+    {
+      for(uint64_t left = 64000; left > 0; left -= packets.back())
+        packets.push_back(std::min<uint64_t>(left, 1400));
+    }
+
+    for(auto num_bytes : packets)
+    {
+      expected.push_back(reference.accept(now, num_bytes, capacity));
+      actual.push_back(accept(counter, now, num_bytes, capacity));
+      ASSERT_EQ(expected.back(), actual.back()) << "step " << step;
+      ASSERT_EQ(reference.bytes_this_epoch, counter.total());
+    }
+    if(step < 10000)
+      max_size = std::max(max_size, counter.size());
+  }
+
+  // Both decisions happened, and the counter stored at most an entry per
+  // update in the window, not one per packet.
+  EXPECT_NE(std::count(actual.begin(), actual.end(), true), 0);
+  EXPECT_NE(std::count(actual.begin(), actual.end(), false), 0);
+  EXPECT_LE(max_size, 1002u);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
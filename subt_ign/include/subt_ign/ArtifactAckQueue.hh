@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef SUBT_IGN_ARTIFACTACKQUEUE_HH_
+#define SUBT_IGN_ARTIFACTACKQUEUE_HH_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace subt
+{
+  /// \brief Report-to-ack statistics of a robot.
+  struct AckMetrics
+  {
+    /// \brief Number of acks sent.
+    uint64_t acks = 0;
+
+    /// \brief Number of reports that could not be scored.
+    uint64_t failures = 0;
+
+    /// \brief Sum of the report-to-ack latencies, in seconds.
+    double totalLatency = 0;
+
+    /// \brief Max report-to-ack latency, in seconds.
+    double maxLatency = 0;
+  };
+
+  /// \brief The work of the base station: artifact reports waiting to be
+  /// scored, score requests waiting for their reply, and scores waiting to
+  /// be sent back to the robots, plus the report-to-ack statistics of every
+  /// robot.
+  ///
+  /// At most a given number of score requests are in flight, the other
+  /// reports wait in the queue. A request without a reply before its
+  /// deadline counts as a failure. Next() blocks the thread doing the work
+  /// until there is some.
+  ///
+  /// All the functions are thread safe.
+  /// \tparam ArtifactT Type of the reported artifacts.
+  /// \tparam ScoreT Type of the scores.
+  template<typename ArtifactT, typename ScoreT>
+  class ArtifactAckQueue
+  {
+    /// \brief Clock of the latencies and deadlines.
+    public: using Clock = std::chrono::steady_clock;
+
+    /// \brief An artifact report.
+    public: struct Report
+    {
+      /// \brief Address of the reporting robot.
+      std::string address;
+
+      /// \brief The reported artifact.
+      ArtifactT artifact;
+
+      /// \brief Time at which the report was received.
+      Clock::time_point received;
+    };
+
+    /// \brief A score to send back to a robot.
+    public: struct Ack
+    {
+      /// \brief Address of the reporting robot.
+      std::string address;
+
+      /// \brief The score.
+      ScoreT score;
+
+      /// \brief Time at which the report was received.
+      Clock::time_point received;
+    };
+
+    /// \brief Work taken by Next().
+    public: struct Batch
+    {
+      /// \brief Reports to score, with the id of their request.
+      std::vector<std::pair<uint64_t, Report>> reports;
+
+      /// \brief Scores to send.
+      std::deque<Ack> acks;
+
+      /// \brief Number of requests that timed out.
+      size_t timedOut = 0;
+    };
+
+    /// \brief Constructor.
+    /// \param[in] _maxRequestsInFlight Maximum number of score requests
+    /// waiting for their reply, at least 1.
+    /// \param[in] _timeout Time to wait for the reply of a score request.
+    public: ArtifactAckQueue(size_t _maxRequestsInFlight,
+                             std::chrono::milliseconds _timeout)
+      : maxRequestsInFlight(std::max<size_t>(_maxRequestsInFlight, 1u)),
+        timeout(_timeout)
+    {
+    }
+
+    /// \brief Queue a report to be scored.
+    /// \param[in] _report The report.
+    public: void AddReport(Report _report)
+    {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->reports.push_back(std::move(_report));
+      }
+      this->cv.notify_all();
+    }
+
+    /// \brief Store the reply of a score request.
+    /// \param[in] _id Id of the request.
+    /// \param[in] _score The score.
+    /// \param[in] _result True if the request succeeded. Otherwise, the
+    /// report counts as a failure.
+    /// \return False if the request is unknown, e.g., it timed out.
+    public: bool OnScore(uint64_t _id, const ScoreT &_score,
+                         const bool _result)
+    {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto iter = this->requests.find(_id);
+        if (iter == this->requests.end())
+          return false;
+
+        if (_result)
+        {
+          this->acks.push_back({iter->second.address, _score,
+              iter->second.received});
+        }
+        else
+        {
+          this->metrics[iter->second.address].failures++;
+          this->metricsChanged = true;
+        }
+        this->requests.erase(iter);
+      }
+      this->cv.notify_all();
+      return true;
+    }
+
+    /// \brief Wait for work, and take it. The scores and as many reports as
+    /// there are free request slots are taken, and a request is started for
+    /// each report. Requests past their deadline are given up.
+    /// \param[out] _batch The work. Its memory is reused.
+    /// \return False if Stop() was called.
+    public: bool Next(Batch &_batch)
+    {
+      _batch.reports.clear();
+      _batch.acks.clear();
+      _batch.timedOut = 0;
+
+      std::unique_lock<std::mutex> lock(this->mutex);
+      auto ready = [this]
+      {
+        return !this->running || !this->acks.empty() ||
+          this->metricsChanged ||
+          (!this->reports.empty() &&
+           this->requests.size() < this->maxRequestsInFlight);
+      };
+
+      // Wake up when there is work, or when the oldest request times out.
+      if (this->requests.empty())
+      {
+        this->cv.wait(lock, ready);
+      }
+      else
+      {
+        auto deadline = this->requests.begin()->second.deadline;
+        for (const auto &request : this->requests)
+          deadline = std::min(deadline, request.second.deadline);
+        this->cv.wait_until(lock, deadline, ready);
+      }
+
+      if (!this->running)
+        return false;
+
+      const auto now = Clock::now();
+      for (auto iter = this->requests.begin(); iter != this->requests.end();)
+      {
+        if (iter->second.deadline <= now)
+        {
+          this->metrics[iter->second.address].failures++;
+          this->metricsChanged = true;
+          ++_batch.timedOut;
+          iter = this->requests.erase(iter);
+        }
+        else
+        {
+          ++iter;
+        }
+      }
+
+      // Nothing is copied, and scores added after this stay in the queue
+      // for the next call.
+      _batch.acks.swap(this->acks);
+      while (!this->reports.empty() &&
+             this->requests.size() < this->maxRequestsInFlight)
+      {
+        const uint64_t id = this->nextRequestId++;
+        Report &report = this->reports.front();
+        this->requests[id] = {report.address, report.received,
+          now + this->timeout};
+        _batch.reports.emplace_back(id, std::move(report));
+        this->reports.pop_front();
+      }
+      return true;
+    }
+
+    /// \brief Record the scores sent back to the robots.
+    /// \param[in] _latencies Address of the robot and report-to-ack latency
+    /// in seconds of each score.
+    public: void AcksSent(
+                const std::vector<std::pair<std::string, double>> &_latencies)
+    {
+      if (_latencies.empty())
+        return;
+
+      std::lock_guard<std::mutex> lock(this->mutex);
+      for (const auto &[address, latency] : _latencies)
+      {
+        AckMetrics &robotMetrics = this->metrics[address];
+        robotMetrics.acks++;
+        robotMetrics.totalLatency += latency;
+        robotMetrics.maxLatency = std::max(robotMetrics.maxLatency, latency);
+      }
+      this->metricsChanged = true;
+    }
+
+    /// \brief Statistics of all the robots, if they changed since the last
+    /// call.
+    /// \param[out] _metrics Statistics by robot address.
+    /// \return False if nothing changed, in which case _metrics is left
+    /// untouched.
+    public: bool TakeMetrics(std::map<std::string, AckMetrics> &_metrics)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (!this->metricsChanged)
+        return false;
+
+      _metrics = this->metrics;
+      this->metricsChanged = false;
+      return true;
+    }
+
+    /// \brief Number of score requests waiting for their reply.
+    /// \return The number of requests.
+    public: size_t InFlight() const
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      return this->requests.size();
+    }
+
+    /// \brief Number of reports waiting for a free request slot.
+    /// \return The number of reports.
+    public: size_t Pending() const
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      return this->reports.size();
+    }
+
+    /// \brief Make Next() return false.
+    public: void Stop()
+    {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->running = false;
+      }
+      this->cv.notify_all();
+    }
+
+    /// \brief A score request waiting for its reply.
+    private: struct Request
+    {
+      /// \brief Address of the reporting robot.
+      std::string address;
+
+      /// \brief Time at which the report was received.
+      Clock::time_point received;
+
+      /// \brief Time after which the request is abandoned.
+      Clock::time_point deadline;
+    };
+
+    /// \brief Maximum number of score requests in flight.
+    private: const size_t maxRequestsInFlight;
+
+    /// \brief Time to wait for the reply of a score request.
+    private: const std::chrono::milliseconds timeout;
+
+    /// \brief Reports waiting for a free request slot.
+    private: std::deque<Report> reports;
+
+    /// \brief Score requests waiting for their reply, by request id.
+    private: std::map<uint64_t, Request> requests;
+
+    /// \brief Id of the next score request.
+    private: uint64_t nextRequestId = 0u;
+
+    /// \brief Scores to send.
+    private: std::deque<Ack> acks;
+
+    /// \brief Report-to-ack statistics, by robot address.
+    private: std::map<std::string, AckMetrics> metrics;
+
+    /// \brief Whether the statistics changed since TakeMetrics().
+    private: bool metricsChanged = false;
+
+    /// \brief False once Stop() is called.
+    private: bool running = true;
+
+    /// \brief Protects all of the above.
+    private: mutable std::mutex mutex;
+
+    /// \brief Signals new work and Stop().
+    private: std::condition_variable cv;
+  };
+}
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef SUBT_IGN_ARTIFACTSCORER_HH_
+#define SUBT_IGN_ARTIFACTSCORER_HH_
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+#include <subt_ign/CommonTypes.hh>
+
+namespace subt
+{
+  /// \brief Offset from an artifact's model origin to its localization point.
+  /// Types without a specified offset use the model origin.
+  ///
+  /// Refer to:
+  /// https://subtchallenge.com/resources/SubT_Urban_Artifacts_Specification.pdf
+  /// \param[in] _type The artifact type.
+  /// \return The offset, expressed in the artifact model frame.
+  ignition::math::Vector3d ArtifactOffset(const ArtifactType &_type);
+
+  /// \brief Compute the localization point of an artifact.
+  /// \param[in] _type The artifact type.
+  /// \param[in] _pose World pose of the artifact model.
+  /// \return The localization point in world coordinates.
+  ignition::math::Vector3d ArtifactLocalizationPoint(
+      const ArtifactType &_type, const ignition::math::Pose3d &_pose);
+
+  /// \brief Result of a closest artifact query.
+  struct ArtifactMatch
+  {
+    /// \brief Name of the closest artifact, empty if there was none.
+    std::string name;
+
+    /// \brief Localization point of the closest artifact.
+    ignition::math::Vector3d pos;
+
+    /// \brief Euclidean distance to the closest artifact. Infinity if there
+    /// was no candidate.
+    double distance = std::numeric_limits<double>::infinity();
+  };
+
+  /// \brief Outcome of scoring an artifact report.
+  struct ArtifactReportResult
+  {
+    /// \brief True if the same report was received before.
+    bool duplicate = false;
+
+    /// \brief Points scored. For a duplicate report, the points that the
+    /// original report scored.
+    double score = 0.0;
+
+    /// \brief Closest artifact of the reported type. Not filled for
+    /// duplicate reports.
+    ArtifactMatch match;
+  };
+
+  /// \brief Static 3D k-d tree holding the localization points of the
+  /// artifacts of a single type.
+  class ArtifactIndex
+  {
+    /// \brief Rebuild the tree. Points with an infinite coordinate (artifacts
+    /// whose pose has not been received yet) are skipped.
+    /// \param[in] _points Artifact names and localization points. Ties in
+    /// distance are resolved in favor of the smallest name, as the linear
+    /// scan over a sorted map used to do.
+    public: void Build(
+        const std::map<std::string, ignition::math::Vector3d> &_points);
+
+    /// \brief Find the closest artifact to a position.
+    /// \param[in] _pos Query position.
+    /// \param[out] _match The closest artifact. Unmodified if the index is
+    /// empty.
+    /// \return True if a match was found.
+    public: bool Closest(const ignition::math::Vector3d &_pos,
+                         ArtifactMatch &_match) const;
+
+    /// \brief Number of indexed points.
+    /// \return The number of points.
+    public: size_t Size() const;
+
+    /// \brief Recursive nearest neighbor search.
+    /// \param[in] _lo First node of the subtree.
+    /// \param[in] _hi One past the last node of the subtree.
+    /// \param[in] _depth Depth of the subtree root.
+    /// \param[in] _pos Query position.
+    /// \param[in,out] _best Index of the best node so far.
+    /// \param[in,out] _bestDist Distance to the best node so far.
+    private: void Search(size_t _lo, size_t _hi, size_t _depth,
+                         const ignition::math::Vector3d &_pos,
+                         size_t &_best, double &_bestDist) const;
+
+    /// \brief A tree node.
+    private: struct Node
+    {
+      /// \brief Localization point.
+      ignition::math::Vector3d pos;
+
+      /// \brief Position of the artifact name in sorted order.
+      size_t rank;
+    };
+
+    /// \brief Tree nodes. The root of every [lo, hi) range is at its middle
+    /// element, and the split axis cycles with the depth.
+    private: std::vector<Node> nodes;
+
+    /// \brief Artifact names, in sorted order.
+    private: std::vector<std::string> names;
+  };
+
+  /// \brief Key identifying a unique artifact report: the artifact type and
+  /// the reported position quantized to micrometers, which matches the
+  /// resolution of the std::to_string key that was used before.
+  struct ReportKey
+  {
+    /// \brief Build a key.
+    /// \param[in] _type The reported artifact type.
+    /// \param[in] _pos The reported position, in the artifact origin frame.
+    public: ReportKey(const ArtifactType &_type,
+                      const ignition::math::Vector3d &_pos);
+
+    /// \brief Equality operator.
+    /// \param[in] _other Key to compare against.
+    /// \return True if both keys represent the same report.
+    public: bool operator==(const ReportKey &_other) const;
+
+    /// \brief Reported type.
+    public: ArtifactType type;
+
+    /// \brief Quantized coordinates.
+    public: int64_t x, y, z;
+  };
+
+  /// \brief Hash function for ReportKey.
+  struct ReportKeyHash
+  {
+    /// \brief Hash a key.
+    /// \param[in] _key The key.
+    /// \return The hash value.
+    size_t operator()(const ReportKey &_key) const;
+  };
+
+  /// \brief Core of the artifact scoring logic, free of any simulation
+  /// dependency. It keeps a spatial index per artifact type and the set of
+  /// unique reports received so far.
+  class ArtifactScorer
+  {
+    /// \brief Set the localization point of an artifact, registering the
+    /// artifact if it is new. The index of the type is only invalidated if the
+    /// point changed.
+    /// \param[in] _type The artifact type.
+    /// \param[in] _name The artifact model name.
+    /// \param[in] _point Localization point in world coordinates. Use
+    /// infinite coordinates for an artifact whose pose is not known yet.
+    /// \return True if the artifact was not registered before.
+    public: bool SetArtifact(const ArtifactType &_type,
+                             const std::string &_name,
+                             const ignition::math::Vector3d &_point);
+
+    /// \brief Whether an artifact has been registered.
+    /// \param[in] _type The artifact type.
+    /// \param[in] _name The artifact model name.
+    /// \return True if the artifact is known.
+    public: bool HasArtifact(const ArtifactType &_type,
+                             const std::string &_name) const;
+
+    /// \brief Total number of registered artifacts.
+    /// \return The number of artifacts.
+    public: size_t ArtifactCount() const;
+
+    /// \brief Score an artifact report. A report scores a point if it is a
+    /// new report located within kScoringDistance of an artifact of the
+    /// reported type that has not been found yet.
+    /// \param[in] _type The reported type.
+    /// \param[in] _reportedPos The reported position, in the artifact origin
+    /// frame. It identifies duplicate reports.
+    /// \param[in] _worldPos The reported position in world coordinates.
+    /// \return The result of the report.
+    public: ArtifactReportResult Score(const ArtifactType &_type,
+                const ignition::math::Vector3d &_reportedPos,
+                const ignition::math::Vector3d &_worldPos);
+
+    /// \brief Number of artifacts found so far.
+    /// \return The number of found artifacts.
+    public: size_t FoundCount() const;
+
+    /// \brief Find the closest artifact of a type to a position.
+    /// \param[in] _type The artifact type.
+    /// \param[in] _pos Position in world coordinates.
+    /// \return The closest artifact. The distance is infinity if there is no
+    /// artifact of the given type.
+    public: ArtifactMatch Closest(const ArtifactType &_type,
+                                  const ignition::math::Vector3d &_pos);
+
+    /// \brief Look up a previous report.
+    /// \param[in] _key The report key.
+    /// \param[out] _score Score obtained by the previous report.
+    /// \return True if the report was received before.
+    public: bool FindReport(const ReportKey &_key, double &_score) const;
+
+    /// \brief Store a unique report.
+    /// \param[in] _key The report key.
+    /// \param[in] _score Score obtained by the report.
+    public: void AddReport(const ReportKey &_key, double _score);
+
+    /// \brief Maximum distance in meters between a report and an artifact
+    /// for the report to score.
+    public: static constexpr double kScoringDistance = 5.0;
+
+    /// \brief Artifacts of a single type.
+    private: struct TypeData
+    {
+      /// \brief Localization point of every artifact of this type.
+      std::map<std::string, ignition::math::Vector3d> points;
+
+      /// \brief Spatial index over points.
+      ArtifactIndex index;
+
+      /// \brief True when the index has to be rebuilt.
+      bool dirty = true;
+    };
+
+    /// \brief Artifacts, keyed by type.
+    private: std::map<ArtifactType, TypeData> types;
+
+    /// \brief Number of registered artifacts.
+    private: size_t count = 0u;
+
+    /// \brief Names of the artifacts found so far.
+    private: std::set<std::string> found;
+
+    /// \brief Unique reports received and the score they got.
+    private: std::unordered_map<ReportKey, double, ReportKeyHash>
+             uniqueReports;
+  };
+}
+#endif
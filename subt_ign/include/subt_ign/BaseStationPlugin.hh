@@ -20,10 +20,9 @@
 
 #include <subt_communication_broker/subt_communication_client.h>
 
-#include <map>
 #include <memory>
 #include <string>
-#include <vector>
+#include <thread>
 
 #include <sdf/Element.hh>
 
@@ -31,11 +30,26 @@
 #include <ignition/launch/Plugin.hh>
 #include <ignition/transport/Node.hh>
 
+#include "subt_ign/ArtifactAckQueue.hh"
 #include "subt_ign/protobuf/artifact.pb.h"
 
 namespace subt
 {
   /// \brief A plugin to receive artifact reports from the teams.
+  ///
+  /// Reports are scored asynchronously, and the scores are sent back to the
+  /// reporting robots as soon as they are available. The plugin accepts the
+  /// following optional parameters:
+  ///
+  /// <max_requests_in_flight> Maximum number of reports being scored at the
+  ///                          same time. Other reports wait in a queue.
+  ///                          Defaults to 8.
+  /// <request_timeout>        Time in milliseconds to wait for a score
+  ///                          before giving up on a report. Defaults to
+  ///                          1000.
+  ///
+  /// Report-to-ack latency statistics of every robot are published on
+  /// /subt/base_station/ack_metrics.
   class BaseStationPlugin : public ignition::launch::Plugin
   {
     /// \brief Constructor
@@ -48,7 +62,7 @@ namespace subt
     public: virtual bool Load(const tinyxml2::XMLElement *_elem) override final;
 
     /// \brief Callback for processing an artifact report.
-    /// \param[in] _srcAddress Unused.
+    /// \param[in] _srcAddress Address of the reporting robot.
     /// \param[in] _dstAddress Unused.
     /// \param[in] _dstPort Unused.
     /// \param[in] _data Serialized artifact.
@@ -57,30 +71,34 @@ namespace subt
                              const uint32_t _dstPort,
                              const std::string &_data);
 
-    private: void RunLoop();
-
-    /// \brief Thread to send Ack when required.
-    private: std::thread ackThread;
-
-    /// \brief Score acknowledgement data to send.
-    private: std::map<std::string,
-                      std::vector<subt::msgs::ArtifactScore>> scores;
+    /// \brief Callback for the reply of a score request.
+    /// \param[in] _id Id of the request.
+    /// \param[in] _score The score.
+    /// \param[in] _result True if the request succeeded.
+    private: void OnScore(uint64_t _id,
+                          const subt::msgs::ArtifactScore &_score,
+                          const bool _result);
 
-    /// \brief Client address to respond with data.
-    private: std::string resAddress;
+    /// \brief Send the score requests and the acks.
+    private: void RunLoop();
 
-    /// \brief Flag to terminate ack thread.
-    private: std::atomic<bool> running{true};
+    /// \brief Queue of reports, score requests and acks.
+    private: using AckQueue =
+      ArtifactAckQueue<subt::msgs::Artifact, subt::msgs::ArtifactScore>;
 
-    /// \brief Mutex to protect ack data.
-    private: std::mutex mutex;
+    /// \brief Thread to send score requests and acks.
+    private: std::thread ackThread;
 
-    /// \brief Condition variable to signal ack data ready.
-    private: std::condition_variable cv;
+    /// \brief Reports, score requests, acks and their statistics. Created
+    /// in Load().
+    private: std::unique_ptr<AckQueue> queue;
 
     /// \brief An ignition transport node.
     private: ignition::transport::Node node;
 
+    /// \brief Publisher of the report-to-ack statistics.
+    private: ignition::transport::Node::Publisher metricsPub;
+
     /// \brief SubT communication client.
     private: std::unique_ptr<subt::CommsClient> client;
   };
@@ -22,9 +22,10 @@
 #include <subt_communication_model/subt_communication_model.h>
 #include <subt_communication_broker/subt_communication_broker.h>
 
-#include <map>
+#include <memory>
 #include <string>
 
+#include <subt_ign/PoseCache.hh>
 #include <subt_ign/VisibilityRfModel.hh>
 
 #include <cstdint>
@@ -57,6 +58,9 @@ namespace subt
   ///                                          visibility cost heuristic to
   ///                                          additional fading exponent
   ///     <comms_cost_max>  Limit visibility cost to this value
+  ///     <coverage_resolution> Size of the cells the coverage shown by
+  ///                       /subt/comms_model/visualize is sampled on, in
+  ///                       meters (default 1)
   ///   <radio_config>      Configuration block for radio model
   ///     <capacity>        Bitrate limit on the channel
   ///     <tx_power>        Default transmit power (dBm)
@@ -64,6 +68,21 @@ namespace subt
   ///     <modulation>      Modulation scheme (must by QPSK), used to compute
   ///                       relationship between signal-to-noise ratio (SNR)
   ///                       and bit-error-rate (BER).
+  ///   <seed>            Seed of the random fading and packet drops
+  ///                       (default 0). The draws of a packet depend only
+  ///                       on the seed, the sender, the receiver and the
+  ///                       packet number, so runs can be reproduced.
+  /// <trace>               Record the traffic to a file, which can be
+  ///                       replayed with comms_trace_replay
+  ///   <path>              Path of the trace file
+  ///   <payload>           Whether to record the payloads of the messages
+  ///                       (default false)
+  /// <telemetry>           Per link traffic counters, published on
+  ///                       /subt/comms/telemetry
+  ///   <period>            Publishing period in seconds, zero to disable
+  ///                       (default 1)
+  ///   <file>              File to also write the counters to, in the
+  ///                       Prometheus text format
   class CommsBrokerPlugin : public ignition::launch::Plugin
   {
     /// \brief Class constructor.
@@ -76,6 +95,10 @@ namespace subt
     /// \param[in] _msg Vector of entity positions.
     private: void OnPose(const ignition::msgs::Pose_V &_msg);
 
+    /// \brief Callback for the entities created in the world.
+    /// \param[in] _msg The created models.
+    private: void OnScene(const ignition::msgs::Scene &_msg);
+
     /// \brief Update the visibility table if new breadcrumbs are found.
     /// Note that this function doesn't consider breadcrumb removals.
     private: void UpdateIfNewBreadcrumbs();
@@ -86,19 +109,15 @@ namespace subt
     /// \brief Last time the plugin checked the ROS parameter server.
     // private: ignition::common::Time lastROSParameterCheckTime;
 
-    private: ignition::common::Time simTime;
-
-    private: std::map<std::string, ignition::math::Pose3d> poses;
+    /// \brief Poses of the team members, shared with the visibility model.
+    private: std::shared_ptr<PoseCache> poseCache =
+      std::make_shared<PoseCache>();
 
     private:
       std::unique_ptr<subt::rf_interface::visibilityModel::VisibilityModel>
       visibilityModel;
 
     private: ignition::transport::Node node;
-
-    /// \brief Names and poses of the breadcrumbs.
-    /// The key is the breadcrumb name and the value is its pose.
-    private: std::map<std::string, ignition::math::Pose3d> breadcrumbs;
   };
 }
 
@@ -29,7 +29,8 @@ class GasDetectorPrivate;
 /*
  * Each emitter is defined as a region in the simulation environment where
  * a particular gas (defined by 'type') can be detected by the mobile
- * GasDetector system.
+ * GasDetector system. Emitters are static; all of them are registered in
+ * a spatial index shared by the detectors.
  *
  * Example 1m cube methane leak at x=10, y=0, z=0
  *
@@ -67,6 +68,11 @@ class GasEmitter:
  * The detector will return true if it is in an emitter region with a
  * matching type, otherwise false.
  *
+ * The detector is evaluated at `update_rate` (in simulation time), or on
+ * every update if it is 0. The result is published when it changes, and
+ * otherwise every `heartbeat_period` seconds (default 1, 0 publishes every
+ * evaluation).
+ *
  * Example propane detector that publishes on `/propane_detector` at 10Hz:
  *
  *  <plugin name="subt::GasDetector" filename="libGasEmitterDetectorPlugin.so">
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef SUBT_IGN_LOCKFREEQUEUE_HH_
+#define SUBT_IGN_LOCKFREEQUEUE_HH_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace subt
+{
+  /// \brief A bounded queue that any number of threads can push to and pop
+  /// from without taking a lock. Pushing fails instead of blocking when the
+  /// queue is full, so a producer such as a transport callback never waits
+  /// for the consumer.
+  ///
+  /// Each slot carries a sequence number which tells producers and consumers
+  /// whether it is free or full for their position in the queue (D. Vyukov's
+  /// bounded MPMC queue).
+  /// \tparam T Type of the elements. It has to be default constructible and
+  /// move assignable.
+  template<typename T>
+  class LockFreeQueue
+  {
+    /// \brief Constructor.
+    /// \param[in] _capacity Maximum number of queued elements. It is rounded
+    /// up to a power of two.
+    public: explicit LockFreeQueue(std::size_t _capacity)
+    {
+      std::size_t capacity = 2u;
+      while (capacity < _capacity)
+        capacity *= 2u;
+
+      this->mask = capacity - 1u;
+      this->slots.reset(new Slot[capacity]);
+      for (std::size_t i = 0u; i < capacity; ++i)
+        this->slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /// \brief Copying would break the other threads using the queue.
+    public: LockFreeQueue(const LockFreeQueue &) = delete;
+
+    /// \brief Copying would break the other threads using the queue.
+    public: LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+    /// \brief Maximum number of queued elements.
+    /// \return The capacity.
+    public: std::size_t Capacity() const
+    {
+      return this->mask + 1u;
+    }
+
+    /// \brief Add an element to the back of the queue.
+    /// \param[in] _value The element.
+    /// \return False if the queue is full. The element is not added then.
+    public: bool Push(T _value)
+    {
+      std::size_t pos = this->tail.load(std::memory_order_relaxed);
+      Slot *slot;
+      while (true)
+      {
+        slot = &this->slots[pos & this->mask];
+        const std::size_t sequence =
+            slot->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence) -
+            static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0)
+        {
+          if (this->tail.compare_exchange_weak(pos, pos + 1u,
+                std::memory_order_relaxed))
+          {
+            break;
+          }
+        }
+        // The consumers haven't freed the slot yet.
+        else if (diff < 0)
+        {
+          return false;
+        }
+        // Another producer took the slot.
+        else
+        {
+          pos = this->tail.load(std::memory_order_relaxed);
+        }
+      }
+
+      slot->value = std::move(_value);
+      slot->sequence.store(pos + 1u, std::memory_order_release);
+      return true;
+    }
+
+    /// \brief Remove the element at the front of the queue.
+    /// \param[out] _value The element.
+    /// \return False if the queue is empty.
+    public: bool Pop(T &_value)
+    {
+      std::size_t pos = this->head.load(std::memory_order_relaxed);
+      Slot *slot;
+      while (true)
+      {
+        slot = &this->slots[pos & this->mask];
+        const std::size_t sequence =
+            slot->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence) -
+            static_cast<std::ptrdiff_t>(pos + 1u);
+        if (diff == 0)
+        {
+          if (this->head.compare_exchange_weak(pos, pos + 1u,
+                std::memory_order_relaxed))
+          {
+            break;
+          }
+        }
+        // The producers haven't filled the slot yet.
+        else if (diff < 0)
+        {
+          return false;
+        }
+        // Another consumer took the slot.
+        else
+        {
+          pos = this->head.load(std::memory_order_relaxed);
+        }
+      }
+
+      _value = std::move(slot->value);
+      slot->sequence.store(pos + this->mask + 1u, std::memory_order_release);
+      return true;
+    }
+
+    /// \brief An element and the position in the queue it belongs to.
+    private: struct Slot
+    {
+      /// \brief Equal to the position when the slot is free, and to the
+      /// position plus one when it holds an element.
+      std::atomic<std::size_t> sequence{0u};
+
+      /// \brief The element.
+      T value{};
+    };
+
+    /// \brief Capacity minus one, used to wrap positions to slots.
+    private: std::size_t mask{0u};
+
+    /// \brief The slots.
+    private: std::unique_ptr<Slot[]> slots;
+
+    /// \brief Position of the next push. Kept on its own cache line so that
+    /// producers and consumers don't contend on it.
+    private: alignas(64) std::atomic<std::size_t> tail{0u};
+
+    /// \brief Position of the next pop.
+    private: alignas(64) std::atomic<std::size_t> head{0u};
+  };
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef SUBT_IGN_POSECACHE_HH_
+#define SUBT_IGN_POSECACHE_HH_
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ignition/common/Time.hh>
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+#include <ignition/msgs.hh>
+
+namespace subt
+{
+  /// \brief Poses of the models the comms plugins care about, shared by
+  /// the comms broker and the visibility model so that the pose messages of
+  /// the world are decoded once.
+  ///
+  /// Only the interned names are tracked, each of them in a slot with an
+  /// integer id. The entities of the pose messages are mapped to slots by
+  /// entity id the first time they are seen, so later messages don't look at
+  /// their names. A few other models can be watched, e.g. to visualize
+  /// them, without being interned. Breadcrumbs are detected from the entity
+  /// creation events of the scene, and from the first pose of each entity
+  /// in case a creation event is missed, instead of scanning the names of
+  /// every pose message.
+  ///
+  /// All the functions are thread safe.
+  class PoseCache
+  {
+    /// \brief Id of names that are not interned.
+    public: static const int kInvalidId = -1;
+
+    /// \brief Maximum number of watched models. Watching more forgets the
+    /// one watched first.
+    public: static const size_t kMaxWatched = 8;
+
+    /// \brief Whether a model is a breadcrumb that has been made static.
+    /// The breadcrumbs system spawns a static copy of a breadcrumb once it
+    /// settles, and only those relay messages.
+    /// \param[in] _name Name of the model.
+    /// \return True if it is a static breadcrumb.
+    public: static bool IsStaticBreadcrumb(const std::string &_name);
+
+    /// \brief Start tracking the pose of a model. Its pose is known from the
+    /// next pose message on.
+    /// \param[in] _name Name of the model.
+    /// \return Id of its slot. Interning a name twice returns the same id.
+    public: int Intern(const std::string &_name);
+
+    /// \brief Id of an interned name.
+    /// \param[in] _name Name of the model.
+    /// \return Id of its slot, or kInvalidId if it isn't interned.
+    public: int Id(const std::string &_name) const;
+
+    /// \brief Last pose of a model.
+    /// \param[in] _id Id of its slot.
+    /// \param[out] _pose The pose.
+    /// \return False if the id is invalid or no pose was received yet.
+    public: bool Pose(int _id, ignition::math::Pose3d &_pose) const;
+
+    /// \brief Last pose of an interned or watched model.
+    /// \param[in] _name Name of the model.
+    /// \param[out] _pose The pose.
+    /// \return False if the model isn't tracked or no pose was received
+    /// yet.
+    public: bool Pose(const std::string &_name,
+                      ignition::math::Pose3d &_pose) const;
+
+    /// \brief Track the pose of a model without interning it. Its pose is
+    /// known from the next pose message on.
+    /// \param[in] _name Name of the model.
+    /// \return False if no entity with that name was seen in the pose
+    /// messages.
+    public: bool Watch(const std::string &_name);
+
+    /// \brief Simulation time of the last pose message.
+    /// \return The time.
+    public: ignition::common::Time SimTime() const;
+
+    /// \brief Update the tracked poses. Call it with the messages of
+    /// /world/<name>/pose/info.
+    /// \param[in] _msg The poses of the world.
+    public: void OnPoses(const ignition::msgs::Pose_V &_msg);
+
+    /// \brief Look for new breadcrumbs. Call it with the messages of
+    /// /world/<name>/scene/info, which carry the entities created.
+    /// \param[in] _msg The created models.
+    public: void OnScene(const ignition::msgs::Scene &_msg);
+
+    /// \brief Positions of the breadcrumbs, if any was created since the
+    /// last call.
+    /// \param[out] _breadcrumbs Positions of all the breadcrumbs.
+    /// \return False if no breadcrumb was created, in which case
+    /// _breadcrumbs is left untouched.
+    public: bool NewBreadcrumbs(
+                std::set<ignition::math::Vector3d> &_breadcrumbs);
+
+    /// \brief A tracked model.
+    private: struct Slot
+    {
+      /// \brief Last pose.
+      ignition::math::Pose3d pose;
+
+      /// \brief Whether a pose was received.
+      bool valid = false;
+    };
+
+    /// \brief Tracked models, indexed by id.
+    private: std::vector<Slot> slots;
+
+    /// \brief Ids of the interned names.
+    private: std::unordered_map<std::string, int> ids;
+
+    /// \brief Add a breadcrumb. Call with the mutex locked.
+    /// \param[in] _name Name of the breadcrumb.
+    /// \param[in] _position Its position.
+    private: void AddBreadcrumb(const std::string &_name,
+                                const ignition::math::Vector3d &_position);
+
+    /// \brief Slot of each entity seen in the pose messages, kInvalidId for
+    /// the entities that aren't interned.
+    private: std::unordered_map<uint32_t, int> entitySlots;
+
+    /// \brief Names of the entities that aren't interned, to find them when
+    /// they are interned or watched.
+    private: std::unordered_map<uint32_t, std::string> entityNames;
+
+    /// \brief Watched models, by name.
+    private: std::map<std::string, Slot> watched;
+
+    /// \brief Names of the watched models, in the order they were watched.
+    private: std::deque<std::string> watchOrder;
+
+    /// \brief Names of the watched models, by entity id.
+    private: std::unordered_map<uint32_t, std::string> watchedEntities;
+
+    /// \brief Positions of the breadcrumbs, by name.
+    private: std::map<std::string, ignition::math::Vector3d> breadcrumbs;
+
+    /// \brief Whether breadcrumbs were created since NewBreadcrumbs().
+    private: bool newBreadcrumbs = false;
+
+    /// \brief Simulation time of the last pose message.
+    private: ignition::common::Time simTime;
+
+    /// \brief Protects all of the above.
+    private: mutable std::mutex mutex;
+  };
+}
+#endif
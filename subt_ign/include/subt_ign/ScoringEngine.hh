@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef SUBT_IGN_SCORINGENGINE_HH_
+#define SUBT_IGN_SCORINGENGINE_HH_
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+#include <ignition/msgs/pose.pb.h>
+#include <ignition/msgs/time.pb.h>
+
+#include <subt_ign/CommonTypes.hh>
+
+namespace subt
+{
+  class ScoringEnginePrivate;
+
+  /// \brief A robot name and the value of a metric for that robot.
+  using RobotMetric = std::pair<std::string, double>;
+
+  /// \brief Statistics of a run. These are the contents of run.yml.
+  struct RunStatistics
+  {
+    /// \brief Sim time at which the statistics were computed.
+    ignition::msgs::Time timestamp;
+
+    /// \brief Name of the world.
+    std::string worldName;
+
+    /// \brief Maximum number of artifact reports.
+    uint32_t reportCountLimit = 0u;
+
+    /// \brief Map of robot name to {platform, config}.
+    std::map<std::string, std::pair<std::string, std::string>> robots;
+
+    /// \brief Map of marsupial parent to child.
+    std::map<std::string, std::string> marsupials;
+
+    /// \brief Number of artifacts found.
+    size_t artifactsFound = 0u;
+
+    /// \brief Number of robots.
+    size_t robotCount = 0u;
+
+    /// \brief Number of unique robot platforms.
+    size_t uniqueRobotCount = 0u;
+
+    /// \brief Sim time elapsed since the start, in seconds.
+    int simTimeElapsed = 0;
+
+    /// \brief Real time elapsed since the start, in seconds.
+    int realTimeElapsed = 0;
+
+    /// \brief Number of unique artifact reports.
+    uint32_t artifactReportCount = 0u;
+
+    /// \brief Number of duplicate artifact reports.
+    uint32_t duplicateReportCount = 0u;
+
+    /// \brief Name of the artifact of the closest successful report.
+    std::string closestReportName;
+
+    /// \brief Type of the artifact of the closest successful report.
+    std::string closestReportType;
+
+    /// \brief True position of the artifact of the closest successful report.
+    ignition::math::Vector3d closestReportTruePos;
+
+    /// \brief Reported position of the closest successful report.
+    ignition::math::Vector3d closestReportReportedPos;
+
+    /// \brief Distance error of the closest successful report, -1 if none.
+    double closestReportDistance = -1;
+
+    /// \brief Sim time of the first successful report, -1 if none.
+    double firstReportTime = -1;
+
+    /// \brief Sim time of the last successful report, -1 if none.
+    double lastReportTime = -1;
+
+    /// \brief Mean sim time between successful reports.
+    double meanTimeBetweenReports = 0;
+
+    /// \brief Robot with the greatest distance traveled.
+    RobotMetric greatestDistanceTraveled = {"", 0};
+
+    /// \brief Robot with the greatest euclidean distance from its start.
+    RobotMetric greatestEuclideanDistanceFromStart = {"", 0};
+
+    /// \brief Distance traveled by all the robots.
+    double totalDistanceTraveled = 0;
+
+    /// \brief Robot with the greatest velocity.
+    RobotMetric greatestMaxVel = {"", 0};
+
+    /// \brief Robot with the greatest average velocity.
+    RobotMetric greatestAvgVel = {"", 0};
+
+    /// \brief Robot with the greatest cumulative elevation gain.
+    RobotMetric greatestElevationGain = {"", 0};
+
+    /// \brief Robot with the greatest cumulative elevation loss.
+    RobotMetric greatestElevationLoss = {"", 0};
+
+    /// \brief Cumulative elevation gain of all the robots.
+    double totalElevationGain = 0;
+
+    /// \brief Cumulative elevation loss of all the robots.
+    double totalElevationLoss = 0;
+
+    /// \brief Robot that reached the highest elevation.
+    RobotMetric maxElevationReached = {"", 0};
+
+    /// \brief Robot that reached the lowest elevation.
+    RobotMetric minElevationReached = {"", 0};
+  };
+
+  /// \brief Kinematic state of a robot, relative to the artifact origin.
+  struct KinematicState
+  {
+    /// \brief Pose of the robot.
+    ignition::math::Pose3d pose;
+
+    /// \brief Velocity of the robot.
+    ignition::math::Vector3d velocity;
+
+    /// \brief Speed of the robot.
+    double speed = 0;
+  };
+
+  /// \brief Poses of all robots, as parallel arrays indexed by the robot
+  /// index returned by ScoringEngine::RobotIndex.
+  struct RobotPoses
+  {
+    /// \brief Resize all the arrays, new robots have no pose.
+    /// \param[in] _size Number of robots.
+    void Resize(std::size_t _size)
+    {
+      for (auto *v : {&this->x, &this->y, &this->z, &this->qw, &this->qx,
+                      &this->qy, &this->qz})
+      {
+        v->resize(_size, 0.0);
+      }
+      this->valid.resize(_size, 0u);
+    }
+
+    /// \brief Set the pose of a robot.
+    /// \param[in] _index Robot index.
+    /// \param[in] _pose World pose of the robot.
+    void Set(std::size_t _index, const ignition::math::Pose3d &_pose)
+    {
+      this->x[_index] = _pose.Pos().X();
+      this->y[_index] = _pose.Pos().Y();
+      this->z[_index] = _pose.Pos().Z();
+      this->qw[_index] = _pose.Rot().W();
+      this->qx[_index] = _pose.Rot().X();
+      this->qy[_index] = _pose.Rot().Y();
+      this->qz[_index] = _pose.Rot().Z();
+      this->valid[_index] = 1u;
+    }
+
+    /// \brief Position of each robot.
+    std::vector<double> x, y, z;
+
+    /// \brief Orientation of each robot.
+    std::vector<double> qw, qx, qy, qz;
+
+    /// \brief Nonzero if the pose of the robot is set.
+    std::vector<uint8_t> valid;
+  };
+
+  /// \brief Outcome of an artifact report.
+  struct ArtifactReportOutcome
+  {
+    /// \brief Status of the report, as sent back to the team.
+    std::string status;
+
+    /// \brief Change in score.
+    double scoreChange = 0;
+
+    /// \brief Number of unique reports after this one.
+    uint32_t reportId = 0u;
+
+    /// \brief True if the report went through scoring and was not a
+    /// duplicate. The fields below describe the report in that case.
+    bool scored = false;
+
+    /// \brief Reported artifact type.
+    std::string reportedType;
+
+    /// \brief Reported position, in the artifact origin frame.
+    ignition::math::Vector3d reportedPos;
+
+    /// \brief Name of the closest artifact of the reported type.
+    std::string closestArtifactName;
+
+    /// \brief Distance to the closest artifact, -1 if there was no artifact
+    /// of the reported type.
+    double distance = 0;
+
+    /// \brief Total score after this report.
+    double totalScore = 0;
+
+    /// \brief True if the run has to finish because of this report. The
+    /// caller is expected to call Finish.
+    bool finish = false;
+  };
+
+  /// \brief Headless implementation of the SubT scoring rules and run
+  /// statistics. It consumes a time-ordered stream of robot poses, artifact
+  /// reports and events, and writes the run files (score.yml, summary.yml,
+  /// run.yml, events.yml and pos-data) to a log directory. It does not depend
+  /// on the simulator or any transport, so the same logic that scores a live
+  /// run can re-score recorded runs.
+  ///
+  /// All the functions are thread safe. The callbacks are invoked with the
+  /// engine lock held and must not call back into the engine.
+  class ScoringEngine
+  {
+    /// \brief Callback for robot events.
+    /// \param[in] _simTime Sim time of the event.
+    /// \param[in] _type Event type.
+    /// \param[in] _robot Robot name.
+    /// \param[in] _eventId Unique id of the event.
+    public: using RobotEventCallback = std::function<void(
+                const ignition::msgs::Time &_simTime,
+                const std::string &_type, const std::string &_robot,
+                int _eventId)>;
+
+    /// \brief Callback for region events.
+    /// \param[in] _simTime Sim time of the event.
+    /// \param[in] _type Event type.
+    /// \param[in] _robot Robot name.
+    /// \param[in] _detector Detector or model name.
+    /// \param[in] _state Event state.
+    /// \param[in] _eventId Unique id of the event.
+    public: using RegionEventCallback = std::function<void(
+                const ignition::msgs::Time &_simTime,
+                const std::string &_type, const std::string &_robot,
+                const std::string &_detector, const std::string &_state,
+                int _eventId)>;
+
+    /// \brief Callback for new kinematic state samples.
+    /// \param[in] _simTime Sim time of the sample.
+    /// \param[in] _robot Robot name.
+    /// \param[in] _state Kinematic state.
+    public: using KinematicStateCallback = std::function<void(
+                const ignition::msgs::Time &_simTime,
+                const std::string &_robot, const KinematicState &_state)>;
+
+    /// \brief Callback for new run statistics.
+    /// \param[in] _stats The statistics.
+    public: using StatisticsCallback =
+                std::function<void(const RunStatistics &_stats)>;
+
+    /// \brief Constructor.
+    public: ScoringEngine();
+
+    /// \brief Destructor.
+    public: ~ScoringEngine();
+
+    /// \brief Open the log files.
+    /// \param[in] _logPath Directory where the run files are written.
+    /// \param[in] _filenamePrefix Prefix of the text log file name.
+    /// \param[in] _worldName Name of the world. The report limit is lowered
+    /// for final worlds.
+    public: void Load(const std::string &_logPath,
+                      const std::string &_filenamePrefix,
+                      const std::string &_worldName);
+
+    /// \brief Set the elevation step size. Elevation data is rounded down to
+    /// the nearest multiple of this value.
+    /// \param[in] _size Step size in meters.
+    public: void SetElevationStepSize(double _size);
+
+    /// \brief Override the maximum number of artifact reports.
+    /// \param[in] _limit The limit.
+    public: void SetReportCountLimit(uint32_t _limit);
+
+    /// \brief Set the robot event callback.
+    /// \param[in] _cb The callback.
+    public: void SetRobotEventCallback(const RobotEventCallback &_cb);
+
+    /// \brief Set the region event callback.
+    /// \param[in] _cb The callback.
+    public: void SetRegionEventCallback(const RegionEventCallback &_cb);
+
+    /// \brief Set the kinematic state callback.
+    /// \param[in] _cb The callback.
+    public: void SetKinematicStateCallback(const KinematicStateCallback &_cb);
+
+    /// \brief Set the statistics callback, called every time a new
+    /// snapshot of the run statistics is taken.
+    /// \param[in] _cb The callback.
+    public: void SetStatisticsCallback(const StatisticsCallback &_cb);
+
+    /// \brief Write a simulation timestamp to the text log.
+    /// \param[in] _simTime Current sim time.
+    /// \return A file stream that can be used to write additional
+    /// information to the log.
+    public: std::ofstream &Log(const ignition::msgs::Time &_simTime);
+
+    /// \brief Write an event to events.yml under a new unique id.
+    /// \param[in] _body The event fields, one "  key: value" line each.
+    /// \return The id assigned to the event.
+    public: int LogEvent(const std::string &_body);
+
+    /// \brief Set the pose of the artifact origin.
+    /// \param[in] _pose Pose in world coordinates.
+    public: void SetArtifactOrigin(const ignition::math::Pose3d &_pose);
+
+    /// \brief Get the pose of the artifact origin.
+    /// \return Pose in world coordinates.
+    public: ignition::math::Pose3d ArtifactOrigin() const;
+
+    /// \brief Set the pose of an artifact, registering it if it is new.
+    /// \param[in] _type Artifact type.
+    /// \param[in] _name Artifact model name.
+    /// \param[in] _pose World pose of the artifact model.
+    /// \return True if the artifact was not registered before.
+    public: bool SetArtifact(const ArtifactType &_type,
+                             const std::string &_name,
+                             const ignition::math::Pose3d &_pose);
+
+    /// \brief Register a robot.
+    /// \param[in] _name Robot name.
+    /// \return True if the robot was not registered before.
+    public: bool AddRobot(const std::string &_name);
+
+    /// \brief Set the platform and configuration of a robot.
+    /// \param[in] _name Robot name.
+    /// \param[in] _platform Platform, e.g. X1.
+    /// \param[in] _config Configuration, e.g. X1_SENSOR_CONFIG_1.
+    public: void SetRobotType(const std::string &_name,
+                              const std::string &_platform,
+                              const std::string &_config);
+
+    /// \brief Get the platform of a robot.
+    /// \param[in] _name Robot name.
+    /// \return The platform, empty if unknown.
+    public: std::string RobotPlatform(const std::string &_name) const;
+
+    /// \brief Get the platform and configuration of all the robots.
+    /// \return Map of robot name to {platform, config}.
+    public: std::map<std::string, std::pair<std::string, std::string>>
+            RobotFullTypes() const;
+
+    /// \brief Set a marsupial pair.
+    /// \param[in] _parent Parent robot name.
+    /// \param[in] _child Child robot name.
+    public: void SetMarsupialPair(const std::string &_parent,
+                                  const std::string &_child);
+
+    /// \brief Get the marsupial pairs.
+    /// \return Map of parent to child robot name.
+    public: std::map<std::string, std::string> MarsupialPairs() const;
+
+    /// \brief Start the run.
+    /// \param[in] _simTime Sim time.
+    /// \return True if the run was started by this call.
+    public: bool Start(const ignition::msgs::Time &_simTime);
+
+    /// \brief Finish the run. All the run files are written when this
+    /// function returns.
+    /// \param[in] _simTime Sim time.
+    /// \return True if the run was finished by this call.
+    public: bool Finish(const ignition::msgs::Time &_simTime);
+
+    /// \brief Log the recording_complete event. Call it after Finish, once
+    /// all the recorders have been stopped.
+    /// \param[in] _simTime Sim time.
+    public: void LogRecordingComplete(const ignition::msgs::Time &_simTime);
+
+    /// \brief Whether the run has started.
+    /// \return True if started.
+    public: bool Started() const;
+
+    /// \brief Whether the run has finished.
+    /// \return True if finished.
+    public: bool Finished() const;
+
+    /// \brief Get the sim time at which the run started.
+    /// \return The start sim time.
+    public: ignition::msgs::Time StartSimTime() const;
+
+    /// \brief Get the total score.
+    /// \return The score.
+    public: double TotalScore() const;
+
+    /// \brief Get the number of unique artifact reports.
+    /// \return The number of reports.
+    public: uint32_t ReportCount() const;
+
+    /// \brief Get the maximum number of unique artifact reports.
+    /// \return The limit.
+    public: uint32_t ReportCountLimit() const;
+
+    /// \brief Process an artifact report.
+    /// \param[in] _simTime Sim time of the report.
+    /// \param[in] _type Reported type, see ArtifactType.
+    /// \param[in] _pose Reported pose, in the artifact origin frame.
+    /// \return The outcome of the report.
+    public: ArtifactReportOutcome ReportArtifact(
+                const ignition::msgs::Time &_simTime, uint32_t _type,
+                const ignition::msgs::Pose &_pose);
+
+    /// \brief Update the pose of a robot, accumulating distance, velocity
+    /// and elevation statistics.
+    /// \param[in] _simTime Sim time of the pose.
+    /// \param[in] _name Robot name.
+    /// \param[in] _pose World pose of the robot.
+    /// \return True if this is the first pose received for the robot.
+    public: bool UpdateRobotPose(const ignition::msgs::Time &_simTime,
+                                 const std::string &_name,
+                                 const ignition::math::Pose3d &_pose);
+
+    /// \brief Get the index of a robot in RobotPoses, adding the robot to
+    /// the statistics if it is new. Indices are assigned consecutively.
+    /// \param[in] _name Robot name.
+    /// \return Index of the robot.
+    public: std::size_t RobotIndex(const std::string &_name);
+
+    /// \brief Update the poses of all robots at once. Robots whose pose is
+    /// not valid are skipped. Equivalent to calling UpdateRobotPose for each
+    /// robot, but robots that neither moved 1 m nor waited 1 s since their
+    /// last sample are filtered out in a single pass.
+    /// \param[in] _simTime Sim time of the poses.
+    /// \param[in] _poses World poses of the robots.
+    public: void UpdateRobotPoses(const ignition::msgs::Time &_simTime,
+                                  const RobotPoses &_poses);
+
+    /// \brief Check whether robots have flipped, using the last poses
+    /// received.
+    /// \param[in] _simTime Current sim time.
+    public: void CheckRobotFlip(const ignition::msgs::Time &_simTime);
+
+    /// \brief Log a robot event, e.g. a collision or a detach.
+    /// \param[in] _simTime Sim time of the event.
+    /// \param[in] _type Event type.
+    /// \param[in] _robot Robot name.
+    public: void RobotEvent(const ignition::msgs::Time &_simTime,
+                            const std::string &_type,
+                            const std::string &_robot);
+
+    /// \brief Process a battery state.
+    /// \param[in] _simTime Sim time of the state.
+    /// \param[in] _robot Robot name.
+    /// \param[in] _percentage Remaining charge.
+    public: void BatteryState(const ignition::msgs::Time &_simTime,
+                              const std::string &_robot, double _percentage);
+
+    /// \brief Process a breadcrumb deployment.
+    /// \param[in] _simTime Sim time of the deployment.
+    /// \param[in] _robot Robot name.
+    public: void BreadcrumbDeploy(const ignition::msgs::Time &_simTime,
+                                  const std::string &_robot);
+
+    /// \brief Process a remaining breadcrumbs update.
+    /// \param[in] _simTime Sim time of the update.
+    /// \param[in] _robot Robot name.
+    /// \param[in] _remaining Remaining breadcrumbs.
+    public: void BreadcrumbDeployRemaining(
+                const ignition::msgs::Time &_simTime,
+                const std::string &_robot, int _remaining);
+
+    /// \brief Process a dynamic collapse deployment.
+    /// \param[in] _simTime Sim time of the deployment.
+    /// \param[in] _model Dynamic collapse model name.
+    public: void DynamicCollapse(const ignition::msgs::Time &_simTime,
+                                 const std::string &_model);
+
+    /// \brief Process a rock fall remaining deployments update.
+    /// \param[in] _simTime Sim time of the update.
+    /// \param[in] _model Rock fall model name.
+    /// \param[in] _remaining Remaining rock falls.
+    public: void RockFallRemaining(const ignition::msgs::Time &_simTime,
+                                   const std::string &_model,
+                                   int _remaining);
+
+    /// \brief Process a performer detector event.
+    /// \param[in] _simTime Current sim time.
+    /// \param[in] _stampSec Sim time of the detection, in seconds.
+    /// \param[in] _detector Detector name.
+    /// \param[in] _robot Robot name.
+    /// \param[in] _state "enter", "exit" or "nil".
+    /// \param[in] _extraData Extra key-value pairs of the detector.
+    public: void DetectorEvent(const ignition::msgs::Time &_simTime,
+                int64_t _stampSec, const std::string &_detector,
+                const std::string &_robot, const std::string &_state,
+                const std::map<std::string, std::string> &_extraData);
+
+    /// \brief Write score.yml, summary.yml and the pos-data files. If the
+    /// run statistics changed since the last call, a new snapshot is taken
+    /// and run.yml is written in the background. The elapsed times alone do
+    /// not count as a change.
+    /// \param[in] _simTime Current sim time.
+    /// \return The time point used to calculate the elapsed real time.
+    public: std::chrono::steady_clock::time_point UpdateScoreFiles(
+                const ignition::msgs::Time &_simTime);
+
+    /// \brief Get the time at which the score files were last written.
+    /// \return The time point.
+    public: std::chrono::steady_clock::time_point LastUpdateScoresTime() const;
+
+    /// \brief Private data pointer.
+    private: std::unique_ptr<ScoringEnginePrivate> dataPtr;
+  };
+}
+#endif
@@ -19,14 +19,27 @@
 
 #include <subt_rf_interface/subt_rf_interface.h>
 #include <subt_rf_interface/subt_rf_model.h>
+#include <subt_communication_model/subt_communication_model.h>
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <ignition/msgs.hh>
 #include <ignition/transport/Node.hh>
 
+#include <subt_ign/PoseCache.hh>
 #include <subt_ign/VisibilityTable.hh>
 namespace subt
 {
@@ -45,6 +58,11 @@ namespace subt
         /// \brief  Maximum comms cost to consider (saturate here)
         public: double commsCostMax = 15.0;
 
+        /// \brief Size of the cells the coverage visualization is sampled
+        /// on (m). The visibility table is sampled every meter, bigger cells
+        /// make the coverage faster to compute and lighter to draw.
+        public: double coverageResolution = 1.0;
+
         /// Output stream operator.
         ///
         /// @param oss Stream
@@ -56,12 +74,25 @@ namespace subt
                << "-- visibilityCostToFadingExponent: "
                << _config.visibilityCostToFadingExponent << std::endl
                << "-- commsCostMax: "
-               << _config.commsCostMax << std::endl;
+               << _config.commsCostMax << std::endl
+               << "-- coverageResolution: "
+               << _config.coverageResolution << std::endl;
 
           return _oss;
         }
       };
 
+      /// \brief Number of levels of packet drop probability the coverage is
+      /// split into, from 0 (no drops) to kCoverageLevels - 1 (all packets
+      /// dropped).
+      const int kCoverageLevels = 6;
+
+      /// \brief Coverage of the radio of a robot: the sampled points of the
+      /// world, grouped by the probability that a packet sent from the robot
+      /// is dropped there.
+      using Coverage =
+        std::array<std::vector<ignition::math::Vector3d>, kCoverageLevels>;
+
       /// \class VisibilityModel
       /// \brief Maintain state of the visibility model.
       ///
@@ -77,6 +108,21 @@ namespace subt
                     range_model::rf_configuration _rangeConfig,
                     const std::string &_worldName);
 
+        /// \brief Destructor. Waits for the coverage being computed.
+        public: ~VisibilityModel();
+
+        /// \brief Set the radio used to compute the coverage, which should
+        /// be the one of the comms broker.
+        /// \param[in] _radio The radio configuration.
+        public: void SetRadioConfiguration(
+                    const communication_model::radio_configuration &_radio);
+
+        /// \brief Set where the poses of the robots are read from, which
+        /// should be the cache of the comms broker. Until then, no coverage
+        /// can be visualized.
+        /// \param[in] _poseCache The pose cache.
+        public: void SetPoseCache(std::shared_ptr<PoseCache> _poseCache);
+
         /// Compute received power function that will be given to
         /// communcation model.
         ///
@@ -113,12 +159,34 @@ namespace subt
         public: void PopulateVisibilityInfo(
                          const std::set<ignition::math::Vector3d> &_relayPoses);
 
-        /// Function to visualize visibility cost in Gazebo.
+        /// \brief Compute the coverage of a radio, in parallel over blocks
+        /// of sampled points. Coverages are cached per tile of the source
+        /// until the breadcrumbs or the radio change, so sources in the same
+        /// tile share the coverage of the first one.
+        /// \param[in] _from Position of the radio.
+        /// \return The coverage, or null if the breadcrumbs changed while
+        /// computing it.
+        public: std::shared_ptr<const Coverage> ComputeCoverage(
+                    const ignition::math::Vector3d &_from);
+
+        /// Function to visualize visibility cost in Gazebo. The coverage is
+        /// computed and drawn in the background, so the service returns
+        /// right away.
         private: bool VisualizeVisibility(const ignition::msgs::StringMsg &_req,
                                           ignition::msgs::Boolean &_rep);
-        /// \brief Handle gazebo pose messages
-        /// \param[in] _msg New set of poses.
-        private: void OnPose(const ignition::msgs::Pose_V &_msg);
+
+        /// \brief Body of the thread computing and drawing the coverages
+        /// requested by VisualizeVisibility().
+        private: void CoverageLoop();
+
+        /// \brief Draw a coverage as point markers, split into chunks so that
+        /// no single message gets too big.
+        /// \param[in] _coverage The coverage.
+        private: void DrawCoverage(const Coverage &_coverage);
+
+        /// \brief Sample one point of the visibility table per cell of
+        /// RfConfiguration::coverageResolution.
+        private: void SampleCoverage();
 
         /// \brief Transport node
         private: ignition::transport::Node n2;
@@ -127,8 +195,47 @@ namespace subt
         private: subt::VisibilityTable visibilityTable;
         private: visibilityModel::RfConfiguration visibilityConfig;
         private: range_model::rf_configuration defaultRangeConfig;
-        private: std::map<std::string, ignition::math::Pose3d> poses;
+
+        /// \brief Poses of the robots whose coverage can be visualized.
+        private: std::shared_ptr<PoseCache> poseCache;
+
         private: bool initialized = false;
+
+        /// \brief Radio used to compute the coverage.
+        private: communication_model::radio_configuration radio;
+
+        /// \brief Points of the visibility table the coverage is computed on.
+        private: std::vector<ignition::math::Vector3d> coverageSamples;
+
+        /// \brief Cached coverages, by tile of the source. The most recently
+        /// used come first.
+        private: std::list<std::pair<uint64_t,
+          std::shared_ptr<const Coverage>>> coverageCache;
+
+        /// \brief Protects poseCache, radio, coverageSamples and
+        /// coverageCache.
+        private: std::mutex coverageMutex;
+
+        /// \brief Held exclusively while the breadcrumbs change the
+        /// visibility table, and shared while computing a coverage.
+        private: std::shared_mutex tableMutex;
+
+        /// \brief Set while the breadcrumbs change, or when destroying the
+        /// model, so that the coverage being computed is given up.
+        private: std::atomic<bool> abortCoverage{false};
+
+        /// \brief Name of the last model whose coverage was requested and
+        /// not drawn yet.
+        private: std::optional<std::string> coverageRequest;
+
+        /// \brief Wakes up the coverage thread.
+        private: std::condition_variable coverageCv;
+
+        /// \brief Computes and draws the requested coverages.
+        private: std::thread coverageThread;
+
+        /// \brief Whether the coverage thread should exit.
+        private: bool stopCoverage = false;
       };
     }
   }
@@ -21,6 +21,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <ignition/math/AxisAlignedBox.hh>
@@ -73,9 +74,35 @@ namespace subt
     /// \brief Get the visibility cost.
     /// \param[in] _from A 3D position.
     /// \param[in] _to A 3D position.
-    /// \return The visibility cost from one point to the other.
-    public: VisibilityCost Cost(const ignition::math::Vector3d &_from,
-                                const ignition::math::Vector3d &_to) const;
+    /// \return The visibility cost from one point to the other. The reference
+    /// is valid until the next call to PopulateVisibilityInfo().
+    public: const VisibilityCost &Cost(const ignition::math::Vector3d &_from,
+                                       const ignition::math::Vector3d &_to)
+                                       const;
+
+    /// \brief Get the visibility cost between two tiles.
+    /// \param[in] _from Source tile.
+    /// \param[in] _to Destination tile.
+    /// \return The visibility cost from one tile to the other. The reference
+    /// is valid until the next call to PopulateVisibilityInfo().
+    /// \sa Tile
+    public: const VisibilityCost &Cost(uint64_t _from, uint64_t _to) const;
+
+    /// \brief Get the tile containing a position, according to the sampled
+    /// points.
+    /// \param[in] _position A 3D position.
+    /// \return The vertex Id of the tile, or the maximum uint64_t value if
+    /// the position wasn't sampled.
+    public: uint64_t Tile(const ignition::math::Vector3d &_position) const;
+
+    /// \brief Get the breadcrumb used for the last hop to a destination in a
+    /// tile. It's the first breadcrumb dropped in the tile.
+    /// \param[in] _tile The tile.
+    /// \return The position of the breadcrumb, or null if there are no
+    /// breadcrumbs in the tile. The pointer is valid until the next call to
+    /// PopulateVisibilityInfo().
+    public: const ignition::math::Vector3d *LastMileBreadcrumb(
+                uint64_t _tile) const;
 
     /// \brief Generate a binary .dat file containing a list of sample points
     /// that are within the explorable areas of the world. Each sample point
@@ -240,6 +267,11 @@ namespace subt
     /// tile.
     private: std::map<uint64_t, std::vector<ignition::math::Vector3d>>
       breadcrumbs;
+
+    /// \brief The position of the first breadcrumb of each tile, used for the
+    /// last hop to a destination in the tile.
+    private: std::unordered_map<uint64_t, ignition::math::Vector3d>
+      lastMileBreadcrumbs;
   };
 }
 
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <ignition/math/Matrix3.hh>
+#include <subt_ign/ArtifactScorer.hh>
+
+namespace subt
+{
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d ArtifactOffset(const ArtifactType &_type)
+{
+  // The gas artifact has a location point of zero because it is placed at
+  // the center point of the entry door threshold at floor level.
+  static const std::map<ArtifactType, ignition::math::Vector3d> kOffsets =
+  {
+    {ArtifactType::TYPE_BACKPACK,
+      ignition::math::Vector3d(0, -0.12766, 0.25668)},
+    {ArtifactType::TYPE_DRILL,
+      ignition::math::Vector3d(0, 0.059073, 0.158863)},
+    {ArtifactType::TYPE_EXTINGUISHER,
+      ignition::math::Vector3d(-0.03557, -0.03509, 0.3479)},
+    {ArtifactType::TYPE_GAS,
+      ignition::math::Vector3d(0, 0, 0)},
+    {ArtifactType::TYPE_HELMET,
+      ignition::math::Vector3d(0, 0, 0.165)},
+    {ArtifactType::TYPE_PHONE,
+      ignition::math::Vector3d(0, -0.004, 0.08)},
+    {ArtifactType::TYPE_RESCUE_RANDY,
+      ignition::math::Vector3d(-0.071305, 0.021966, 0.39217)},
+    {ArtifactType::TYPE_ROPE,
+      ignition::math::Vector3d(0.004, -0.03, 0.095)},
+    {ArtifactType::TYPE_VENT,
+      ignition::math::Vector3d(0, 0, 0.138369)},
+    {ArtifactType::TYPE_CUBE,
+      ignition::math::Vector3d(0, 0, 0.2)}
+  };
+
+  auto iter = kOffsets.find(_type);
+  if (iter == kOffsets.end())
+    return ignition::math::Vector3d::Zero;
+  return iter->second;
+}
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d ArtifactLocalizationPoint(
+    const ArtifactType &_type, const ignition::math::Pose3d &_pose)
+{
+  // Get a rotation matrix for the artifact
+  ignition::math::Matrix3d mat(_pose.Rot());
+  return _pose.Pos() + mat * ArtifactOffset(_type);
+}
+
+/////////////////////////////////////////////////
+void ArtifactIndex::Build(
+    const std::map<std::string, ignition::math::Vector3d> &_points)
+{
+  this->nodes.clear();
+  this->names.clear();
+  this->nodes.reserve(_points.size());
+  this->names.reserve(_points.size());
+
+  for (const auto &point : _points)
+  {
+    // make sure the artifact has been loaded
+    const ignition::math::Vector3d &pos = point.second;
+    if (std::isinf(pos.X()) || std::isinf(pos.Y()) || std::isinf(pos.Z()))
+      continue;
+
+    this->nodes.push_back({pos, this->names.size()});
+    this->names.push_back(point.first);
+  }
+
+  // Arrange the nodes so that the median of every range along the axis of
+  // its depth sits in the middle of the range.
+  std::function<void(size_t, size_t, size_t)> build =
+    [&](size_t _lo, size_t _hi, size_t _depth)
+    {
+      if (_hi - _lo < 2)
+        return;
+      size_t mid = _lo + (_hi - _lo) / 2;
+      size_t axis = _depth % 3;
+      std::nth_element(this->nodes.begin() + _lo, this->nodes.begin() + mid,
+          this->nodes.begin() + _hi,
+          [axis](const Node &_a, const Node &_b)
+          {
+            return _a.pos[axis] < _b.pos[axis];
+          });
+      build(_lo, mid, _depth + 1);
+      build(mid + 1, _hi, _depth + 1);
+    };
+  build(0, this->nodes.size(), 0);
+}
+
+/////////////////////////////////////////////////
+bool ArtifactIndex::Closest(const ignition::math::Vector3d &_pos,
+    ArtifactMatch &_match) const
+{
+  if (this->nodes.empty())
+    return false;
+
+  size_t best = this->nodes.size();
+  double bestDist = std::numeric_limits<double>::infinity();
+  this->Search(0, this->nodes.size(), 0, _pos, best, bestDist);
+
+  if (best >= this->nodes.size())
+    return false;
+
+  _match.name = this->names[this->nodes[best].rank];
+  _match.pos = this->nodes[best].pos;
+  _match.distance = bestDist;
+  return true;
+}
+
+/////////////////////////////////////////////////
+size_t ArtifactIndex::Size() const
+{
+  return this->nodes.size();
+}
+
+/////////////////////////////////////////////////
+void ArtifactIndex::Search(size_t _lo, size_t _hi, size_t _depth,
+    const ignition::math::Vector3d &_pos, size_t &_best,
+    double &_bestDist) const
+{
+  if (_lo >= _hi)
+    return;
+
+  size_t mid = _lo + (_hi - _lo) / 2;
+  const Node &node = this->nodes[mid];
+
+  double distance = _pos.Distance(node.pos);
+  if (distance < _bestDist ||
+      (distance == _bestDist && _best < this->nodes.size() &&
+       node.rank < this->nodes[_best].rank))
+  {
+    _best = mid;
+    _bestDist = distance;
+  }
+
+  size_t axis = _depth % 3;
+  double diff = _pos[axis] - node.pos[axis];
+  size_t nearLo = diff < 0 ? _lo : mid + 1;
+  size_t nearHi = diff < 0 ? mid : _hi;
+  size_t farLo = diff < 0 ? mid + 1 : _lo;
+  size_t farHi = diff < 0 ? _hi : mid;
+
+  this->Search(nearLo, nearHi, _depth + 1, _pos, _best, _bestDist);
+
+  // Points on the far side of the split plane can only win if the plane is
+  // not farther than the best match. Equality is kept to honor tie-breaking.
+  if (std::abs(diff) <= _bestDist)
+    this->Search(farLo, farHi, _depth + 1, _pos, _best, _bestDist);
+}
+
+/////////////////////////////////////////////////
+ReportKey::ReportKey(const ArtifactType &_type,
+    const ignition::math::Vector3d &_pos)
+  : type(_type),
+    x(std::llround(_pos.X() * 1e6)),
+    y(std::llround(_pos.Y() * 1e6)),
+    z(std::llround(_pos.Z() * 1e6))
+{
+}
+
+/////////////////////////////////////////////////
+bool ReportKey::operator==(const ReportKey &_other) const
+{
+  return this->type == _other.type && this->x == _other.x &&
+    this->y == _other.y && this->z == _other.z;
+}
+
+/////////////////////////////////////////////////
+size_t ReportKeyHash::operator()(const ReportKey &_key) const
+{
+  // Combine the members using the boost::hash_combine mixing step.
+  size_t seed = std::hash<uint32_t>()(static_cast<uint32_t>(_key.type));
+  for (int64_t v : {_key.x, _key.y, _key.z})
+  {
+    seed ^= std::hash<int64_t>()(v) + 0x9e3779b97f4a7c15ULL +
+      (seed << 6) + (seed >> 2);
+  }
+  return seed;
+}
+
+/////////////////////////////////////////////////
+bool ArtifactScorer::SetArtifact(const ArtifactType &_type,
+    const std::string &_name, const ignition::math::Vector3d &_point)
+{
+  TypeData &data = this->types[_type];
+  auto iter = data.points.find(_name);
+  if (iter == data.points.end())
+  {
+    data.points.emplace(_name, _point);
+    data.dirty = true;
+    this->count++;
+    return true;
+  }
+
+  // Compare exactly, Vector3d::operator== has a tolerance.
+  if (iter->second.X() != _point.X() || iter->second.Y() != _point.Y() ||
+      iter->second.Z() != _point.Z())
+  {
+    iter->second = _point;
+    data.dirty = true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+bool ArtifactScorer::HasArtifact(const ArtifactType &_type,
+    const std::string &_name) const
+{
+  auto iter = this->types.find(_type);
+  return iter != this->types.end() &&
+    iter->second.points.find(_name) != iter->second.points.end();
+}
+
+/////////////////////////////////////////////////
+size_t ArtifactScorer::ArtifactCount() const
+{
+  return this->count;
+}
+
+/////////////////////////////////////////////////
+ArtifactReportResult ArtifactScorer::Score(const ArtifactType &_type,
+    const ignition::math::Vector3d &_reportedPos,
+    const ignition::math::Vector3d &_worldPos)
+{
+  ArtifactReportResult result;
+
+  ReportKey key(_type, _reportedPos);
+  if (this->FindReport(key, result.score))
+  {
+    result.duplicate = true;
+    return result;
+  }
+
+  result.match = this->Closest(_type, _worldPos);
+
+  // Calculate the score based on accuracy in the location. Make sure that
+  // the artifact was not already reported.
+  if (result.match.distance < kScoringDistance &&
+      this->found.insert(result.match.name).second)
+  {
+    result.score = 1.0;
+  }
+
+  // This is a new unique report, let's save it.
+  this->AddReport(key, result.score);
+  return result;
+}
+
+/////////////////////////////////////////////////
+size_t ArtifactScorer::FoundCount() const
+{
+  return this->found.size();
+}
+
+/////////////////////////////////////////////////
+ArtifactMatch ArtifactScorer::Closest(const ArtifactType &_type,
+    const ignition::math::Vector3d &_pos)
+{
+  ArtifactMatch match;
+  auto iter = this->types.find(_type);
+  if (iter == this->types.end())
+    return match;
+
+  TypeData &data = iter->second;
+  if (data.dirty)
+  {
+    data.index.Build(data.points);
+    data.dirty = false;
+  }
+
+  data.index.Closest(_pos, match);
+  return match;
+}
+
+/////////////////////////////////////////////////
+bool ArtifactScorer::FindReport(const ReportKey &_key, double &_score) const
+{
+  auto iter = this->uniqueReports.find(_key);
+  if (iter == this->uniqueReports.end())
+    return false;
+
+  _score = iter->second;
+  return true;
+}
+
+/////////////////////////////////////////////////
+void ArtifactScorer::AddReport(const ReportKey &_key, double _score)
+{
+  this->uniqueReports[_key] = _score;
+}
+}
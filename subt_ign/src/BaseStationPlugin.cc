@@ -15,7 +15,18 @@
  *
 */
 
+#include <tinyxml2.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <ignition/common/Console.hh>
+#include <ignition/msgs/param.pb.h>
 
 #include "subt_ign/BaseStationPlugin.hh"
 #include "subt_ign/CommonTypes.hh"
@@ -33,18 +44,35 @@ BaseStationPlugin::BaseStationPlugin()
 //////////////////////////////////////////////////
 BaseStationPlugin::~BaseStationPlugin()
 {
-  {
-    std::lock_guard<std::mutex> lk(this->mutex);
-    this->running = false;
-  }
-  this->cv.notify_all();
-  this->ackThread.join();
+  if (this->queue)
+    this->queue->Stop();
+  if (this->ackThread.joinable())
+    this->ackThread.join();
 }
 
 
 //////////////////////////////////////////////////
-bool BaseStationPlugin::Load(const tinyxml2::XMLElement *)
+bool BaseStationPlugin::Load(const tinyxml2::XMLElement *_elem)
 {
+  int maxRequestsInFlight = 8;
+  std::chrono::milliseconds requestTimeout(1000);
+  if (_elem)
+  {
+    const tinyxml2::XMLElement *elem =
+      _elem->FirstChildElement("max_requests_in_flight");
+    if (elem)
+      maxRequestsInFlight = std::max(1, std::stoi(elem->GetText()));
+
+    elem = _elem->FirstChildElement("request_timeout");
+    if (elem)
+      requestTimeout = std::chrono::milliseconds(std::stoi(elem->GetText()));
+  }
+  this->queue = std::make_unique<AckQueue>(maxRequestsInFlight,
+      requestTimeout);
+
+  this->metricsPub = this->node.Advertise<ignition::msgs::Param>(
+      "/subt/base_station/ack_metrics");
+
   this->client.reset(new subt::CommsClient("base_station", true, true));
   this->client->Bind(&BaseStationPlugin::OnArtifact, this);
 
@@ -59,28 +87,30 @@ void BaseStationPlugin::OnArtifact(const std::string &_srcAddress,
   const std::string &/*_dstAddress*/, const uint32_t /*_dstPort*/,
   const std::string &_data)
 {
-  subt::msgs::Artifact artifact;
-  if (!artifact.ParseFromString(_data))
+  AckQueue::Report report;
+  report.received = AckQueue::Clock::now();
+  if (!report.artifact.ParseFromString(_data))
   {
     ignerr << "Error parsing artifact with data[" << _data << "]" << std::endl;
     return;
   }
+  report.address = _srcAddress;
 
-  unsigned int timeout = 1000;
-  bool result;
-
-  subt::msgs::ArtifactScore newScore;
-
-  // Report this artifact to the scoring plugin.
-  this->node.Request(kNewArtifactSrv, artifact, timeout, newScore, result);
+  // The report is scored by the ack thread, so that this callback does not
+  // block the delivery of other messages.
+  this->queue->AddReport(std::move(report));
+}
 
-  // If successfully reported, forward to requester.
-  if (result)
+//////////////////////////////////////////////////
+void BaseStationPlugin::OnScore(uint64_t _id,
+    const subt::msgs::ArtifactScore &_score, const bool _result)
+{
+  if (!this->queue->OnScore(_id, _score, _result))
   {
-    std::scoped_lock<std::mutex> lk(this->mutex);
-    this->scores[_srcAddress].push_back(newScore);
+    // The request timed out.
+    ignwarn << "Ignoring late artifact score" << std::endl;
   }
-  else
+  else if (!_result)
   {
     ignerr << "Error scoring artifact" << std::endl;
   }
@@ -89,50 +119,85 @@ void BaseStationPlugin::OnArtifact(const std::string &_srcAddress,
 //////////////////////////////////////////////////
 void BaseStationPlugin::RunLoop()
 {
-  std::map<std::string, std::vector<subt::msgs::ArtifactScore>> scoresCopy;
-  while (this->running)
+  AckQueue::Batch batch;
+  std::vector<std::pair<std::string, double>> latencies;
+  std::map<std::string, AckMetrics> metrics;
+
+  // The queue's mutex is only held inside its functions. Holding it when
+  // calling this->client->SendTo() could end in a deadlock.
+  //
+  // Process 1:
+  //     1.  BaseStationPlugin::RunLoop() locks the queue's mutex.
+  //     2.  Call this->client->SendTo(data, scorePair.first) which goes
+  //         to Broker::OnMessage(const subt::msgs::Datagram &_req))
+  //     4.  Attmepts to lock Broker's mutex but the mutex is held by
+  //         Process 2.
+  //
+  // Process 2:
+  //     1.  Broker::DispatchMessages(): Locks the Broker's mutex. Which
+  //         blocks Process 1.
+  //     2.  An artifact report goes to BaseStationPlugin::OnArtifact.
+  //     3.  Attemps to lock the queue's mutex. However, this mutex is
+  //         lock by Process 1.
+  //
+  // The score requests are sent without the lock too, because the reply
+  // callback runs in this thread if the scoring service is local.
+  while (this->queue->Next(batch))
   {
-    // Copy the scores so that we don't lock the mutex when calling
-    // this->client->SendTo(data, scorePair.first) because we could end in a
-    // deadlock.
-    //
-    // Process 1:
-    //     1.  BaseStationPlugin::RunLoop() locks this->mutex.
-    //     2.  Call this->client->SendTo(data, scorePair.first) which goes
-    //         to Broker::OnMessage(const subt::msgs::Datagram &_req))
-    //     4.  Attmepts to lock Broker's mutex but the mutex is held by
-    //         Process 2.
-    //
-    // Process 2:
-    //     1.  Broker::DispatchMessages(): Locks the Broker's mutex. Which
-    //         blocks Process 1.
-    //     2.  An artifact report goes to BaseStationPlugin::OnArtifact.
-    //     3.  Attemps to lock BaseStationPlugin's mutex. However, this
-    //         mutex is lock by Process 1.
+    if (batch.timedOut > 0)
     {
-      std::scoped_lock<std::mutex> lk(this->mutex);
-      scoresCopy = this->scores;
+      ignerr << "Error scoring " << batch.timedOut
+             << " artifact(s), request timed out" << std::endl;
     }
 
-    // Send the scores, and clear the score list.
-    for (const std::pair<std::string, std::vector<subt::msgs::ArtifactScore>>
-        &scorePair : scoresCopy)
+    // Report the artifacts to the scoring plugin.
+    for (auto &[id, report] : batch.reports)
     {
-      for (const subt::msgs::ArtifactScore &score : scorePair.second)
-      {
-        std::string data;
-        score.SerializeToString(&data);
-        this->client->SendTo(data, scorePair.first);
-      }
+      std::function<void(const subt::msgs::ArtifactScore &, const bool)> cb =
+        [this, id = id](const subt::msgs::ArtifactScore &_score,
+                        const bool _result)
+        {
+          this->OnScore(id, _score, _result);
+        };
+      if (!this->node.Request(kNewArtifactSrv, report.artifact, cb))
+        this->OnScore(id, subt::msgs::ArtifactScore(), false);
     }
 
+    // Send the scores.
+    latencies.clear();
+    for (const auto &ack : batch.acks)
     {
-      std::scoped_lock<std::mutex> lk(this->mutex);
-      this->scores.clear();
-      scoresCopy.clear();
+      std::string data;
+      ack.score.SerializeToString(&data);
+      this->client->SendTo(data, ack.address);
+      latencies.emplace_back(ack.address, std::chrono::duration<double>(
+            AckQueue::Clock::now() - ack.received).count());
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    this->queue->AcksSent(latencies);
+
+    // Publish the statistics whenever they change: acks, failed requests
+    // and timeouts alike. The snapshot is a copy, so nothing is locked
+    // while publishing.
+    if (!this->queue->TakeMetrics(metrics))
+      continue;
+
+    ignition::msgs::Param metricsMsg;
+    auto &params = *metricsMsg.mutable_params();
+    for (const auto &[address, robotMetrics] : metrics)
+    {
+      params[address + "/acks"].set_type(ignition::msgs::Any::INT32);
+      params[address + "/acks"].set_int_value(robotMetrics.acks);
+      params[address + "/failures"].set_type(ignition::msgs::Any::INT32);
+      params[address + "/failures"].set_int_value(robotMetrics.failures);
+      params[address + "/mean_latency"].set_type(ignition::msgs::Any::DOUBLE);
+      params[address + "/mean_latency"].set_double_value(
+          robotMetrics.acks > 0 ?
+          robotMetrics.totalLatency / robotMetrics.acks : 0.0);
+      params[address + "/max_latency"].set_type(ignition::msgs::Any::DOUBLE);
+      params[address + "/max_latency"].set_double_value(
+          robotMetrics.maxLatency);
+    }
+    this->metricsPub.Publish(metricsMsg);
   }
   igndbg << "Terminating run loop" << std::endl;
 }
-
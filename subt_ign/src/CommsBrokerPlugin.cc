@@ -63,6 +63,10 @@ bool CommsBrokerPlugin::Load(const tinyxml2::XMLElement *_elem)
       if (elem)
         visibilityConfig.commsCostMax = std::stod(elem->GetText());
 
+      elem = rfConfigElem->FirstChildElement("coverage_resolution");
+      if (elem)
+        visibilityConfig.coverageResolution = std::stod(elem->GetText());
+
       igndbg << "Loading visibility_config from SDF: \n" << visibilityConfig
         << std::endl;
     }
@@ -122,6 +126,13 @@ bool CommsBrokerPlugin::Load(const tinyxml2::XMLElement *_elem)
 
       igndbg << "Loading radio_config from SDF: \n" << radio << std::endl;
     }
+
+    // Seed of the random fading and packet drops. Runs with the same seed
+    // and traffic drop the same packets.
+    const tinyxml2::XMLElement *seedElem =
+      commsModelElem->FirstChildElement("seed");
+    if (seedElem)
+      radio.seed = std::stoull(seedElem->GetText());
   }
 
   std::string worldName = "default";
@@ -173,6 +184,7 @@ bool CommsBrokerPlugin::Load(const tinyxml2::XMLElement *_elem)
   // TODO: Maybe only try to instantiate if visibility type is selected
   this->visibilityModel = std::make_unique<VisibilityModel>(
     visibilityConfig, rangeConfig, worldName);
+  this->visibilityModel->SetPoseCache(this->poseCache);
 
   // Only consider the visibility range if all files (.dot and .dat) are found.
   if (this->visibilityModel->Initialized())
@@ -220,6 +232,9 @@ bool CommsBrokerPlugin::Load(const tinyxml2::XMLElement *_elem)
   radio.pathloss_f = pathlossFunctions[commsModelType];
   broker.SetDefaultRadioConfiguration(radio);
 
+  // The coverage visualization uses the same radio as the robots.
+  this->visibilityModel->SetRadioConfiguration(radio);
+
   // Set communication function (i.e., the attempt_send function) to
   // use for the broker
   broker.SetCommunicationFunction(&subt::communication_model::attempt_send);
@@ -227,9 +242,9 @@ bool CommsBrokerPlugin::Load(const tinyxml2::XMLElement *_elem)
   // Build function to get pose from gazebo
   auto updatePoseFunc = [&](const std::string &_name)
   {
-    std::map<std::string, ignition::math::Pose3d>::iterator iter =
-      this->poses.find(_name);
-    if (iter == this->poses.end())
+    // Team members are interned the first time the broker asks for them.
+    ignition::math::Pose3d pose;
+    if (!this->poseCache->Pose(this->poseCache->Intern(_name), pose))
     {
       return std::make_tuple(false,
                              ignition::math::Pose3<double>(),
@@ -237,16 +252,57 @@ bool CommsBrokerPlugin::Load(const tinyxml2::XMLElement *_elem)
     }
 
     return std::make_tuple(true,
-                           iter->second,
-                           simTime.Double());
+                           pose,
+                           this->poseCache->SimTime().Double());
   };
   broker.SetPoseUpdateFunction(updatePoseFunc);
+
+  const tinyxml2::XMLElement *traceElem = _elem->FirstChildElement("trace");
+  if (traceElem && traceElem->FirstChildElement("path"))
+  {
+    std::string tracePath = traceElem->FirstChildElement("path")->GetText();
+    bool tracePayload = false;
+    const tinyxml2::XMLElement *payloadElem =
+      traceElem->FirstChildElement("payload");
+    if (payloadElem && payloadElem->GetText())
+    {
+      std::string payloadStr = payloadElem->GetText();
+      tracePayload = common::lowercase(payloadStr) == "true" ||
+        payloadStr == "1";
+    }
+
+    if (broker.RecordTrace(tracePath, tracePayload))
+      ignmsg << "Recording comms trace to [" << tracePath << "]" << std::endl;
+  }
+
+  const tinyxml2::XMLElement *telemetryElem =
+    _elem->FirstChildElement("telemetry");
+  if (telemetryElem)
+  {
+    double telemetryPeriod = 1.0;
+    std::string telemetryFile;
+    const tinyxml2::XMLElement *periodElem =
+      telemetryElem->FirstChildElement("period");
+    if (periodElem && periodElem->GetText())
+      telemetryPeriod = std::stod(periodElem->GetText());
+    const tinyxml2::XMLElement *fileElem =
+      telemetryElem->FirstChildElement("file");
+    if (fileElem && fileElem->GetText())
+      telemetryFile = fileElem->GetText();
+
+    broker.SetTelemetryOutput(telemetryPeriod, telemetryFile);
+  }
+
   broker.Start();
 
   // Subscribe to pose messages.
   this->node.Subscribe("/world/" + worldName + "/pose/info",
       &CommsBrokerPlugin::OnPose, this);
 
+  // Subscribe to the entities created, to find the breadcrumbs.
+  this->node.Subscribe("/world/" + worldName + "/scene/info",
+      &CommsBrokerPlugin::OnScene, this);
+
   ignmsg << "Starting SubT comms broker" << std::endl;
 
   return true;
@@ -255,16 +311,8 @@ bool CommsBrokerPlugin::Load(const tinyxml2::XMLElement *_elem)
 /////////////////////////////////////////////////
 void CommsBrokerPlugin::OnPose(const ignition::msgs::Pose_V &_msg)
 {
-  // Store sim time if present
-  if (_msg.has_header() && _msg.header().has_stamp())
-  {
-    this->simTime.Set(_msg.header().stamp().sec(),
-        _msg.header().stamp().nsec());
-  }
-
-  // Update all the published poses
-  for (int i = 0; i < _msg.pose_size(); ++i)
-    this->poses[_msg.pose(i).name()] = ignition::msgs::Convert(_msg.pose(i));
+  // Update the poses of the team, and the sim time.
+  this->poseCache->OnPoses(_msg);
 
   // Update the visibility graph if needed.
   this->UpdateIfNewBreadcrumbs();
@@ -312,28 +360,19 @@ void CommsBrokerPlugin::OnPose(const ignition::msgs::Pose_V &_msg)
 }
 
 /////////////////////////////////////////////////
-void CommsBrokerPlugin::UpdateIfNewBreadcrumbs()
+void CommsBrokerPlugin::OnScene(const ignition::msgs::Scene &_msg)
 {
-  bool newBreadcrumbFound = false;
-  for (const auto& [name, pose] : this->poses)
-  {
-    // New breadcrumb found.
-    // A static model is spawned when the breadcrumb is made static
-    if (name.find("__breadcrumb__") != std::string::npos &&
-        name.find("__static__") != std::string::npos &&
-        this->breadcrumbs.find(name) == this->breadcrumbs.end())
-    {
-      this->breadcrumbs[name] = pose;
-      newBreadcrumbFound = true;
-    }
-  }
+  // The visibility table is updated from OnPose(), in the thread that
+  // dispatches the messages.
+  this->poseCache->OnScene(_msg);
+}
 
-  // Update the comms.
-  if (newBreadcrumbFound)
+/////////////////////////////////////////////////
+void CommsBrokerPlugin::UpdateIfNewBreadcrumbs()
+{
+  std::set<ignition::math::Vector3d> breadcrumbPoses;
+  if (this->poseCache->NewBreadcrumbs(breadcrumbPoses))
   {
-    std::set<ignition::math::Vector3d> breadcrumbPoses;
-    for (const auto& it : this->breadcrumbs)
-      breadcrumbPoses.insert(it.second.Pos());
     this->visibilityModel->PopulateVisibilityInfo(breadcrumbPoses);
     ignmsg << "New breadcrumb detected, visibility graph updated" << std::endl;
   }
@@ -15,7 +15,6 @@
  *
 */
 
-#include <yaml-cpp/yaml.h>
 #include <ros/ros.h>
 #include <rosbag/recorder.h>
 
@@ -25,11 +24,17 @@
 #include <ignition/plugin/Register.hh>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <ignition/gazebo/Link.hh>
 #include <ignition/gazebo/components/AngularVelocity.hh>
@@ -76,8 +81,10 @@
 #include "subt_ros/RunStatus.h"
 #include "subt_ign/Common.hh"
 #include "subt_ign/GameLogicPlugin.hh"
+#include "subt_ign/LockFreeQueue.hh"
 #include "subt_ign/protobuf/artifact.pb.h"
 #include "subt_ign/RobotPlatformTypes.hh"
+#include "subt_ign/ScoringEngine.hh"
 
 IGNITION_ADD_PLUGIN(
     subt::GameLogicPlugin,
@@ -108,27 +115,181 @@ class KineticEnergyInfo
   public: std::string robotName;
 };
 
-class subt::GameLogicPluginPrivate
+/// \brief Robots in the world, as parallel arrays. A robot is a model with
+/// a sensor in one of its links. Robots are registered once, when their
+/// sensors appear, so the per-update work is proportional to the number of
+/// robots and not to the number of sensors.
+class RobotRegistry
 {
-  /// \brief Write a simulation timestamp to a logfile.
-  /// \param[in] _simTime Current sim time.
-  /// \return A file stream that can be used to write additional
-  /// information to the logfile.
-  public: std::ofstream &Log(const ignition::msgs::Time &_simTime);
+  /// \brief Model entity of each robot, kNullEntity once removed.
+  public: std::vector<gazebo::Entity> models;
 
-  /// \brief Calculate the score of a new artifact request.
-  /// \param[in] _simTime Simulation time.
-  /// \param[in] _type The object type. See ArtifactType.
-  /// \param[in] _pose The object pose.
-  /// \return A tuple where the first parameter is the score obtained for this
-  /// report, and the second parameter is true if the artifact report is a
-  /// duplicate and false otherwise.
-  public: std::tuple<double, bool> ScoreArtifact(
-              const ignition::msgs::Time &_simTime,
-              const subt::ArtifactType &_type,
-              const ignition::msgs::Pose &_pose,
-              subt_ros::ArtifactReport &_artifactMsg);
+  /// \brief Name of each robot.
+  public: std::vector<std::string> names;
+
+  /// \brief Index of each robot in the scoring engine.
+  public: std::vector<std::size_t> statsIndices;
+
+  /// \brief Map of model entity to its position in the arrays above.
+  public: std::unordered_map<gazebo::Entity, std::size_t> slots;
+
+  /// \brief Current poses of the robots, indexed by the scoring engine
+  /// robot index.
+  public: RobotPoses poses;
+
+  /// \brief Whether the sensors existing before the first update were
+  /// visited.
+  public: bool initialized = false;
+};
+
+/// \brief An event received on one of the topics of GameEventSubscriber.
+struct GameEvent
+{
+  /// \brief Kinds of events.
+  enum Type : uint8_t
+  {
+    /// \brief A marsupial child was detached.
+    DETACH,
+
+    /// \brief A robot deployed a breadcrumb.
+    BREADCRUMB_DEPLOY,
+
+    /// \brief Number of breadcrumbs a robot has left, in value.
+    BREADCRUMB_REMAINING,
+
+    /// \brief A robot's battery ran out, with the charge in value.
+    BATTERY_DEPLETED,
+
+    /// \brief Number of rock falls a model has left, in value.
+    ROCK_FALL_REMAINING,
+
+    /// \brief A dynamic collapse was deployed.
+    DYNAMIC_COLLAPSE
+  };
+
+  /// \brief Kind of the event.
+  Type type{DETACH};
+
+  /// \brief Index of the model name in GameEventSubscriber.
+  uint32_t model{0u};
+
+  /// \brief Payload of the event.
+  double value{0.0};
+};
+
+/// \brief Subscribes to the topics of the game events (detach, breadcrumbs,
+/// battery, rock falls and dynamic collapses) on a background thread, so
+/// that transport discovery doesn't stall the simulation. Only topics of
+/// plugins declared in a model's SDF are subscribed. The received events
+/// are queued without locking, and popped on the simulation thread.
+class GameEventSubscriber
+{
+  /// \brief Constructor, starts the subscription thread.
+  public: GameEventSubscriber();
+
+  /// \brief Destructor, stops the subscription thread.
+  public: ~GameEventSubscriber();
+
+  /// \brief Request the subscriptions to the events of a robot.
+  /// \param[in] _name Name of the robot.
+  /// \param[in] _sdf SDF of the robot. All the topics the robot could use
+  /// are subscribed if null.
+  public: void AddRobot(const std::string &_name,
+    const sdf::ElementPtr &_sdf);
+
+  /// \brief Request the subscriptions to the events of a static model,
+  /// such as a rock fall.
+  /// \param[in] _name Name of the model.
+  /// \param[in] _sdf SDF of the model. All the topics the model could use
+  /// are subscribed if null.
+  public: void AddStaticModel(const std::string &_name,
+    const sdf::ElementPtr &_sdf);
+
+  /// \brief Take the next received event.
+  /// \param[out] _event The event.
+  /// \return False if there is no event.
+  public: bool Pop(GameEvent &_event);
+
+  /// \brief Name of a model of an event.
+  /// \param[in] _index GameEvent::model.
+  /// \return The model name.
+  public: const std::string &ModelName(uint32_t _index) const;
+
+  /// \brief Number of events dropped because the queue was full.
+  /// \return The count since the last call.
+  public: uint64_t TakeDropped();
+
+  /// \brief A topic to subscribe to.
+  private: struct Request
+  {
+    /// \brief The topic.
+    std::string topic;
+
+    /// \brief Event published on the topic.
+    GameEvent::Type type;
+
+    /// \brief Index of the model name.
+    uint32_t model;
+  };
+
+  /// \brief Index of a model name, adding it if needed.
+  /// \param[in] _name Model name.
+  /// \return The index.
+  private: uint32_t ModelIndex(const std::string &_name);
+
+  /// \brief Queue a subscription request for the thread.
+  /// \param[in] _topic The topic.
+  /// \param[in] _type Event published on the topic.
+  /// \param[in] _model Name of the model the event is about.
+  private: void RequestSubscription(const std::string &_topic,
+    GameEvent::Type _type, const std::string &_model);
 
+  /// \brief Queue a received event.
+  /// \param[in] _event The event.
+  private: void Queue(const GameEvent &_event);
+
+  /// \brief Subscribe to a topic.
+  /// \param[in] _request The topic and its event.
+  private: void Subscribe(const Request &_request);
+
+  /// \brief Body of the subscription thread.
+  private: void Run();
+
+  /// \brief Model names, only used on the simulation thread.
+  private: std::vector<std::string> modelNames;
+
+  /// \brief Index of each model name.
+  private: std::unordered_map<std::string, uint32_t> modelIndices;
+
+  /// \brief Received events. Big enough to never fill up when it is
+  /// emptied every simulation step.
+  private: LockFreeQueue<GameEvent> events{4096u};
+
+  /// \brief Number of events dropped because the queue was full.
+  private: std::atomic<uint64_t> dropped{0u};
+
+  /// \brief Protects the requests and stop.
+  private: std::mutex mutex;
+
+  /// \brief Notifies the thread of new requests.
+  private: std::condition_variable condition;
+
+  /// \brief Pending subscription requests.
+  private: std::vector<Request> requests;
+
+  /// \brief Whether the thread should stop.
+  private: bool stop{false};
+
+  /// \brief Node owning the subscriptions. It is declared after the event
+  /// queue so that it is destroyed, and stops calling back, first.
+  private: transport::Node node;
+
+  /// \brief The subscription thread.
+  private: std::thread thread;
+};
+
+class subt::GameLogicPluginPrivate
+{
   /// \brief Callback executed to process a new artifact request
   /// sent by a team.
   /// \param[in] _req The service request.
@@ -139,18 +300,6 @@ class subt::GameLogicPluginPrivate
   /// \param[in] _event Unused.
   public: void PublishScore();
 
-  /// \brief Log robot pos data
-  public: void LogRobotPosData();
-
-  /// \brief Log robot and artifact data
-  /// \param[in] _simTime Current sim time.
-  /// \param[in] _realElapsed Elapsed real time in seconds.
-  /// \param[in] _simElapsed Elapsed sim time in seconds.
-  public: void LogRobotArtifactData(
-              const ignition::msgs::Time &_simTime,
-              int _realElapsed,
-              int _simElapsed) const;
-
   /// \brief Finish game and generate log files
   /// \param[in] _simTime Simulation time.
   public: void Finish(const ignition::msgs::Time &_simTime);
@@ -163,23 +312,10 @@ class subt::GameLogicPluginPrivate
                const ignition::msgs::StringMsg &_req,
                ignition::msgs::Pose &_res);
 
-  /// \brief Update the score.yml and summary.yml files. This function also
-  /// returns the time point used to calculate the elapsed real time. By
-  /// returning this time point, we can make sure that the ::Finish function
-  /// uses the same time point.
-  /// \param[in] _simTime Current sim time.
-  /// \return The time point used to calculate the elapsed real time.
-  public: std::chrono::steady_clock::time_point UpdateScoreFiles(
-              const ignition::msgs::Time &_simTime);
-
   /// \brief Performer detector subscription callback.
   /// \param[in] _msg Pose message of the event.
   public: void OnEvent(const ignition::msgs::Pose &_msg);
 
-  /// \brief Log an event to the eventStream.
-  /// \param[in] _event The event to log.
-  public: void LogEvent(const std::string &_event);
-
   /// \brief Publish a robot event.
   /// \param[in] _simTime Current sim time.
   /// \param[in] _type Event type.
@@ -203,44 +339,32 @@ class subt::GameLogicPluginPrivate
     const std::string &_state,
     int _eventId);
 
-  /// \brief Marsupial detach subscription callback.
-  /// \param[in] _msg Detach message.
-  /// \param[in] _info Message information.
-  public: void OnDetachEvent(const ignition::msgs::Empty &_msg,
-    const transport::MessageInfo &_info);
-
-  /// \brief Breadcrumb deploy subscription callback.
-  /// \param[in] _msg Deploy message.
-  /// \param[in] _info Message information.
-  public: void OnBreadcrumbDeployEvent(const ignition::msgs::Empty &_msg,
-    const transport::MessageInfo &_info);
-
-  /// \brief Breadcrumb remaining subscription callback.
-  /// \param[in] _msg Remaining count.
-  /// \param[in] _info Message information.
-  public: void OnBreadcrumbDeployRemainingEvent(
-    const ignition::msgs::Int32 &_msg,
-    const transport::MessageInfo &_info);
-
-  /// \brief Dynamic collapse remaining subscription callback.
-  /// \param[in] _msg Remaining count.
-  /// \param[in] _info Message information.
-  public: void OnDynamicCollapseDeployRemainingEvent(
-    const ignition::msgs::Int32 &_msg,
-    const transport::MessageInfo &_info);
-
-  /// \brief Rock fall remaining subscription callback.
-  /// \param[in] _msg Remaining count.
-  /// \param[in] _info Message information.
-  public: void OnRockFallDeployRemainingEvent(
-    const ignition::msgs::Int32 &_msg,
-    const transport::MessageInfo &_info);
-
-  /// \brief Battery subscription callback.
-  /// \param[in] _msg Battery message.
-  /// \param[in] _info Message information.
-  public: void OnBatteryMsg(const ignition::msgs::BatteryState &_msg,
-    const transport::MessageInfo &_info);
+  /// \brief Publish the pose and kinematic state of a robot.
+  /// \param[in] _simTime Current sim time.
+  /// \param[in] _robot Robot name.
+  /// \param[in] _state Kinematic state in the artifact origin frame.
+  public: void PublishKinematicState(
+    const ignition::msgs::Time &_simTime,
+    const std::string &_robot,
+    const KinematicState &_state);
+
+  /// \brief Publish the run statistics.
+  /// \param[in] _stats The statistics.
+  public: void PublishRunStatistics(const RunStatistics &_stats);
+
+  /// \brief Pass the received game events to the scoring engine.
+  public: void ProcessGameEvents();
+
+  /// \brief Register the robot that owns a sensor, if it is new.
+  /// \param[in] _sensorParent Entity the sensor is attached to.
+  /// \param[in] _ecm Entity component manager.
+  public: void RegisterRobot(const gazebo::Entity &_sensorParent,
+    const gazebo::EntityComponentManager &_ecm);
+
+  /// \brief Register new robots, forget removed ones and read the poses of
+  /// all robots.
+  /// \param[in] _ecm Entity component manager.
+  public: void UpdateRobots(const gazebo::EntityComponentManager &_ecm);
 
   private: bool PoseFromArtifactHelper(const std::string &_robot,
     ignition::math::Pose3d &_result);
@@ -264,21 +388,9 @@ class subt::GameLogicPluginPrivate
   public: bool OnFinishCall(const ignition::msgs::Boolean &_req,
                ignition::msgs::Boolean &_res);
 
-  /// \brief Checks if a robot has flipped.
-  public: void CheckRobotFlip();
-
-  /// \brief Round input number n down to the nearest mulitple of m
-  /// \param[in] _n input number
-  /// \param[in] _m the input number will be rounded down to the nearest
-  /// multiple of this number.
-  /// \return Result
-  public: double FloorMultiple(double _n, double _m);
-
-  /// \brief Convert a world pose to be in the artifact origin frame.
-  /// \param[in] _pose Pose to convert.
-  /// \return Pose in the artifact origin frame.
-  public: ignition::math::Pose3d ConvertToArtifactOrigin(
-    const ignition::math::Pose3d &_pose) const;
+  /// \brief Scoring rules and run statistics. The plugin feeds it with the
+  /// state of the simulation and publishes its output.
+  public: ScoringEngine engine;
 
   /// \brief Ignition Transport node.
   public: transport::Node node;
@@ -289,9 +401,6 @@ class subt::GameLogicPluginPrivate
   /// \brief Amount of allowed warmup time in seconds.
   public: int warmupTimeSec = 900;
 
-  /// \brief The simulation time of the start call.
-  public: ignition::msgs::Time startSimTime;
-
   /// \brief Number of simulation seconds allowed.
   public: std::chrono::seconds runDuration{0};
 
@@ -301,146 +410,11 @@ class subt::GameLogicPluginPrivate
   /// \brief Thread on which the ROS bag recorder runs.
   public: std::unique_ptr<std::thread> bagThread = nullptr;
 
-  /// \brief Whether the task has started.
-  public: bool started = false;
-
-  /// \brief Whether the task has finished.
-  public: bool finished = false;
-
-  /// \brief Start time used for scoring.
-  public: std::chrono::steady_clock::time_point startTime;
-
-  /// \brief Store all artifacts.
-  /// The key is the object type. See ArtifactType for all supported values.
-  /// The value is another map, where the key is the model name and the value
-  /// is a Model pointer.
-  public: std::map<subt::ArtifactType,
-                    std::map<std::string, ignition::math::Pose3d>> artifacts;
-
-  /// \brief Artifacts that were found.
-  public: std::set<std::string> foundArtifacts;
-
   public: std::map<std::string, ignition::math::Pose3d> poses;
 
-  /// \brief Counter to track unique identifiers.
-  public: uint32_t reportCount = 0u;
-
-  /// \brief Counter to track duplicate artifact reports
-  public: uint32_t duplicateReportCount = 0u;
-
-  /// The maximum number of times that a team can attempt an
-  /// artifact report.
-  public: uint32_t reportCountLimit = 40u;
-
-  /// \brief The total number of artifacts.
-  public: uint32_t artifactCount = 20u;
-
-  /// \brief Total score.
-  public: double totalScore = 0.0;
-
-  /// \brief Closest artifact report. The elements are: artifact name, type,
-  /// true pos, reported pos, distance between true pos and reported pos
-  public: std::tuple<std::string, std::string, ignition::math::Vector3d,
-      ignition::math::Vector3d, double> closestReport =
-    {"", "", ignition::math::Vector3d(), ignition::math::Vector3d(), -1};
-
-  /// \brief First artifact report time
-  public: double firstReportTime = -1;
-
-  /// \brief Last artifact report time
-  public: double lastReportTime = -1;
-
-  /// \brief A map of robot name and a vector of timestamped position data
-  public: std::map<std::string, std::vector<std::pair<
-      std::chrono::steady_clock::duration, ignition::math::Pose3d>>>
-      robotPoseData;
-
-  /// \brief A map of robot name and its starting pose
-  public: std::map<std::string, ignition::math::Pose3d> robotStartPose;
-
-  /// \brief A map of robot name and distance traveled
-  public: std::map<std::string, double> robotDistance;
-
-  /// \brief Step size for elevation gain / loss
-  public: double elevationStepSize = 5.0;
-
-  /// \brief A map of robot name and elevation gain (cumulative)
-  public: std::map<std::string, double> robotElevationGain;
-
-  /// \brief A map of robot name and elevation loss (cumulative)
-  public: std::map<std::string, double> robotElevationLoss;
-
-  /// \brief A map of robot name and max euclidean distance traveled
-  public: std::map<std::string, double> robotMaxEuclideanDistance;
-
-  /// \brief A map of robot name and its average velocity
-  public: std::map<std::string, double> robotAvgVel;
-
-  /// \brief A map of robot name and its previous pose
-  public: std::map<std::string, ignition::math::Pose3d> robotPrevPose;
-
-  /// \brief A map of robot name to its flip information.
-  /// The value is a pair stating the sim time where the most recent flip started,
-  /// and if the robot is currently flipped.
-  public: std::map<std::string, std::pair<int64_t, bool>> robotFlipInfo;
-
-  /// \brief Robot name with the max velocity
-  public: std::pair<std::string, double> maxRobotVel = {"", 0};
-
-  /// \brief Robot name with the max average velocity
-  public: std::pair<std::string, double> maxRobotAvgVel = {"", 0};
-
-  /// \brief Robot name with the max distance traveled;
-  public: std::pair<std::string, double> maxRobotDistance = {"", 0};
-
-  /// \brief Robot name with the max euclidean distance from starting area;
-  public: std::pair<std::string, double> maxRobotEuclideanDistance  = {"", 0};
-
-  /// \brief Robot name with the max cumulative elevation gain;
-  public: std::pair<std::string, double> maxRobotElevationGain = {"", 0};
-
-  /// \brief Robot name with the max cumulative elevation loss;
-  public: std::pair<std::string, double> maxRobotElevationLoss = {"", 0};
-
-  /// \brief Robot name with the max elevation reached;
-  public: std::pair<std::string, double> maxRobotElevation = {"", 0};
-
-  /// \brief Robot name with the min elevation reached;
-  public: std::pair<std::string, double> minRobotElevation = {"", 0};
-
-  /// \brief Total distanced traveled by all robots
-  public: double robotsTotalDistance = 0;
-
-  /// \brief Total cumulative elevation gain by all robots
-  public: double robotsTotalElevationGain = 0;
-
-  /// \brief Total cumulative elevation loss by all robots
-  public: double robotsTotalElevationLoss = 0;
-
-  /// \brief A map of robot name and its pos output stream
-  public: std::map<std::string, std::shared_ptr<std::ofstream>> robotPosStream;
-
-  /// \brief A mutex.
-  public: std::mutex logMutex;
-
-  /// \brief A mutex.
-  public: std::mutex mutex;
-
   /// \brief Mutex to protect the poses data structure.
   public: std::mutex posesMutex;
 
-  /// \brief Log file output stream.
-  public: std::ofstream logStream;
-
-  /// \brief Event file output stream.
-  public: std::ofstream eventStream;
-
-  /// \brief Mutex to protect the eventStream.
-  public: std::mutex eventMutex;
-
-  /// \brief The pose of the object marking the origin of the artifacts.
-  public: ignition::math::Pose3d artifactOriginPose;
-
   /// \brief Ignition transport start publisher. This is needed by cloudsim
   /// to know when a run has been started.
   public: transport::Node::Publisher startPub;
@@ -454,92 +428,27 @@ class subt::GameLogicPluginPrivate
   /// \brief Ignition transport that publishes robot name and type info.
   public: transport::Node::Publisher robotPub;
 
-  /// \brief Logpath.
-  public: std::string logPath{"/dev/null"};
-
-  /// \brief Names of the spawned robots.
-  public: std::set<std::string> robotNames;
-
-  /// \brief Robot types for keeping track of unique robot platform types.
-  public: std::set<std::string> robotTypes;
-
-  /// \brief Map of robot name to {platform, config}. For example:
-  /// {"MY_ROBOT_NAME", {"X1", "X1 SENSOR CONFIG 1"}}.
-  public: std::map<std::string, std::pair<std::string, std::string>>
-          robotFullTypes;
-
-  /// \brief The unique artifact reports received, and the score it received.
-  public: std::map<std::string, double> uniqueReports;
-
   /// \brief Current state.
   public: std::string state="init";
 
   /// \brief Time at which the last status publication took place.
   public: std::chrono::steady_clock::time_point lastStatusPubTime;
 
-  /// \brief Time at which the summary.yaml file was last updated.
-  public: mutable std::chrono::steady_clock::time_point lastUpdateScoresTime;
-
   /// \brief Distance from the base station after which the competition is
   /// automatically started, and a robot can no longer receive the artifact
   /// origin frame.
   public: const double allowedDistanceFromBase = 21.0;
 
-  /// \brief The world name.
-  public: std::string worldName = "default";
-
-  /// \brief Offsets from each artifact's origin to its localization point.
-  /// The gas artifact has a location point of zero because it is placed at
-  /// the center point of the entry door threshold at floor level.
-  ///
-  /// Refer to:
-  /// https://subtchallenge.com/resources/SubT_Urban_Artifacts_Specification.pdf
-  public: std::map<subt::ArtifactType, ignition::math::Vector3d>
-          artifactOffsets =
-  {
-    {subt::ArtifactType::TYPE_BACKPACK,
-      ignition::math::Vector3d(0, -0.12766, 0.25668)},
-    {subt::ArtifactType::TYPE_DRILL,
-      ignition::math::Vector3d(0, 0.059073, 0.158863)},
-    {subt::ArtifactType::TYPE_EXTINGUISHER,
-      ignition::math::Vector3d(-0.03557, -0.03509, 0.3479)},
-    {subt::ArtifactType::TYPE_GAS,
-      ignition::math::Vector3d(0, 0, 0)},
-    {subt::ArtifactType::TYPE_HELMET,
-      ignition::math::Vector3d(0, 0, 0.165)},
-    {subt::ArtifactType::TYPE_PHONE,
-      ignition::math::Vector3d(0, -0.004, 0.08)},
-    {subt::ArtifactType::TYPE_RESCUE_RANDY,
-      ignition::math::Vector3d(-0.071305, 0.021966, 0.39217)},
-    {subt::ArtifactType::TYPE_ROPE,
-      ignition::math::Vector3d(0.004, -0.03, 0.095)},
-    {subt::ArtifactType::TYPE_VENT,
-      ignition::math::Vector3d(0, 0, 0.138369)},
-    {subt::ArtifactType::TYPE_CUBE,
-      ignition::math::Vector3d(0, 0, 0.2)}
-  };
-
   /// \brief Event manager for pausing simulation
   public: EventManager *eventManager;
 
-  /// \brief The set of marsupial pairs.
-  public: std::map<std::string, std::string> marsupialPairs;
-
-  /// \brief Models with dead batteries.
-  public: std::set<std::string> deadBatteries;
+  /// \brief Static models whose SDF was checked for rock fall and dynamic
+  /// collapse topics.
+  public: std::set<std::string> staticModels;
 
-  /// \brief Map of model name to {sim_time_sec, deployments_over_max}. This
-  /// map is used to log when no more rock falls are possible for a rock
-  /// fall model.
-  public: std::map<std::string, std::pair<int, int>> rockFallsMax;
-
-  /// \brief Map of model name to bool. This map is used to log when no more
-  /// dynamic collapses are possible.
-  public: std::map<std::string, bool> dynamicCollapseMax;
-
-  /// \brief Map of model name to deployments_over_max. This map
-  /// is used to log when no more breadcrumb deployments are possible.
-  public: std::map<std::string, int> breadcrumbsMax;
+  /// \brief Subscriptions to the detach, breadcrumb, battery, rock fall and
+  /// dynamic collapse events.
+  public: GameEventSubscriber gameEvents;
 
   /// \brief The ROS node handler used for communications.
   public: std::unique_ptr<ros::NodeHandle> rosnode;
@@ -556,11 +465,8 @@ class subt::GameLogicPluginPrivate
 
   public: std::string prevPhase = "";
 
-  /// \brief Counter to create unique id for events
-  public: int eventCounter = 0;
-
-  /// \brief Mutex to protect the eventCounter.
-  public: std::mutex eventCounterMutex;
+  /// \brief The robots in the world.
+  public: RobotRegistry robots;
 
   /// \brief Kinetic energy information for each robot.
   public: std::map<gazebo::Entity, KineticEnergyInfo> keInfo;
@@ -572,6 +478,292 @@ class subt::GameLogicPluginPrivate
   public: double keHeight = 0.077;
 };
 
+/////////////////////////////////////////////////
+/// \brief Get the plugins of a model with a given name.
+/// \param[in] _sdf SDF of the model.
+/// \param[in] _name Name of the plugin, e.g.
+/// "ignition::gazebo::systems::Breadcrumbs".
+/// \return The plugin elements.
+static std::vector<sdf::ElementPtr> FindPlugins(const sdf::ElementPtr &_sdf,
+    const std::string &_name)
+{
+  std::vector<sdf::ElementPtr> result;
+  if (!_sdf || !_sdf->HasElement("plugin"))
+    return result;
+
+  for (auto plugin = _sdf->GetElement("plugin"); plugin;
+       plugin = plugin->GetNextElement("plugin"))
+  {
+    if (plugin->Get<std::string>("name") == _name)
+      result.push_back(plugin);
+  }
+  return result;
+}
+
+/////////////////////////////////////////////////
+/// \brief Get the deploy topic of a breadcrumbs plugin.
+/// \param[in] _plugin The plugin element.
+/// \param[in] _modelName Name of the model the plugin belongs to.
+/// \param[out] _breadcrumb Name of the breadcrumb model, empty if it isn't
+/// declared inline.
+/// \return The topic.
+static std::string BreadcrumbsTopic(const sdf::ElementPtr &_plugin,
+    const std::string &_modelName, std::string &_breadcrumb)
+{
+  _breadcrumb.clear();
+  auto elem = _plugin->FindElement("breadcrumb");
+  if (elem)
+    elem = elem->FindElement("sdf");
+  if (elem)
+    elem = elem->FindElement("model");
+  if (elem)
+    _breadcrumb = elem->Get<std::string>("name");
+
+  if (_plugin->HasElement("topic"))
+    return _plugin->Get<std::string>("topic");
+
+  // Default of the breadcrumbs system.
+  return "/model/" + _modelName + "/breadcrumbs/" + _breadcrumb + "/deploy";
+}
+
+//////////////////////////////////////////////////
+GameEventSubscriber::GameEventSubscriber()
+  : thread(&GameEventSubscriber::Run, this)
+{
+}
+
+//////////////////////////////////////////////////
+GameEventSubscriber::~GameEventSubscriber()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->condition.notify_one();
+  this->thread.join();
+}
+
+//////////////////////////////////////////////////
+void GameEventSubscriber::AddRobot(const std::string &_name,
+    const sdf::ElementPtr &_sdf)
+{
+  const std::string prefix = "/model/" + _name;
+
+  // Without the SDF, subscribe to every topic a robot could publish on.
+  // Robots that don't have the corresponding plugin won't create the
+  // publisher.
+  if (!_sdf)
+  {
+    this->RequestSubscription(prefix + "/detach", GameEvent::DETACH, _name);
+    this->RequestSubscription(prefix + "/breadcrumb/deploy",
+        GameEvent::BREADCRUMB_DEPLOY, _name);
+    this->RequestSubscription(prefix + "/breadcrumb/deploy/remaining",
+        GameEvent::BREADCRUMB_REMAINING, _name);
+    this->RequestSubscription(prefix + "/battery/linear_battery/state",
+        GameEvent::BATTERY_DEPLETED, _name);
+    return;
+  }
+
+  // The detachable joint is declared by the marsupial parent, and detaches
+  // the child. Joints without an explicit topic aren't controlled by teams.
+  for (const auto &plugin :
+       FindPlugins(_sdf, "ignition::gazebo::systems::DetachableJoint"))
+  {
+    if (plugin->HasElement("topic") && plugin->HasElement("child_model"))
+    {
+      this->RequestSubscription(plugin->Get<std::string>("topic"),
+          GameEvent::DETACH, plugin->Get<std::string>("child_model"));
+    }
+  }
+
+  std::string breadcrumb;
+  for (const auto &plugin :
+       FindPlugins(_sdf, "ignition::gazebo::systems::Breadcrumbs"))
+  {
+    const std::string topic = BreadcrumbsTopic(plugin, _name, breadcrumb);
+    this->RequestSubscription(topic, GameEvent::BREADCRUMB_DEPLOY, _name);
+    this->RequestSubscription(topic + "/remaining",
+        GameEvent::BREADCRUMB_REMAINING, _name);
+  }
+
+  for (const auto &plugin :
+       FindPlugins(_sdf, "ignition::gazebo::systems::LinearBatteryPlugin"))
+  {
+    this->RequestSubscription(prefix + "/battery/" +
+        plugin->Get<std::string>("battery_name") + "/state",
+        GameEvent::BATTERY_DEPLETED, _name);
+  }
+}
+
+//////////////////////////////////////////////////
+void GameEventSubscriber::AddStaticModel(const std::string &_name,
+    const sdf::ElementPtr &_sdf)
+{
+  const std::string prefix = "/model/" + _name + "/breadcrumbs/";
+  if (!_sdf)
+  {
+    this->RequestSubscription(prefix + "Rock/deploy/remaining",
+        GameEvent::ROCK_FALL_REMAINING, _name);
+    this->RequestSubscription(prefix + "Wall/deploy/remaining",
+        GameEvent::DYNAMIC_COLLAPSE, _name);
+    return;
+  }
+
+  // Rock falls and dynamic collapses are breadcrumbs systems deploying
+  // "Rock" and "Wall" models.
+  std::string breadcrumb;
+  for (const auto &plugin :
+       FindPlugins(_sdf, "ignition::gazebo::systems::Breadcrumbs"))
+  {
+    const std::string topic =
+        BreadcrumbsTopic(plugin, _name, breadcrumb) + "/remaining";
+    if (breadcrumb == "Rock")
+    {
+      this->RequestSubscription(topic, GameEvent::ROCK_FALL_REMAINING, _name);
+    }
+    else if (breadcrumb == "Wall")
+    {
+      this->RequestSubscription(topic, GameEvent::DYNAMIC_COLLAPSE, _name);
+    }
+    // The breadcrumb is included from elsewhere, so it may be either.
+    else if (breadcrumb.empty())
+    {
+      this->RequestSubscription(prefix + "Rock/deploy/remaining",
+          GameEvent::ROCK_FALL_REMAINING, _name);
+      this->RequestSubscription(prefix + "Wall/deploy/remaining",
+          GameEvent::DYNAMIC_COLLAPSE, _name);
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+bool GameEventSubscriber::Pop(GameEvent &_event)
+{
+  return this->events.Pop(_event);
+}
+
+//////////////////////////////////////////////////
+const std::string &GameEventSubscriber::ModelName(uint32_t _index) const
+{
+  return this->modelNames[_index];
+}
+
+//////////////////////////////////////////////////
+uint64_t GameEventSubscriber::TakeDropped()
+{
+  return this->dropped.exchange(0u);
+}
+
+//////////////////////////////////////////////////
+uint32_t GameEventSubscriber::ModelIndex(const std::string &_name)
+{
+  auto inserted = this->modelIndices.emplace(_name,
+      static_cast<uint32_t>(this->modelNames.size()));
+  if (inserted.second)
+    this->modelNames.push_back(_name);
+  return inserted.first->second;
+}
+
+//////////////////////////////////////////////////
+void GameEventSubscriber::RequestSubscription(const std::string &_topic,
+    GameEvent::Type _type, const std::string &_model)
+{
+  // The model index is resolved here, so that the other threads never
+  // touch the names.
+  Request request{_topic, _type, this->ModelIndex(_model)};
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->requests.push_back(std::move(request));
+  }
+  this->condition.notify_one();
+}
+
+//////////////////////////////////////////////////
+void GameEventSubscriber::Queue(const GameEvent &_event)
+{
+  if (!this->events.Push(_event))
+    ++this->dropped;
+}
+
+//////////////////////////////////////////////////
+void GameEventSubscriber::Subscribe(const Request &_request)
+{
+  const GameEvent event{_request.type, _request.model, 0.0};
+  bool result = false;
+  switch (_request.type)
+  {
+    case GameEvent::DETACH:
+    case GameEvent::BREADCRUMB_DEPLOY:
+    {
+      std::function<void(const ignition::msgs::Empty &)> cb =
+        [this, event](const ignition::msgs::Empty &)
+        {
+          this->Queue(event);
+        };
+      result = this->node.Subscribe(_request.topic, cb);
+      break;
+    }
+    case GameEvent::BREADCRUMB_REMAINING:
+    case GameEvent::ROCK_FALL_REMAINING:
+    case GameEvent::DYNAMIC_COLLAPSE:
+    {
+      std::function<void(const ignition::msgs::Int32 &)> cb =
+        [this, event](const ignition::msgs::Int32 &_msg)
+        {
+          GameEvent e = event;
+          e.value = _msg.data();
+          this->Queue(e);
+        };
+      result = this->node.Subscribe(_request.topic, cb);
+      break;
+    }
+    case GameEvent::BATTERY_DEPLETED:
+    {
+      // Battery states arrive at a high rate, only the depleted ones are
+      // of interest.
+      std::function<void(const ignition::msgs::BatteryState &)> cb =
+        [this, event](const ignition::msgs::BatteryState &_msg)
+        {
+          if (_msg.percentage() > 0)
+            return;
+          GameEvent e = event;
+          e.value = _msg.percentage();
+          this->Queue(e);
+        };
+      result = this->node.Subscribe(_request.topic, cb);
+      break;
+    }
+  }
+
+  if (!result)
+    ignerr << "Failed to subscribe to [" << _request.topic << "]\n";
+}
+
+//////////////////////////////////////////////////
+void GameEventSubscriber::Run()
+{
+  std::vector<Request> pending;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->condition.wait(lock, [this]
+          {
+            return this->stop || !this->requests.empty();
+          });
+      if (this->stop)
+        return;
+      pending.swap(this->requests);
+    }
+
+    // Subscribing waits on transport discovery, so it is done without
+    // holding the lock.
+    for (const Request &request : pending)
+      this->Subscribe(request);
+    pending.clear();
+  }
+}
+
 //////////////////////////////////////////////////
 GameLogicPlugin::GameLogicPlugin()
   : dataPtr(new GameLogicPluginPrivate)
@@ -607,6 +799,7 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
     const_cast<sdf::Element*>(_sdf.get())->GetElement("logging");
 
   std::string filenamePrefix;
+  std::string logPath = "/dev/null";
   if (loggingElem && loggingElem->HasElement("filename_prefix"))
   {
     // Get the log filename prefix.
@@ -616,8 +809,7 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
     // Get the logpath from the <path> element, if it exists.
     if (loggingElem->HasElement("path"))
     {
-      this->dataPtr->logPath =
-        loggingElem->Get<std::string>("path", "/dev/null").first;
+      logPath = loggingElem->Get<std::string>("path", "/dev/null").first;
     }
     else
     {
@@ -631,7 +823,7 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
       }
       else
       {
-        this->dataPtr->logPath = homePath;
+        logPath = homePath;
       }
     }
     // Read elevation step size. Elevation data will be discretized and
@@ -639,9 +831,8 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
     // during logging
     if (loggingElem->HasElement("elevation_step_size"))
     {
-      this->dataPtr->elevationStepSize =
-          loggingElem->Get<double>("elevation_step_size",
-          this->dataPtr->elevationStepSize).first;
+      this->dataPtr->engine.SetElevationStepSize(
+          loggingElem->Get<double>("elevation_step_size", 5.0).first);
     }
   }
 
@@ -679,8 +870,8 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
       // Setup a ros bag recorder.
       rosbag::RecorderOptions recorderOptions;
       recorderOptions.append_date=false;
-      recorderOptions.prefix = ignition::common::joinPaths(
-        this->dataPtr->logPath, "cloudsim");
+      recorderOptions.prefix = ignition::common::joinPaths(logPath,
+          "cloudsim");
       recorderOptions.regex=true;
       recorderOptions.topics.push_back("/subt/.*");
 
@@ -692,14 +883,47 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
     }
   }
 
-  // Open the log file.
-  this->dataPtr->logStream.open(
-      (this->dataPtr->logPath + "/" + filenamePrefix + "_" +
-      ignition::common::systemTimeISO() + ".log").c_str(), std::ios::out);
+  std::string worldName = "default";
+  if (_sdf->HasElement("world_name"))
+  {
+    worldName = _sdf->Get<std::string>("world_name", "subt").first;
+  }
+  else
+  {
+    ignerr << "Missing <world_name>, the GameLogicPlugin will assume a "
+      << " world name of 'default'. This could lead to incorrect scoring\n";
+  }
 
-  // Open the event log file.
-  this->dataPtr->eventStream.open(
-      (this->dataPtr->logPath + "/events.yml").c_str(), std::ios::out);
+  // Open the log files. The report limit is set to 25 for final worlds.
+  this->dataPtr->engine.Load(logPath, filenamePrefix, worldName);
+
+  // Forward the output of the scoring engine to ROS.
+  GameLogicPluginPrivate *priv = this->dataPtr.get();
+  this->dataPtr->engine.SetRobotEventCallback(
+      [priv](const ignition::msgs::Time &_simTime, const std::string &_type,
+             const std::string &_robot, int _eventId)
+      {
+        priv->PublishRobotEvent(_simTime, _type, _robot, _eventId);
+      });
+  this->dataPtr->engine.SetRegionEventCallback(
+      [priv](const ignition::msgs::Time &_simTime, const std::string &_type,
+             const std::string &_robot, const std::string &_detector,
+             const std::string &_state, int _eventId)
+      {
+        priv->PublishRegionEvent(_simTime, _type, _robot, _detector, _state,
+            _eventId);
+      });
+  this->dataPtr->engine.SetKinematicStateCallback(
+      [priv](const ignition::msgs::Time &_simTime, const std::string &_robot,
+             const KinematicState &_state)
+      {
+        priv->PublishKinematicState(_simTime, _robot, _state);
+      });
+  this->dataPtr->engine.SetStatisticsCallback(
+      [priv](const RunStatistics &_stats)
+      {
+        priv->PublishRunStatistics(_stats);
+      });
 
   // Advertise the service to receive artifact reports.
   // Note that we're setting the scope to this service to SCOPE_T, so only
@@ -720,17 +944,6 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
       << " seconds.\n";
   }
 
-  if (_sdf->HasElement("world_name"))
-  {
-    this->dataPtr->worldName =
-      _sdf->Get<std::string>("world_name", "subt").first;
-  }
-  else
-  {
-    ignerr << "Missing <world_name>, the GameLogicPlugin will assume a "
-      << " world name of 'default'. This could lead to incorrect scoring\n";
-  }
-
   this->dataPtr->node.Advertise("/subt/pose_from_artifact_origin",
       &GameLogicPluginPrivate::OnPoseFromArtifact, this->dataPtr.get());
 
@@ -760,267 +973,174 @@ void GameLogicPlugin::Configure(const ignition::gazebo::Entity & /*_entity*/,
 
   ignmsg << "Starting SubT" << std::endl;
 
-  // Set the report limit to 25 for final worlds.
-  this->dataPtr->reportCountLimit =
-    this->dataPtr->worldName.find("final") != std::string::npos ? 25 :
-    this->dataPtr->reportCountLimit;
-
   // Make sure that there are score files.
-  this->dataPtr->UpdateScoreFiles(this->dataPtr->simTime);
+  this->dataPtr->engine.UpdateScoreFiles(this->dataPtr->simTime);
 }
 
 //////////////////////////////////////////////////
-void GameLogicPluginPrivate::OnBatteryMsg(
-    const ignition::msgs::BatteryState &_msg,
-    const transport::MessageInfo &_info)
+void GameLogicPluginPrivate::ProcessGameEvents()
 {
-  ignition::msgs::Time localSimTime(this->simTime);
-  if (_msg.percentage() <= 0)
+  const uint64_t dropped = this->gameEvents.TakeDropped();
+  if (dropped > 0u)
   {
-    std::vector<std::string> topicParts = common::split(_info.Topic(), "/");
-    std::string name = "_unknown_";
-
-    // Get the name of the model from the topic name, where the topic name
-    // look like '/model/{model_name}/detach'.
-    if (topicParts.size() > 1)
-      name = topicParts[1];
-
-    // Make sure the event is logged once.
-    if (this->deadBatteries.find(name) == this->deadBatteries.end())
-    {
-      this->deadBatteries.emplace(name);
-      {
-        std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-        std::ostringstream stream;
-        stream
-          << "- event:\n"
-          << "  id: " << this->eventCounter << "\n"
-          << "  type: dead_battery\n"
-          << "  time_sec: " << localSimTime.sec() << "\n"
-          << "  robot: " << name << std::endl;
-
-        this->LogEvent(stream.str());
-        this->PublishRobotEvent(localSimTime, "dead_battery", name,
-            this->eventCounter);
-        this->eventCounter++;
-      }
-    }
+    ignwarn << "Dropped [" << dropped << "] game events, the event queue "
+      << "was full." << std::endl;
   }
-}
-
-//////////////////////////////////////////////////
-void GameLogicPluginPrivate::OnBreadcrumbDeployEvent(
-    const ignition::msgs::Empty &/*_msg*/,
-    const transport::MessageInfo &_info)
-{
-  ignition::msgs::Time localSimTime(this->simTime);
-  std::vector<std::string> topicParts = common::split(_info.Topic(), "/");
-  std::string name = "_unknown_";
-
-  // Get the name of the model from the topic name, where the topic name
-  // look like '/model/{model_name}/deploy'.
-  if (topicParts.size() > 1)
-    name = topicParts[1];
 
+  GameEvent event;
+  while (this->gameEvents.Pop(event))
   {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter << "\n"
-      << "  type: breadcrumb_deploy\n"
-      << "  time_sec: " << localSimTime.sec() << "\n"
-      << "  robot: " << name << std::endl;
-
-    this->LogEvent(stream.str());
-
-    // Only publish if max breadcrumbs has not been reached.
-    if (this->breadcrumbsMax.find(name) == this->breadcrumbsMax.end() ||
-        this->breadcrumbsMax[name] <= 0)
+    const std::string &model = this->gameEvents.ModelName(event.model);
+    switch (event.type)
     {
-      this->PublishRobotEvent(localSimTime, "breadcrumb_deploy", name,
-          this->eventCounter);
+      case GameEvent::DETACH:
+        this->engine.RobotEvent(this->simTime, "detach", model);
+        break;
+      case GameEvent::BREADCRUMB_DEPLOY:
+        this->engine.BreadcrumbDeploy(this->simTime, model);
+        break;
+      case GameEvent::BREADCRUMB_REMAINING:
+        this->engine.BreadcrumbDeployRemaining(this->simTime, model,
+            static_cast<int>(event.value));
+        break;
+      case GameEvent::BATTERY_DEPLETED:
+        this->engine.BatteryState(this->simTime, model, event.value);
+        break;
+      case GameEvent::ROCK_FALL_REMAINING:
+        this->engine.RockFallRemaining(this->simTime, model,
+            static_cast<int>(event.value));
+        break;
+      case GameEvent::DYNAMIC_COLLAPSE:
+        this->engine.DynamicCollapse(this->simTime, model);
+        break;
     }
-    this->eventCounter++;
   }
 }
 
 //////////////////////////////////////////////////
-void GameLogicPluginPrivate::OnBreadcrumbDeployRemainingEvent(
-    const ignition::msgs::Int32 &_msg,
-    const transport::MessageInfo &_info)
+void GameLogicPluginPrivate::RegisterRobot(
+    const gazebo::Entity &_sensorParent,
+    const gazebo::EntityComponentManager &_ecm)
 {
-  ignition::msgs::Time localSimTime(this->simTime);
-  if (_msg.data() == 0)
-  {
-    std::vector<std::string> topicParts = common::split(_info.Topic(), "/");
-    std::string name = "_unknown_";
+  // Get the model. We are assuming that a sensor is attached to
+  // a link.
+  auto model = _ecm.Component<gazebo::components::ParentEntity>(
+      _sensorParent);
+  if (!model || this->robots.slots.count(model->Data()))
+    return;
 
-    // Get the name of the model from the topic name, where the topic name
-    // look like '/model/{model_name}/deploy'.
-    if (topicParts.size() > 1)
-      name = topicParts[1];
+  // Get the model name
+  auto mName = _ecm.Component<gazebo::components::Name>(model->Data());
+  if (!mName)
+    return;
+  const std::string &name = mName->Data();
+
+  const std::size_t statsIndex = this->engine.RobotIndex(name);
+  this->robots.slots[model->Data()] = this->robots.models.size();
+  this->robots.models.push_back(model->Data());
+  this->robots.names.push_back(name);
+  this->robots.statsIndices.push_back(statsIndex);
+  if (this->robots.poses.valid.size() <= statsIndex)
+    this->robots.poses.Resize(statsIndex + 1);
+
+  // The names of the robots are only captured until the team triggers the
+  // start signal.
+  if (!this->engine.Started() && this->engine.AddRobot(name))
+  {
+    auto filePath =
+      _ecm.Component<gazebo::components::SourceFilePath>(
+      model->Data());
 
-    if (this->breadcrumbsMax[name] > 0)
+    // Store unique robot platform information.
+    for (const std::pair<std::string, double> &typeKE :
+        robotPlatformTypes)
     {
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter++ << "\n"
-        << "  type: max_breadcrumb_deploy\n"
-        << "  time_sec: " << localSimTime.sec() << "\n"
-        << "  robot: " << name << std::endl;
-
-      this->LogEvent(stream.str());
-      // Do not publish if max breadcrumbs have already been deployed
-      // if (this->breadcrumbsMax[name] == 1)
-      //  this->PublishRobotEvent(localSimTime, "max_breadcrumb_deploy", name);
+      std::string platformNameUpper = filePath->Data();
+      std::transform(platformNameUpper.begin(),
+          platformNameUpper.end(),
+          platformNameUpper.begin(), ::toupper);
+      if (platformNameUpper.find(typeKE.first) != std::string::npos)
+      {
+        // The full type is in the directory name, which is third
+        // from the end (.../TYPE/VERSION/model.sdf).
+        std::vector<std::string> pathParts =
+          ignition::common::split(platformNameUpper, "/");
+        this->engine.SetRobotType(name,
+            typeKE.first, pathParts[pathParts.size()-3]);
+      }
     }
 
-    this->breadcrumbsMax[name]++;
+    // Subscribe to the detach, breadcrumb and battery topics of the
+    // plugins the robot declares.
+    auto modelSdf =
+      _ecm.Component<gazebo::components::ModelSdf>(model->Data());
+    this->gameEvents.AddRobot(name,
+        modelSdf ? modelSdf->Data().Element() : nullptr);
   }
-}
 
-//////////////////////////////////////////////////
-void GameLogicPluginPrivate::OnDynamicCollapseDeployRemainingEvent(
-    const ignition::msgs::Int32 &/*_msg*/,
-    const transport::MessageInfo &_info)
-{
-  ignition::msgs::Time localSimTime(this->simTime);
-  std::vector<std::string> topicParts = common::split(_info.Topic(), "/");
-  std::string name = "_unknown_";
-
-  // Get the name of the model from the topic name, where the topic name
-  // look like '/model/{model_name}/deploy'.
-  if (topicParts.size() > 1)
-    name = topicParts[1];
-
-  if (!this->dynamicCollapseMax[name])
+  if (this->rosnode)
   {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter << "\n"
-      << "  type: dynamic_collapse\n"
-      << "  time_sec: " << localSimTime.sec() << "\n"
-      << "  model: " << name << std::endl;
-
-    this->LogEvent(stream.str());
-    this->PublishRegionEvent(localSimTime, "dynamic_collapse", "", name,
-        "dynamic_collapse", this->eventCounter);
-    this->eventCounter++;
-    this->dynamicCollapseMax[name] = true;
+    this->rosRobotPosePubs[name] =
+      this->rosnode->advertise<geometry_msgs::PoseStamped>(
+          "poses/" + name, 1000);
+    this->rosRobotKinematicPubs[name] =
+      this->rosnode->advertise<subt_ros::KinematicStates>(
+          "kinematic_states/" + name, 1000);
   }
 }
 
 //////////////////////////////////////////////////
-void GameLogicPluginPrivate::OnRockFallDeployRemainingEvent(
-    const ignition::msgs::Int32 &_msg,
-    const transport::MessageInfo &_info)
+void GameLogicPluginPrivate::UpdateRobots(
+    const gazebo::EntityComponentManager &_ecm)
 {
-  ignition::msgs::Time localSimTime(this->simTime);
-  std::vector<std::string> topicParts = common::split(_info.Topic(), "/");
-  std::string name = "_unknown_";
-
-  // Get the name of the model from the topic name, where the topic name
-  // look like '/model/{model_name}/deploy'.
-  if (topicParts.size() > 1)
-    name = topicParts[1];
-
-  if (_msg.data() == 0)
+  auto registerRobot = [&](const gazebo::Entity &,
+      const gazebo::components::Sensor *,
+      const gazebo::components::ParentEntity *_parent) -> bool
   {
-    // Sim time is used to make sure that we report only once per rock fall,
-    // and not once for every rock in the rock fall.
-    if (this->rockFallsMax[name].first != localSimTime.sec())
-    {
-      if (this->rockFallsMax[name].second == 1)
-      {
-        std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-        std::ostringstream stream;
-        stream
-          << "- event:\n"
-          << "  id: " << this->eventCounter++ << "\n"
-          << "  type: max_rock_falls\n"
-          << "  time_sec: " << localSimTime.sec() << "\n"
-          << "  model: " << name << std::endl;
-
-        this->LogEvent(stream.str());
-
-        // Don't publish this event.
-        // this->PublishRegionEvent(localSimTime, "max_rock_falls", "n/a", name,
-        //   "max_rock_falls");
-      }
-      else if (this->rockFallsMax[name].second == 0)
-      {
-        std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-        std::ostringstream stream;
-        stream
-          << "- event:\n"
-          << "  id: " << this->eventCounter << "\n"
-          << "  type: rock_fall\n"
-          << "  time_sec: " << localSimTime.sec() << "\n"
-          << "  model: " << name << std::endl;
-
-        this->LogEvent(stream.str());
-        this->PublishRegionEvent(localSimTime, "rock_fall", "", name,
-            "rock_fall", this->eventCounter);
-        this->eventCounter++;
-      }
+    this->RegisterRobot(_parent->Data(), _ecm);
+    return true;
+  };
 
-      this->rockFallsMax[name].second++;
-      this->rockFallsMax[name].first = localSimTime.sec();
-    }
+  // Visit all sensors once, then only the new ones.
+  if (!this->robots.initialized)
+  {
+    _ecm.Each<gazebo::components::Sensor,
+              gazebo::components::ParentEntity>(registerRobot);
+    this->robots.initialized = true;
   }
-  // Sim time is used to make sure that we report only once per rock fall,
-  // and not once for every rock in the rock fall.
-  else if (this->rockFallsMax[name].first != localSimTime.sec())
+  else
   {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter << "\n"
-      << "  type: rock_fall\n"
-      << "  time_sec: " << localSimTime.sec() << "\n"
-      << "  model: " << name << std::endl;
-
-    this->LogEvent(stream.str());
-    this->PublishRegionEvent(localSimTime, "rock_fall", "", name, "rock_fall",
-        this->eventCounter);
-    this->eventCounter++;
-    this->rockFallsMax[name].first = localSimTime.sec();
+    _ecm.EachNew<gazebo::components::Sensor,
+                 gazebo::components::ParentEntity>(registerRobot);
   }
-}
 
-//////////////////////////////////////////////////
-void GameLogicPluginPrivate::OnDetachEvent(
-    const ignition::msgs::Empty &/*_msg*/,
-    const transport::MessageInfo &_info)
-{
-  ignition::msgs::Time localSimTime(this->simTime);
-  std::vector<std::string> topicParts = common::split(_info.Topic(), "/");
-  std::string name = "_unknown_";
-
-  // Get the name of the model from the topic name, where the topic name
-  // look like '/model/{model_name}/detach'.
-  if (topicParts.size() > 1)
-    name = topicParts[1];
+  _ecm.EachRemoved<gazebo::components::Model>(
+      [&](const gazebo::Entity &_entity,
+          const gazebo::components::Model *) -> bool
+      {
+        auto slot = this->robots.slots.find(_entity);
+        if (slot != this->robots.slots.end())
+        {
+          this->robots.models[slot->second] = gazebo::kNullEntity;
+          this->robots.poses.valid[
+            this->robots.statsIndices[slot->second]] = 0u;
+          this->robots.slots.erase(slot);
+        }
+        return true;
+      });
 
+  for (std::size_t i = 0; i < this->robots.models.size(); ++i)
   {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter << "\n"
-      << "  type: detach\n"
-      << "  time_sec: " << localSimTime.sec() << "\n"
-      << "  robot: " << name << std::endl;
-
-    this->LogEvent(stream.str());
-    this->PublishRobotEvent(localSimTime, "detach", name, this->eventCounter);
-    this->eventCounter++;
+    if (this->robots.models[i] == gazebo::kNullEntity)
+      continue;
+
+    // robot pose.
+    auto poseComp =
+      _ecm.Component<gazebo::components::Pose>(this->robots.models[i]);
+    if (poseComp)
+      this->robots.poses.Set(this->robots.statsIndices[i], poseComp->Data());
+    else
+      this->robots.poses.valid[this->robots.statsIndices[i]] = 0u;
   }
 }
 
@@ -1049,55 +1169,15 @@ void GameLogicPluginPrivate::OnEvent(const ignition::msgs::Pose &_msg)
     }
   }
 
-  {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    // Default to detect
-    std::string regionEventType;
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter << "\n"
-      << "  type: detect\n"
-      << "  time_sec: " << _msg.header().stamp().sec() << "\n"
-      << "  detector: " << frameId << "\n"
-      << "  robot: " << _msg.name() << "\n"
-      << "  state: " << state << std::endl;
-    if (!extraData.empty())
-    {
-      stream << "  extra:\n";
-      for (const auto &data : extraData)
-      {
-        // there should be only 1 key-value pair. Just in case, we will grab
-        // only the first. The key is currently always "type", which we can
-        // ignore when sending the ROS message.
-        if (regionEventType.empty())
-        {
-          if (data.second.find("performer_detector_rockfall") ==
-              std::string::npos)
-          {
-            regionEventType = data.second;
-          }
-        }
-
-        stream << "    "
-          << data.first << ": " << data.second << std::endl;
-      }
-    }
-    // Default to "detect" if not set.
-    if (regionEventType.empty())
-      regionEventType = "detect";
-    this->LogEvent(stream.str());
-    this->PublishRegionEvent(localSimTime,
-        regionEventType, _msg.name(), frameId, state, this->eventCounter);
-    this->eventCounter++;
-  }
+  this->engine.DetectorEvent(localSimTime, _msg.header().stamp().sec(),
+      frameId, _msg.name(), state, extraData);
 }
 
 //////////////////////////////////////////////////
 void GameLogicPlugin::PreUpdate(const UpdateInfo &_info,
     EntityComponentManager &_ecm)
 {
-  if (!this->dataPtr->started)
+  if (!this->dataPtr->engine.Started())
   {
     _ecm.Each<gazebo::components::Sensor,
                  gazebo::components::ParentEntity>(
@@ -1222,7 +1302,7 @@ void GameLogicPlugin::PreUpdate(const UpdateInfo &_info,
 
         // Apply KE factor.
         deltaKE *= robotPlatformTypes.at(
-          this->dataPtr->robotFullTypes[ke.second.robotName].first);
+          this->dataPtr->engine.RobotPlatform(ke.second.robotName));
         ke.second.prevKineticEnergy = currKineticEnergy;
 
         // Crash if past the threshold.
@@ -1236,19 +1316,8 @@ void GameLogicPlugin::PreUpdate(const UpdateInfo &_info,
           localSimTime.set_sec(sec);
           localSimTime.set_nsec(nsec);
 
-          std::lock_guard<std::mutex> lock(this->dataPtr->eventCounterMutex);
-          std::ostringstream stream;
-          stream
-            << "- event:\n"
-            << "  id: " << this->dataPtr->eventCounter << "\n"
-            << "  type: collision\n"
-            << "  time_sec: " << localSimTime.sec() << "\n"
-            << "  robot: " << ke.second.robotName << std::endl;
-          this->dataPtr->LogEvent(stream.str());
-          this->dataPtr->PublishRobotEvent(
-              localSimTime, "collision", ke.second.robotName,
-              this->dataPtr->eventCounter);
-          this->dataPtr->eventCounter++;
+          this->dataPtr->engine.RobotEvent(localSimTime, "collision",
+              ke.second.robotName);
 
           auto *haltMotionComp =
             _ecm.Component<components::HaltMotion>(ke.first);
@@ -1274,9 +1343,15 @@ void GameLogicPlugin::PostUpdate(
   this->dataPtr->simTime.set_sec(s);
   this->dataPtr->simTime.set_nsec(ns);
 
-  // Capture the names of the robots. We only do this until the team
-  // triggers the start signal.
-  if (!this->dataPtr->started)
+  // Handle the events received since the last update.
+  this->dataPtr->ProcessGameEvents();
+
+  // Register new robots and read their poses.
+  this->dataPtr->UpdateRobots(_ecm);
+
+  // Capture the marsupial pairs. We only do this until the team triggers
+  // the start signal.
+  if (!this->dataPtr->engine.Started())
   {
     // Get an iterator to the base station's pose.
     std::map<std::string, ignition::math::Pose3d>::iterator baseIter =
@@ -1302,476 +1377,107 @@ void GameLogicPlugin::PostUpdate(
             auto parentName = _ecm.Component<gazebo::components::Name>(
                 parentModel->Data());
 
-            auto childName = _ecm.Component<gazebo::components::Name>(
-                childModel->Data());
-            this->dataPtr->marsupialPairs[parentName->Data()] =
-              childName->Data();
-          }
-          return true;
-        });
-
-    _ecm.Each<gazebo::components::Sensor,
-              gazebo::components::ParentEntity>(
-        [&](const gazebo::Entity &,
-            const gazebo::components::Sensor *,
-            const gazebo::components::ParentEntity *_parent) -> bool
-        {
-          // Get the model. We are assuming that a sensor is attached to
-          // a link.
-          auto model = _ecm.Component<gazebo::components::ParentEntity>(
-              _parent->Data());
-
-          if (model)
-          {
-            // Check if the robot has moved into the tunnel. In this case,
-            // we need to trigger the /subt/start.
-            if (!this->dataPtr->started && baseIter !=
-                this->dataPtr->poses.end())
-            {
-              auto mPose =
-                _ecm.Component<gazebo::components::Pose>(model->Data());
-              // Execute the start logic if a robot has moved into the tunnel.
-              if (mPose &&
-                  baseIter->second.Pos().Distance(mPose->Data().Pos()) >
-                  this->dataPtr->allowedDistanceFromBase)
-              {
-                ignition::msgs::Boolean req, res;
-                req.set_data(true);
-                this->dataPtr->OnStartCall(req, res);
-              }
-            }
-
-            // Get the model name
-            auto mName =
-              _ecm.Component<gazebo::components::Name>(model->Data());
-            if (this->dataPtr->robotNames.find(mName->Data()) ==
-                this->dataPtr->robotNames.end())
-            {
-              this->dataPtr->robotNames.insert(mName->Data());
-
-              auto filePath =
-                _ecm.Component<gazebo::components::SourceFilePath>(
-                model->Data());
-
-              // Store unique robot platform information.
-              for (const std::pair<std::string, double> &typeKE :
-                  robotPlatformTypes)
-              {
-                std::string platformNameUpper = filePath->Data();
-                std::transform(platformNameUpper.begin(),
-                    platformNameUpper.end(),
-                    platformNameUpper.begin(), ::toupper);
-                if (platformNameUpper.find(typeKE.first) != std::string::npos)
-                {
-                  this->dataPtr->robotTypes.insert(typeKE.first);
-
-                  // The full type is in the directory name, which is third
-                  // from the end (.../TYPE/VERSION/model.sdf).
-                  std::vector<std::string> pathParts =
-                    ignition::common::split(platformNameUpper, "/");
-                  this->dataPtr->robotFullTypes[mName->Data()] =
-                    {typeKE.first, pathParts[pathParts.size()-3]};
-                }
-              }
-
-              // Subscribe to detach topics. We are doing a blanket
-              // subscribe even though a robot model may not be marsupial.
-              // This is fine since non-marsupial vehicles won't create the
-              // publisher, and no extra logic is required here.
-              std::string detachTopic = std::string("/model/") +
-                mName->Data() + "/detach";
-              this->dataPtr->node.Subscribe(detachTopic,
-                  &GameLogicPluginPrivate::OnDetachEvent, this->dataPtr.get());
-
-              // Subscribe to breadcrumb deploy topics. We are doing a blanket
-              // subscribe even though a robot model may not have
-              // breadcrumbs.
-              std::string deployTopic = std::string("/model/") +
-                mName->Data() + "/breadcrumb/deploy";
-              this->dataPtr->node.Subscribe(deployTopic,
-                  &GameLogicPluginPrivate::OnBreadcrumbDeployEvent,
-                  this->dataPtr.get());
-
-              std::string deployRemainingTopic = std::string("/model/") +
-                mName->Data() + "/breadcrumb/deploy/remaining";
-              this->dataPtr->node.Subscribe(deployRemainingTopic,
-                  &GameLogicPluginPrivate::OnBreadcrumbDeployRemainingEvent,
-                  this->dataPtr.get());
-
-              // Subscribe to battery state in order to log battery events.
-              std::string batteryTopic = std::string("/model/") +
-                mName->Data() + "/battery/linear_battery/state";
-              this->dataPtr->node.Subscribe(batteryTopic,
-                  &GameLogicPluginPrivate::OnBatteryMsg, this->dataPtr.get());
-            }
-          }
-          return true;
-        });
-
-    // Start automatically if warmup time has elapsed.
-    if (this->dataPtr->simTime.sec() >= this->dataPtr->warmupTimeSec)
-    {
-      this->dataPtr->Start(this->dataPtr->simTime);
-    }
-  }
-
-  // Update pose information
-  _ecm.Each<gazebo::components::Model,
-            gazebo::components::Name,
-            gazebo::components::Pose,
-            gazebo::components::Static>(
-      [&](const gazebo::Entity &,
-          const gazebo::components::Model *,
-          const gazebo::components::Name *_nameComp,
-          const gazebo::components::Pose *_poseComp,
-          const gazebo::components::Static *) -> bool
-      {
-        // Subscribe to remaining rock fall deploy topics. We are doing a
-        // blanket subscribe even though a model in this function may not be
-        // a rock fall.
-        if (this->dataPtr->rockFallsMax.find(_nameComp->Data()) ==
-            this->dataPtr->rockFallsMax.end())
-        {
-          std::string deployRemainingTopic = std::string("/model/") +
-                  _nameComp->Data() + "/breadcrumbs/Rock/deploy/remaining";
-          this->dataPtr->rockFallsMax[_nameComp->Data()] = {0, 0};
-          this->dataPtr->node.Subscribe(deployRemainingTopic,
-              &GameLogicPluginPrivate::OnRockFallDeployRemainingEvent,
-              this->dataPtr.get());
-        }
-
-        // Subscribe to remaining dynamic collapse deploy topics. We are doing a
-        // blanket subscribe even though a model in this function may not be
-        // a dynamic collapse.
-        if (this->dataPtr->dynamicCollapseMax.find(_nameComp->Data()) ==
-            this->dataPtr->dynamicCollapseMax.end())
-        {
-          std::string deployRemainingTopic = std::string("/model/") +
-                  _nameComp->Data() + "/breadcrumbs/Wall/deploy/remaining";
-          this->dataPtr->dynamicCollapseMax[_nameComp->Data()] = false;
-          this->dataPtr->node.Subscribe(deployRemainingTopic,
-              &GameLogicPluginPrivate::OnDynamicCollapseDeployRemainingEvent,
-              this->dataPtr.get());
-        }
-
-        {
-          std::lock_guard<std::mutex> lock(this->dataPtr->posesMutex);
-          this->dataPtr->poses[_nameComp->Data()] = _poseComp->Data();
-        }
-
-        // Iterate over possible artifact names
-        for (size_t kArtifactNamesIdx = 0;
-             kArtifactNamesIdx < kArtifactNames.size();
-             ++kArtifactNamesIdx)
-        {
-          // If the name of the model is a possible artifact, then add it to
-          // our list of artifacts.
-          if (_nameComp->Data().find(
-                kArtifactNames[kArtifactNamesIdx].first) == 0)
-          {
-            bool add = true;
-            // Check to make sure the artifact has not already been added.
-            for (const std::pair<std::string, ignition::math::Pose3d>
-                &artifactPair : this->dataPtr->artifacts[
-                kArtifactNames[kArtifactNamesIdx].second])
-            {
-              if (artifactPair.first == _nameComp->Data())
-              {
-                add = false;
-                break;
-              }
-            }
-
-            if (add)
-            {
-              ignmsg << "Adding artifact name[" << _nameComp->Data()
-                << "] type string["
-                << kArtifactTypes[kArtifactNamesIdx].second
-                << "] typeid["
-                << static_cast<int>(
-                    kArtifactNames[kArtifactNamesIdx].second)
-                << "]\n";
-
-              this->dataPtr->artifacts[
-                kArtifactNames[
-                  kArtifactNamesIdx].second][_nameComp->Data()] =
-                    ignition::math::Pose3d(ignition::math::INF_D,
-                        ignition::math::INF_D, ignition::math::INF_D, 0, 0, 0);
-
-              // Helper variable that is the total number of artifacts.
-              this->dataPtr->artifactCount++;
-            }
-          }
-        }
-
-        for (std::pair<const subt::ArtifactType,
-            std::map<std::string, ignition::math::Pose3d>> &artifactPair :
-            this->dataPtr->artifacts)
-        {
-          for (std::pair<const std::string, ignition::math::Pose3d> &artifact :
-              artifactPair.second)
-          {
-            if (artifact.first == _nameComp->Data())
-            {
-              // Get a rotation matrix for the artifact
-              ignition::math::Matrix3d mat(_poseComp->Data().Rot());
-
-              // Compute the localization point
-              ignition::math::Vector3d localizationPoint =
-                _poseComp->Data().Pos() +
-                mat * this->dataPtr->artifactOffsets[artifactPair.first];
-
-              // Store the final localization point.
-              artifact.second.Pos() = localizationPoint;
-              break;
-            }
-          }
-        }
-
-        return true;
-      });
-
-    // log robot pose and vel data
-    _ecm.Each<gazebo::components::Sensor,
-              gazebo::components::ParentEntity>(
-        [&](const gazebo::Entity &,
-            const gazebo::components::Sensor *,
-            const gazebo::components::ParentEntity *_parent) -> bool
-        {
-          // Get the model. We are assuming that a sensor is attached to
-          // a link.
-          auto model = _ecm.Component<gazebo::components::ParentEntity>(
-              _parent->Data());
-
-          if (!model)
-            return true;
-
-          // robot pose.
-          auto poseComp =
-              _ecm.Component<gazebo::components::Pose>(model->Data());
-          if (!poseComp)
-            return true;
-          math::Pose3d pose = poseComp->Data();
-
-          // robot name
-          auto nameComp =
-              _ecm.Component<gazebo::components::Name>(model->Data());
-          if (!nameComp)
-            return true;
-          std::string name = nameComp->Data();
-
-          // sim time
-          double t = s + static_cast<double>(ns)*1e-9;
-          auto tDur =
-              std::chrono::duration_cast<std::chrono::steady_clock::duration>
-              (std::chrono::seconds(s) + std::chrono::nanoseconds(ns));
-
-          // store robot pose and velocity data only if robot has traveled
-          // more than 1 meter
-          auto robotPoseDataIt = this->dataPtr->robotPoseData.find(name);
-          if (robotPoseDataIt == this->dataPtr->robotPoseData.end())
-          {
-            this->dataPtr->robotPoseData[name].push_back(
-                std::make_pair(tDur, pose));
-
-            this->dataPtr->robotStartPose[name] = pose;
-            this->dataPtr->robotDistance[name] = 0.0;
-            this->dataPtr->robotMaxEuclideanDistance[name] = 0.0;
-            this->dataPtr->robotAvgVel[name] = 0.0;
-            this->dataPtr->robotElevationGain[name] = 0.0;
-            this->dataPtr->robotElevationLoss[name] = 0.0;
-
-            if (this->dataPtr->rosnode)
-            {
-              this->dataPtr->rosRobotPosePubs[name] =
-                this->dataPtr->rosnode->advertise<geometry_msgs::PoseStamped>(
-                    "poses/" + name, 1000);
-              this->dataPtr->rosRobotKinematicPubs[name] =
-                this->dataPtr->rosnode->advertise<subt_ros::KinematicStates>(
-                    "kinematic_states/" + name, 1000);
-            }
-
-            this->dataPtr->robotPrevPose[name] = pose;
-            return true;
-          }
-          // Send robot pose information if the robot has traveled more then
-          // 1m or 1second of simulation time has elapsed.
-          else if (!robotPoseDataIt->second.empty() &&
-              (robotPoseDataIt->second.back().second.Pos().Distance(
-                pose.Pos()) > 1.0 ||
-               t - robotPoseDataIt->second.back().first.count() * 1e-9 > 1.0))
-          {
-            //  time passed since last pose sample
-            double prevT = robotPoseDataIt->second.back().first.count() * 1e-9;
-            double dt = t - prevT;
-
-            // sim paused?
-            if (dt <= 0)
-              return true;
-            geometry_msgs::PoseStamped msg;
-            msg.header.stamp.sec = this->dataPtr->simTime.sec();
-            msg.header.stamp.nsec = this->dataPtr->simTime.nsec();
-            msg.header.frame_id = "artifact_origin";
-            ignition::math::Pose3d p = this->dataPtr->ConvertToArtifactOrigin(
-                pose);
-            msg.pose.position.x = p.Pos().X();
-            msg.pose.position.y = p.Pos().Y();
-            msg.pose.position.z = p.Pos().Z();
-            msg.pose.orientation.x = p.Rot().X();
-            msg.pose.orientation.y = p.Rot().Y();
-            msg.pose.orientation.z = p.Rot().Z();
-            msg.pose.orientation.w = p.Rot().W();
-
-            if (this->dataPtr->rosnode)
-              this->dataPtr->rosRobotPosePubs[name].publish(msg);
-
-            // calculate robot velocity and speed
-            math::Vector3d p1 = p.Pos();
-            math::Vector3d p2 = this->dataPtr->ConvertToArtifactOrigin(
-                robotPoseDataIt->second.back().second).Pos();
-            double dx = p1.X() - p2.X();
-            double dy = p1.Y() - p2.Y();
-            double dz = p1.Z() - p2.Z();
-            double dist = sqrt(std::pow(dx, 2) + std::pow(dy, 2) +
-                std::pow(dz, 2));
-            double vel = dist / dt;
-
-            // publish the pose, velocity, and speed
-            subt_ros::KinematicStates kmsg;
-            kmsg.header.stamp.sec = this->dataPtr->simTime.sec();
-            kmsg.header.stamp.nsec = this->dataPtr->simTime.nsec();
-            kmsg.header.frame_id = "artifact_origin";
-            kmsg.pose.position.x = p.Pos().X();
-            kmsg.pose.position.y = p.Pos().Y();
-            kmsg.pose.position.z = p.Pos().Z();
-            kmsg.pose.orientation.x = p.Rot().X();
-            kmsg.pose.orientation.y = p.Rot().Y();
-            kmsg.pose.orientation.z = p.Rot().Z();
-            kmsg.pose.orientation.w = p.Rot().W();
-            kmsg.velocity.x = dx / dt;
-            kmsg.velocity.y = dy / dt;
-            kmsg.velocity.z = dz / dt;
-            kmsg.speed = vel;
-
-            if (this->dataPtr->rosnode)
-              this->dataPtr->rosRobotKinematicPubs[name].publish(kmsg);
-
-            // greatest max velocity by a robot
-            if (vel > this->dataPtr->maxRobotVel.second)
-            {
-              this->dataPtr->maxRobotVel.first = name;
-              this->dataPtr->maxRobotVel.second = vel;
-            }
-
-            // avg vel for this robot
-            size_t velCount = robotPoseDataIt->second.size();
-            double avgVel =
-                (this->dataPtr->robotAvgVel[name] * velCount + vel) /
-                (velCount + 1);
-            this->dataPtr->robotAvgVel[name] = avgVel;
-
-            // greatest avg vel by a robot
-            if (avgVel > this->dataPtr->maxRobotAvgVel.second)
-            {
-              this->dataPtr->maxRobotAvgVel.first = name;
-              this->dataPtr->maxRobotAvgVel.second = avgVel;
-            }
-
-            robotPoseDataIt->second.push_back(std::make_pair(tDur, pose));
-
-            // compute and log greatest / total distance traveled and
-            // elevation changes
-
-            // distance traveled by this robot
-            double distanceDiff =
-                this->dataPtr->robotPrevPose[name].Pos().Distance(pose.Pos());
-            double distanceTraveled = this->dataPtr->robotDistance[name] +
-                distanceDiff;
-            this->dataPtr->robotDistance[name] = distanceTraveled;
-
-            // greatest distance traveled by a robot
-            if (distanceTraveled > this->dataPtr->maxRobotDistance.second)
-            {
-              this->dataPtr->maxRobotDistance.first = name;
-              this->dataPtr->maxRobotDistance.second = distanceTraveled;
-            }
-
-            // max euclidean from starting pose for this robot
-            double euclideanDist =
-                pose.Pos().Distance(this->dataPtr->robotStartPose[name].Pos());
-            if (euclideanDist > this->dataPtr->robotMaxEuclideanDistance[name])
-                this->dataPtr->robotMaxEuclideanDistance[name] = euclideanDist;
+            auto childName = _ecm.Component<gazebo::components::Name>(
+                childModel->Data());
+            this->dataPtr->engine.SetMarsupialPair(parentName->Data(),
+                childName->Data());
+          }
+          return true;
+        });
 
-            // greatest euclidean distance traveled by a robot
-            if (euclideanDist > this->dataPtr->maxRobotEuclideanDistance.second)
-            {
-              this->dataPtr->maxRobotEuclideanDistance.first = name;
-              this->dataPtr->maxRobotEuclideanDistance.second = euclideanDist;
-            }
+    // Check if a robot has moved into the tunnel. In this case, we need to
+    // trigger the /subt/start.
+    if (baseIter != this->dataPtr->poses.end())
+    {
+      const RobotPoses &poses = this->dataPtr->robots.poses;
+      const math::Vector3d &base = baseIter->second.Pos();
+      const double limit2 = this->dataPtr->allowedDistanceFromBase *
+        this->dataPtr->allowedDistanceFromBase;
+      uint8_t moved = 0u;
+      for (std::size_t i = 0; i < poses.valid.size(); ++i)
+      {
+        const double dx = poses.x[i] - base.X();
+        const double dy = poses.y[i] - base.Y();
+        const double dz = poses.z[i] - base.Z();
+        moved |= poses.valid[i] & (dx * dx + dy * dy + dz * dz > limit2);
+      }
 
-            // total distance traveled by all robots
-            this->dataPtr->robotsTotalDistance += distanceDiff;
+      // Execute the start logic if a robot has moved into the tunnel.
+      if (moved)
+      {
+        ignition::msgs::Boolean req, res;
+        req.set_data(true);
+        this->dataPtr->OnStartCall(req, res);
+      }
+    }
 
-            // greatest elevation gain / loss
-            // Elevations are rounded down to nearest mulitple of the elevation
-            // step size
-            double elevationDiff = this->dataPtr->FloorMultiple(
-                 pose.Pos().Z(), this->dataPtr->elevationStepSize) -
-                 this->dataPtr->FloorMultiple(
-                 this->dataPtr->robotPrevPose[name].Pos().Z(),
-                 this->dataPtr->elevationStepSize);
+    // Start automatically if warmup time has elapsed.
+    if (this->dataPtr->simTime.sec() >= this->dataPtr->warmupTimeSec)
+    {
+      this->dataPtr->Start(this->dataPtr->simTime);
+    }
+  }
 
-            if (elevationDiff > 0)
-            {
-              double elevationGain = this->dataPtr->robotElevationGain[name]
-                  + elevationDiff;
-              this->dataPtr->robotElevationGain[name] = elevationGain;
-              if (elevationGain > this->dataPtr->maxRobotElevationGain.second)
-              {
-                this->dataPtr->maxRobotElevationGain.first = name;
-                this->dataPtr->maxRobotElevationGain.second = elevationGain;
-              }
-              // total elevation gain by all robots
-              this->dataPtr->robotsTotalElevationGain += elevationDiff;
-            }
-            else
-            {
-              double elevationLoss = this->dataPtr->robotElevationLoss[name]
-                  + elevationDiff;
-              this->dataPtr->robotElevationLoss[name] = elevationLoss;
-              if (elevationLoss < this->dataPtr->maxRobotElevationLoss.second)
-              {
-                this->dataPtr->maxRobotElevationLoss.first = name;
-                this->dataPtr->maxRobotElevationLoss.second = elevationLoss;
-              }
-              // total elevation loss by all robots
-              this->dataPtr->robotsTotalElevationLoss += elevationDiff;
-            }
+  // Update pose information
+  _ecm.Each<gazebo::components::Model,
+            gazebo::components::Name,
+            gazebo::components::Pose,
+            gazebo::components::Static>(
+      [&](const gazebo::Entity &_entity,
+          const gazebo::components::Model *,
+          const gazebo::components::Name *_nameComp,
+          const gazebo::components::Pose *_poseComp,
+          const gazebo::components::Static *) -> bool
+      {
+        if (this->dataPtr->staticModels.insert(_nameComp->Data()).second)
+        {
+          // Subscribe to the rock fall and dynamic collapse topics of the
+          // model, if it has any.
+          auto modelSdf =
+            _ecm.Component<gazebo::components::ModelSdf>(_entity);
+          this->dataPtr->gameEvents.AddStaticModel(_nameComp->Data(),
+              modelSdf ? modelSdf->Data().Element() : nullptr);
+        }
 
-            // min / max elevation reached
-            double elevation = this->dataPtr->FloorMultiple(pose.Pos().Z(),
-                this->dataPtr->elevationStepSize);
-            if (elevation > this->dataPtr->maxRobotElevation.second ||
-                this->dataPtr->maxRobotElevation.first.empty())
-            {
-              this->dataPtr->maxRobotElevation.first = name;
-              this->dataPtr->maxRobotElevation.second = elevation;
-            }
+        {
+          std::lock_guard<std::mutex> lock(this->dataPtr->posesMutex);
+          this->dataPtr->poses[_nameComp->Data()] = _poseComp->Data();
+        }
 
-            if (elevation < this->dataPtr->minRobotElevation.second ||
-                this->dataPtr->minRobotElevation.first.empty())
+        // Iterate over possible artifact names
+        for (size_t kArtifactNamesIdx = 0;
+             kArtifactNamesIdx < kArtifactNames.size();
+             ++kArtifactNamesIdx)
+        {
+          // If the name of the model is a possible artifact, then add it to
+          // our list of artifacts and store its localization point.
+          if (_nameComp->Data().find(
+                kArtifactNames[kArtifactNamesIdx].first) == 0)
+          {
+            const ArtifactType type = kArtifactNames[kArtifactNamesIdx].second;
+            if (this->dataPtr->engine.SetArtifact(type, _nameComp->Data(),
+                  _poseComp->Data()))
             {
-              this->dataPtr->minRobotElevation.first = name;
-              this->dataPtr->minRobotElevation.second = elevation;
+              ignmsg << "Adding artifact name[" << _nameComp->Data()
+                << "] type string["
+                << kArtifactTypes[kArtifactNamesIdx].second
+                << "] typeid["
+                << static_cast<int>(type)
+                << "]\n";
             }
-            this->dataPtr->robotPrevPose[name] = pose;
           }
-          return true;
-        });
+        }
+
+        return true;
+      });
 
+  // Accumulate the distance, velocity and elevation statistics of all
+  // robots.
+  this->dataPtr->engine.UpdateRobotPoses(this->dataPtr->simTime,
+      this->dataPtr->robots.poses);
 
   // Set the artifact origin pose
-  if (this->dataPtr->artifactOriginPose == ignition::math::Pose3d::Zero)
+  if (this->dataPtr->engine.ArtifactOrigin() == ignition::math::Pose3d::Zero)
   {
     static bool errorSent = false;
 
@@ -1788,27 +1494,30 @@ void GameLogicPlugin::PostUpdate(
     }
     else
     {
-      this->dataPtr->artifactOriginPose = originIter->second;
+      this->dataPtr->engine.SetArtifactOrigin(originIter->second);
     }
   }
 
+  bool started = this->dataPtr->engine.Started();
+  bool finished = this->dataPtr->engine.Finished();
+
   // Get the start sim time in nanoseconds.
+  ignition::msgs::Time startSimTimeMsg = this->dataPtr->engine.StartSimTime();
   auto startSimTime = std::chrono::nanoseconds(
-      this->dataPtr->startSimTime.sec() * 1000000000 +
-      this->dataPtr->startSimTime.nsec());
+      startSimTimeMsg.sec() * 1000000000 + startSimTimeMsg.nsec());
 
   // Compute the elapsed competition time.
-  auto elapsedCompetitionTime = this->dataPtr->started ?
+  auto elapsedCompetitionTime = started ?
     _info.simTime - startSimTime : std::chrono::seconds(0);
 
   // Compute the remaining competition time.
-  auto remainingCompetitionTime = this->dataPtr->started &&
+  auto remainingCompetitionTime = started &&
     this->dataPtr->runDuration != std::chrono::seconds(0) ?
     this->dataPtr->runDuration - elapsedCompetitionTime :
     std::chrono::seconds(0) ;
 
   // Check if the allowed time has elapsed. If so, then mark as finished.
-  if ((this->dataPtr->started && !this->dataPtr->finished) &&
+  if ((started && !finished) &&
       this->dataPtr->runDuration != std::chrono::seconds(0) &&
       remainingCompetitionTime <= std::chrono::seconds(0))
   {
@@ -1824,14 +1533,15 @@ void GameLogicPlugin::PostUpdate(
     ignition::msgs::Header::Map *mapData =
       competitionClockMsg.mutable_header()->add_data();
     mapData->set_key("phase");
-    if (this->dataPtr->started)
+    if (this->dataPtr->engine.Started())
     {
-      mapData->add_value(this->dataPtr->finished ? "finished" : "run");
+      mapData->add_value(
+          this->dataPtr->engine.Finished() ? "finished" : "run");
       auto secondsRemaining = std::chrono::duration_cast<std::chrono::seconds>(
           remainingCompetitionTime);
       competitionClockMsg.mutable_sim()->set_sec(secondsRemaining.count());
     }
-    else if (!this->dataPtr->finished)
+    else if (!this->dataPtr->engine.Finished())
     {
       mapData->add_value("setup");
       competitionClockMsg.mutable_sim()->set_sec(
@@ -1865,15 +1575,15 @@ void GameLogicPlugin::PostUpdate(
 
     // Publish the remaining artifact reports
     ignition::msgs::Int32 limitMsg;
-    limitMsg.set_data(this->dataPtr->reportCountLimit -
-        this->dataPtr->reportCount);
+    limitMsg.set_data(this->dataPtr->engine.ReportCountLimit() -
+        this->dataPtr->engine.ReportCount());
     this->dataPtr->artifactReportPub.Publish(limitMsg);
 
     // Publish robot name and type information.
     ignition::msgs::Param_V robotMsg;
     for (const std::pair<std::string,
          std::pair<std::string, std::string>> &robot :
-         this->dataPtr->robotFullTypes)
+         this->dataPtr->engine.RobotFullTypes())
     {
       ignition::msgs::Param *param = robotMsg.add_param();
       (*param->mutable_params())["name"].set_type(
@@ -1894,7 +1604,7 @@ void GameLogicPlugin::PostUpdate(
 
     // Add in marsupial pairs.
     for (const std::pair<std::string, std::string> &pair :
-         this->dataPtr->marsupialPairs)
+         this->dataPtr->engine.MarsupialPairs())
     {
       ignition::msgs::Param *param = robotMsg.add_param();
       (*param->mutable_params())["marsupial_parent"].set_type(
@@ -1909,23 +1619,24 @@ void GameLogicPlugin::PostUpdate(
     this->dataPtr->robotPub.Publish(robotMsg);
   }
 
-  this->dataPtr->CheckRobotFlip();
+  this->dataPtr->engine.CheckRobotFlip(this->dataPtr->simTime);
 
   // Periodically update the score file.
-  if (!this->dataPtr->finished && currentTime -
-      this->dataPtr->lastUpdateScoresTime > std::chrono::seconds(30))
+  if (!this->dataPtr->engine.Finished() && currentTime -
+      this->dataPtr->engine.LastUpdateScoresTime() > std::chrono::seconds(30))
   {
-    this->dataPtr->UpdateScoreFiles(this->dataPtr->simTime);
+    this->dataPtr->engine.UpdateScoreFiles(this->dataPtr->simTime);
   }
 }
 
+
 /////////////////////////////////////////////////
 bool GameLogicPluginPrivate::OnNewArtifact(const subt::msgs::Artifact &_req,
                                            subt::msgs::ArtifactScore &_resp)
 {
   ignition::msgs::Time localSimTime(this->simTime);
 
-  this->Log(localSimTime) << "new_artifact_reported" << std::endl;
+  this->engine.Log(localSimTime) << "new_artifact_reported" << std::endl;
   ignmsg << "SimTime[" << localSimTime.sec() << " " << localSimTime.nsec()
          << "] OnNewArtifact Msg=" << _req.DebugString() << std::endl;
 
@@ -1942,346 +1653,37 @@ bool GameLogicPluginPrivate::OnNewArtifact(const subt::msgs::Artifact &_req,
   // TODO(anyone) Where does run information come from?
   _resp.set_run(1);
 
-  ArtifactType artifactType;
+  ArtifactReportOutcome outcome = this->engine.ReportArtifact(localSimTime,
+      _req.type(), _req.pose());
 
-  if (this->started && this->finished)
-  {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    _resp.set_report_status("scoring finished");
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter++ << "\n"
-      << "  type: artifact_report_score_finished\n"
-      << "  time_sec: " << localSimTime.sec() << "\n"
-      << "  total_score: " << this->totalScore << std::endl;
-    this->LogEvent(stream.str());
-  }
-  else if (!this->started && !this->finished)
-  {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    _resp.set_report_status("run not started");
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter++ << "\n"
-      << "  type: artifact_report_not_started\n"
-      << "  time_sec: " << localSimTime.sec() << "\n"
-      << "  total_score: " << this->totalScore << std::endl;
-    this->LogEvent(stream.str());
-  }
-  else if (this->reportCount >= this->reportCountLimit)
-  {
-    {
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      _resp.set_report_status("report limit exceeded");
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter++ << "\n"
-        << "  type: artifact_report_limit_exceeded\n"
-        << "  time_sec: " << localSimTime.sec() << "\n"
-        << "  total_score: " << this->totalScore << std::endl;
-      this->LogEvent(stream.str());
-    }
-    this->Finish(localSimTime);
-  }
-  else if (!ArtifactFromInt(_req.type(), artifactType))
-  {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter++ << "\n"
-      << "  type: artifact_report_unknown_artifact\n"
-      << "  time_sec: " << localSimTime.sec() << "\n"
-      << "  total_score: " << this->totalScore << std::endl;
-    this->LogEvent(stream.str());
-
-    ignerr << "Unknown artifact code. The number should be between 0 and "
-          << kArtifactTypes.size() - 1 << " but we received "
-          << _req.type() << std::endl;
-
-    this->Log(localSimTime)
-      <<"error Unknown artifact code. The number should be between "
-      << "0 and " << kArtifactTypes.size() - 1
-      << " but we received " << _req.type() << std::endl;
-    _resp.set_report_status("scored");
-  }
-  else
+  _resp.set_report_status(outcome.status);
+  _resp.set_score_change(outcome.scoreChange);
+  _resp.set_report_id(outcome.reportId);
+
+  if (outcome.scored && this->rosnode)
   {
     subt_ros::ArtifactReport artifactMsg;
     artifactMsg.timestamp.sec = localSimTime.sec();
     artifactMsg.timestamp.nsec = localSimTime.nsec();
-    artifactMsg.points_scored = 0;
-    artifactMsg.total_score = this->totalScore;
-
-    std::lock_guard<std::mutex> lock(this->mutex);
-    auto [scoreDiff, duplicate] = this->ScoreArtifact(localSimTime,
-        artifactType, _req.pose(), artifactMsg);
-
-    _resp.set_score_change(scoreDiff);
-    _resp.set_report_status("scored");
-
-    if (!duplicate)
-    {
-      this->totalScore += scoreDiff;
-      if (this->rosnode)
-        this->rosArtifactPub.publish(artifactMsg);
-    }
-
-    ignmsg << "Total score: " << this->totalScore << std::endl;
-    this->Log(localSimTime)
-      << "new_total_score " << this->totalScore << std::endl;
+    artifactMsg.reported_artifact_type = outcome.reportedType;
+    artifactMsg.reported_artifact_position.x = outcome.reportedPos.X();
+    artifactMsg.reported_artifact_position.y = outcome.reportedPos.Y();
+    artifactMsg.reported_artifact_position.z = outcome.reportedPos.Z();
+    artifactMsg.closest_artifact_name = outcome.closestArtifactName;
+    artifactMsg.distance = outcome.distance;
+    artifactMsg.points_scored = outcome.scoreChange;
+    artifactMsg.total_score = outcome.totalScore;
+    this->rosArtifactPub.publish(artifactMsg);
   }
 
-  _resp.set_report_id(this->reportCount);
-
   // Finish if the maximum score has been reached, or if the maximum number
-  // of artifact reports has been reached..
-  if (!this->finished && this->totalScore >= this->artifactCount)
-  {
-    ignmsg << "Max score has been reached. Congratulations!" << std::endl;
-    this->Finish(localSimTime);
-    return true;
-  }
-
-  if (!this->finished && this->reportCount >= this->reportCountLimit)
-  {
-    _resp.set_report_status("report limit reached");
-    this->Log(localSimTime) << "report_limit_reached" << std::endl;
-    ignmsg << "Report limit reached." << std::endl;
-
-    {
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter++ << "\n"
-        << "  type: artifact_report_limit_reached\n"
-        << "  time_sec: " << localSimTime.sec() << "\n"
-        << "  total_score: " << this->totalScore << std::endl;
-      this->LogEvent(stream.str());
-    }
-
+  // of artifact reports has been reached.
+  if (outcome.finish)
     this->Finish(localSimTime);
-    return true;
-  }
-
-  // Update the score files, in case something bad happens.
-  // The ::Finish functions, used above, will also call the UpdateScoreFiles
-  // function.
-  this->UpdateScoreFiles(localSimTime);
 
   return true;
 }
 
-/////////////////////////////////////////////////
-ignition::math::Pose3d GameLogicPluginPrivate::ConvertToArtifactOrigin(
-    const ignition::math::Pose3d &_pose) const
-{
-  return _pose - this->artifactOriginPose;
-}
-
-/////////////////////////////////////////////////
-std::tuple<double, bool> GameLogicPluginPrivate::ScoreArtifact(
-    const ignition::msgs::Time &_simTime,
-    const ArtifactType &_type, const ignition::msgs::Pose &_pose,
-    subt_ros::ArtifactReport &_artifactMsg)
-{
-  // Sanity check: Make sure that we have crossed the starting gate.
-  if (!this->started)
-  {
-    ignmsg << "  The task hasn't started yet" << std::endl;
-    this->Log(_simTime) << "task_not_started" << std::endl;
-    return {0.0, false};
-  }
-
-  // Sanity check: Make sure that we still have artifacts.
-  if (this->foundArtifacts.size() >= this->artifactCount)
-  {
-    ignmsg << "  No artifacts remaining" << std::endl;
-    this->Log(_simTime) << "no_remaining_artifacts_of_specified_type"
-      << std::endl;
-    return {0.0, false};
-  }
-
-  // The teams are reporting the artifact poses relative to the fiducial located
-  // in the staging area. Now, we convert the reported pose to world coordinates
-  ignition::math::Pose3d artifactPose = ignition::msgs::Convert(_pose);
-  ignition::math::Pose3d pose = artifactPose + this->artifactOriginPose;
-  ignition::math::Vector3d observedObjectPose = pose.Pos();
-
-  // Type converted into a string.
-  std::string reportType;
-  if (!StringFromArtifact(_type, reportType))
-  {
-    ignmsg << "Unknown artifact type" << std::endl;
-    this->Log(_simTime) << "Unkown artifact type reported" << std::endl;
-
-    {
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter++ << "\n"
-        << "  type: unknown_artifact_type\n"
-        << "  time_sec: " << _simTime.sec() << "\n"
-        << "  reported_pose_world_frame: " << observedObjectPose << "\n"
-        << "  reported_pose_artifact_frame: " << artifactPose.Pos() << "\n"
-        << "  reported_artifact_type: " << reportType << "\n";
-      this->LogEvent(stream.str());
-    }
-
-    return {0.0, false};
-  }
-
-  // Pose converted into a string.
-  std::string reportPose = std::to_string(_pose.position().x()) + "_" +
-                           std::to_string(_pose.position().y()) + "_" +
-                           std::to_string(_pose.position().z());
-
-  // Unique report Id: Type and pose combined into a string.
-  std::string uniqueReportStr = reportType + "_" + reportPose;
-
-  auto uniqueReport = this->uniqueReports.find(uniqueReportStr);
-
-  // Check whether we received the same report before.
-  if (uniqueReport != this->uniqueReports.end())
-  {
-    ignmsg << "This report has been received before" << std::endl;
-    this->Log(_simTime) << "This report has been received before" << std::endl;
-
-    {
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter++ << "\n"
-        << "  type: duplicate_artifact_report\n"
-        << "  time_sec: " << _simTime.sec() << "\n"
-        << "  reported_pose_world_frame: " << observedObjectPose << "\n"
-        << "  reported_pose_artifact_frame: " << artifactPose.Pos() << "\n"
-        << "  reported_artifact_type: " << reportType << "\n";
-      this->LogEvent(stream.str());
-    }
-
-    this->duplicateReportCount++;
-    return {uniqueReport->second, true};
-  }
-
-  // This is a unique report.
-  this->reportCount++;
-
-  double score = 0.0;
-  std::map<std::string, ignition::math::Pose3d> &potentialArtifacts =
-    this->artifacts[_type];
-
-  // From the list of potential artifacts, find out which one is
-  // closer (Euclidean distance) to the located by this request.
-  std::tuple<std::string, ignition::math::Vector3d, double> minDistance =
-    {"", ignition::math::Vector3d(), std::numeric_limits<double>::infinity()};
-  for (const std::pair<std::string, ignition::math::Pose3d> &object :
-       potentialArtifacts)
-  {
-    // make sure the artifact has been loaded
-    ignition::math::Vector3d artifactPos = object.second.Pos();
-    if (std::isinf(artifactPos.X()) || std::isinf(artifactPos.Y())
-        || std::isinf(artifactPos.Z()))
-      continue;
-
-    double distance = observedObjectPose.Distance(artifactPos);
-
-    if (distance < std::get<2>(minDistance))
-    {
-      std::get<0>(minDistance) = object.first;
-      std::get<1>(minDistance) = object.second.Pos();
-      std::get<2>(minDistance) = distance;
-    }
-  }
-
-  // Calculate the score based on accuracy in the location. Make sure that
-  // the artifact was not already reported.
-  double distToArtifact = std::get<2>(minDistance);
-  if (distToArtifact < 5)
-  {
-    std::string artifactName = std::get<0>(minDistance);
-    if (this->foundArtifacts.find(artifactName) ==
-        this->foundArtifacts.end())
-    {
-      score = 1.0;
-
-      // Keep track of the artifacts that were found.
-      this->foundArtifacts.insert(artifactName);
-      this->Log(_simTime) << "found_artifact "
-        << std::get<0>(minDistance) << std::endl;
-
-      // collect artifact report data for logging
-      // update closest artifact reported so far
-      double closestDist = std::get<4>(this->closestReport);
-      if (closestDist < 0.0 || distToArtifact < closestDist)
-      {
-        std::string artifactType;
-        if (!StringFromArtifact(_type, artifactType))
-          artifactType = "";
-        // the elements are name, type, true pos, reported pos, dist
-        std::get<0>(this->closestReport) = artifactName;
-        std::get<1>(this->closestReport) = artifactType;
-        std::get<2>(this->closestReport) = std::get<1>(minDistance);
-        std::get<3>(this->closestReport) = observedObjectPose;
-        std::get<4>(this->closestReport) = std::get<2>(minDistance);
-      }
-      // compute sim time of this report
-      double reportTime = _simTime.sec() + _simTime.nsec() * 1e-9;
-      this->lastReportTime = reportTime;
-      if (this->firstReportTime < 0)
-        this->firstReportTime = reportTime;
-    }
-  }
-
-  // This is a new unique report, let's save it.
-  this->uniqueReports[uniqueReportStr] = score;
-
-  auto outDist = std::isinf(std::get<2>(minDistance)) ? -1 :
-    std::get<2>(minDistance);
-
-  {
-    std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-    std::ostringstream stream;
-    stream
-      << "- event:\n"
-      << "  id: " << this->eventCounter++ << "\n"
-      << "  type: artifact_report_attempt\n"
-      << "  time_sec: " << _simTime.sec() << "\n"
-      << "  reported_pose_world_frame: " << observedObjectPose << "\n"
-      << "  reported_pose_artifact_frame: " << artifactPose.Pos() << "\n"
-      << "  reported_artifact_type: " << reportType << "\n"
-      << "  closest_artifact_name: " << std::get<0>(minDistance) << "\n"
-      << "  distance: " <<  outDist << "\n"
-      << "  points_scored: " << score << "\n"
-      << "  total_score: " << this->totalScore + score << std::endl;
-    this->LogEvent(stream.str());
-  }
-
-  _artifactMsg.reported_artifact_type = reportType;
-  _artifactMsg.reported_artifact_position.x = artifactPose.Pos().X();
-  _artifactMsg.reported_artifact_position.y = artifactPose.Pos().Y();
-  _artifactMsg.reported_artifact_position.z = artifactPose.Pos().Z();
-  _artifactMsg.closest_artifact_name = std::get<0>(minDistance);
-  _artifactMsg.distance = outDist;
-  _artifactMsg.points_scored = score;
-  _artifactMsg.total_score = this->totalScore + score;
-
-  this->Log(_simTime) << "calculated_dist[" << std::get<2>(minDistance)
-    << "] for artifact[" << std::get<0>(minDistance) << "] reported_pos["
-    << artifactPose.Pos() << "]" << std::endl;
-
-  ignmsg << "  [Total]: " << score << std::endl;
-  this->Log(_simTime) << "modified_score " << score << std::endl;
-
-  return {score, false};
-}
-
 /////////////////////////////////////////////////
 void GameLogicPluginPrivate::PublishScore()
 {
@@ -2289,9 +1691,9 @@ void GameLogicPluginPrivate::PublishScore()
     this->node.Advertise<ignition::msgs::Float>("/subt/score");
   ignition::msgs::Float msg;
 
-  while (!this->finished)
+  while (!this->engine.Finished())
   {
-    msg.set_data(this->totalScore);
+    msg.set_data(this->engine.TotalScore());
 
     scorePub.Publish(msg);
     IGN_SLEEP_S(1);
@@ -2303,7 +1705,7 @@ bool GameLogicPluginPrivate::OnFinishCall(const ignition::msgs::Boolean &_req,
   ignition::msgs::Boolean &_res)
 {
   ignition::msgs::Time localSimTime(this->simTime);
-  if (this->started && _req.data() && !this->finished)
+  if (this->engine.Started() && _req.data() && !this->engine.Finished())
   {
     this->Finish(localSimTime);
     _res.set_data(true);
@@ -2331,17 +1733,11 @@ bool GameLogicPluginPrivate::OnStartCall(const ignition::msgs::Boolean &_req,
 /////////////////////////////////////////////////
 bool GameLogicPluginPrivate::Start(const ignition::msgs::Time &_simTime)
 {
-  bool result = false;
+  // The engine also updates the score files.
+  bool result = this->engine.Start(_simTime);
 
-  if (!this->started && !this->finished)
+  if (result)
   {
-    result = true;
-    this->started = true;
-    this->startTime = std::chrono::steady_clock::now();
-    this->startSimTime = _simTime;
-    ignmsg << "Scoring has Started" << std::endl;
-    this->Log(_simTime) << "scoring_started" << std::endl;
-
     ignition::msgs::StringMsg msg;
     msg.mutable_header()->mutable_stamp()->CopyFrom(_simTime);
     msg.set_data("started");
@@ -2349,32 +1745,17 @@ bool GameLogicPluginPrivate::Start(const ignition::msgs::Time &_simTime)
     this->startPub.Publish(msg);
     this->lastStatusPubTime = std::chrono::steady_clock::now();
 
+    if (this->rosnode)
     {
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter << "\n"
-        << "  type: started\n"
-        << "  time_sec: " << _simTime.sec() << std::endl;
-      this->LogEvent(stream.str());
-
-      if (this->rosnode)
-      {
-        this->prevPhase = "run";
-        subt_ros::RunStatus statusMsg;
-        statusMsg.status = "run";
-        statusMsg.timestamp.sec = _simTime.sec();
-        statusMsg.timestamp.nsec = _simTime.nsec();
-        this->rosStatusPub.publish(statusMsg);
-      }
-      this->eventCounter++;
+      this->prevPhase = "run";
+      subt_ros::RunStatus statusMsg;
+      statusMsg.status = "run";
+      statusMsg.timestamp.sec = _simTime.sec();
+      statusMsg.timestamp.nsec = _simTime.nsec();
+      this->rosStatusPub.publish(statusMsg);
     }
   }
 
-  // Update files when scoring has started.
-  this->UpdateScoreFiles(_simTime);
-
   return result;
 }
 
@@ -2385,454 +1766,135 @@ void GameLogicPluginPrivate::Finish(const ignition::msgs::Time &_simTime)
   // safe.
   this->eventManager->Emit<events::Pause>(true);
 
-  if (this->finished)
+  // The engine updates the score files and logs the finished event.
+  if (!this->engine.Finish(_simTime) || !this->engine.Started())
     return;
 
-  // Elapsed time
-  int realElapsed = 0;
-  int simElapsed = 0;
+  // \todo(nkoenig) After the tunnel circuit, change the /subt/start topic
+  // to /sub/status.
+  ignition::msgs::StringMsg msg;
+  msg.mutable_header()->mutable_stamp()->CopyFrom(_simTime);
+  msg.set_data("finished");
+  this->state = "finished";
+  this->startPub.Publish(msg);
+  this->lastStatusPubTime = std::chrono::steady_clock::now();
 
-  // Update the score.yml and summary.yml files. This function also
-  // returns the time point used to calculate the elapsed real time. By
-  // returning this time point, we can make sure that this function (the
-  // ::Finish function) uses the same time point.
-  std::chrono::steady_clock::time_point currTime =
-    this->UpdateScoreFiles(_simTime);
-
-  if (this->started)
+  if (this->rosnode)
   {
-    realElapsed = std::chrono::duration_cast<std::chrono::seconds>(
-        currTime - this->startTime).count();
-
-    simElapsed = _simTime.sec() - this->startSimTime.sec();
-
-    ignmsg << "Scoring has finished. Elapsed real time: "
-          << realElapsed << " seconds. Elapsed sim time: "
-          << simElapsed << " seconds. " << std::endl;
-
-    this->Log(_simTime) << "finished_elapsed_real_time " << realElapsed
-      << " s." << std::endl;
-    this->Log(_simTime) << "finished_elapsed_sim_time " << simElapsed
-      << " s." << std::endl;
-    this->Log(_simTime) << "finished_score " << this->totalScore << std::endl;
-    this->logStream.flush();
+    this->engine.Log(_simTime) << "ROS node exists, time to shutdown."
+      << std::endl;
 
-    {
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter << "\n"
-        << "  type: finished\n"
-        << "  time_sec: " << _simTime.sec() << "\n"
-        << "  elapsed_real_time: " << realElapsed << "\n"
-        << "  elapsed_sim_time: " << simElapsed << "\n"
-        << "  total_score: " << this->totalScore << std::endl;
-      this->LogEvent(stream.str());
-      this->eventCounter++;
-    }
+    this->prevPhase = "finished";
+    subt_ros::RunStatus statusMsg;
+    statusMsg.status = "finished";
+    statusMsg.timestamp.sec = _simTime.sec();
+    statusMsg.timestamp.nsec = _simTime.nsec();
+    this->rosStatusPub.publish(statusMsg);
 
+    if (this->bagThread && this->bagThread->joinable())
     {
-      // \todo(nkoenig) After the tunnel circuit, change the /subt/start topic
-      // to /sub/status.
-      ignition::msgs::StringMsg msg;
-      msg.mutable_header()->mutable_stamp()->CopyFrom(_simTime);
-      msg.set_data("finished");
-      this->state = "finished";
-      this->startPub.Publish(msg);
-      this->lastStatusPubTime = std::chrono::steady_clock::now();
-
-      if (this->rosnode)
-      {
-        this->Log(_simTime) << "ROS node exists, time to shutdown."
-          << std::endl;
-
-        this->prevPhase = "finished";
-        subt_ros::RunStatus statusMsg;
-        statusMsg.status = "finished";
-        statusMsg.timestamp.sec = _simTime.sec();
-        statusMsg.timestamp.nsec = _simTime.nsec();
-        this->rosStatusPub.publish(statusMsg);
-
-        if (this->bagThread && this->bagThread->joinable())
-        {
-          this->Log(_simTime) << "Calling ros::shutdown." << std::endl;
-
-          // Shutdown ros. this makes the ROS bag recorder stop.
-          ros::shutdown();
-          this->bagThread->join();
-        }
-
-        this->Log(_simTime) << "ROS has been shutdown." << std::endl;
-      }
+      this->engine.Log(_simTime) << "Calling ros::shutdown." << std::endl;
 
-      // Send the recording_complete message after ROS has shutdown, if ROS
-      // has been enabled.
-      ignition::msgs::StringMsg completeMsg;
-      completeMsg.mutable_header()->mutable_stamp()->CopyFrom(
-          this->simTime);
-      completeMsg.set_data("recording_complete");
-      this->state = "recording_complete";
-      this->startPub.Publish(completeMsg);
-
-      std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-      std::ostringstream stream;
-      stream
-        << "- event:\n"
-        << "  id: " << this->eventCounter << "\n"
-        << "  type: recording_complete\n"
-        << "  time_sec: " << _simTime.sec() << "\n"
-        << "  elapsed_real_time: " << realElapsed << "\n"
-        << "  elapsed_sim_time: " << simElapsed << "\n"
-        << "  total_score: " << this->totalScore << std::endl;
-      this->LogEvent(stream.str());
-      this->eventCounter++;
+      // Shutdown ros. this makes the ROS bag recorder stop.
+      ros::shutdown();
+      this->bagThread->join();
     }
-  }
-
-  this->finished = true;
-}
-
-/////////////////////////////////////////////////
-std::chrono::steady_clock::time_point GameLogicPluginPrivate::UpdateScoreFiles(
-    const ignition::msgs::Time &_simTime)
-{
-  std::lock_guard<std::mutex> lock(this->logMutex);
-
-  // Elapsed time
-  int realElapsed = 0;
-  int simElapsed = 0;
-  std::chrono::steady_clock::time_point currTime =
-    std::chrono::steady_clock::now();
-
-  if (this->started)
-  {
-    simElapsed = _simTime.sec() - this->startSimTime.sec();
-    realElapsed = std::chrono::duration_cast<std::chrono::seconds>(
-        currTime - this->startTime).count();
-  }
-
-  // Output a run summary
-  std::ofstream summary(this->logPath + "/summary.yml", std::ios::out);
-
-  summary << "was_started: " << this->started << std::endl;
-  summary << "sim_time_duration_sec: " << simElapsed << std::endl;
-  summary << "real_time_duration_sec: " << realElapsed << std::endl;
-  summary << "model_count: " << this->robotNames.size() << std::endl;
-  summary.flush();
-
-  // Output a score file with just the final score
-  std::ofstream score(this->logPath + "/score.yml", std::ios::out);
-  score << totalScore << std::endl;
-  score.flush();
-
-  this->LogRobotPosData();
-  this->LogRobotArtifactData(_simTime, realElapsed, simElapsed);
-
-  this->lastUpdateScoresTime = currTime;
-  return currTime;
-}
 
-/////////////////////////////////////////////////
-void GameLogicPluginPrivate::LogRobotPosData()
-{
-  std::string path = common::joinPaths(this->logPath, "pos-data");
-
-  // remove previous pos data on start
-  if (this->lastUpdateScoresTime.time_since_epoch().count() == 0u)
-  {
-    common::removeAll(path);
-    common::createDirectory(path);
+    this->engine.Log(_simTime) << "ROS has been shutdown." << std::endl;
   }
 
-  // log robot pos data
-  for (auto &it : this->robotPoseData)
-  {
-    if (it.second.empty())
-      return;
-    std::string robotName = it.first;
-
-    // create the pos data file if it does not exist yet
-    std::shared_ptr<std::ofstream> posStream;
-    auto streamIt = this->robotPosStream.find(robotName);
-    bool fileExists = true;
-    if (streamIt == this->robotPosStream.end())
-    {
-      std::string file = common::joinPaths(path, robotName + "-pos.data");
-      std::shared_ptr<std::ofstream> logFile =
-          std::make_shared<std::ofstream>(file, std::ios::ate);
-      this->robotPosStream[robotName] = logFile;
-      posStream = logFile;
-      fileExists = false;
-    }
-    else
-    {
-      posStream = streamIt->second;
-    }
-
-    // write to file only if there are new data, or it is the first time.
-    // Note that robot pos data should always have at least 1 (latest) pos data
-    // in the vector which is used during PostUpdate for computating robot
-    // distance traveled and vel data
-    if (!fileExists || it.second.size() > 1u)
-    {
-      auto poseData = std::move(it.second);
-      auto posIt = poseData.begin();
-
-      // if file already exists, it is not the first time we are writing out
-      // pos data. So the first entry in the vector should be the last pos
-      // data that was already written out to file so skip it
-      if (fileExists)
-        posIt++;
-      for(; posIt != poseData.end(); ++posIt)
-      {
-        auto t = posIt->first;
-        int64_t s, ns;
-        std::tie(s, ns) = ignition::math::durationToSecNsec(posIt->first);
-        math::Vector3d pos = posIt->second.Pos();
-        // sec nsec x y z
-        *posStream << s << " " << ns << " " << pos << std::endl;
-      }
-      posStream->flush();
+  // Send the recording_complete message after ROS has shutdown, if ROS
+  // has been enabled.
+  ignition::msgs::StringMsg completeMsg;
+  completeMsg.mutable_header()->mutable_stamp()->CopyFrom(
+      this->simTime);
+  completeMsg.set_data("recording_complete");
+  this->state = "recording_complete";
+  this->startPub.Publish(completeMsg);
 
-      // make sure to push the latest pos data back in the vector
-      it.second.push_back({poseData.back().first, poseData.back().second});
-    }
-  }
+  this->engine.LogRecordingComplete(_simTime);
 }
 
 /////////////////////////////////////////////////
-void GameLogicPluginPrivate::LogRobotArtifactData(
-    const ignition::msgs::Time &_simTime,
-    int _realElapsed,
-    int _simElapsed) const
+void GameLogicPluginPrivate::PublishRunStatistics(const RunStatistics &_stats)
 {
-  // output robot and artifact data to a yml file
-  // 1. Number of artifacts found.
-  // 2. Robot count
-  // 3. Unique robot count (for example, a team of two X1_SENSOR_CONFIG_1
-  // robots would have a unique count of 1).
-  // 4. Total simulation time.
-  // 5. Total real time.
-  // 6. Number of artifact report attempts
-  // 7. Number of duplicate artifact reports.
-  // 8. Closest artifact report:
-  //      a. Distance in meters.
-  //      b. True position of the artifact.
-  //      c. Reported position.
-  //      d. Artifact type and name.
-  // 9. First artifact report time.
-  // 10. Last artifact report time.
-  // 11. Mean time between success reports
-  // 12. Greatest distance traveled by a robot on the team.
-  // 13. Greatest euclidean distance traveled by a robot from the staging area.
-  // 14. Total distance traveled by all the robots.
-  // 15. Greatest maximum velocity by a robot.
-  // 16. Greatest average velocity.
-  // 17. Greatest cumulative elevation gain by a robot on the team
-  // 18. Greatest cumulative elevation loss by a robot on the team
-  // 19. Total cumulative elevation gain by all the robots.
-  // 20. Total cumulative elevation loss by all the robots.
-  // 21. Max elevation reached by a robot
-  // 22. Min elevation reached by a robot
-  // 23. Robot configurations and marsupial pairs.
+  if (!this->rosnode)
+    return;
 
   subt_ros::RunStatistics statsMsg;
 
-  statsMsg.timestamp.sec = _simTime.sec();
-  statsMsg.timestamp.nsec = _simTime.nsec();
-  statsMsg.world_name = this->worldName;
+  statsMsg.timestamp.sec = _stats.timestamp.sec();
+  statsMsg.timestamp.nsec = _stats.timestamp.nsec();
+  statsMsg.world_name = _stats.worldName;
 
-  YAML::Emitter out;
-  out << YAML::BeginMap;
-
-  out << YAML::Key << "world_name";
-  out << YAML::Value  << this->worldName;
-  out << YAML::Key << "report_count_limit";
-  out << YAML::Value  << this->reportCountLimit;
-  out << YAML::Key << "robots";
-  out << YAML::Value << YAML::BeginMap;
-  for (auto const &pair : this->robotFullTypes)
+  for (auto const &pair : _stats.robots)
   {
     subt_ros::Robot robotMsg;
     robotMsg.name = pair.first;
     robotMsg.platform = pair.second.first;
     robotMsg.type = pair.second.second;
     statsMsg.robots.push_back(robotMsg);
-
-    out << YAML::Key << pair.first;
-    out << YAML::Value << YAML::BeginMap;
-    out << YAML::Key << "platform" << YAML::Value << pair.second.first;
-    out << YAML::Key << "config" << YAML::Value << pair.second.second;
-    out << YAML::EndMap;
   }
-  out << YAML::EndMap;
 
-  out << YAML::Key << "marsupials";
-  out << YAML::Value << YAML::BeginMap;
-  for (auto const &pair : this->marsupialPairs)
+  for (auto const &pair : _stats.marsupials)
   {
-    out << YAML::Key << pair.first << YAML::Value << pair.second;
     subt_ros::Marsupial marsupialMsg;
     marsupialMsg.parent = pair.first;
     marsupialMsg.child = pair.second;
     statsMsg.marsupials.push_back(marsupialMsg);
   }
-  out << YAML::EndMap;
-
-  // artifact data
-  out << YAML::Key << "artifacts_found";
-  out << YAML::Value << this->foundArtifacts.size();
-  statsMsg.artifacts_found = this->foundArtifacts.size();
-
-  out << YAML::Key << "robot_count";
-  out << YAML::Value << this->robotNames.size();
-  statsMsg.robot_count = this->robotNames.size();
-
-  out << YAML::Key << "unique_robot_count";
-  out << YAML::Value << this->robotTypes.size();
-  statsMsg.unique_robot_count = this->robotTypes.size();
-
-  out << YAML::Key << "sim_time";
-  out << YAML::Value << _simElapsed;
-  statsMsg.sim_time_elapsed = _simElapsed;
-
-  out << YAML::Key << "real_time";
-  out << YAML::Value << _realElapsed;
-  statsMsg.real_time_elapsed = _realElapsed;
-
-  out << YAML::Key << "artifact_report_count";
-  out << YAML::Value << this->reportCount;
-  statsMsg.artifact_report_count = this->reportCount;
-
-  out << YAML::Key << "duplicate_report_count";
-  out << YAML::Value << this->duplicateReportCount;
-  statsMsg.duplicate_report_count = this->duplicateReportCount;
-
-  std::stringstream artifactPos;
-  artifactPos << std::get<2>(this->closestReport);
-  std::stringstream reportedPos;
-  reportedPos << std::get<3>(this->closestReport);
-
-  out << YAML::Key << "closest_artifact_report";
-  out << YAML::Value << YAML::BeginMap
-      << YAML::Key << "name"
-      << YAML::Value << std::get<0>(this->closestReport)
-      << YAML::Key << "type"
-      << YAML::Value << std::get<1>(this->closestReport)
-      << YAML::Key << "true_pos"
-      << YAML::Value << artifactPos.str()
-      << YAML::Key << "reported_pos"
-      << YAML::Value << reportedPos.str()
-      << YAML::Key << "distance"
-      << YAML::Value << std::get<4>(this->closestReport)
-      << YAML::EndMap;
-  out << YAML::Key << "first_artifact_report";
-  out << YAML::Value << this->firstReportTime;
-  out << YAML::Key << "last_artifact_report";
-  out << YAML::Value << this->lastReportTime;
-  statsMsg.closest_artifact_report_name = std::get<0>(this->closestReport);
-  statsMsg.closest_artifact_report_type = std::get<1>(this->closestReport);
-  statsMsg.closest_artifact_report_true_pos.x = std::get<2>(this->closestReport).X();
-  statsMsg.closest_artifact_report_true_pos.y = std::get<2>(this->closestReport).Y();
-  statsMsg.closest_artifact_report_true_pos.z = std::get<2>(this->closestReport).Z();
-  statsMsg.closest_artifact_report_reported_pos.x = std::get<3>(this->closestReport).X();
-  statsMsg.closest_artifact_report_reported_pos.y = std::get<3>(this->closestReport).Y();
-  statsMsg.closest_artifact_report_reported_pos.z = std::get<3>(this->closestReport).Z();
-  statsMsg.closest_artifact_report_distance = std::get<4>(this->closestReport);
-  statsMsg.first_artifact_report_time = this->firstReportTime;
-  statsMsg.last_artifact_report_time = this->lastReportTime;
-
-  double meanReportTime = 0;
-  if (this->foundArtifacts.size() > 1)
-  {
-    meanReportTime = (this->lastReportTime-this->firstReportTime) /
-        (this->foundArtifacts.size() - 1);
-  }
-  out << YAML::Key << "mean_time_between_successful_artifact_reports";
-  out << YAML::Value << meanReportTime;
-  statsMsg.mean_time_between_successful_artifact_reports = meanReportTime;
-
-  // robot distance traveled and vel data
-  out << YAML::Key << "greatest_distance_traveled";
-  out << YAML::Value << this->maxRobotDistance.second;
-  out << YAML::Key << "greatest_distance_traveled_robot";
-  out << YAML::Value << this->maxRobotDistance.first;
-  statsMsg.greatest_distance_traveled.name = this->maxRobotDistance.first;
-  statsMsg.greatest_distance_traveled.data = this->maxRobotDistance.second;
-
-  out << YAML::Key << "greatest_euclidean_distance_from_start";
-  out << YAML::Value << this->maxRobotEuclideanDistance.second;
-  out << YAML::Key << "greatest_euclidean_distance_from_start_robot";
-  out << YAML::Value << this->maxRobotEuclideanDistance.first;
+
+  statsMsg.artifacts_found = _stats.artifactsFound;
+  statsMsg.robot_count = _stats.robotCount;
+  statsMsg.unique_robot_count = _stats.uniqueRobotCount;
+  statsMsg.sim_time_elapsed = _stats.simTimeElapsed;
+  statsMsg.real_time_elapsed = _stats.realTimeElapsed;
+  statsMsg.artifact_report_count = _stats.artifactReportCount;
+  statsMsg.duplicate_report_count = _stats.duplicateReportCount;
+
+  statsMsg.closest_artifact_report_name = _stats.closestReportName;
+  statsMsg.closest_artifact_report_type = _stats.closestReportType;
+  statsMsg.closest_artifact_report_true_pos.x = _stats.closestReportTruePos.X();
+  statsMsg.closest_artifact_report_true_pos.y = _stats.closestReportTruePos.Y();
+  statsMsg.closest_artifact_report_true_pos.z = _stats.closestReportTruePos.Z();
+  statsMsg.closest_artifact_report_reported_pos.x =
+    _stats.closestReportReportedPos.X();
+  statsMsg.closest_artifact_report_reported_pos.y =
+    _stats.closestReportReportedPos.Y();
+  statsMsg.closest_artifact_report_reported_pos.z =
+    _stats.closestReportReportedPos.Z();
+  statsMsg.closest_artifact_report_distance = _stats.closestReportDistance;
+  statsMsg.first_artifact_report_time = _stats.firstReportTime;
+  statsMsg.last_artifact_report_time = _stats.lastReportTime;
+  statsMsg.mean_time_between_successful_artifact_reports =
+    _stats.meanTimeBetweenReports;
+
+  statsMsg.greatest_distance_traveled.name =
+    _stats.greatestDistanceTraveled.first;
+  statsMsg.greatest_distance_traveled.data =
+    _stats.greatestDistanceTraveled.second;
   statsMsg.greatest_euclidean_distance_from_start.name =
-    this->maxRobotEuclideanDistance.first;
+    _stats.greatestEuclideanDistanceFromStart.first;
   statsMsg.greatest_euclidean_distance_from_start.data =
-    this->maxRobotEuclideanDistance.second;
-
-  out << YAML::Key << "total_distance_traveled";
-  out << YAML::Value << this->robotsTotalDistance;
-  statsMsg.total_distance_traveled =this->robotsTotalDistance;
-
-  out << YAML::Key << "greatest_max_vel";
-  out << YAML::Value << this->maxRobotVel.second;
-  out << YAML::Key << "greatest_max_vel_robot";
-  out << YAML::Value << this->maxRobotVel.first;
-  statsMsg.greatest_max_vel.name = this->maxRobotVel.first;
-  statsMsg.greatest_max_vel.data = this->maxRobotVel.second;
-
-  out << YAML::Key << "greatest_avg_vel";
-  out << YAML::Value << this->maxRobotAvgVel.second;
-  out << YAML::Key << "greatest_avg_vel_robot";
-  out << YAML::Value << this->maxRobotAvgVel.first;
-  statsMsg.greatest_avg_vel.name = this->maxRobotAvgVel.first;
-  statsMsg.greatest_avg_vel.data = this->maxRobotAvgVel.second;
-
-  // robot elevation data
-  out << YAML::Key << "greatest_elevation_gain";
-  out << YAML::Value << this->maxRobotElevationGain.second;
-  out << YAML::Key << "greatest_elevation_gain_robot";
-  out << YAML::Value << this->maxRobotElevationGain.first;
-  statsMsg.greatest_elevation_gain.name = this->maxRobotElevationGain.first;
-  statsMsg.greatest_elevation_gain.data = this->maxRobotElevationGain.second;
-
-  out << YAML::Key << "greatest_elevation_loss";
-  out << YAML::Value << this->maxRobotElevationLoss.second;
-  out << YAML::Key << "greatest_elevation_loss_robot";
-  out << YAML::Value << this->maxRobotElevationLoss.first;
-  statsMsg.greatest_elevation_loss.name = this->maxRobotElevationLoss.first;
-  statsMsg.greatest_elevation_loss.data = this->maxRobotElevationLoss.second;
-
-  out << YAML::Key << "total_elevation_gain";
-  out << YAML::Value << this->robotsTotalElevationGain;
-  statsMsg.total_elevation_gain = this->robotsTotalElevationGain;
-
-  out << YAML::Key << "total_elevation_loss";
-  out << YAML::Value << this->robotsTotalElevationLoss;
-  statsMsg.total_elevation_loss = this->robotsTotalElevationLoss;
-
-  out << YAML::Key << "max_elevation_reached";
-  out << YAML::Value << this->maxRobotElevation.second;
-  out << YAML::Key << "max_elevation_reached_robot";
-  out << YAML::Value << this->maxRobotElevation.first;
-  statsMsg.max_elevation_reached.name = this->maxRobotElevation.first;
-  statsMsg.max_elevation_reached.data = this->maxRobotElevation.second;
-
-  out << YAML::Key << "min_elevation_reached";
-  out << YAML::Value << this->minRobotElevation.second;
-  out << YAML::Key << "min_elevation_reached_robot";
-  out << YAML::Value << this->minRobotElevation.first;
-  statsMsg.min_elevation_reached.name = this->minRobotElevation.first;
-  statsMsg.min_elevation_reached.data = this->minRobotElevation.second;
-
-  out << YAML::EndMap;
-
-  std::ofstream logFile(this->logPath + "/run.yml", std::ios::out);
-  logFile << out.c_str() << std::endl;
-  logFile.flush();
-
-  if (this->rosnode)
-    this->rosStatsPub.publish(statsMsg);
+    _stats.greatestEuclideanDistanceFromStart.second;
+  statsMsg.total_distance_traveled = _stats.totalDistanceTraveled;
+  statsMsg.greatest_max_vel.name = _stats.greatestMaxVel.first;
+  statsMsg.greatest_max_vel.data = _stats.greatestMaxVel.second;
+  statsMsg.greatest_avg_vel.name = _stats.greatestAvgVel.first;
+  statsMsg.greatest_avg_vel.data = _stats.greatestAvgVel.second;
+
+  statsMsg.greatest_elevation_gain.name = _stats.greatestElevationGain.first;
+  statsMsg.greatest_elevation_gain.data = _stats.greatestElevationGain.second;
+  statsMsg.greatest_elevation_loss.name = _stats.greatestElevationLoss.first;
+  statsMsg.greatest_elevation_loss.data = _stats.greatestElevationLoss.second;
+  statsMsg.total_elevation_gain = _stats.totalElevationGain;
+  statsMsg.total_elevation_loss = _stats.totalElevationLoss;
+  statsMsg.max_elevation_reached.name = _stats.maxElevationReached.first;
+  statsMsg.max_elevation_reached.data = _stats.maxElevationReached.second;
+  statsMsg.min_elevation_reached.name = _stats.minElevationReached.first;
+  statsMsg.min_elevation_reached.data = _stats.minElevationReached.second;
+
+  this->rosStatsPub.publish(statsMsg);
 }
 
 /////////////////////////////////////////////////
@@ -2881,7 +1943,7 @@ bool GameLogicPluginPrivate::PoseFromArtifactHelper(const std::string &_robot,
   }
 
   // Pose.
-  _result = robotPose - this->artifactOriginPose;
+  _result = robotPose - this->engine.ArtifactOrigin();
   return true;
 }
 
@@ -2902,14 +1964,6 @@ bool GameLogicPluginPrivate::OnPoseFromArtifact(
   return result;
 }
 
-/////////////////////////////////////////////////
-void GameLogicPluginPrivate::LogEvent(const std::string &_event)
-{
-  std::lock_guard<std::mutex> lock(this->eventMutex);
-  this->eventStream << _event;
-  this->eventStream.flush();
-}
-
 /////////////////////////////////////////////////
 void GameLogicPluginPrivate::PublishRobotEvent(
     const ignition::msgs::Time &_simTime,
@@ -2948,70 +2002,36 @@ void GameLogicPluginPrivate::PublishRegionEvent(
 }
 
 /////////////////////////////////////////////////
-std::ofstream &GameLogicPluginPrivate::Log(
-    const ignition::msgs::Time &_simTime)
-{
-  this->logStream << _simTime.sec()
-                  << " " << _simTime.nsec() << " ";
-  return this->logStream;
-}
-
-/////////////////////////////////////////////////
-void GameLogicPluginPrivate::CheckRobotFlip()
+void GameLogicPluginPrivate::PublishKinematicState(
+    const ignition::msgs::Time &_simTime,
+    const std::string &_robot,
+    const KinematicState &_state)
 {
-  for (const auto &posePair : this->robotPrevPose)
-  {
-    auto name = posePair.first;
-    auto pose = posePair.second;
-
-    if (this->robotFlipInfo.find(name) == this->robotFlipInfo.end())
-    {
-      this->robotFlipInfo[name] = {this->simTime.sec(), false};
-      continue;
-    }
-
-    // Get cos(theta) between the world's z-axis and the robot's z-axis
-    // If they are in opposite directions (cos(theta) close to -1), robot is flipped
-    ignition::math::Vector3d a = pose.Rot() * ignition::math::Vector3d(0,0,1);
-    auto cos_theta = a.Z();
-    if (std::abs(-1 - cos_theta) <= 0.1 )
-    {
-      // make sure the robot has been flipped for a few seconds before logging a flip
-      // (avoid false positives)
-      auto simElapsed = this->simTime.sec() - this->robotFlipInfo[name].first;
-      if (!this->robotFlipInfo[name].second && (simElapsed >= 3))
-      {
-        this->robotFlipInfo[name].second = true;
-        ignition::msgs::Time localSimTime(this->simTime);
-
-        {
-          std::lock_guard<std::mutex> lock(this->eventCounterMutex);
-          std::ostringstream stream;
-          stream
-            << "- event:\n"
-            << "  id: " << this->eventCounter << "\n"
-            << "  type: flip\n"
-            << "  time_sec: " << localSimTime.sec() << "\n"
-            << "  robot: " << name << "\n";
-          this->LogEvent(stream.str());
-          this->PublishRobotEvent(localSimTime, "flip", name,
-              this->eventCounter);
-          this->eventCounter++;
-        }
-      }
-    }
-    else
-    {
-      this->robotFlipInfo[name] = {this->simTime.sec(), false};
-    }
-  }
-}
+  if (!this->rosnode)
+    return;
 
-/////////////////////////////////////////////////
-double GameLogicPluginPrivate::FloorMultiple(double _n, double _m)
-{
-  double out = _n - fmod(_n, _m);
-  if (_n < 0)
-    out -= _m;
-  return out;
+  const ignition::math::Pose3d &p = _state.pose;
+
+  geometry_msgs::PoseStamped msg;
+  msg.header.stamp.sec = _simTime.sec();
+  msg.header.stamp.nsec = _simTime.nsec();
+  msg.header.frame_id = "artifact_origin";
+  msg.pose.position.x = p.Pos().X();
+  msg.pose.position.y = p.Pos().Y();
+  msg.pose.position.z = p.Pos().Z();
+  msg.pose.orientation.x = p.Rot().X();
+  msg.pose.orientation.y = p.Rot().Y();
+  msg.pose.orientation.z = p.Rot().Z();
+  msg.pose.orientation.w = p.Rot().W();
+  this->rosRobotPosePubs[_robot].publish(msg);
+
+  // publish the pose, velocity, and speed
+  subt_ros::KinematicStates kmsg;
+  kmsg.header = msg.header;
+  kmsg.pose = msg.pose;
+  kmsg.velocity.x = _state.velocity.X();
+  kmsg.velocity.y = _state.velocity.Y();
+  kmsg.velocity.z = _state.velocity.Z();
+  kmsg.speed = _state.speed;
+  this->rosRobotKinematicPubs[_robot].publish(kmsg);
 }
@@ -21,6 +21,7 @@
 
 #include <ignition/common/StringUtils.hh>
 #include <ignition/common/Console.hh>
+#include <ignition/math/OrientedBox.hh>
 #include <ignition/math/Pose3.hh>
 #include <ignition/plugin/Register.hh>
 #include <ignition/transport/Node.hh>
@@ -32,9 +33,17 @@
 #include <ignition/gazebo/components/Pose.hh>
 #include <ignition/gazebo/components/World.hh>
 #include <ignition/gazebo/components/Model.hh>
+#include <ignition/gazebo/Conversions.hh>
 #include <ignition/gazebo/Util.hh>
 
-#include <set>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 IGNITION_ADD_PLUGIN(
     subt::GasEmitter,
@@ -54,6 +63,191 @@ IGN_GAZEBO_REGISTER_COMPONENT("subt_components.GasType", GasType)
 using namespace ignition;
 using namespace subt;
 
+namespace
+{
+/// \brief Spatial index of all gas emitters in the world. Emitters are
+/// stored in the cells of a uniform grid they overlap, so a detector only
+/// tests the emitters near it. Gas types are interned as integers.
+class GasEmitterIndex
+{
+  /// \brief Get the id of a gas type, adding it if it is new.
+  /// \param[in] _type Name of the gas type.
+  /// \return Id of the gas type.
+  public: uint32_t InternType(const std::string &_type)
+  {
+    auto it = this->typeIds.emplace(_type,
+        static_cast<uint32_t>(this->typeIds.size())).first;
+    return it->second;
+  }
+
+  /// \brief Add an emitter.
+  /// \param[in] _type Id of the gas type.
+  /// \param[in] _size Size of the emitter box.
+  /// \param[in] _pose World pose of the center of the emitter box.
+  public: void Add(const uint32_t _type, const math::Vector3d &_size,
+      const math::Pose3d &_pose)
+  {
+    Emitter emitter{_type, _pose.Pos(), _pose.Pos(),
+        math::OrientedBoxd(_size, _pose)};
+
+    // Axis-aligned bounds of the corners of the box.
+    for (double x : {-0.5, 0.5})
+    {
+      for (double y : {-0.5, 0.5})
+      {
+        for (double z : {-0.5, 0.5})
+        {
+          const auto corner = _pose.Pos() + _pose.Rot().RotateVector(
+              math::Vector3d(x * _size.X(), y * _size.Y(), z * _size.Z()));
+          emitter.min.Min(corner);
+          emitter.max.Max(corner);
+        }
+      }
+    }
+
+    const auto index = static_cast<uint32_t>(this->emitters.size());
+    this->emitters.push_back(emitter);
+
+    const int64_t minX = Cell(emitter.min.X());
+    const int64_t minY = Cell(emitter.min.Y());
+    const int64_t minZ = Cell(emitter.min.Z());
+    const int64_t maxX = Cell(emitter.max.X());
+    const int64_t maxY = Cell(emitter.max.Y());
+    const int64_t maxZ = Cell(emitter.max.Z());
+    if ((maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1) >
+        kMaxCellsPerEmitter)
+    {
+      this->oversized.push_back(index);
+      return;
+    }
+
+    for (int64_t x = minX; x <= maxX; ++x)
+      for (int64_t y = minY; y <= maxY; ++y)
+        for (int64_t z = minZ; z <= maxZ; ++z)
+          this->cells[Key(x, y, z)].push_back(index);
+  }
+
+  /// \brief Check whether a point is inside an emitter of the given types.
+  /// \param[in] _pos The point in world frame.
+  /// \param[in] _types Sorted ids of the gas types. All types if empty.
+  /// \return True if the point is inside a matching emitter.
+  public: bool Detect(const math::Vector3d &_pos,
+      const std::vector<uint32_t> &_types) const
+  {
+    auto inside = [&](const uint32_t _index)
+    {
+      const auto &emitter = this->emitters[_index];
+      return (_types.empty() ||
+          std::binary_search(_types.begin(), _types.end(), emitter.type)) &&
+        _pos.X() >= emitter.min.X() && _pos.X() <= emitter.max.X() &&
+        _pos.Y() >= emitter.min.Y() && _pos.Y() <= emitter.max.Y() &&
+        _pos.Z() >= emitter.min.Z() && _pos.Z() <= emitter.max.Z() &&
+        emitter.box.Contains(_pos);
+    };
+
+    auto cell = this->cells.find(
+        Key(Cell(_pos.X()), Cell(_pos.Y()), Cell(_pos.Z())));
+    if (cell != this->cells.end() &&
+        std::any_of(cell->second.begin(), cell->second.end(), inside))
+    {
+      return true;
+    }
+    return std::any_of(this->oversized.begin(), this->oversized.end(), inside);
+  }
+
+  /// \brief Index of the grid cell containing a coordinate.
+  private: static int64_t Cell(const double _coord)
+  {
+    return static_cast<int64_t>(std::floor(_coord / kCellSize));
+  }
+
+  /// \brief Hash key of a grid cell. Distant cells may share a key, which
+  /// only costs a few more tests.
+  private: static uint64_t Key(const int64_t _x, const int64_t _y,
+      const int64_t _z)
+  {
+    const uint64_t mask = (1u << 21) - 1u;
+    return ((static_cast<uint64_t>(_x) & mask) << 42) |
+      ((static_cast<uint64_t>(_y) & mask) << 21) |
+      (static_cast<uint64_t>(_z) & mask);
+  }
+
+  /// \brief Size of a grid cell in meters.
+  private: static constexpr double kCellSize = 10.0;
+
+  /// \brief Emitters overlapping more cells are tested for every query.
+  private: static constexpr int64_t kMaxCellsPerEmitter = 64;
+
+  /// \brief An emitter.
+  private: struct Emitter
+  {
+    /// \brief Id of the gas type.
+    uint32_t type;
+
+    /// \brief Minimum corner of the axis-aligned bounds.
+    math::Vector3d min;
+
+    /// \brief Maximum corner of the axis-aligned bounds.
+    math::Vector3d max;
+
+    /// \brief The emitter volume.
+    math::OrientedBoxd box;
+  };
+
+  /// \brief All emitters.
+  private: std::vector<Emitter> emitters;
+
+  /// \brief Indices of emitters in each grid cell.
+  private: std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+
+  /// \brief Indices of emitters too large to be stored in the grid.
+  private: std::vector<uint32_t> oversized;
+
+  /// \brief Ids of the gas types.
+  private: std::unordered_map<std::string, uint32_t> typeIds;
+};
+
+/// \brief The index is shared by pointer, it is not serialized.
+class GasEmitterIndexSerializer
+{
+  public: static std::ostream &Serialize(std::ostream &_out,
+      const std::shared_ptr<GasEmitterIndex> &)
+  {
+    return _out;
+  }
+
+  public: static std::istream &Deserialize(std::istream &_in,
+      std::shared_ptr<GasEmitterIndex> &)
+  {
+    return _in;
+  }
+};
+
+using GasEmitterIndexComponent = gazebo::components::Component<
+    std::shared_ptr<GasEmitterIndex>, class GasEmitterIndexTag,
+    GasEmitterIndexSerializer>;
+
+/// \brief Get the emitter index stored in the world entity, creating it if
+/// it doesn't exist yet.
+/// \param[in] _ecm The entity component manager.
+/// \return The emitter index.
+std::shared_ptr<GasEmitterIndex> EmitterIndex(
+    gazebo::EntityComponentManager &_ecm)
+{
+  const auto world = _ecm.EntityByComponents(gazebo::components::World());
+  auto component = _ecm.Component<GasEmitterIndexComponent>(world);
+  if (nullptr != component)
+    return component->Data();
+
+  auto index = std::make_shared<GasEmitterIndex>();
+  _ecm.CreateComponent(world, GasEmitterIndexComponent(index));
+  return index;
+}
+}
+
+IGN_GAZEBO_REGISTER_COMPONENT("subt_components.GasEmitterIndex",
+    GasEmitterIndexComponent)
+
 //////////////////////////////////////////////////
 class subt::GasDetectorPrivate
 {
@@ -63,11 +257,34 @@ class subt::GasDetectorPrivate
   /// \brief publisher to publish detections
   public: transport::Node::Publisher pub;
 
-  /// \brief update rate
-  public: double updateRate;
+  /// \brief Period of evaluating the detector. Zero evaluates it on every
+  /// update.
+  public: std::chrono::steady_clock::duration updatePeriod{0};
+
+  /// \brief Period of publishing an unchanged detection. Zero publishes
+  /// every evaluation.
+  public: std::chrono::steady_clock::duration heartbeatPeriod{0};
+
+  /// \brief Simulation time of the next evaluation.
+  public: std::chrono::steady_clock::duration nextUpdate{0};
+
+  /// \brief Simulation time of the last evaluation.
+  public: std::chrono::steady_clock::duration lastUpdate{0};
+
+  /// \brief Simulation time of the last publication.
+  public: std::chrono::steady_clock::duration lastPublish{0};
+
+  /// \brief Whether anything was published yet.
+  public: bool published{false};
+
+  /// \brief Sorted ids of the gas detection types. Empty accepts all types.
+  public: std::vector<uint32_t> detectorTypes;
 
-  /// \brief gas detection types
-  public: std::set<std::string> detectorTypes;
+  /// \brief Index of the gas emitters.
+  public: std::shared_ptr<GasEmitterIndex> index;
+
+  /// \brief The last published message.
+  public: msgs::Boolean msg;
 
   /// \brief Entity this sensor is attached to
   public: gazebo::Entity entity;
@@ -85,6 +302,8 @@ void GasEmitter::Configure(const gazebo::Entity &_entity,
     gazebo::EntityComponentManager &_ecm,
     gazebo::EventManager & /*_eventMgr*/)
 {
+  auto index = EmitterIndex(_ecm);
+
   sdf::ElementPtr gasElem = const_cast<sdf::Element*>(
       _sdf.get())->GetElement("emitter");
 
@@ -102,10 +321,12 @@ void GasEmitter::Configure(const gazebo::Entity &_entity,
     _ecm.CreateComponent(entity, gazebo::components::Geometry(geometry));
     _ecm.CreateComponent(entity, gazebo::components::Pose(pose));
 
+    bool hasWorldPose = false;
     if (_ecm.EntityHasComponentType(_entity,
                                     gazebo::components::World::typeId))
     {
       _ecm.CreateComponent(entity, gazebo::components::WorldPose(pose));
+      hasWorldPose = true;
     }
     else if (_ecm.EntityHasComponentType(_entity,
                                          gazebo::components::Model::typeId))
@@ -113,8 +334,19 @@ void GasEmitter::Configure(const gazebo::Entity &_entity,
       auto model_pose = _ecm.Component<gazebo::components::Pose>(_entity);
       pose += model_pose->Data();
       _ecm.CreateComponent(entity, gazebo::components::WorldPose(pose));
+      hasWorldPose = true;
     }
 
+    auto emitterBox = geometry.BoxShape();
+    if (nullptr == emitterBox)
+    {
+      ignerr << "Geometry of gas emitter [" << entity << "] is not a box, "
+             << "it will not be detected." << std::endl;
+    }
+    else if (hasWorldPose)
+    {
+      index->Add(index->InternType(gasType), emitterBox->Size(), pose);
+    }
 
     gasElem = gasElem->GetNextElement("emitter");
   }
@@ -137,32 +369,44 @@ void GasDetector::Configure(
     gazebo::EventManager & /*_eventMgr*/)
 {
   this->dataPtr->entity = _entity;
+  this->dataPtr->index = EmitterIndex(_ecm);
 
   // Split up space delimited gas types
   auto gasType = _sdf->Get<std::string>("type", "").first;
-  auto gasTypes = common::Split(gasType, ' ');
-  if (gasType != "")
+  for (const auto &type : common::Split(gasType, ' '))
   {
-    this->dataPtr->detectorTypes =
-      std::set<std::string>(gasTypes.begin(), gasTypes.end());
+    if (!type.empty())
+    {
+      this->dataPtr->detectorTypes.push_back(
+          this->dataPtr->index->InternType(type));
+    }
   }
+  std::sort(this->dataPtr->detectorTypes.begin(),
+      this->dataPtr->detectorTypes.end());
 
   auto topic = _sdf->Get<std::string>("topic",
       gazebo::scopedName(_entity, _ecm) + "/leak").first;
-  this->dataPtr->updateRate = _sdf->Get<double>("update_rate", 0.0).first;
 
-
-  if (this->dataPtr->updateRate > 0.0)
+  const auto updateRate = _sdf->Get<double>("update_rate", 0.0).first;
+  if (updateRate > 0.0)
   {
-    transport::AdvertiseMessageOptions opts;
-    opts.SetMsgsPerSec(this->dataPtr->updateRate);
-    this->dataPtr->pub =  this->dataPtr->node.Advertise<msgs::Boolean>(
-        topic, opts);
+    this->dataPtr->updatePeriod =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / updateRate));
   }
-  else
+
+  const auto heartbeatPeriod =
+    _sdf->Get<double>("heartbeat_period", 1.0).first;
+  if (heartbeatPeriod > 0.0)
   {
-    this->dataPtr->pub =  this->dataPtr->node.Advertise<msgs::Boolean>(topic);
+    this->dataPtr->heartbeatPeriod =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(heartbeatPeriod));
   }
+
+  // The detector is evaluated at most at the update rate, so the publisher
+  // is not throttled; throttling in wall time could drop a change.
+  this->dataPtr->pub =  this->dataPtr->node.Advertise<msgs::Boolean>(topic);
 }
 
 //////////////////////////////////////////////////
@@ -173,41 +417,33 @@ void GasDetector::PostUpdate(
   if (_info.paused)
     return;
 
-  auto detectorPose = gazebo::worldPose(this->dataPtr->entity, _ecm);
-  auto detected = false;
+  auto &data = *this->dataPtr;
 
-  _ecm.Each<GasType,
-            gazebo::components::WorldPose,
-            gazebo::components::Geometry>(
-    [&](const gazebo::Entity &_entity,
-        const GasType *_gasType,
-        const gazebo::components::WorldPose *_worldPose,
-        const gazebo::components::Geometry *_geometry)
-    {
-      // If the set is empty, accept all types.
-      if (this->dataPtr->detectorTypes.size() == 0 ||
-          this->dataPtr->detectorTypes.count(_gasType->Data())) {
-        auto emitterBox = _geometry->Data().BoxShape();
-        if (nullptr == emitterBox)
-        {
-          ignerr << "Internal error: geometry of gas emitter [" << _entity
-                << "] missing box." << std::endl;
-        }
-        else
-        {
-          ignition::math::OrientedBoxd emitterVolume { emitterBox->Size(),
-                                                       _worldPose->Data() };
-          if (emitterVolume.Contains(detectorPose.Pos())) {
-            detected = true;
-          }
-        }
-      }
-      return true;
-    });
+  // Evaluate at the update rate. If time went back, e.g. after a reset,
+  // evaluate immediately.
+  const bool wentBack = _info.simTime < data.lastUpdate;
+  if (!wentBack && _info.simTime < data.nextUpdate)
+    return;
+  data.lastUpdate = _info.simTime;
+  data.nextUpdate = (wentBack ? _info.simTime : data.nextUpdate) +
+    data.updatePeriod;
+  if (data.nextUpdate <= _info.simTime)
+    data.nextUpdate = _info.simTime + data.updatePeriod;
+
+  auto detectorPose = gazebo::worldPose(data.entity, _ecm);
+  const bool detected =
+    data.index->Detect(detectorPose.Pos(), data.detectorTypes);
+
+  const bool heartbeat = data.heartbeatPeriod.count() == 0 ||
+    _info.simTime < data.lastPublish ||
+    _info.simTime - data.lastPublish >= data.heartbeatPeriod;
+  if (data.published && detected == data.msg.data() && !heartbeat)
+    return;
 
-  msgs::Boolean msg;
-  msg.mutable_header()->mutable_stamp()->CopyFrom(
+  data.msg.mutable_header()->mutable_stamp()->CopyFrom(
       gazebo::convert<msgs::Time>(_info.simTime));
-  msg.set_data(detected);
-  this->dataPtr->pub.Publish(msg);
+  data.msg.set_data(detected);
+  data.pub.Publish(data.msg);
+  data.published = true;
+  data.lastPublish = _info.simTime;
 }
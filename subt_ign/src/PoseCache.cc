@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+
+#include <ignition/common/Console.hh>
+#include <subt_ign/PoseCache.hh>
+
+using namespace subt;
+
+const int PoseCache::kInvalidId;
+const size_t PoseCache::kMaxWatched;
+
+/////////////////////////////////////////////////
+bool PoseCache::IsStaticBreadcrumb(const std::string &_name)
+{
+  return _name.find("__breadcrumb__") != std::string::npos &&
+         _name.find("__static__") != std::string::npos;
+}
+
+/////////////////////////////////////////////////
+int PoseCache::Intern(const std::string &_name)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto iter = this->ids.find(_name);
+  if (iter != this->ids.end())
+    return iter->second;
+
+  const int id = static_cast<int>(this->slots.size());
+  this->slots.emplace_back();
+  this->ids[_name] = id;
+
+  // Bind the entities already seen with this name.
+  for (auto it = this->entityNames.begin(); it != this->entityNames.end();)
+  {
+    if (it->second == _name)
+    {
+      this->entitySlots[it->first] = id;
+      this->watchedEntities.erase(it->first);
+      it = this->entityNames.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  // A watched model keeps its pose.
+  auto watchedIter = this->watched.find(_name);
+  if (watchedIter != this->watched.end())
+  {
+    this->slots[id] = watchedIter->second;
+    this->watched.erase(watchedIter);
+    this->watchOrder.erase(std::find(this->watchOrder.begin(),
+      this->watchOrder.end(), _name));
+  }
+  return id;
+}
+
+/////////////////////////////////////////////////
+int PoseCache::Id(const std::string &_name) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto iter = this->ids.find(_name);
+  return iter == this->ids.end() ? kInvalidId : iter->second;
+}
+
+/////////////////////////////////////////////////
+bool PoseCache::Pose(int _id, ignition::math::Pose3d &_pose) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (_id < 0 || _id >= static_cast<int>(this->slots.size()) ||
+      !this->slots[_id].valid)
+  {
+    return false;
+  }
+
+  _pose = this->slots[_id].pose;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool PoseCache::Pose(const std::string &_name,
+                     ignition::math::Pose3d &_pose) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  const Slot *slot = nullptr;
+  auto iter = this->ids.find(_name);
+  if (iter != this->ids.end())
+  {
+    slot = &this->slots[iter->second];
+  }
+  else
+  {
+    auto watchedIter = this->watched.find(_name);
+    if (watchedIter != this->watched.end())
+      slot = &watchedIter->second;
+  }
+
+  if (!slot || !slot->valid)
+    return false;
+
+  _pose = slot->pose;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool PoseCache::Watch(const std::string &_name)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->ids.find(_name) != this->ids.end() ||
+      this->watched.find(_name) != this->watched.end())
+  {
+    return true;
+  }
+
+  std::vector<uint32_t> entities;
+  for (const auto &entity : this->entityNames)
+  {
+    if (entity.second == _name)
+      entities.push_back(entity.first);
+  }
+  if (entities.empty())
+    return false;
+
+  if (this->watched.size() >= kMaxWatched)
+  {
+    const std::string &oldest = this->watchOrder.front();
+    for (auto it = this->watchedEntities.begin();
+         it != this->watchedEntities.end();)
+    {
+      if (it->second == oldest)
+        it = this->watchedEntities.erase(it);
+      else
+        ++it;
+    }
+    this->watched.erase(oldest);
+    this->watchOrder.pop_front();
+  }
+
+  this->watched[_name] = Slot();
+  this->watchOrder.push_back(_name);
+  for (uint32_t entity : entities)
+    this->watchedEntities[entity] = _name;
+  return true;
+}
+
+/////////////////////////////////////////////////
+ignition::common::Time PoseCache::SimTime() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->simTime;
+}
+
+/////////////////////////////////////////////////
+void PoseCache::OnPoses(const ignition::msgs::Pose_V &_msg)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  // Store sim time if present
+  if (_msg.has_header() && _msg.header().has_stamp())
+  {
+    this->simTime.Set(_msg.header().stamp().sec(),
+        _msg.header().stamp().nsec());
+  }
+
+  for (int i = 0; i < _msg.pose_size(); ++i)
+  {
+    const ignition::msgs::Pose &pose = _msg.pose(i);
+
+    // Entities are looked up by name only the first time they are seen.
+    auto iter = this->entitySlots.find(pose.id());
+    if (iter == this->entitySlots.end())
+    {
+      auto idIter = this->ids.find(pose.name());
+      iter = this->entitySlots.emplace(pose.id(),
+        idIter == this->ids.end() ? kInvalidId : idIter->second).first;
+
+      if (iter->second == kInvalidId)
+      {
+        this->entityNames[pose.id()] = pose.name();
+        if (this->watched.find(pose.name()) != this->watched.end())
+          this->watchedEntities[pose.id()] = pose.name();
+      }
+
+      // In case the creation event of the breadcrumb was missed.
+      if (IsStaticBreadcrumb(pose.name()))
+        this->AddBreadcrumb(pose.name(), ignition::msgs::Convert(pose).Pos());
+    }
+
+    Slot *slot = nullptr;
+    if (iter->second != kInvalidId)
+    {
+      slot = &this->slots[iter->second];
+    }
+    else if (!this->watchedEntities.empty())
+    {
+      auto watchedIter = this->watchedEntities.find(pose.id());
+      if (watchedIter != this->watchedEntities.end())
+        slot = &this->watched[watchedIter->second];
+    }
+
+    if (!slot)
+      continue;
+
+    slot->pose = ignition::msgs::Convert(pose);
+    slot->valid = true;
+  }
+}
+
+/////////////////////////////////////////////////
+void PoseCache::OnScene(const ignition::msgs::Scene &_msg)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  for (int i = 0; i < _msg.model_size(); ++i)
+  {
+    const ignition::msgs::Model &model = _msg.model(i);
+
+    // Static breadcrumbs don't move, so their pose at creation is final.
+    if (IsStaticBreadcrumb(model.name()))
+    {
+      this->AddBreadcrumb(model.name(),
+        ignition::msgs::Convert(model.pose()).Pos());
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+void PoseCache::AddBreadcrumb(const std::string &_name,
+                              const ignition::math::Vector3d &_position)
+{
+  if (this->breadcrumbs.emplace(_name, _position).second)
+  {
+    igndbg << "Breadcrumb [" << _name << "] created" << std::endl;
+    this->newBreadcrumbs = true;
+  }
+}
+
+/////////////////////////////////////////////////
+bool PoseCache::NewBreadcrumbs(
+    std::set<ignition::math::Vector3d> &_breadcrumbs)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->newBreadcrumbs)
+    return false;
+
+  _breadcrumbs.clear();
+  for (const auto &breadcrumb : this->breadcrumbs)
+    _breadcrumbs.insert(breadcrumb.second);
+  this->newBreadcrumbs = false;
+  return true;
+}
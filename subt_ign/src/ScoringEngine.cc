@@ -0,0 +1,1913 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <ignition/common/Console.hh>
+#include <ignition/common/Filesystem.hh>
+#include <ignition/common/Util.hh>
+#include <ignition/math/Helpers.hh>
+#include <ignition/msgs/Utility.hh>
+
+#include "subt_ign/ArtifactScorer.hh"
+#include "subt_ign/Common.hh"
+#include "subt_ign/ScoringEngine.hh"
+
+using namespace ignition;
+using namespace subt;
+
+class subt::ScoringEnginePrivate
+{
+  /// \brief Write a simulation timestamp to the text log.
+  /// \param[in] _simTime Current sim time.
+  /// \return The text log stream.
+  public: std::ofstream &Log(const ignition::msgs::Time &_simTime);
+
+  /// \brief Write an event to events.yml under a new unique id.
+  /// \param[in] _body The event fields.
+  /// \return The id assigned to the event.
+  public: int LogEvent(const std::string &_body);
+
+  /// \brief Log a robot event and invoke the robot event callback.
+  /// \param[in] _simTime Sim time of the event.
+  /// \param[in] _type Event type.
+  /// \param[in] _robot Robot name.
+  public: void RobotEvent(const ignition::msgs::Time &_simTime,
+                          const std::string &_type,
+                          const std::string &_robot);
+
+  /// \brief Invoke the robot event callback, if any.
+  /// \param[in] _simTime Sim time of the event.
+  /// \param[in] _type Event type.
+  /// \param[in] _robot Robot name.
+  /// \param[in] _eventId Unique id of the event.
+  public: void PublishRobotEvent(const ignition::msgs::Time &_simTime,
+                                 const std::string &_type,
+                                 const std::string &_robot,
+                                 int _eventId);
+
+  /// \brief Invoke the region event callback, if any.
+  /// \param[in] _simTime Sim time of the event.
+  /// \param[in] _type Event type.
+  /// \param[in] _robot Robot name.
+  /// \param[in] _detector Detector or model name.
+  /// \param[in] _state Event state.
+  /// \param[in] _eventId Unique id of the event.
+  public: void PublishRegionEvent(const ignition::msgs::Time &_simTime,
+                                  const std::string &_type,
+                                  const std::string &_robot,
+                                  const std::string &_detector,
+                                  const std::string &_state,
+                                  int _eventId);
+
+  /// \brief Calculate the score of a new artifact request.
+  /// \param[in] _simTime Simulation time.
+  /// \param[in] _type The object type. See ArtifactType.
+  /// \param[in] _pose The object pose, in the artifact origin frame.
+  /// \param[out] _outcome Outcome to fill with the report details.
+  /// \return A tuple where the first parameter is the score obtained for
+  /// this report, and the second parameter is true if the artifact report
+  /// is a duplicate and false otherwise.
+  public: std::tuple<double, bool> ScoreArtifact(
+              const ignition::msgs::Time &_simTime,
+              const ArtifactType &_type,
+              const ignition::msgs::Pose &_pose,
+              ArtifactReportOutcome &_outcome);
+
+  /// \brief Update the score.yml, summary.yml and run.yml files.
+  /// \param[in] _simTime Current sim time.
+  /// \return The time point used to calculate the elapsed real time.
+  public: std::chrono::steady_clock::time_point UpdateScoreFiles(
+              const ignition::msgs::Time &_simTime);
+
+  /// \brief Log robot pos data.
+  public: void LogRobotPosData();
+
+  /// \brief Gather the run statistics.
+  /// \param[in] _simTime Current sim time.
+  /// \param[in] _realElapsed Elapsed real time in seconds.
+  /// \param[in] _simElapsed Elapsed sim time in seconds.
+  /// \return The statistics.
+  public: RunStatistics Statistics(const ignition::msgs::Time &_simTime,
+                                   int _realElapsed, int _simElapsed) const;
+
+  /// \brief Write the run statistics to run.yml.
+  /// \param[in] _logPath Directory of the run files.
+  /// \param[in] _stats The statistics.
+  public: static void WriteRunStatistics(const std::string &_logPath,
+                                         const RunStatistics &_stats);
+
+  /// \brief Hand a statistics snapshot to the writer thread. A snapshot
+  /// that has not been written yet is replaced.
+  /// \param[in] _stats The statistics.
+  public: void QueueRunStatistics(RunStatistics &&_stats);
+
+  /// \brief Wait until the writer thread has written the last snapshot.
+  public: void FlushRunStatistics();
+
+  /// \brief Writer thread, writes run.yml in the background.
+  public: void RunStatisticsWriter();
+
+  /// \brief Round input number n down to the nearest mulitple of m
+  /// \param[in] _n Input number
+  /// \param[in] _m Multiple
+  /// \return Number rounded down to nearest multiple of m
+  public: static double FloorMultiple(double _n, double _m);
+
+  /// \brief Get the index of a robot, adding it if it is new.
+  /// \param[in] _name Robot name.
+  /// \return Index of the robot.
+  public: std::size_t RobotIndex(const std::string &_name);
+
+  /// \brief Update the pose of a robot, accumulating distance, velocity
+  /// and elevation statistics.
+  /// \param[in] _index Robot index.
+  /// \param[in] _simTime Sim time of the pose.
+  /// \param[in] _pose World pose of the robot.
+  /// \return True if this is the first pose received for the robot.
+  public: bool UpdateRobotPose(std::size_t _index,
+              const ignition::msgs::Time &_simTime,
+              const ignition::math::Pose3d &_pose);
+
+  /// \brief Mutex protecting all the data below.
+  public: std::recursive_mutex mutex;
+
+  /// \brief Logpath.
+  public: std::string logPath{"/dev/null"};
+
+  /// \brief The world name.
+  public: std::string worldName = "default";
+
+  /// \brief Log file output stream.
+  public: std::ofstream logStream;
+
+  /// \brief Event file output stream.
+  public: std::ofstream eventStream;
+
+  /// \brief Counter to create unique id for events
+  public: int eventCounter = 0;
+
+  /// \brief Whether the task has started.
+  public: bool started = false;
+
+  /// \brief Whether the task has finished.
+  public: bool finished = false;
+
+  /// \brief Start time used for scoring.
+  public: std::chrono::steady_clock::time_point startTime;
+
+  /// \brief The simulation time of the start call.
+  public: ignition::msgs::Time startSimTime;
+
+  /// \brief Elapsed real time in seconds when the run finished.
+  public: int finishRealElapsed = 0;
+
+  /// \brief Elapsed sim time in seconds when the run finished.
+  public: int finishSimElapsed = 0;
+
+  /// \brief Spatial index of all the artifacts and the unique reports
+  /// received so far.
+  public: ArtifactScorer scorer;
+
+  /// \brief Counter to track unique identifiers.
+  public: uint32_t reportCount = 0u;
+
+  /// \brief Counter to track duplicate artifact reports
+  public: uint32_t duplicateReportCount = 0u;
+
+  /// \brief The maximum number of times that a team can attempt an
+  /// artifact report.
+  public: uint32_t reportCountLimit = 40u;
+
+  /// \brief The total number of artifacts.
+  public: uint32_t artifactCount = 20u;
+
+  /// \brief Total score.
+  public: double totalScore = 0.0;
+
+  /// \brief Closest artifact report. The elements are: artifact name, type,
+  /// true pos, reported pos, distance between true pos and reported pos
+  public: std::tuple<std::string, std::string, ignition::math::Vector3d,
+      ignition::math::Vector3d, double> closestReport{"", "",
+      ignition::math::Vector3d::Zero, ignition::math::Vector3d::Zero, -1};
+
+  /// \brief First artifact report time
+  public: double firstReportTime = -1;
+
+  /// \brief Last artifact report time
+  public: double lastReportTime = -1;
+
+  /// \brief The pose of the object marking the origin of the artifacts.
+  public: ignition::math::Pose3d artifactOriginPose;
+
+  /// \brief Statistics of a robot, updated as pose samples come in.
+  public: struct RobotAggregates
+  {
+    /// \brief Timestamped pose samples not written to pos-data yet. The
+    /// last sample written is kept to compute the next velocity.
+    std::vector<std::pair<std::chrono::steady_clock::duration,
+        ignition::math::Pose3d>> poseData;
+
+    /// \brief Starting pose.
+    ignition::math::Pose3d startPose;
+
+    /// \brief Pose of the last sample.
+    ignition::math::Pose3d prevPose;
+
+    /// \brief Distance traveled.
+    double distance = 0;
+
+    /// \brief Max euclidean distance from the starting pose.
+    double maxEuclideanDistance = 0;
+
+    /// \brief Average velocity.
+    double avgVel = 0;
+
+    /// \brief Number of samples in the average velocity, including the
+    /// starting pose.
+    uint64_t velCount = 1;
+
+    /// \brief Cumulative elevation gain.
+    double elevationGain = 0;
+
+    /// \brief Cumulative elevation loss.
+    double elevationLoss = 0;
+  };
+
+  /// \brief Statistics of each robot, indexed by robot index.
+  public: std::vector<RobotAggregates> robotStats;
+
+  /// \brief Name of each robot, indexed by robot index.
+  public: std::vector<std::string> robotStatsNames;
+
+  /// \brief Map of robot name to robot index.
+  public: std::map<std::string, std::size_t> robotStatsIndex;
+
+  /// \brief Robot indices sorted by robot name, the order in which events
+  /// and files of several robots are written.
+  public: std::vector<std::size_t> robotsByName;
+
+  /// \brief The state of the robots checked on every update, as parallel
+  /// arrays indexed by robot index.
+  public: struct RobotKinematics
+  {
+    /// \brief Position of the last sample.
+    std::vector<double> x, y, z;
+
+    /// \brief Sim time of the last sample in seconds.
+    std::vector<double> time;
+
+    /// \brief Z component of the robot's z axis in the last sample.
+    std::vector<double> upZ;
+
+    /// \brief Nonzero once the robot has a sample.
+    std::vector<uint8_t> hasPose;
+
+    /// \brief Nonzero if the robot is due for a new sample.
+    std::vector<uint8_t> due;
+
+    /// \brief Nonzero if the robot is upside down.
+    std::vector<uint8_t> upsideDown;
+
+    /// \brief Nonzero once the flip state of the robot is tracked.
+    std::vector<uint8_t> flipTracked;
+
+    /// \brief Nonzero if a flip of the robot has been logged.
+    std::vector<uint8_t> flipped;
+
+    /// \brief Sim time in seconds at which the most recent flip started.
+    std::vector<int64_t> flipStart;
+  };
+
+  /// \brief Kinematic state of the robots.
+  public: RobotKinematics kinematics;
+
+  /// \brief Step size for elevation gain / loss
+  public: double elevationStepSize = 5.0;
+
+  /// \brief Robot name with the max velocity
+  public: RobotMetric maxRobotVel = {"", 0};
+
+  /// \brief Robot name with the max average velocity
+  public: RobotMetric maxRobotAvgVel = {"", 0};
+
+  /// \brief Robot name with the max distance traveled;
+  public: RobotMetric maxRobotDistance = {"", 0};
+
+  /// \brief Robot name with the max euclidean distance from starting area;
+  public: RobotMetric maxRobotEuclideanDistance  = {"", 0};
+
+  /// \brief Robot name with the max cumulative elevation gain;
+  public: RobotMetric maxRobotElevationGain = {"", 0};
+
+  /// \brief Robot name with the max cumulative elevation loss;
+  public: RobotMetric maxRobotElevationLoss = {"", 0};
+
+  /// \brief Robot name with the max elevation reached;
+  public: RobotMetric maxRobotElevation = {"", 0};
+
+  /// \brief Robot name with the min elevation reached;
+  public: RobotMetric minRobotElevation = {"", 0};
+
+  /// \brief Total distanced traveled by all robots
+  public: double robotsTotalDistance = 0;
+
+  /// \brief Total cumulative elevation gain by all robots
+  public: double robotsTotalElevationGain = 0;
+
+  /// \brief Total cumulative elevation loss by all robots
+  public: double robotsTotalElevationLoss = 0;
+
+  /// \brief A map of robot name and its pos output stream
+  public: std::map<std::string, std::shared_ptr<std::ofstream>> robotPosStream;
+
+  /// \brief Names of the spawned robots.
+  public: std::set<std::string> robotNames;
+
+  /// \brief Robot types for keeping track of unique robot platform types.
+  public: std::set<std::string> robotTypes;
+
+  /// \brief Map of robot name to {platform, config}. For example:
+  /// {"X1", "X1_SENSOR_CONFIG_1"}.
+  public: std::map<std::string, std::pair<std::string, std::string>>
+          robotFullTypes;
+
+  /// \brief The set of marsupial pairs.
+  public: std::map<std::string, std::string> marsupialPairs;
+
+  /// \brief Models with dead batteries.
+  public: std::set<std::string> deadBatteries;
+
+  /// \brief Map of model name to {sim_time_sec, deployments_over_max}. This
+  /// map is used to log when no more rock falls are possible for a rock
+  /// fall model.
+  public: std::map<std::string, std::pair<int, int>> rockFallsMax;
+
+  /// \brief Map of model name to bool. This map is used to log when no more
+  /// dynamic collapses are possible for a model.
+  public: std::map<std::string, bool> dynamicCollapseMax;
+
+  /// \brief Map of model name to deployments_over_max. This map
+  /// is used to log when no more breadcrumbs are possible for a robot.
+  public: std::map<std::string, int> breadcrumbsMax;
+
+  /// \brief Time at which the summary.yaml file was last updated.
+  public: std::chrono::steady_clock::time_point lastUpdateScoresTime;
+
+  /// \brief Robot event callback.
+  public: ScoringEngine::RobotEventCallback robotEventCb;
+
+  /// \brief Region event callback.
+  public: ScoringEngine::RegionEventCallback regionEventCb;
+
+  /// \brief Kinematic state callback.
+  public: ScoringEngine::KinematicStateCallback kinematicStateCb;
+
+  /// \brief Statistics callback.
+  public: ScoringEngine::StatisticsCallback statisticsCb;
+
+  /// \brief Incremented whenever a value of the run statistics, other than
+  /// the elapsed times, changes.
+  public: uint64_t statsVersion = 1u;
+
+  /// \brief Value of statsVersion in the last snapshot taken.
+  public: uint64_t snapshotStatsVersion = 0u;
+
+  /// \brief Mutex protecting the writer data below. It is never held
+  /// while waiting for the engine mutex.
+  public: std::mutex writerMutex;
+
+  /// \brief Notified when a snapshot is queued, when a snapshot has been
+  /// written and on shutdown.
+  public: std::condition_variable writerCv;
+
+  /// \brief Snapshot waiting to be written, null if none.
+  public: std::unique_ptr<RunStatistics> pendingStats;
+
+  /// \brief Directory where the pending snapshot is written.
+  public: std::string pendingStatsPath;
+
+  /// \brief True while the writer thread is writing a snapshot.
+  public: bool writingStats = false;
+
+  /// \brief True to stop the writer thread.
+  public: bool stopWriter = false;
+
+  /// \brief Thread that writes run.yml.
+  public: std::thread writerThread;
+};
+
+/////////////////////////////////////////////////
+ScoringEngine::ScoringEngine()
+  : dataPtr(new ScoringEnginePrivate)
+{
+  this->dataPtr->writerThread = std::thread(
+      &ScoringEnginePrivate::RunStatisticsWriter, this->dataPtr.get());
+}
+
+/////////////////////////////////////////////////
+ScoringEngine::~ScoringEngine()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->dataPtr->writerMutex);
+    this->dataPtr->stopWriter = true;
+  }
+  this->dataPtr->writerCv.notify_all();
+  this->dataPtr->writerThread.join();
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::Load(const std::string &_logPath,
+    const std::string &_filenamePrefix, const std::string &_worldName)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->logPath = _logPath;
+  this->dataPtr->worldName = _worldName;
+
+  // Open the log file.
+  this->dataPtr->logStream.open(
+      (this->dataPtr->logPath + "/" + _filenamePrefix + "_" +
+      ignition::common::systemTimeISO() + ".log").c_str(), std::ios::out);
+
+  // Open the event log file.
+  this->dataPtr->eventStream.open(
+      (this->dataPtr->logPath + "/events.yml").c_str(), std::ios::out);
+
+  // Set the report limit to 25 for final worlds.
+  if (this->dataPtr->worldName.find("final") != std::string::npos)
+    this->dataPtr->reportCountLimit = 25;
+  this->dataPtr->statsVersion++;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetElevationStepSize(double _size)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->elevationStepSize = _size;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetReportCountLimit(uint32_t _limit)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->reportCountLimit = _limit;
+  this->dataPtr->statsVersion++;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetRobotEventCallback(const RobotEventCallback &_cb)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->robotEventCb = _cb;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetRegionEventCallback(const RegionEventCallback &_cb)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->regionEventCb = _cb;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetKinematicStateCallback(
+    const KinematicStateCallback &_cb)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->kinematicStateCb = _cb;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetStatisticsCallback(const StatisticsCallback &_cb)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->statisticsCb = _cb;
+}
+
+/////////////////////////////////////////////////
+std::ofstream &ScoringEngine::Log(const ignition::msgs::Time &_simTime)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->Log(_simTime);
+}
+
+/////////////////////////////////////////////////
+int ScoringEngine::LogEvent(const std::string &_body)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->LogEvent(_body);
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetArtifactOrigin(const ignition::math::Pose3d &_pose)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->artifactOriginPose = _pose;
+}
+
+/////////////////////////////////////////////////
+ignition::math::Pose3d ScoringEngine::ArtifactOrigin() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->artifactOriginPose;
+}
+
+/////////////////////////////////////////////////
+bool ScoringEngine::SetArtifact(const ArtifactType &_type,
+    const std::string &_name, const ignition::math::Pose3d &_pose)
+{
+  ignition::math::Vector3d localizationPoint =
+    ArtifactLocalizationPoint(_type, _pose);
+
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  if (!this->dataPtr->scorer.SetArtifact(_type, _name, localizationPoint))
+    return false;
+
+  // Helper variable that is the total number of artifacts.
+  this->dataPtr->artifactCount++;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool ScoringEngine::AddRobot(const std::string &_name)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  if (!this->dataPtr->robotNames.insert(_name).second)
+    return false;
+
+  this->dataPtr->statsVersion++;
+  return true;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetRobotType(const std::string &_name,
+    const std::string &_platform, const std::string &_config)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->robotTypes.insert(_platform);
+  this->dataPtr->robotFullTypes[_name] = {_platform, _config};
+  this->dataPtr->statsVersion++;
+}
+
+/////////////////////////////////////////////////
+std::string ScoringEngine::RobotPlatform(const std::string &_name) const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  auto iter = this->dataPtr->robotFullTypes.find(_name);
+  if (iter == this->dataPtr->robotFullTypes.end())
+    return "";
+  return iter->second.first;
+}
+
+/////////////////////////////////////////////////
+std::map<std::string, std::pair<std::string, std::string>>
+ScoringEngine::RobotFullTypes() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->robotFullTypes;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::SetMarsupialPair(const std::string &_parent,
+    const std::string &_child)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->marsupialPairs[_parent] = _child;
+  this->dataPtr->statsVersion++;
+}
+
+/////////////////////////////////////////////////
+std::map<std::string, std::string> ScoringEngine::MarsupialPairs() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->marsupialPairs;
+}
+
+/////////////////////////////////////////////////
+bool ScoringEngine::Start(const ignition::msgs::Time &_simTime)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  bool result = false;
+
+  if (!this->dataPtr->started && !this->dataPtr->finished)
+  {
+    result = true;
+    this->dataPtr->started = true;
+    this->dataPtr->startTime = std::chrono::steady_clock::now();
+    this->dataPtr->startSimTime = _simTime;
+    this->dataPtr->statsVersion++;
+    ignmsg << "Scoring has Started" << std::endl;
+    this->dataPtr->Log(_simTime) << "scoring_started" << std::endl;
+
+    std::ostringstream stream;
+    stream
+      << "  type: started\n"
+      << "  time_sec: " << _simTime.sec() << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+  }
+
+  // Update files when scoring has started.
+  this->dataPtr->UpdateScoreFiles(_simTime);
+
+  return result;
+}
+
+/////////////////////////////////////////////////
+bool ScoringEngine::Finish(const ignition::msgs::Time &_simTime)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  if (this->dataPtr->finished)
+    return false;
+
+  // Update the score.yml and summary.yml files. This function also
+  // returns the time point used to calculate the elapsed real time. By
+  // returning this time point, we can make sure that this function (the
+  // ::Finish function) uses the same time point. The final elapsed times
+  // always go to run.yml, and it is complete when this function returns.
+  this->dataPtr->statsVersion++;
+  std::chrono::steady_clock::time_point currTime =
+    this->dataPtr->UpdateScoreFiles(_simTime);
+  this->dataPtr->FlushRunStatistics();
+
+  if (this->dataPtr->started)
+  {
+    // Elapsed time
+    int realElapsed = std::chrono::duration_cast<std::chrono::seconds>(
+        currTime - this->dataPtr->startTime).count();
+    int simElapsed = _simTime.sec() - this->dataPtr->startSimTime.sec();
+
+    ignmsg << "Scoring has finished. Elapsed real time: "
+          << realElapsed << " seconds. Elapsed sim time: "
+          << simElapsed << " seconds. " << std::endl;
+
+    this->dataPtr->Log(_simTime) << "finished_elapsed_real_time "
+      << realElapsed << " s." << std::endl;
+    this->dataPtr->Log(_simTime) << "finished_elapsed_sim_time "
+      << simElapsed << " s." << std::endl;
+    this->dataPtr->Log(_simTime) << "finished_score "
+      << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->logStream.flush();
+
+    std::ostringstream stream;
+    stream
+      << "  type: finished\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  elapsed_real_time: " << realElapsed << "\n"
+      << "  elapsed_sim_time: " << simElapsed << "\n"
+      << "  total_score: " << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+
+    this->dataPtr->finishRealElapsed = realElapsed;
+    this->dataPtr->finishSimElapsed = simElapsed;
+  }
+
+  this->dataPtr->finished = true;
+  return true;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::LogRecordingComplete(const ignition::msgs::Time &_simTime)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  if (!this->dataPtr->started)
+    return;
+
+  std::ostringstream stream;
+  stream
+    << "  type: recording_complete\n"
+    << "  time_sec: " << _simTime.sec() << "\n"
+    << "  elapsed_real_time: " << this->dataPtr->finishRealElapsed << "\n"
+    << "  elapsed_sim_time: " << this->dataPtr->finishSimElapsed << "\n"
+    << "  total_score: " << this->dataPtr->totalScore << std::endl;
+  this->dataPtr->LogEvent(stream.str());
+}
+
+/////////////////////////////////////////////////
+bool ScoringEngine::Started() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->started;
+}
+
+/////////////////////////////////////////////////
+bool ScoringEngine::Finished() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->finished;
+}
+
+/////////////////////////////////////////////////
+ignition::msgs::Time ScoringEngine::StartSimTime() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->startSimTime;
+}
+
+/////////////////////////////////////////////////
+double ScoringEngine::TotalScore() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->totalScore;
+}
+
+/////////////////////////////////////////////////
+uint32_t ScoringEngine::ReportCount() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->reportCount;
+}
+
+/////////////////////////////////////////////////
+uint32_t ScoringEngine::ReportCountLimit() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->reportCountLimit;
+}
+
+/////////////////////////////////////////////////
+ArtifactReportOutcome ScoringEngine::ReportArtifact(
+    const ignition::msgs::Time &_simTime, uint32_t _type,
+    const ignition::msgs::Pose &_pose)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  ArtifactReportOutcome outcome;
+  ArtifactType artifactType;
+
+  if (this->dataPtr->started && this->dataPtr->finished)
+  {
+    outcome.status = "scoring finished";
+    std::ostringstream stream;
+    stream
+      << "  type: artifact_report_score_finished\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  total_score: " << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+  }
+  else if (!this->dataPtr->started && !this->dataPtr->finished)
+  {
+    outcome.status = "run not started";
+    std::ostringstream stream;
+    stream
+      << "  type: artifact_report_not_started\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  total_score: " << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+  }
+  else if (this->dataPtr->reportCount >= this->dataPtr->reportCountLimit)
+  {
+    outcome.status = "report limit exceeded";
+    std::ostringstream stream;
+    stream
+      << "  type: artifact_report_limit_exceeded\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  total_score: " << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+    outcome.finish = true;
+  }
+  else if (!ArtifactFromInt(_type, artifactType))
+  {
+    std::ostringstream stream;
+    stream
+      << "  type: artifact_report_unknown_artifact\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  total_score: " << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+
+    ignerr << "Unknown artifact code. The number should be between 0 and "
+          << kArtifactTypes.size() - 1 << " but we received "
+          << _type << std::endl;
+
+    this->dataPtr->Log(_simTime)
+      <<"error Unknown artifact code. The number should be between "
+      << "0 and " << kArtifactTypes.size() - 1
+      << " but we received " << _type << std::endl;
+    outcome.status = "scored";
+  }
+  else
+  {
+    auto [scoreDiff, duplicate] = this->dataPtr->ScoreArtifact(_simTime,
+        artifactType, _pose, outcome);
+
+    outcome.scoreChange = scoreDiff;
+    outcome.status = "scored";
+
+    if (!duplicate)
+    {
+      this->dataPtr->totalScore += scoreDiff;
+      outcome.scored = true;
+    }
+
+    ignmsg << "Total score: " << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->Log(_simTime)
+      << "new_total_score " << this->dataPtr->totalScore << std::endl;
+  }
+
+  outcome.reportId = this->dataPtr->reportCount;
+  outcome.totalScore = this->dataPtr->totalScore;
+
+  if (outcome.finish || this->dataPtr->finished)
+    return outcome;
+
+  // Finish if the maximum score has been reached, or if the maximum number
+  // of artifact reports has been reached.
+  if (this->dataPtr->totalScore >= this->dataPtr->artifactCount)
+  {
+    ignmsg << "Max score has been reached. Congratulations!" << std::endl;
+    outcome.finish = true;
+  }
+  else if (this->dataPtr->reportCount >= this->dataPtr->reportCountLimit)
+  {
+    outcome.status = "report limit reached";
+    this->dataPtr->Log(_simTime) << "report_limit_reached" << std::endl;
+    ignmsg << "Report limit reached." << std::endl;
+
+    std::ostringstream stream;
+    stream
+      << "  type: artifact_report_limit_reached\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  total_score: " << this->dataPtr->totalScore << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+    outcome.finish = true;
+  }
+  else
+  {
+    // Update the score files, in case something bad happens. Finish
+    // will also update the score files.
+    this->dataPtr->UpdateScoreFiles(_simTime);
+  }
+
+  return outcome;
+}
+
+/////////////////////////////////////////////////
+std::size_t ScoringEngine::RobotIndex(const std::string &_name)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->RobotIndex(_name);
+}
+
+/////////////////////////////////////////////////
+bool ScoringEngine::UpdateRobotPose(const ignition::msgs::Time &_simTime,
+    const std::string &_name, const ignition::math::Pose3d &_pose)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->UpdateRobotPose(this->dataPtr->RobotIndex(_name),
+      _simTime, _pose);
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::UpdateRobotPoses(const ignition::msgs::Time &_simTime,
+    const RobotPoses &_poses)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  ScoringEnginePrivate::RobotKinematics &kin = this->dataPtr->kinematics;
+
+  const double t = _simTime.sec() + static_cast<double>(_simTime.nsec())*1e-9;
+  const std::size_t count = std::min(_poses.valid.size(), kin.x.size());
+
+  // Find the robots due for a new sample: the first one, or one after the
+  // robot traveled more than 1 m or 1 s of sim time elapsed. The loop has
+  // no branches, so that it can be vectorized.
+  const double *x = _poses.x.data();
+  const double *y = _poses.y.data();
+  const double *z = _poses.z.data();
+  const uint8_t *valid = _poses.valid.data();
+  uint8_t *due = kin.due.data();
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const double dx = x[i] - kin.x[i];
+    const double dy = y[i] - kin.y[i];
+    const double dz = z[i] - kin.z[i];
+    const double dist2 = dx * dx + dy * dy + dz * dz;
+    due[i] = valid[i] & ((kin.hasPose[i] == 0u) | (dist2 > 1.0) |
+        (t - kin.time[i] > 1.0));
+  }
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    if (!due[i])
+      continue;
+    this->dataPtr->UpdateRobotPose(i, _simTime, ignition::math::Pose3d(
+        x[i], y[i], z[i], _poses.qw[i], _poses.qx[i], _poses.qy[i],
+        _poses.qz[i]));
+  }
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::CheckRobotFlip(const ignition::msgs::Time &_simTime)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  ScoringEnginePrivate::RobotKinematics &kin = this->dataPtr->kinematics;
+
+  // Get cos(theta) between the world's z-axis and the robot's z-axis
+  // If they are in opposite directions (cos(theta) close to -1), robot is
+  // flipped
+  const std::size_t count = kin.upZ.size();
+  for (std::size_t i = 0; i < count; ++i)
+    kin.upsideDown[i] = std::abs(-1 - kin.upZ[i]) <= 0.1;
+
+  for (std::size_t i : this->dataPtr->robotsByName)
+  {
+    if (!kin.hasPose[i])
+      continue;
+
+    if (!kin.flipTracked[i])
+    {
+      kin.flipTracked[i] = 1u;
+      kin.flipStart[i] = _simTime.sec();
+      kin.flipped[i] = 0u;
+      continue;
+    }
+
+    if (kin.upsideDown[i])
+    {
+      // make sure the robot has been flipped for a few seconds before
+      // logging a flip (avoid false positives)
+      auto simElapsed = _simTime.sec() - kin.flipStart[i];
+      if (!kin.flipped[i] && (simElapsed >= 3))
+      {
+        kin.flipped[i] = 1u;
+        this->dataPtr->RobotEvent(_simTime, "flip",
+            this->dataPtr->robotStatsNames[i]);
+      }
+    }
+    else
+    {
+      kin.flipStart[i] = _simTime.sec();
+      kin.flipped[i] = 0u;
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::RobotEvent(const ignition::msgs::Time &_simTime,
+    const std::string &_type, const std::string &_robot)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->RobotEvent(_simTime, _type, _robot);
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::BatteryState(const ignition::msgs::Time &_simTime,
+    const std::string &_robot, double _percentage)
+{
+  if (_percentage > 0)
+    return;
+
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+
+  // Make sure the event is logged once.
+  if (this->dataPtr->deadBatteries.insert(_robot).second)
+    this->dataPtr->RobotEvent(_simTime, "dead_battery", _robot);
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::BreadcrumbDeploy(const ignition::msgs::Time &_simTime,
+    const std::string &_robot)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  std::ostringstream stream;
+  stream
+    << "  type: breadcrumb_deploy\n"
+    << "  time_sec: " << _simTime.sec() << "\n"
+    << "  robot: " << _robot << std::endl;
+  int id = this->dataPtr->LogEvent(stream.str());
+
+  // Only publish if max breadcrumbs has not been reached.
+  auto iter = this->dataPtr->breadcrumbsMax.find(_robot);
+  if (iter == this->dataPtr->breadcrumbsMax.end() || iter->second <= 0)
+    this->dataPtr->PublishRobotEvent(_simTime, "breadcrumb_deploy", _robot, id);
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::BreadcrumbDeployRemaining(
+    const ignition::msgs::Time &_simTime, const std::string &_robot,
+    int _remaining)
+{
+  if (_remaining != 0)
+    return;
+
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  int &deploymentsOverMax = this->dataPtr->breadcrumbsMax[_robot];
+  if (deploymentsOverMax > 0)
+  {
+    // Do not publish if max breadcrumbs have already been deployed
+    std::ostringstream stream;
+    stream
+      << "  type: max_breadcrumb_deploy\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  robot: " << _robot << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+  }
+
+  deploymentsOverMax++;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::DynamicCollapse(const ignition::msgs::Time &_simTime,
+    const std::string &_model)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  bool &deployed = this->dataPtr->dynamicCollapseMax[_model];
+  if (deployed)
+    return;
+
+  std::ostringstream stream;
+  stream
+    << "  type: dynamic_collapse\n"
+    << "  time_sec: " << _simTime.sec() << "\n"
+    << "  model: " << _model << std::endl;
+  int id = this->dataPtr->LogEvent(stream.str());
+  this->dataPtr->PublishRegionEvent(_simTime, "dynamic_collapse", "", _model,
+      "dynamic_collapse", id);
+  deployed = true;
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::RockFallRemaining(const ignition::msgs::Time &_simTime,
+    const std::string &_model, int _remaining)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  std::pair<int, int> &rockFall = this->dataPtr->rockFallsMax[_model];
+
+  // Sim time is used to make sure that we report only once per rock fall,
+  // and not once for every rock in the rock fall.
+  if (rockFall.first == _simTime.sec())
+    return;
+
+  if (_remaining == 0 && rockFall.second == 1)
+  {
+    // Don't publish this event.
+    std::ostringstream stream;
+    stream
+      << "  type: max_rock_falls\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  model: " << _model << std::endl;
+    this->dataPtr->LogEvent(stream.str());
+  }
+  else if (_remaining != 0 || rockFall.second == 0)
+  {
+    std::ostringstream stream;
+    stream
+      << "  type: rock_fall\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  model: " << _model << std::endl;
+    int id = this->dataPtr->LogEvent(stream.str());
+    this->dataPtr->PublishRegionEvent(_simTime, "rock_fall", "", _model,
+        "rock_fall", id);
+  }
+
+  if (_remaining == 0)
+    rockFall.second++;
+  rockFall.first = _simTime.sec();
+}
+
+/////////////////////////////////////////////////
+void ScoringEngine::DetectorEvent(const ignition::msgs::Time &_simTime,
+    int64_t _stampSec, const std::string &_detector,
+    const std::string &_robot, const std::string &_state,
+    const std::map<std::string, std::string> &_extraData)
+{
+  // Default to detect
+  std::string regionEventType;
+  std::ostringstream stream;
+  stream
+    << "  type: detect\n"
+    << "  time_sec: " << _stampSec << "\n"
+    << "  detector: " << _detector << "\n"
+    << "  robot: " << _robot << "\n"
+    << "  state: " << _state << std::endl;
+  if (!_extraData.empty())
+  {
+    stream << "  extra:\n";
+    for (const auto &data : _extraData)
+    {
+      // there should be only 1 key-value pair. Just in case, we will grab
+      // only the first. The key is currently always "type", which we can
+      // ignore when sending the ROS message.
+      if (regionEventType.empty())
+      {
+        if (data.second.find("performer_detector_rockfall") ==
+            std::string::npos)
+        {
+          regionEventType = data.second;
+        }
+      }
+
+      stream << "    "
+        << data.first << ": " << data.second << std::endl;
+    }
+  }
+  // Default to "detect" if not set.
+  if (regionEventType.empty())
+    regionEventType = "detect";
+
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  int id = this->dataPtr->LogEvent(stream.str());
+  this->dataPtr->PublishRegionEvent(_simTime, regionEventType, _robot,
+      _detector, _state, id);
+}
+
+/////////////////////////////////////////////////
+std::chrono::steady_clock::time_point ScoringEngine::UpdateScoreFiles(
+    const ignition::msgs::Time &_simTime)
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->UpdateScoreFiles(_simTime);
+}
+
+/////////////////////////////////////////////////
+std::chrono::steady_clock::time_point
+ScoringEngine::LastUpdateScoresTime() const
+{
+  std::lock_guard<std::recursive_mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->lastUpdateScoresTime;
+}
+
+/////////////////////////////////////////////////
+std::ofstream &ScoringEnginePrivate::Log(const ignition::msgs::Time &_simTime)
+{
+  this->logStream << _simTime.sec()
+                  << " " << _simTime.nsec() << " ";
+  return this->logStream;
+}
+
+/////////////////////////////////////////////////
+int ScoringEnginePrivate::LogEvent(const std::string &_body)
+{
+  int id = this->eventCounter++;
+  this->eventStream << "- event:\n  id: " << id << "\n" << _body;
+  this->eventStream.flush();
+  return id;
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::RobotEvent(const ignition::msgs::Time &_simTime,
+    const std::string &_type, const std::string &_robot)
+{
+  std::ostringstream stream;
+  stream
+    << "  type: " << _type << "\n"
+    << "  time_sec: " << _simTime.sec() << "\n"
+    << "  robot: " << _robot << std::endl;
+  int id = this->LogEvent(stream.str());
+  this->PublishRobotEvent(_simTime, _type, _robot, id);
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::PublishRobotEvent(
+    const ignition::msgs::Time &_simTime, const std::string &_type,
+    const std::string &_robot, int _eventId)
+{
+  if (this->robotEventCb)
+    this->robotEventCb(_simTime, _type, _robot, _eventId);
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::PublishRegionEvent(
+    const ignition::msgs::Time &_simTime, const std::string &_type,
+    const std::string &_robot, const std::string &_detector,
+    const std::string &_state, int _eventId)
+{
+  if (this->regionEventCb)
+    this->regionEventCb(_simTime, _type, _robot, _detector, _state, _eventId);
+}
+
+/////////////////////////////////////////////////
+std::tuple<double, bool> ScoringEnginePrivate::ScoreArtifact(
+    const ignition::msgs::Time &_simTime,
+    const ArtifactType &_type, const ignition::msgs::Pose &_pose,
+    ArtifactReportOutcome &_outcome)
+{
+  // Sanity check: Make sure that we have crossed the starting gate.
+  if (!this->started)
+  {
+    ignmsg << "  The task hasn't started yet" << std::endl;
+    this->Log(_simTime) << "task_not_started" << std::endl;
+    return {0.0, false};
+  }
+
+  // Sanity check: Make sure that we still have artifacts.
+  if (this->scorer.FoundCount() >= this->artifactCount)
+  {
+    ignmsg << "  No artifacts remaining" << std::endl;
+    this->Log(_simTime) << "no_remaining_artifacts_of_specified_type"
+      << std::endl;
+    return {0.0, false};
+  }
+
+  // The teams are reporting the artifact poses relative to the fiducial located
+  // in the staging area. Now, we convert the reported pose to world coordinates
+  ignition::math::Pose3d artifactPose = ignition::msgs::Convert(_pose);
+  ignition::math::Pose3d pose = artifactPose + this->artifactOriginPose;
+  ignition::math::Vector3d observedObjectPose = pose.Pos();
+
+  // Type converted into a string.
+  std::string reportType;
+  if (!StringFromArtifact(_type, reportType))
+  {
+    ignmsg << "Unknown artifact type" << std::endl;
+    this->Log(_simTime) << "Unkown artifact type reported" << std::endl;
+
+    std::ostringstream stream;
+    stream
+      << "  type: unknown_artifact_type\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  reported_pose_world_frame: " << observedObjectPose << "\n"
+      << "  reported_pose_artifact_frame: " << artifactPose.Pos() << "\n"
+      << "  reported_artifact_type: " << reportType << "\n";
+    this->LogEvent(stream.str());
+
+    return {0.0, false};
+  }
+
+  // Check whether we received the same report before, and find out which
+  // artifact of the reported type is closer (Euclidean distance) to the
+  // location of this request.
+  ArtifactReportResult result = this->scorer.Score(_type, artifactPose.Pos(),
+      observedObjectPose);
+
+  if (result.duplicate)
+  {
+    ignmsg << "This report has been received before" << std::endl;
+    this->Log(_simTime) << "This report has been received before" << std::endl;
+
+    std::ostringstream stream;
+    stream
+      << "  type: duplicate_artifact_report\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  reported_pose_world_frame: " << observedObjectPose << "\n"
+      << "  reported_pose_artifact_frame: " << artifactPose.Pos() << "\n"
+      << "  reported_artifact_type: " << reportType << "\n";
+    this->LogEvent(stream.str());
+
+    this->duplicateReportCount++;
+    this->statsVersion++;
+    return {result.score, true};
+  }
+
+  // This is a unique report.
+  this->reportCount++;
+  this->statsVersion++;
+
+  double score = result.score;
+  const ArtifactMatch &minDistance = result.match;
+  if (score > 0)
+  {
+    this->Log(_simTime) << "found_artifact "
+      << minDistance.name << std::endl;
+
+    // collect artifact report data for logging
+    // update closest artifact reported so far
+    double closestDist = std::get<4>(this->closestReport);
+    if (closestDist < 0.0 || minDistance.distance < closestDist)
+    {
+      // the elements are name, type, true pos, reported pos, dist
+      std::get<0>(this->closestReport) = minDistance.name;
+      std::get<1>(this->closestReport) = reportType;
+      std::get<2>(this->closestReport) = minDistance.pos;
+      std::get<3>(this->closestReport) = observedObjectPose;
+      std::get<4>(this->closestReport) = minDistance.distance;
+    }
+    // compute sim time of this report
+    double reportTime = _simTime.sec() + _simTime.nsec() * 1e-9;
+    this->lastReportTime = reportTime;
+    if (this->firstReportTime < 0)
+      this->firstReportTime = reportTime;
+  }
+
+  auto outDist = std::isinf(minDistance.distance) ? -1 : minDistance.distance;
+
+  {
+    std::ostringstream stream;
+    stream
+      << "  type: artifact_report_attempt\n"
+      << "  time_sec: " << _simTime.sec() << "\n"
+      << "  reported_pose_world_frame: " << observedObjectPose << "\n"
+      << "  reported_pose_artifact_frame: " << artifactPose.Pos() << "\n"
+      << "  reported_artifact_type: " << reportType << "\n"
+      << "  closest_artifact_name: " << minDistance.name << "\n"
+      << "  distance: " <<  outDist << "\n"
+      << "  points_scored: " << score << "\n"
+      << "  total_score: " << this->totalScore + score << std::endl;
+    this->LogEvent(stream.str());
+  }
+
+  _outcome.reportedType = reportType;
+  _outcome.reportedPos = artifactPose.Pos();
+  _outcome.closestArtifactName = minDistance.name;
+  _outcome.distance = outDist;
+
+  this->Log(_simTime) << "calculated_dist[" << minDistance.distance
+    << "] for artifact[" << minDistance.name << "] reported_pos["
+    << artifactPose.Pos() << "]" << std::endl;
+
+  ignmsg << "  [Total]: " << score << std::endl;
+  this->Log(_simTime) << "modified_score " << score << std::endl;
+
+  return {score, false};
+}
+
+/////////////////////////////////////////////////
+std::chrono::steady_clock::time_point ScoringEnginePrivate::UpdateScoreFiles(
+    const ignition::msgs::Time &_simTime)
+{
+  // Elapsed time
+  int realElapsed = 0;
+  int simElapsed = 0;
+  std::chrono::steady_clock::time_point currTime =
+    std::chrono::steady_clock::now();
+
+  if (this->started)
+  {
+    simElapsed = _simTime.sec() - this->startSimTime.sec();
+    realElapsed = std::chrono::duration_cast<std::chrono::seconds>(
+        currTime - this->startTime).count();
+  }
+
+  // Output a run summary
+  std::ofstream summary(this->logPath + "/summary.yml", std::ios::out);
+
+  summary << "was_started: " << this->started << std::endl;
+  summary << "sim_time_duration_sec: " << simElapsed << std::endl;
+  summary << "real_time_duration_sec: " << realElapsed << std::endl;
+  summary << "model_count: " << this->robotNames.size() << std::endl;
+  summary.flush();
+
+  // Output a score file with just the final score
+  std::ofstream score(this->logPath + "/score.yml", std::ios::out);
+  score << this->totalScore << std::endl;
+  score.flush();
+
+  this->LogRobotPosData();
+
+  // The statistics are aggregated as data comes in, so a snapshot is cheap.
+  // A new snapshot is only taken when a value changed, and run.yml is
+  // written by the writer thread.
+  if (this->snapshotStatsVersion != this->statsVersion)
+  {
+    this->snapshotStatsVersion = this->statsVersion;
+    RunStatistics stats = this->Statistics(_simTime, realElapsed, simElapsed);
+    if (this->statisticsCb)
+      this->statisticsCb(stats);
+    this->QueueRunStatistics(std::move(stats));
+  }
+
+  this->lastUpdateScoresTime = currTime;
+  return currTime;
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::LogRobotPosData()
+{
+  std::string path = common::joinPaths(this->logPath, "pos-data");
+
+  // remove previous pos data on start
+  if (this->lastUpdateScoresTime.time_since_epoch().count() == 0u)
+  {
+    common::removeAll(path);
+    common::createDirectory(path);
+  }
+
+  // log robot pos data
+  for (std::size_t index : this->robotsByName)
+  {
+    std::vector<std::pair<std::chrono::steady_clock::duration,
+        ignition::math::Pose3d>> &robotPoseData =
+          this->robotStats[index].poseData;
+    // Robots may be registered before their first pose.
+    if (robotPoseData.empty())
+      continue;
+    const std::string &robotName = this->robotStatsNames[index];
+
+    // create the pos data file if it does not exist yet
+    std::shared_ptr<std::ofstream> posStream;
+    auto streamIt = this->robotPosStream.find(robotName);
+    bool fileExists = true;
+    if (streamIt == this->robotPosStream.end())
+    {
+      std::string file = common::joinPaths(path, robotName + "-pos.data");
+      std::shared_ptr<std::ofstream> logFile =
+          std::make_shared<std::ofstream>(file, std::ios::ate);
+      this->robotPosStream[robotName] = logFile;
+      posStream = logFile;
+      fileExists = false;
+    }
+    else
+    {
+      posStream = streamIt->second;
+    }
+
+    // write to file only if there are new data, or it is the first time.
+    // Note that robot pos data should always have at least 1 (latest) pos data
+    // in the vector which is used by UpdateRobotPose for computating robot
+    // distance traveled and vel data
+    if (!fileExists || robotPoseData.size() > 1u)
+    {
+      auto poseData = std::move(robotPoseData);
+      auto posIt = poseData.begin();
+
+      // if file already exists, it is not the first time we are writing out
+      // pos data. So the first entry in the vector should be the last pos
+      // data that was already written out to file so skip it
+      if (fileExists)
+        posIt++;
+      for(; posIt != poseData.end(); ++posIt)
+      {
+        int64_t s, ns;
+        std::tie(s, ns) = ignition::math::durationToSecNsec(posIt->first);
+        math::Vector3d pos = posIt->second.Pos();
+        // sec nsec x y z
+        *posStream << s << " " << ns << " " << pos << std::endl;
+      }
+      posStream->flush();
+
+      // make sure to push the latest pos data back in the vector
+      robotPoseData.clear();
+      robotPoseData.push_back({poseData.back().first, poseData.back().second});
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+RunStatistics ScoringEnginePrivate::Statistics(
+    const ignition::msgs::Time &_simTime, int _realElapsed,
+    int _simElapsed) const
+{
+  RunStatistics stats;
+  stats.timestamp = _simTime;
+  stats.worldName = this->worldName;
+  stats.reportCountLimit = this->reportCountLimit;
+  stats.robots = this->robotFullTypes;
+  stats.marsupials = this->marsupialPairs;
+
+  stats.artifactsFound = this->scorer.FoundCount();
+  stats.robotCount = this->robotNames.size();
+  stats.uniqueRobotCount = this->robotTypes.size();
+  stats.simTimeElapsed = _simElapsed;
+  stats.realTimeElapsed = _realElapsed;
+  stats.artifactReportCount = this->reportCount;
+  stats.duplicateReportCount = this->duplicateReportCount;
+
+  std::tie(stats.closestReportName, stats.closestReportType,
+      stats.closestReportTruePos, stats.closestReportReportedPos,
+      stats.closestReportDistance) = this->closestReport;
+  stats.firstReportTime = this->firstReportTime;
+  stats.lastReportTime = this->lastReportTime;
+  if (stats.artifactsFound > 1)
+  {
+    stats.meanTimeBetweenReports =
+      (this->lastReportTime - this->firstReportTime) /
+      (stats.artifactsFound - 1);
+  }
+
+  stats.greatestDistanceTraveled = this->maxRobotDistance;
+  stats.greatestEuclideanDistanceFromStart = this->maxRobotEuclideanDistance;
+  stats.totalDistanceTraveled = this->robotsTotalDistance;
+  stats.greatestMaxVel = this->maxRobotVel;
+  stats.greatestAvgVel = this->maxRobotAvgVel;
+
+  stats.greatestElevationGain = this->maxRobotElevationGain;
+  stats.greatestElevationLoss = this->maxRobotElevationLoss;
+  stats.totalElevationGain = this->robotsTotalElevationGain;
+  stats.totalElevationLoss = this->robotsTotalElevationLoss;
+  stats.maxElevationReached = this->maxRobotElevation;
+  stats.minElevationReached = this->minRobotElevation;
+  return stats;
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::WriteRunStatistics(const std::string &_logPath,
+    const RunStatistics &_stats)
+{
+  // output robot and artifact data to a yml file
+  // 1. Number of artifacts found.
+  // 2. Robot count
+  // 3. Unique robot count (for example, a team of two X1_SENSOR_CONFIG_1
+  // robots would have a unique count of 1).
+  // 4. Total simulation time.
+  // 5. Total real time.
+  // 6. Number of artifact report attempts
+  // 7. Number of duplicate artifact reports.
+  // 8. Closest artifact report:
+  //      a. Distance in meters.
+  //      b. True position of the artifact.
+  //      c. Reported position.
+  //      d. Artifact type and name.
+  // 9. First artifact report time.
+  // 10. Last artifact report time.
+  // 11. Mean time between success reports
+  // 12. Greatest distance traveled by a robot on the team.
+  // 13. Greatest euclidean distance traveled by a robot from the staging area.
+  // 14. Total distance traveled by all the robots.
+  // 15. Greatest maximum velocity by a robot.
+  // 16. Greatest average velocity.
+  // 17. Greatest cumulative elevation gain by a robot on the team
+  // 18. Greatest cumulative elevation loss by a robot on the team
+  // 19. Total cumulative elevation gain by all the robots.
+  // 20. Total cumulative elevation loss by all the robots.
+  // 21. Max elevation reached by a robot
+  // 22. Min elevation reached by a robot
+  // 23. Robot configurations and marsupial pairs.
+  YAML::Emitter out;
+  out << YAML::BeginMap;
+
+  out << YAML::Key << "world_name";
+  out << YAML::Value  << _stats.worldName;
+  out << YAML::Key << "report_count_limit";
+  out << YAML::Value  << _stats.reportCountLimit;
+  out << YAML::Key << "robots";
+  out << YAML::Value << YAML::BeginMap;
+  for (auto const &pair : _stats.robots)
+  {
+    out << YAML::Key << pair.first;
+    out << YAML::Value << YAML::BeginMap;
+    out << YAML::Key << "platform" << YAML::Value << pair.second.first;
+    out << YAML::Key << "config" << YAML::Value << pair.second.second;
+    out << YAML::EndMap;
+  }
+  out << YAML::EndMap;
+
+  out << YAML::Key << "marsupials";
+  out << YAML::Value << YAML::BeginMap;
+  for (auto const &pair : _stats.marsupials)
+    out << YAML::Key << pair.first << YAML::Value << pair.second;
+  out << YAML::EndMap;
+
+  // artifact data
+  out << YAML::Key << "artifacts_found";
+  out << YAML::Value << _stats.artifactsFound;
+  out << YAML::Key << "robot_count";
+  out << YAML::Value << _stats.robotCount;
+  out << YAML::Key << "unique_robot_count";
+  out << YAML::Value << _stats.uniqueRobotCount;
+  out << YAML::Key << "sim_time";
+  out << YAML::Value << _stats.simTimeElapsed;
+  out << YAML::Key << "real_time";
+  out << YAML::Value << _stats.realTimeElapsed;
+  out << YAML::Key << "artifact_report_count";
+  out << YAML::Value << _stats.artifactReportCount;
+  out << YAML::Key << "duplicate_report_count";
+  out << YAML::Value << _stats.duplicateReportCount;
+
+  std::stringstream artifactPos;
+  artifactPos << _stats.closestReportTruePos;
+  std::stringstream reportedPos;
+  reportedPos << _stats.closestReportReportedPos;
+
+  out << YAML::Key << "closest_artifact_report";
+  out << YAML::Value << YAML::BeginMap
+      << YAML::Key << "name"
+      << YAML::Value << _stats.closestReportName
+      << YAML::Key << "type"
+      << YAML::Value << _stats.closestReportType
+      << YAML::Key << "true_pos"
+      << YAML::Value << artifactPos.str()
+      << YAML::Key << "reported_pos"
+      << YAML::Value << reportedPos.str()
+      << YAML::Key << "distance"
+      << YAML::Value << _stats.closestReportDistance
+      << YAML::EndMap;
+  out << YAML::Key << "first_artifact_report";
+  out << YAML::Value << _stats.firstReportTime;
+  out << YAML::Key << "last_artifact_report";
+  out << YAML::Value << _stats.lastReportTime;
+  out << YAML::Key << "mean_time_between_successful_artifact_reports";
+  out << YAML::Value << _stats.meanTimeBetweenReports;
+
+  // robot distance traveled and vel data
+  out << YAML::Key << "greatest_distance_traveled";
+  out << YAML::Value << _stats.greatestDistanceTraveled.second;
+  out << YAML::Key << "greatest_distance_traveled_robot";
+  out << YAML::Value << _stats.greatestDistanceTraveled.first;
+  out << YAML::Key << "greatest_euclidean_distance_from_start";
+  out << YAML::Value << _stats.greatestEuclideanDistanceFromStart.second;
+  out << YAML::Key << "greatest_euclidean_distance_from_start_robot";
+  out << YAML::Value << _stats.greatestEuclideanDistanceFromStart.first;
+  out << YAML::Key << "total_distance_traveled";
+  out << YAML::Value << _stats.totalDistanceTraveled;
+  out << YAML::Key << "greatest_max_vel";
+  out << YAML::Value << _stats.greatestMaxVel.second;
+  out << YAML::Key << "greatest_max_vel_robot";
+  out << YAML::Value << _stats.greatestMaxVel.first;
+  out << YAML::Key << "greatest_avg_vel";
+  out << YAML::Value << _stats.greatestAvgVel.second;
+  out << YAML::Key << "greatest_avg_vel_robot";
+  out << YAML::Value << _stats.greatestAvgVel.first;
+
+  // robot elevation data
+  out << YAML::Key << "greatest_elevation_gain";
+  out << YAML::Value << _stats.greatestElevationGain.second;
+  out << YAML::Key << "greatest_elevation_gain_robot";
+  out << YAML::Value << _stats.greatestElevationGain.first;
+  out << YAML::Key << "greatest_elevation_loss";
+  out << YAML::Value << _stats.greatestElevationLoss.second;
+  out << YAML::Key << "greatest_elevation_loss_robot";
+  out << YAML::Value << _stats.greatestElevationLoss.first;
+  out << YAML::Key << "total_elevation_gain";
+  out << YAML::Value << _stats.totalElevationGain;
+  out << YAML::Key << "total_elevation_loss";
+  out << YAML::Value << _stats.totalElevationLoss;
+  out << YAML::Key << "max_elevation_reached";
+  out << YAML::Value << _stats.maxElevationReached.second;
+  out << YAML::Key << "max_elevation_reached_robot";
+  out << YAML::Value << _stats.maxElevationReached.first;
+  out << YAML::Key << "min_elevation_reached";
+  out << YAML::Value << _stats.minElevationReached.second;
+  out << YAML::Key << "min_elevation_reached_robot";
+  out << YAML::Value << _stats.minElevationReached.first;
+
+  out << YAML::EndMap;
+
+  std::ofstream logFile(_logPath + "/run.yml", std::ios::out);
+  logFile << out.c_str() << std::endl;
+  logFile.flush();
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::QueueRunStatistics(RunStatistics &&_stats)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->writerMutex);
+    this->pendingStats = std::make_unique<RunStatistics>(std::move(_stats));
+    this->pendingStatsPath = this->logPath;
+  }
+  this->writerCv.notify_all();
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::FlushRunStatistics()
+{
+  std::unique_lock<std::mutex> lock(this->writerMutex);
+  this->writerCv.wait(lock, [this]
+      {
+        return !this->pendingStats && !this->writingStats;
+      });
+}
+
+/////////////////////////////////////////////////
+void ScoringEnginePrivate::RunStatisticsWriter()
+{
+  std::unique_lock<std::mutex> lock(this->writerMutex);
+  while (true)
+  {
+    this->writerCv.wait(lock, [this]
+        {
+          return this->pendingStats || this->stopWriter;
+        });
+
+    // Write the last snapshot before stopping.
+    if (!this->pendingStats)
+      return;
+
+    std::unique_ptr<RunStatistics> stats = std::move(this->pendingStats);
+    std::string path = this->pendingStatsPath;
+    this->writingStats = true;
+
+    lock.unlock();
+    WriteRunStatistics(path, *stats);
+    lock.lock();
+
+    this->writingStats = false;
+    this->writerCv.notify_all();
+  }
+}
+
+/////////////////////////////////////////////////
+std::size_t ScoringEnginePrivate::RobotIndex(const std::string &_name)
+{
+  auto it = this->robotStatsIndex.find(_name);
+  if (it != this->robotStatsIndex.end())
+    return it->second;
+
+  const std::size_t index = this->robotStats.size();
+  this->robotStatsIndex[_name] = index;
+  this->robotStatsNames.push_back(_name);
+  this->robotStats.emplace_back();
+
+  RobotKinematics &kin = this->kinematics;
+  const std::size_t count = index + 1;
+  for (auto *v : {&kin.x, &kin.y, &kin.z, &kin.time, &kin.upZ})
+    v->resize(count, 0.0);
+  for (auto *v : {&kin.hasPose, &kin.due, &kin.upsideDown, &kin.flipTracked,
+                  &kin.flipped})
+  {
+    v->resize(count, 0u);
+  }
+  kin.flipStart.resize(count, 0);
+
+  this->robotsByName.clear();
+  for (const auto &robot : this->robotStatsIndex)
+    this->robotsByName.push_back(robot.second);
+
+  return index;
+}
+
+/////////////////////////////////////////////////
+bool ScoringEnginePrivate::UpdateRobotPose(std::size_t _index,
+    const ignition::msgs::Time &_simTime, const ignition::math::Pose3d &_pose)
+{
+  // sim time
+  double t = _simTime.sec() + static_cast<double>(_simTime.nsec())*1e-9;
+  auto tDur =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>
+      (std::chrono::seconds(_simTime.sec()) +
+       std::chrono::nanoseconds(_simTime.nsec()));
+
+  const std::string &name = this->robotStatsNames[_index];
+  RobotAggregates &stats = this->robotStats[_index];
+  RobotKinematics &kin = this->kinematics;
+
+  // store robot pose and velocity data only if robot has traveled
+  // more than 1 meter
+  if (!kin.hasPose[_index])
+  {
+    stats.poseData.push_back(std::make_pair(tDur, _pose));
+    stats.startPose = _pose;
+    stats.prevPose = _pose;
+    kin.x[_index] = _pose.Pos().X();
+    kin.y[_index] = _pose.Pos().Y();
+    kin.z[_index] = _pose.Pos().Z();
+    kin.time[_index] = t;
+    kin.upZ[_index] = (_pose.Rot() * ignition::math::Vector3d(0, 0, 1)).Z();
+    kin.hasPose[_index] = 1u;
+    return true;
+  }
+
+  // Send robot pose information if the robot has traveled more then
+  // 1m or 1second of simulation time has elapsed.
+  if (stats.poseData.empty() ||
+      (stats.poseData.back().second.Pos().Distance(_pose.Pos()) <= 1.0 &&
+       t - stats.poseData.back().first.count() * 1e-9 <= 1.0))
+  {
+    return false;
+  }
+
+  //  time passed since last pose sample
+  double prevT = stats.poseData.back().first.count() * 1e-9;
+  double dt = t - prevT;
+
+  // sim paused?
+  if (dt <= 0)
+    return false;
+
+  // calculate robot velocity and speed
+  ignition::math::Pose3d p = _pose - this->artifactOriginPose;
+  math::Vector3d p1 = p.Pos();
+  math::Vector3d p2 = (stats.poseData.back().second -
+      this->artifactOriginPose).Pos();
+  double dx = p1.X() - p2.X();
+  double dy = p1.Y() - p2.Y();
+  double dz = p1.Z() - p2.Z();
+  double dist = sqrt(std::pow(dx, 2) + std::pow(dy, 2) +
+      std::pow(dz, 2));
+  double vel = dist / dt;
+
+  // publish the pose, velocity, and speed
+  if (this->kinematicStateCb)
+  {
+    KinematicState state;
+    state.pose = p;
+    state.velocity.Set(dx / dt, dy / dt, dz / dt);
+    state.speed = vel;
+    this->kinematicStateCb(_simTime, name, state);
+  }
+
+  // greatest max velocity by a robot
+  if (vel > this->maxRobotVel.second)
+  {
+    this->maxRobotVel.first = name;
+    this->maxRobotVel.second = vel;
+  }
+
+  // avg vel for this robot, the starting pose counts as a sample at rest.
+  stats.avgVel = (stats.avgVel * stats.velCount + vel) / (stats.velCount + 1);
+  stats.velCount++;
+
+  // greatest avg vel by a robot
+  if (stats.avgVel > this->maxRobotAvgVel.second)
+  {
+    this->maxRobotAvgVel.first = name;
+    this->maxRobotAvgVel.second = stats.avgVel;
+  }
+
+  stats.poseData.push_back(std::make_pair(tDur, _pose));
+
+  // compute and log greatest / total distance traveled and
+  // elevation changes
+
+  // distance traveled by this robot
+  double distanceDiff = stats.prevPose.Pos().Distance(_pose.Pos());
+  stats.distance += distanceDiff;
+
+  // greatest distance traveled by a robot
+  if (stats.distance > this->maxRobotDistance.second)
+  {
+    this->maxRobotDistance.first = name;
+    this->maxRobotDistance.second = stats.distance;
+  }
+
+  // max euclidean from starting pose for this robot
+  double euclideanDist = _pose.Pos().Distance(stats.startPose.Pos());
+  if (euclideanDist > stats.maxEuclideanDistance)
+      stats.maxEuclideanDistance = euclideanDist;
+
+  // greatest euclidean distance traveled by a robot
+  if (euclideanDist > this->maxRobotEuclideanDistance.second)
+  {
+    this->maxRobotEuclideanDistance.first = name;
+    this->maxRobotEuclideanDistance.second = euclideanDist;
+  }
+
+  // total distance traveled by all robots
+  this->robotsTotalDistance += distanceDiff;
+
+  // greatest elevation gain / loss
+  // Elevations are rounded down to nearest mulitple of the elevation
+  // step size
+  double elevationDiff = this->FloorMultiple(
+       _pose.Pos().Z(), this->elevationStepSize) -
+       this->FloorMultiple(
+       stats.prevPose.Pos().Z(), this->elevationStepSize);
+
+  if (elevationDiff > 0)
+  {
+    stats.elevationGain += elevationDiff;
+    if (stats.elevationGain > this->maxRobotElevationGain.second)
+    {
+      this->maxRobotElevationGain.first = name;
+      this->maxRobotElevationGain.second = stats.elevationGain;
+    }
+    // total elevation gain by all robots
+    this->robotsTotalElevationGain += elevationDiff;
+  }
+  else
+  {
+    stats.elevationLoss += elevationDiff;
+    if (stats.elevationLoss < this->maxRobotElevationLoss.second)
+    {
+      this->maxRobotElevationLoss.first = name;
+      this->maxRobotElevationLoss.second = stats.elevationLoss;
+    }
+    // total elevation loss by all robots
+    this->robotsTotalElevationLoss += elevationDiff;
+  }
+
+  // min / max elevation reached
+  double elevation = this->FloorMultiple(_pose.Pos().Z(),
+      this->elevationStepSize);
+  if (elevation > this->maxRobotElevation.second ||
+      this->maxRobotElevation.first.empty())
+  {
+    this->maxRobotElevation.first = name;
+    this->maxRobotElevation.second = elevation;
+  }
+
+  if (elevation < this->minRobotElevation.second ||
+      this->minRobotElevation.first.empty())
+  {
+    this->minRobotElevation.first = name;
+    this->minRobotElevation.second = elevation;
+  }
+  stats.prevPose = _pose;
+  kin.x[_index] = _pose.Pos().X();
+  kin.y[_index] = _pose.Pos().Y();
+  kin.z[_index] = _pose.Pos().Z();
+  kin.time[_index] = t;
+  kin.upZ[_index] = (_pose.Rot() * ignition::math::Vector3d(0, 0, 1)).Z();
+  this->statsVersion++;
+  return false;
+}
+
+
+/////////////////////////////////////////////////
+double ScoringEnginePrivate::FloorMultiple(double _n, double _m)
+{
+  double out = _n - fmod(_n, _m);
+  if (_n < 0)
+    out -= _m;
+  return out;
+}
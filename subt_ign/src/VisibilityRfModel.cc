@@ -19,6 +19,12 @@
 #include <ignition/common/Console.hh>
 #include <subt_ign/VisibilityRfModel.hh>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
 #include <ignition/math.hh>
 #include <ignition/common.hh>
 
@@ -31,6 +37,44 @@ using namespace visibilityModel;
 inline double dbmToPow(double x) { return 0.001 * pow(10., x / 10.); }
 inline double QPSKPowerToBER(double P, double N) { return erfc(sqrt(P / N)); }
 
+/// \brief Size of the packets the coverage is computed for (bytes).
+static const uint64_t kCoveragePacketSize = 100;
+
+/// \brief Number of samples a thread computes the coverage of at once.
+static const size_t kCoverageBlockSize = 4096;
+
+/// \brief Maximum number of coverages cached.
+static const size_t kMaxCachedCoverages = 8;
+
+/// \brief Maximum number of points of a coverage marker.
+static const size_t kMaxPointsPerMarker = 50000;
+
+/// \brief Namespace of the coverage markers.
+static const char kCoverageNamespace[] = "comms_coverage";
+
+/////////////////////////////////////////////
+/// \brief Level of coverage of a point, from the packet drop probability
+/// computed as in subt_communication_model/src/subt_communication_model.cpp
+/// \param[in] _rxPower Power received at the point (dBm).
+/// \param[in] _radio The radio.
+/// \return The level, from 0 to kCoverageLevels - 1.
+static int coverageLevel(double _rxPower,
+                         const communication_model::radio_configuration &_radio)
+{
+  // Based on rx_power, noise value, and modulation, compute the bit error
+  // rate (BER)
+  double ber = 0.0;
+  if (_radio.modulation == "QPSK")
+  {
+    ber = QPSKPowerToBER(dbmToPow(_rxPower), dbmToPow(_radio.noise_floor));
+  }
+  double packetDropProb = 1.0 - exp(kCoveragePacketSize * log(1 - ber));
+
+  // Scale packet drop probability to align with the color scheme
+  return std::clamp(static_cast<int>(floor(packetDropProb * 5.00001)), 0,
+                    kCoverageLevels - 1);
+}
+
 /////////////////////////////////////////////
 VisibilityModel::VisibilityModel(
     visibilityModel::RfConfiguration _visibilityConfig,
@@ -50,13 +94,42 @@ VisibilityModel::VisibilityModel(
   this->node.Advertise("/subt/comms_model/visualize",
       &VisibilityModel::VisualizeVisibility, this, opts);
 
-  // Subscribe to pose messages.
-  this->node.Subscribe("/world/" + _worldName + "/pose/info",
-      &VisibilityModel::OnPose, this);
+  this->coverageThread = std::thread(&VisibilityModel::CoverageLoop, this);
 
   this->initialized = true;
 }
 
+/////////////////////////////////////////////
+VisibilityModel::~VisibilityModel()
+{
+  if (this->coverageThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->coverageMutex);
+      this->stopCoverage = true;
+    }
+    this->abortCoverage = true;
+    this->coverageCv.notify_one();
+    this->coverageThread.join();
+  }
+}
+
+/////////////////////////////////////////////
+void VisibilityModel::SetPoseCache(std::shared_ptr<PoseCache> _poseCache)
+{
+  std::lock_guard<std::mutex> lock(this->coverageMutex);
+  this->poseCache = std::move(_poseCache);
+}
+
+/////////////////////////////////////////////
+void VisibilityModel::SetRadioConfiguration(
+  const communication_model::radio_configuration &_radio)
+{
+  std::lock_guard<std::mutex> lock(this->coverageMutex);
+  this->radio = _radio;
+  this->coverageCache.clear();
+}
+
 /////////////////////////////////////////////
 bool VisibilityModel::Initialized() const
 {
@@ -69,12 +142,14 @@ rf_power VisibilityModel::ComputeReceivedPower(const double &_txPower,
                                                radio_state &_rxState)
 {
   // Use this->visibilityTable.Cost(_txState, _rxState) to compute
-  // pathloss and thus, received power
-  VisibilityCost visibilityCost =
-    this->visibilityTable.Cost(_txState.pose.Pos(), _rxState.pose.Pos());
+  // pathloss and thus, received power. The cost is looked up by reference,
+  // it isn't copied.
+  const uint64_t rxTile = this->visibilityTable.Tile(_rxState.pose.Pos());
+  const VisibilityCost &visibilityCost = this->visibilityTable.Cost(
+    this->visibilityTable.Tile(_txState.pose.Pos()), rxTile);
 
   if (visibilityCost.cost > this->visibilityConfig.commsCostMax)
-    return {-std::numeric_limits<double>::infinity(), 0.0};
+    return {-std::numeric_limits<double>::infinity(), 0.0, true};
 
   range_model::rf_configuration localConfig = this->defaultRangeConfig;
 
@@ -100,27 +175,12 @@ rf_power VisibilityModel::ComputeReceivedPower(const double &_txPower,
     // This block considers breadcrumbs located in the tile of the destination
     // robot. Note that this breadcrumb is not included in the route but it
     // will be used for computing ranges.
+    const ignition::math::Vector3d *lastMileBc =
+      this->visibilityTable.LastMileBreadcrumb(rxTile);
+    if (lastMileBc)
     {
-      double distLastMile = 0;
-      int32_t x = std::round(_rxState.pose.Pos().X());
-      int32_t y = std::round(_rxState.pose.Pos().Y());
-      int32_t z = std::round(_rxState.pose.Pos().Z());
-      auto vertexId = std::make_tuple(x, y, z);
-
-      auto const &vertices = this->visibilityTable.Vertices();
-      auto it = vertices.find(vertexId);
-      if (it != vertices.end())
-      {
-        auto tileId = it->second;
-        auto const &breadcrumbs = this->visibilityTable.Breadcrumbs();
-        auto breadcrumbIt = breadcrumbs.find(tileId);
-        if (breadcrumbIt != breadcrumbs.end())
-        {
-          auto poseLastBc = breadcrumbIt->second.front();
-          distLastMile = poseLastBc.Distance(_rxState.pose.Pos());
-          distLastBreadcrumbToDestination = distLastMile;
-        }
-      }
+      distLastBreadcrumbToDestination =
+        lastMileBc->Distance(_rxState.pose.Pos());
     }
 
     range = std::max(distSourceToFirstBreadcrumb,
@@ -131,9 +191,14 @@ rf_power VisibilityModel::ComputeReceivedPower(const double &_txPower,
   // Option 1: Using log_normal_v2_received_power.
   rf_power rx = range_model::log_normal_v2_received_power(
     _txPower, range, visibilityCost.route.size(), localConfig);
-  igndbg << "Range: " << range << ", Exp: " << localConfig.fading_exponent
-         << ", Num hops: " << visibilityCost.route.size()
-         << ", TX: " << _txPower << ", RX: " << rx.mean << std::endl;
+  // Skip formatting the message when it would be discarded anyway, this is
+  // called for every pair of radios and every packet.
+  if (ignition::common::Console::Verbosity() >= 4)
+  {
+    igndbg << "Range: " << range << ", Exp: " << localConfig.fading_exponent
+           << ", Num hops: " << visibilityCost.route.size()
+           << ", TX: " << _txPower << ", RX: " << rx.mean << std::endl;
+  }
   // End option 1.
 
   // Option 2: Using log_normal_received_power.
@@ -161,119 +226,261 @@ rf_power VisibilityModel::ComputeReceivedPower(const double &_txPower,
 void VisibilityModel::PopulateVisibilityInfo(
   const std::set<ignition::math::Vector3d> &_relayPoses)
 {
-  this->visibilityTable.PopulateVisibilityInfo(_relayPoses);
+  // Give up the coverage being computed rather than waiting for it.
+  this->abortCoverage = true;
+  {
+    std::unique_lock<std::shared_mutex> tableLock(this->tableMutex);
+    this->visibilityTable.PopulateVisibilityInfo(_relayPoses);
+    this->abortCoverage = false;
+  }
+
+  std::lock_guard<std::mutex> lock(this->coverageMutex);
+  this->coverageCache.clear();
 }
 
 /////////////////////////////////////////////
-bool VisibilityModel::VisualizeVisibility(const ignition::msgs::StringMsg &_req,
-                                          ignition::msgs::Boolean &_rep)
+std::shared_ptr<const Coverage> VisibilityModel::ComputeCoverage(
+  const ignition::math::Vector3d &_from)
 {
-  _rep.set_data(false);
+  std::shared_lock<std::shared_mutex> tableLock(this->tableMutex);
+  const uint64_t tile = this->visibilityTable.Tile(_from);
 
-  std::map<int, ignition::msgs::Marker> perCostMarkers;
+  communication_model::radio_configuration localRadio;
+  {
+    std::lock_guard<std::mutex> lock(this->coverageMutex);
+    if (this->coverageSamples.empty())
+      this->SampleCoverage();
 
-  ignition::msgs::Marker markerMsg;
-  markerMsg.set_ns("default");
-  markerMsg.set_action(ignition::msgs::Marker::ADD_MODIFY);
-  markerMsg.set_type(ignition::msgs::Marker::POINTS);
-  markerMsg.clear_point();
-  markerMsg.mutable_lifetime()->set_sec(0.0);
-  markerMsg.mutable_lifetime()->set_nsec(0.0);
+    for (auto it = this->coverageCache.begin();
+         it != this->coverageCache.end(); ++it)
+    {
+      if (it->first == tile)
+      {
+        this->coverageCache.splice(this->coverageCache.begin(),
+                                   this->coverageCache, it);
+        return it->second;
+      }
+    }
+    localRadio = this->radio;
+  }
 
-  ignition::msgs::Set(markerMsg.mutable_pose(),
-                      ignition::math::Pose3d(0, 0, 0, 0, 0, 0));
+  // The samples don't change once taken. Each thread takes the next block
+  // of samples and writes their levels, so they share nothing else.
+  const std::vector<ignition::math::Vector3d> &samples =
+    this->coverageSamples;
+  std::vector<int> levels(samples.size(), kCoverageLevels - 1);
+  std::atomic<size_t> nextBlock{0};
+  auto work = [&]()
+  {
+    rf_interface::radio_state tx;
+    rf_interface::radio_state rx;
+    tx.pose.Set(_from.X(), _from.Y(), _from.Z(), 0, 0, 0);
+    while (!this->abortCoverage)
+    {
+      const size_t begin = kCoverageBlockSize * nextBlock++;
+      if (begin >= samples.size())
+        break;
 
-  // Available colors
-  //
-  // GreenGlow, TurquoiseGlow, BlueGlow, YellowGlow, RedGlow
-  // High (good)                                    Low (bad)
-  std::map<int, ignition::math::Color> indexToColor;
-  indexToColor[0] = ignition::math::Color(0, 1, 0);
-  indexToColor[1] = ignition::math::Color(0, 1, 1);
-  indexToColor[2] = ignition::math::Color(0, 0, 1);
-  indexToColor[3] = ignition::math::Color(1, 1, 0);
-  indexToColor[4] = ignition::math::Color(1, 0, 0);
-  indexToColor[5] = ignition::math::Color(1, 1, 1);
-
-  for (int i = 0; i < 6; ++i)
+      const size_t end = std::min(samples.size(), begin + kCoverageBlockSize);
+      for (size_t i = begin; i < end; ++i)
+      {
+        rx.pose.Set(samples[i].X(), samples[i].Y(), samples[i].Z(), 0, 0, 0);
+        const rf_power power = this->ComputeReceivedPower(
+          localRadio.default_tx_power, tx, rx);
+        levels[i] = coverageLevel(power.mean, localRadio);
+      }
+    }
+  };
+
+  const size_t blocks =
+    (samples.size() + kCoverageBlockSize - 1) / kCoverageBlockSize;
+  const size_t jobs = std::max<size_t>(1u, std::min<size_t>(blocks,
+    std::thread::hardware_concurrency()));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < jobs; ++i)
+    threads.emplace_back(work);
+  work();
+  for (auto &thread : threads)
+    thread.join();
+
+  if (this->abortCoverage)
+    return nullptr;
+
+  auto coverage = std::make_shared<Coverage>();
+  for (size_t i = 0; i < samples.size(); ++i)
+    (*coverage)[levels[i]].push_back(samples[i]);
+
+  // Positions outside of the table don't have a tile to share.
+  if (tile != std::numeric_limits<uint64_t>::max())
   {
-    markerMsg.set_id(i);
+    std::lock_guard<std::mutex> lock(this->coverageMutex);
+    this->coverageCache.emplace_front(tile, coverage);
+    if (this->coverageCache.size() > kMaxCachedCoverages)
+      this->coverageCache.pop_back();
+  }
+  return coverage;
+}
 
-    ignition::msgs::Material *matMsg = markerMsg.mutable_material();
-    ignition::msgs::Set(matMsg->mutable_ambient(), indexToColor[i]);
-    ignition::msgs::Set(matMsg->mutable_diffuse(), indexToColor[i]);
-    ignition::msgs::Set(matMsg->mutable_emissive(), indexToColor[i]);
-     ignition::msgs::Set(markerMsg.mutable_scale(),
-                         ignition::math::Vector3d(1.0, 1.0, 1.0));
+/////////////////////////////////////////////
+void VisibilityModel::SampleCoverage()
+{
+  // Keep the first vertex of the table in each cell.
+  const double resolution = this->visibilityConfig.coverageResolution;
+  std::set<std::tuple<int64_t, int64_t, int64_t>> cells;
+  for (auto const &entry : this->visibilityTable.Vertices())
+  {
+    const auto &vertex = entry.first;
+    if (resolution > 1.0 && !cells.emplace(
+          static_cast<int64_t>(std::floor(std::get<0>(vertex) / resolution)),
+          static_cast<int64_t>(std::floor(std::get<1>(vertex) / resolution)),
+          static_cast<int64_t>(std::floor(std::get<2>(vertex) / resolution)))
+        .second)
+    {
+      continue;
+    }
 
-     perCostMarkers.insert(std::make_pair(i, markerMsg));
+    this->coverageSamples.emplace_back(std::get<0>(vertex),
+      std::get<1>(vertex), std::get<2>(vertex));
   }
 
+  igndbg << "Sampled " << this->coverageSamples.size() << " of "
+         << this->visibilityTable.Vertices().size()
+         << " vertices for the coverage visualization" << std::endl;
+}
+
+/////////////////////////////////////////////
+bool VisibilityModel::VisualizeVisibility(const ignition::msgs::StringMsg &_req,
+                                          ignition::msgs::Boolean &_rep)
+{
+  _rep.set_data(false);
+
   std::string modelName = _req.data();
-  std::map<std::string, ignition::math::Pose3d>::iterator iter =
-    this->poses.find(modelName);
-  if (iter == this->poses.end())
+  std::shared_ptr<PoseCache> poses;
+  {
+    std::lock_guard<std::mutex> lock(this->coverageMutex);
+    poses = this->poseCache;
+  }
+
+  // Models other than the team members are watched, which doesn't keep
+  // their poses forever. Their pose is known from the next pose message.
+  if (!poses || !poses->Watch(modelName))
   {
     ignerr << "[" << modelName << "] model not found" << std::endl;
     return true;
   }
 
-  ignition::math::Vector3d from = iter->second.Pos();
+  // Only the last request is drawn if several arrive while computing.
+  {
+    std::lock_guard<std::mutex> lock(this->coverageMutex);
+    this->coverageRequest = modelName;
+  }
+  this->coverageCv.notify_one();
 
-  for (auto const &entry : this->visibilityTable.Vertices())
+  _rep.set_data(true);
+  return true;
+}
+
+/////////////////////////////////////////////
+void VisibilityModel::CoverageLoop()
+{
+  // Attempts to get the pose of the requested model.
+  const int kCoverageRetries = 20;
+  int retries = 0;
+  std::string lastModel;
+
+  std::unique_lock<std::mutex> lock(this->coverageMutex);
+  while (!this->stopCoverage)
   {
-    const auto &toTuple = entry.first;
-    ignition::math::Vector3d to = ignition::math::Vector3d(
-      std::get<0>(toTuple), std::get<1>(toTuple), std::get<2>(toTuple));
-    VisibilityCost visibilityCost = this->visibilityTable.Cost(from, to);
-    if (visibilityCost.cost <= this->visibilityConfig.commsCostMax)
+    if (!this->coverageRequest)
+    {
+      this->coverageCv.wait(lock);
+      continue;
+    }
+
+    const std::string modelName = *this->coverageRequest;
+    this->coverageRequest.reset();
+    std::shared_ptr<PoseCache> poses = this->poseCache;
+    lock.unlock();
+
+    ignition::math::Pose3d pose;
+    const bool posed = poses && poses->Pose(modelName, pose);
+    std::shared_ptr<const Coverage> coverage;
+    if (posed)
+      coverage = this->ComputeCoverage(pose.Pos());
+    if (coverage)
+      this->DrawCoverage(*coverage);
+
+    // Try again, unless there's a newer request, leaving time for the pose
+    // to arrive or for the breadcrumbs to change the visibility table.
+    lock.lock();
+    if (posed || modelName != lastModel)
+      retries = 0;
+    lastModel = modelName;
+    if (!coverage && !this->stopCoverage)
     {
-      /// Calculations from subt_communication_model/src/subt_communication_model.cpp
-      double txPower = 20.0; // Hardcoded from cave_circuit.ign
-      double noise_floor = -90.0; // Hardcoded from cave_circuit.ign
-      rf_interface::radio_state tx, rx;
-      // Set and calculate rf power
-      tx.pose.Set(from.X(), from.Y(), from.Z(), 0, 0, 0);
-      rx.pose.Set(to.X(), to.Y(), to.Z(), 0, 0, 0);
-      rf_power rf_pow = ComputeReceivedPower(txPower, tx, rx);
-      // Based on rx_power, noise value, and modulation, compute the bit error rate (BER)
-      double ber = QPSKPowerToBER( dbmToPow(rf_pow.mean), dbmToPow(noise_floor) );
-      int num_bytes = 100; // Hardcoded number of bytes
-      double packet_drop_prob = 1.0 - exp(num_bytes*log(1-ber));
-      // Scale packet drop probability to align with the color scheme
-      int pdp = floor(packet_drop_prob*5.00001);
-
-      auto m = perCostMarkers.find(static_cast<int>(pdp));
-
-      if (m == perCostMarkers.end())
+      if (!posed && ++retries > kCoverageRetries)
       {
-        ignwarn << "Have not pre-allocated a marker for cost: " << packet_drop_prob
-          << " (" << pdp << ")\n";
-        continue;
+        ignerr << "No pose of [" << modelName << "] received" << std::endl;
+        retries = 0;
       }
-
-      ignition::msgs::Set(m->second.add_point(),
-          ignition::math::Vector3d(to.X(), to.Y(), to.Z()));
+      else if (!this->coverageRequest)
+      {
+        this->coverageRequest = modelName;
+      }
+      this->coverageCv.wait_for(lock, std::chrono::milliseconds(100));
     }
   }
-
-  this->node.Request("/marker", perCostMarkers[0]);
-  this->node.Request("/marker", perCostMarkers[1]);
-  this->node.Request("/marker", perCostMarkers[2]);
-  this->node.Request("/marker", perCostMarkers[3]);
-  this->node.Request("/marker", perCostMarkers[4]);
-
-  _rep.set_data(true);
-  return true;
 }
 
-/////////////////////////////////////////////////
-void VisibilityModel::OnPose(const ignition::msgs::Pose_V &_msg)
+/////////////////////////////////////////////
+void VisibilityModel::DrawCoverage(const Coverage &_coverage)
 {
-  // Check the all the published poses
-  for (int i = 0; i < _msg.pose_size(); ++i)
+  // Remove the previous coverage, which may have had more chunks.
+  ignition::msgs::Marker markerMsg;
+  markerMsg.set_ns(kCoverageNamespace);
+  markerMsg.set_action(ignition::msgs::Marker::DELETE_ALL);
+  this->node.Request("/marker", markerMsg);
+
+  markerMsg.set_action(ignition::msgs::Marker::ADD_MODIFY);
+  markerMsg.set_type(ignition::msgs::Marker::POINTS);
+  markerMsg.mutable_lifetime()->set_sec(0.0);
+  markerMsg.mutable_lifetime()->set_nsec(0.0);
+
+  ignition::msgs::Set(markerMsg.mutable_pose(),
+                      ignition::math::Pose3d(0, 0, 0, 0, 0, 0));
+  ignition::msgs::Set(markerMsg.mutable_scale(),
+                      ignition::math::Vector3d(1.0, 1.0, 1.0));
+
+  // Available colors
+  //
+  // GreenGlow, TurquoiseGlow, BlueGlow, YellowGlow, RedGlow
+  // High (good)                                    Low (bad)
+  const std::array<ignition::math::Color, kCoverageLevels - 1> levelToColor{{
+    ignition::math::Color(0, 1, 0),
+    ignition::math::Color(0, 1, 1),
+    ignition::math::Color(0, 0, 1),
+    ignition::math::Color(1, 1, 0),
+    ignition::math::Color(1, 0, 0)}};
+
+  // The points where all packets are dropped aren't drawn.
+  int id = 0;
+  for (int level = 0; level < kCoverageLevels - 1; ++level)
   {
-    const ignition::msgs::Pose &pose = _msg.pose(i);
-    this->poses[pose.name()] = ignition::msgs::Convert(pose);
+    ignition::msgs::Material *matMsg = markerMsg.mutable_material();
+    ignition::msgs::Set(matMsg->mutable_ambient(), levelToColor[level]);
+    ignition::msgs::Set(matMsg->mutable_diffuse(), levelToColor[level]);
+    ignition::msgs::Set(matMsg->mutable_emissive(), levelToColor[level]);
+
+    const std::vector<ignition::math::Vector3d> &points = _coverage[level];
+    for (size_t begin = 0; begin < points.size();
+         begin += kMaxPointsPerMarker)
+    {
+      markerMsg.set_id(id++);
+      markerMsg.clear_point();
+      const size_t end = std::min(points.size(), begin + kMaxPointsPerMarker);
+      for (size_t i = begin; i < end; ++i)
+        ignition::msgs::Set(markerMsg.add_point(), points[i]);
+      this->node.Request("/marker", markerMsg);
+    }
   }
 }
@@ -16,10 +16,12 @@
 */
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <utility>
 #include <ignition/common/Console.hh>
 #include <ignition/common/Util.hh>
@@ -113,40 +115,53 @@ bool VisibilityTable::LoadLUT()
 }
 
 //////////////////////////////////////////////////
-VisibilityCost VisibilityTable::Cost(const ignition::math::Vector3d &_from,
+const VisibilityCost &VisibilityTable::Cost(
+  const ignition::math::Vector3d &_from,
   const ignition::math::Vector3d &_to) const
 {
-  int32_t x = std::round(_from.X());
-  int32_t y = std::round(_from.Y());
-  int32_t z = std::round(_from.Z());
-  auto sampleFrom = std::make_tuple(x, y, z);
-
-  x = std::round(_to.X());
-  y = std::round(_to.Y());
-  z = std::round(_to.Z());
-  auto sampleTo = std::make_tuple(x, y, z);
-
-  uint64_t from = std::numeric_limits<uint64_t>::max();
-  auto it = this->vertices.find(sampleFrom);
-  if (it != this->vertices.end())
-    from = it->second;
-
-  uint64_t to = std::numeric_limits<uint64_t>::max();
-  it = this->vertices.find(sampleTo);
-  if (it != this->vertices.end())
-    to = it->second;
-
-  auto key = std::make_pair(from, to);
-  auto itVisibility = this->visibilityInfo.find(key);
+  return this->Cost(this->Tile(_from), this->Tile(_to));
+}
+
+//////////////////////////////////////////////////
+const VisibilityCost &VisibilityTable::Cost(uint64_t _from, uint64_t _to)
+  const
+{
+  // Returned when there is no route.
+  static const VisibilityCost kUnreachable{std::numeric_limits<double>::max(),
+    {}, {}, {}, std::numeric_limits<double>::max()};
+
+  auto itVisibility = this->visibilityInfo.find(std::make_pair(_from, _to));
   if (itVisibility == this->visibilityInfo.end())
-    return {std::numeric_limits<double>::max(),
-            {}, {}, {},
-            std::numeric_limits<double>::max()};
+    return kUnreachable;
 
   // The cost.
   return itVisibility->second;
 }
 
+//////////////////////////////////////////////////
+uint64_t VisibilityTable::Tile(const ignition::math::Vector3d &_position)
+  const
+{
+  int32_t x = std::round(_position.X());
+  int32_t y = std::round(_position.Y());
+  int32_t z = std::round(_position.Z());
+
+  auto it = this->vertices.find(std::make_tuple(x, y, z));
+  if (it == this->vertices.end())
+    return std::numeric_limits<uint64_t>::max();
+  return it->second;
+}
+
+//////////////////////////////////////////////////
+const ignition::math::Vector3d *VisibilityTable::LastMileBreadcrumb(
+  uint64_t _tile) const
+{
+  auto it = this->lastMileBreadcrumbs.find(_tile);
+  if (it == this->lastMileBreadcrumbs.end())
+    return nullptr;
+  return &it->second;
+}
+
 //////////////////////////////////////////////////
 void VisibilityTable::Generate()
 {
@@ -312,6 +327,7 @@ void VisibilityTable::PopulateVisibilityInfo(
     {
       relays.insert(it->second);
       this->breadcrumbs[it->second].push_back(pose);
+      this->lastMileBreadcrumbs.emplace(it->second, pose);
     }
   }
 
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+
+#include <subt_communication_model/subt_communication_model.h>
+#include <subt_rf_interface/subt_rf_model.h>
+
+#include "subt_ign/VisibilityRfModel.hh"
+#include "subt_ign/VisibilityTable.hh"
+
+#include "headless_broker.hh"
+
+using namespace subt;
+using namespace subt::communication_broker;
+using namespace subt::communication_model;
+using namespace subt::rf_interface;
+
+/// \brief Number of heap allocations made by the process.
+static std::atomic<uint64_t> allocations{0};
+
+/////////////////////////////////////////////////
+void *operator new(std::size_t _size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(_size ? _size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+/////////////////////////////////////////////////
+void *operator new[](std::size_t _size)
+{
+  return ::operator new(_size);
+}
+
+/////////////////////////////////////////////////
+void operator delete(void *_ptr) noexcept
+{
+  std::free(_ptr);
+}
+
+/////////////////////////////////////////////////
+void operator delete[](void *_ptr) noexcept
+{
+  std::free(_ptr);
+}
+
+/////////////////////////////////////////////////
+void operator delete(void *_ptr, std::size_t) noexcept
+{
+  std::free(_ptr);
+}
+
+/////////////////////////////////////////////////
+void operator delete[](void *_ptr, std::size_t) noexcept
+{
+  std::free(_ptr);
+}
+
+/////////////////////////////////////////////////
+void usage()
+{
+  std::cerr << "Usage comms_broker_benchmark [options]" << std::endl
+    << std::endl
+    << "  --robots=N        Number of robots (default 10)" << std::endl
+    << "  --steps=N         Number of dispatches (default 10000)" << std::endl
+    << "  --rate=N          Messages sent by each robot per dispatch "
+    << "(default 1)" << std::endl
+    << "  --broadcast=F     Fraction of broadcast messages (default 0.2)"
+    << std::endl
+    << "  --payload=MIN:MAX Payload size range in bytes (default 64:1500)"
+    << std::endl
+    << "  --model=M         log_normal_range or visibility_range "
+    << "(default log_normal_range)" << std::endl
+    << "  --world=W         World of the visibility model" << std::endl
+    << "  --relays=N        Breadcrumbs of the visibility model "
+    << "(default 10)" << std::endl
+    << std::endl
+    << "Example: ./comms_broker_benchmark --robots=20 "
+    << "--model=visibility_range --world=simple_cave_02" << std::endl;
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  int robots = 10;
+  int steps = 10000;
+  int rate = 1;
+  double broadcast = 0.2;
+  size_t payloadMin = 64;
+  size_t payloadMax = 1500;
+  std::string model = "log_normal_range";
+  std::string world;
+  int relays = 10;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const auto eq = arg.find('=');
+    const std::string key = arg.substr(0, eq);
+    const std::string value =
+      eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+
+    if (key == "--robots")
+      robots = std::atoi(value.c_str());
+    else if (key == "--steps")
+      steps = std::atoi(value.c_str());
+    else if (key == "--rate")
+      rate = std::atoi(value.c_str());
+    else if (key == "--broadcast")
+      broadcast = std::atof(value.c_str());
+    else if (key == "--payload" && value.find(':') != std::string::npos)
+    {
+      payloadMin = std::stoul(value.substr(0, value.find(':')));
+      payloadMax = std::stoul(value.substr(value.find(':') + 1));
+    }
+    else if (key == "--model")
+      model = value;
+    else if (key == "--world")
+      world = value;
+    else if (key == "--relays")
+      relays = std::atoi(value.c_str());
+    else
+    {
+      usage();
+      return -1;
+    }
+  }
+
+  if (robots < 2 || steps < 1 || rate < 1 || payloadMin > payloadMax ||
+      (model == "visibility_range" && world.empty()) ||
+      (model != "visibility_range" && model != "log_normal_range"))
+  {
+    usage();
+    return -1;
+  }
+
+  // Always the same sequence, so that runs are comparable.
+  std::mt19937 gen(0);
+
+  // Waypoints of the trajectories. The visibility model only knows the
+  // positions of its vertices, the range model any position.
+  std::vector<ignition::math::Vector3d> waypoints;
+  radio_configuration radio;
+  range_model::rf_configuration rangeConfig;
+  std::unique_ptr<visibilityModel::VisibilityModel> visibility;
+  if (model == "visibility_range")
+  {
+    visibility = std::make_unique<visibilityModel::VisibilityModel>(
+      visibilityModel::RfConfiguration(), rangeConfig, world);
+    VisibilityTable table;
+    if (!visibility->Initialized() || !table.Load(world, true))
+      return -1;
+
+    for (auto const &vertex : table.Vertices())
+    {
+      waypoints.emplace_back(std::get<0>(vertex.first),
+        std::get<1>(vertex.first), std::get<2>(vertex.first));
+    }
+    if (waypoints.empty())
+    {
+      std::cerr << "No vertices in the visibility table" << std::endl;
+      return -1;
+    }
+
+    std::uniform_int_distribution<size_t> pick(0, waypoints.size() - 1);
+    std::set<ignition::math::Vector3d> relayPoses;
+    for (int i = 0; i < relays; ++i)
+      relayPoses.insert(waypoints[pick(gen)]);
+    visibility->PopulateVisibilityInfo(relayPoses);
+
+    radio.pathloss_f = std::bind(
+      &visibilityModel::VisibilityModel::ComputeReceivedPower,
+      visibility.get(), std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3);
+  }
+  else
+  {
+    std::uniform_real_distribution<double> coord(0.0, 200.0);
+    for (int i = 0; i < 256; ++i)
+      waypoints.emplace_back(coord(gen), coord(gen), 0.0);
+
+    radio.pathloss_f = std::bind(&range_model::log_normal_received_power,
+      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+      rangeConfig);
+  }
+
+  // Each robot visits its own sequence of waypoints, dwelling a few
+  // dispatches at each one.
+  const int kDwell = 20;
+  const double kStepSize = 0.05;
+  std::uniform_int_distribution<size_t> pickWaypoint(0, waypoints.size() - 1);
+  std::vector<std::string> names;
+  std::map<std::string, std::vector<ignition::math::Vector3d>> trajectories;
+  for (int i = 0; i < robots; ++i)
+  {
+    names.push_back("R" + std::to_string(i));
+    auto &trajectory = trajectories[names.back()];
+    for (int w = 0; w < 64; ++w)
+      trajectory.push_back(waypoints[pickWaypoint(gen)]);
+  }
+
+  int step = 0;
+  HeadlessBroker broker;
+  broker.SetDefaultRadioConfiguration(radio);
+  broker.SetCommunicationFunction(&attempt_send);
+  broker.SetPoseUpdateFunction([&](const std::string &_name)
+  {
+    auto it = trajectories.find(_name);
+    if (it == trajectories.end())
+      return std::make_tuple(false, ignition::math::Pose3d(), 0.0);
+
+    const auto &trajectory = it->second;
+    ignition::math::Pose3d pose;
+    pose.Pos() = trajectory[(step / kDwell) % trajectory.size()];
+    return std::make_tuple(true, pose, step * kStepSize);
+  });
+
+  for (const auto &name : names)
+  {
+    broker.Register(name);
+    broker.BindEndPoint(name, name + ":" + std::to_string(kDefaultPort));
+    broker.BindEndPoint(name, kBroadcast + ":" + std::to_string(kDefaultPort));
+  }
+
+  // Messages are generated ahead of time, the benchmark only times the
+  // dispatching.
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::uniform_int_distribution<size_t> pickPayload(payloadMin, payloadMax);
+  std::uniform_int_distribution<int> pickRobot(0, robots - 1);
+  const std::string payload(payloadMax, 'x');
+
+  std::vector<double> latencies;
+  latencies.reserve(steps);
+  uint64_t packets = 0;
+  uint64_t dispatchAllocations = 0;
+  double elapsed = 0;
+  for (step = 0; step < steps; ++step)
+  {
+    for (int src = 0; src < robots; ++src)
+    {
+      for (int m = 0; m < rate; ++m)
+      {
+        subt::msgs::Datagram msg;
+        msg.set_src_address(names[src]);
+        msg.set_dst_port(kDefaultPort);
+        msg.set_data(payload.substr(0, pickPayload(gen)));
+        if (uniform(gen) < broadcast)
+          msg.set_dst_address(kBroadcast);
+        else
+        {
+          int dst = pickRobot(gen);
+          if (dst == src)
+            dst = (dst + 1) % robots;
+          msg.set_dst_address(names[dst]);
+        }
+        broker.Push(msg);
+        ++packets;
+      }
+    }
+
+    const uint64_t allocationsBefore = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    broker.DispatchMessages();
+    const std::chrono::duration<double> latency =
+      std::chrono::steady_clock::now() - start;
+    dispatchAllocations += allocations.load() - allocationsBefore;
+
+    latencies.push_back(latency.count());
+    elapsed += latency.count();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double _p)
+  {
+    return latencies[static_cast<size_t>(_p * (latencies.size() - 1))];
+  };
+
+  std::cout << "Model: " << model << std::endl
+            << "Robots: " << robots << std::endl
+            << "Dispatches: " << steps << std::endl
+            << "Packets: " << packets << std::endl
+            << "Delivered: " << broker.delivered << " ("
+            << broker.deliveredBytes << " bytes)" << std::endl
+            << "Elapsed [s]: " << elapsed << std::endl
+            << "Throughput [packets/s]: " << packets / elapsed << std::endl
+            << "Dispatch latency p50 [us]: " << percentile(0.5) * 1e6
+            << std::endl
+            << "Dispatch latency p99 [us]: " << percentile(0.99) * 1e6
+            << std::endl
+            << "Allocations per packet: "
+            << static_cast<double>(dispatchAllocations) / packets
+            << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,408 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <ignition/math/Pose3.hh>
+
+#include <subt_communication_broker/subt_communication_compression.h>
+#include <subt_communication_model/subt_communication_model.h>
+#include <subt_rf_interface/subt_rf_model.h>
+
+#include "headless_broker.hh"
+
+using namespace subt;
+using namespace subt::communication_broker;
+using namespace subt::communication_model;
+using namespace subt::rf_interface;
+
+/// \brief Values of the cells of an occupancy grid, as in
+/// nav_msgs/OccupancyGrid.
+static const int8_t kUnknown = -1;
+static const int8_t kFree = 0;
+static const int8_t kOccupied = 100;
+
+/// \brief Maximum payload accepted by CommsClient.
+static const size_t kMtu = 1500;
+
+/////////////////////////////////////////////////
+void usage()
+{
+  std::cerr << "Usage comms_compression_benchmark [options]" << std::endl
+    << std::endl
+    << "Streams the tiles of a synthetic occupancy grid between two robots "
+    << "through a headless broker, raw and compressed, and reports the map "
+    << "data delivered per second of simulation." << std::endl
+    << std::endl
+    << "  --size=N      Side of the grid in cells (default 1024)" << std::endl
+    << "  --tile=N      Side of a raw tile in cells (default 32)" << std::endl
+    << "  --noise=F     Fraction of cells flipped by sensor noise "
+    << "(default 0.01)" << std::endl
+    << "  --capacity=F  Radio capacity in bits per second (default 1000000)"
+    << std::endl
+    << "  --distance=F  Distance between the robots in meters (default 10)"
+    << std::endl
+    << "  --seconds=F   Simulation time of each run (default 20)"
+    << std::endl
+    << "  --level=N     zlib compression level (default 6)" << std::endl
+    << std::endl
+    << "Example: ./comms_compression_benchmark --tile=64 --noise=0.05"
+    << std::endl;
+}
+
+/////////////////////////////////////////////////
+/// \brief Generate an occupancy grid of rooms joined by corridors, with
+/// walls around the free space and unknown space elsewhere.
+/// \param[in] _size Side of the grid in cells.
+/// \param[in] _noise Fraction of cells flipped by sensor noise.
+/// \param[in] _gen Random number generator.
+/// \return The cells, row by row.
+std::vector<int8_t> generateGrid(int _size, double _noise, std::mt19937 &_gen)
+{
+  std::vector<int8_t> grid(_size * _size, kUnknown);
+  auto carve = [&](int _x0, int _y0, int _x1, int _y1)
+  {
+    for (int y = std::max(_y0, 1); y < std::min(_y1, _size - 1); ++y)
+      for (int x = std::max(_x0, 1); x < std::min(_x1, _size - 1); ++x)
+        grid[y * _size + x] = kFree;
+  };
+
+  // Rooms, each joined to the previous one by an L shaped corridor.
+  std::uniform_int_distribution<int> pos(0, _size - 1);
+  std::uniform_int_distribution<int> extent(8, 40);
+  int lastX = _size / 2;
+  int lastY = _size / 2;
+  const int rooms = _size * _size / 4096;
+  for (int i = 0; i < rooms; ++i)
+  {
+    const int x = pos(_gen);
+    const int y = pos(_gen);
+    carve(x, y, x + extent(_gen), y + extent(_gen));
+    carve(std::min(x, lastX), lastY - 1, std::max(x, lastX) + 1, lastY + 2);
+    carve(x - 1, std::min(y, lastY), x + 2, std::max(y, lastY) + 1);
+    lastX = x;
+    lastY = y;
+  }
+
+  // Walls on the unknown cells next to free ones.
+  for (int y = 1; y < _size - 1; ++y)
+  {
+    for (int x = 1; x < _size - 1; ++x)
+    {
+      if (grid[y * _size + x] != kUnknown)
+        continue;
+      for (int d = 0; d < 9; ++d)
+      {
+        if (grid[(y + d / 3 - 1) * _size + x + d % 3 - 1] == kFree)
+        {
+          grid[y * _size + x] = kOccupied;
+          break;
+        }
+      }
+    }
+  }
+
+  // Noise in the observed space.
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  for (auto &cell : grid)
+  {
+    if (cell != kUnknown && uniform(_gen) < _noise)
+      cell = cell == kFree ? kOccupied : kFree;
+  }
+  return grid;
+}
+
+/////////////////////////////////////////////////
+/// \brief Split a grid into tiles, each one prefixed with its position as
+/// a robot would send it.
+/// \param[in] _grid The grid.
+/// \param[in] _size Side of the grid in cells.
+/// \param[in] _tile Side of a tile in cells.
+/// \return The tiles.
+std::vector<std::string> makeTiles(const std::vector<int8_t> &_grid,
+                                   int _size, int _tile)
+{
+  std::vector<std::string> tiles;
+  for (int ty = 0; ty < _size; ty += _tile)
+  {
+    for (int tx = 0; tx < _size; tx += _tile)
+    {
+      std::string tile;
+      const int32_t header[2] = {tx, ty};
+      tile.append(reinterpret_cast<const char *>(header), sizeof(header));
+      for (int y = ty; y < std::min(ty + _tile, _size); ++y)
+      {
+        tile.append(reinterpret_cast<const char *>(&_grid[y * _size + tx]),
+                    std::min(_tile, _size - tx));
+      }
+      tiles.push_back(tile);
+    }
+  }
+  return tiles;
+}
+
+/// \brief Results of streaming the tiles.
+struct RunResult
+{
+  /// \brief Payload bytes sent.
+  uint64_t payloadBytes = 0;
+
+  /// \brief Map bytes delivered and decompressed.
+  uint64_t dataBytes = 0;
+
+  /// \brief Tiles too big for a packet.
+  uint64_t oversized = 0;
+
+  /// \brief Map bytes compressed.
+  uint64_t compressedBytes = 0;
+
+  /// \brief Wall time spent compressing (s).
+  double compressTime = 0;
+
+  /// \brief Wall time spent decompressing (s).
+  double decompressTime = 0;
+};
+
+/////////////////////////////////////////////////
+/// \brief Stream tiles from one robot to another through a headless broker
+/// for some simulation time, pacing the sender to the capacity of the
+/// radio as a well behaved client would.
+/// \param[in] _tiles The tiles, sent round robin.
+/// \param[in] _radio Radio configuration.
+/// \param[in] _distance Distance between the robots (m).
+/// \param[in] _seconds Simulation time (s).
+/// \param[in] _compressor Compressor, or null to send raw tiles.
+/// \return The results.
+RunResult stream(const std::vector<std::string> &_tiles,
+                 const radio_configuration &_radio, double _distance,
+                 double _seconds, PayloadCompressor *_compressor)
+{
+  const double kStep = 0.01;
+  double stamp = 0;
+
+  HeadlessBroker broker;
+  broker.SetDefaultRadioConfiguration(_radio);
+  broker.SetCommunicationFunction(&attempt_send);
+  broker.SetPoseUpdateFunction([&](const std::string &_name)
+  {
+    const double x = _name == "rx" ? _distance : 0.0;
+    return std::make_tuple(true, ignition::math::Pose3d(x, 0, 0, 0, 0, 0),
+                           stamp);
+  });
+  broker.Register("tx");
+  broker.Register("rx");
+  broker.BindEndPoint("rx", "rx:" + std::to_string(kDefaultPort));
+
+  RunResult result;
+  std::string data;
+  broker.onDeliver = [&](const std::string &, const subt::msgs::Datagram &_msg)
+  {
+    if (!_compressor)
+    {
+      result.dataBytes += _msg.data().size();
+      return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (_compressor->Decompress(_msg.data(), data))
+      result.dataBytes += data.size();
+    result.decompressTime += std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  };
+
+  subt::msgs::Datagram msg;
+  msg.set_src_address("tx");
+  msg.set_dst_address("rx");
+  msg.set_dst_port(kDefaultPort);
+
+  // The next payload to send, prepared once and kept until the budget
+  // allows sending it.
+  std::string payload;
+  size_t next = 0;
+  auto prepare = [&]()
+  {
+    const std::string &tile = _tiles[next++ % _tiles.size()];
+    if (!_compressor)
+    {
+      payload = tile;
+      return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    _compressor->Compress(tile, payload);
+    result.compressTime += std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    result.compressedBytes += tile.size();
+  };
+
+  prepare();
+  double budget = 0;
+  for (; stamp < _seconds; stamp += kStep)
+  {
+    budget += _radio.capacity / 8.0 * kStep;
+    while (payload.size() > kMtu || payload.size() <= budget)
+    {
+      if (payload.size() > kMtu)
+      {
+        if (++result.oversized >= _tiles.size())
+          return result;
+      }
+      else
+      {
+        budget -= payload.size();
+        msg.set_data(payload);
+        broker.Push(msg);
+        result.payloadBytes += payload.size();
+      }
+      prepare();
+    }
+    broker.DispatchMessages();
+  }
+  return result;
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  int size = 1024;
+  int tile = 32;
+  double noise = 0.01;
+  double capacity = 1e6;
+  double distance = 10;
+  double seconds = 20;
+  int level = 6;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const auto eq = arg.find('=');
+    const std::string key = arg.substr(0, eq);
+    const std::string value =
+      eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+
+    if (key == "--size")
+      size = std::atoi(value.c_str());
+    else if (key == "--tile")
+      tile = std::atoi(value.c_str());
+    else if (key == "--noise")
+      noise = std::atof(value.c_str());
+    else if (key == "--capacity")
+      capacity = std::atof(value.c_str());
+    else if (key == "--distance")
+      distance = std::atof(value.c_str());
+    else if (key == "--seconds")
+      seconds = std::atof(value.c_str());
+    else if (key == "--level")
+      level = std::atoi(value.c_str());
+    else
+    {
+      usage();
+      return -1;
+    }
+  }
+
+  if (size < 64 || tile < 1 || tile > size || capacity <= 0 || seconds <= 0)
+  {
+    usage();
+    return -1;
+  }
+
+  // Always the same maps, so that runs are comparable. The dictionary is
+  // a tile of another map, as a team would ship one with its robots.
+  std::mt19937 gen(0);
+  const auto grid = generateGrid(size, noise, gen);
+  const auto tiles = makeTiles(grid, size, tile);
+  const auto other = makeTiles(generateGrid(size, noise, gen), size,
+    std::min(size, 128));
+  std::string dictionary;
+  for (const auto &t : other)
+  {
+    if (std::count(t.begin(), t.end(), kUnknown) * 2 <
+        static_cast<int64_t>(t.size()))
+      dictionary = t;
+  }
+
+  radio_configuration radio;
+  radio.capacity = capacity;
+  range_model::rf_configuration rangeConfig;
+  radio.pathloss_f = std::bind(&range_model::log_normal_received_power,
+    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+    rangeConfig);
+
+  std::cout << "Grid: " << size << "x" << size << " cells, " << tiles.size()
+            << " tiles of " << tile << "x" << tile << std::endl
+            << "Capacity [bit/s]: " << capacity << std::endl
+            << "Simulation time [s]: " << seconds << std::endl;
+
+  PayloadCompressor plain("", level);
+  PayloadCompressor withDictionary(dictionary, level);
+  struct Mode
+  {
+    std::string name;
+    PayloadCompressor *compressor;
+  };
+  double rawThroughput = 0;
+  for (const Mode &mode : {Mode{"raw", nullptr},
+                           Mode{"deflate", &plain},
+                           Mode{"deflate+dictionary", &withDictionary}})
+  {
+    const RunResult result =
+      stream(tiles, radio, distance, seconds, mode.compressor);
+    const double throughput = result.dataBytes * 8.0 / seconds;
+    if (!mode.compressor)
+      rawThroughput = throughput;
+
+    std::cout << std::endl << "[" << mode.name << "]" << std::endl;
+    if (result.oversized >= tiles.size())
+    {
+      std::cout << "Every tile is bigger than the MTU" << std::endl;
+      continue;
+    }
+
+    std::cout << "Payload sent [bit/s]: "
+              << result.payloadBytes * 8.0 / seconds << std::endl
+              << "Map data delivered [bit/s]: " << throughput << std::endl;
+    if (rawThroughput > 0)
+    {
+      std::cout << "Gain over raw: " << throughput / rawThroughput << "x"
+                << std::endl;
+    }
+    if (result.oversized > 0)
+    {
+      std::cout << "Tiles bigger than the MTU: " << result.oversized
+                << std::endl;
+    }
+    if (mode.compressor)
+    {
+      std::cout << "Compression [MB/s]: " << result.compressedBytes /
+                   std::max(result.compressTime, 1e-9) / 1e6 << std::endl
+                << "Decompression [MB/s]: " << result.dataBytes /
+                   std::max(result.decompressTime, 1e-9) / 1e6 << std::endl;
+    }
+  }
+
+  return 0;
+}
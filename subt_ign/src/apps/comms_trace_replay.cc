@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <ignition/math/Pose3.hh>
+
+#include <subt_communication_broker/subt_communication_trace.h>
+#include <subt_communication_model/subt_communication_model.h>
+#include <subt_rf_interface/subt_rf_model.h>
+
+#include "subt_ign/VisibilityRfModel.hh"
+
+#include "headless_broker.hh"
+
+using namespace subt;
+using namespace subt::communication_broker;
+using namespace subt::communication_model;
+using namespace subt::rf_interface;
+
+/////////////////////////////////////////////////
+void usage()
+{
+  std::cerr << "Usage comms_trace_replay <trace> [options]" << std::endl
+    << std::endl
+    << "Feeds a trace recorded by the comms broker through a headless "
+    << "broker, as fast as possible." << std::endl
+    << std::endl
+    << "  --model=M  log_normal_range or visibility_range "
+    << "(default log_normal_range)" << std::endl
+    << "  --world=W  World of the visibility model" << std::endl
+    << "  --seed=N   Seed of the comms model (default 0)" << std::endl
+    << "  --out=F    Record the replayed traffic to a new trace" << std::endl
+    << std::endl
+    << "Example: ./comms_trace_replay comms.trace "
+    << "--model=visibility_range --world=simple_cave_02" << std::endl;
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    usage();
+    return -1;
+  }
+
+  const std::string tracePath = argv[1];
+  std::string model = "log_normal_range";
+  std::string world;
+  std::string outPath;
+  uint64_t seed = 0;
+
+  for (int i = 2; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const auto eq = arg.find('=');
+    const std::string key = arg.substr(0, eq);
+    const std::string value =
+      eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+
+    if (key == "--model")
+      model = value;
+    else if (key == "--world")
+      world = value;
+    else if (key == "--seed")
+      seed = std::stoull(value);
+    else if (key == "--out")
+      outPath = value;
+    else
+    {
+      usage();
+      return -1;
+    }
+  }
+
+  if ((model == "visibility_range" && world.empty()) ||
+      (model != "visibility_range" && model != "log_normal_range"))
+  {
+    usage();
+    return -1;
+  }
+
+  TraceReader reader;
+  if (!reader.Open(tracePath))
+    return -1;
+
+  radio_configuration radio;
+  radio.seed = seed;
+  range_model::rf_configuration rangeConfig;
+  std::unique_ptr<visibilityModel::VisibilityModel> visibility;
+  if (model == "visibility_range")
+  {
+    visibility = std::make_unique<visibilityModel::VisibilityModel>(
+      visibilityModel::RfConfiguration(), rangeConfig, world);
+    if (!visibility->Initialized())
+      return -1;
+
+    radio.pathloss_f = std::bind(
+      &visibilityModel::VisibilityModel::ComputeReceivedPower,
+      visibility.get(), std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3);
+  }
+  else
+  {
+    radio.pathloss_f = std::bind(&range_model::log_normal_received_power,
+      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+      rangeConfig);
+  }
+
+  // Poses of the team at the current dispatch.
+  std::map<std::string, ignition::math::Pose3d> poses;
+  double stamp = 0;
+
+  HeadlessBroker broker;
+  broker.SetDefaultRadioConfiguration(radio);
+  broker.SetCommunicationFunction(&attempt_send);
+  broker.SetPoseUpdateFunction([&](const std::string &_name)
+  {
+    auto it = poses.find(_name);
+    if (it == poses.end())
+      return std::make_tuple(false, ignition::math::Pose3d(), 0.0);
+    return std::make_tuple(true, it->second, stamp);
+  });
+
+  if (!outPath.empty() && !broker.RecordTrace(outPath, false))
+    return -1;
+
+  // Deliveries in the order they were decided, to compare the replay with
+  // the recording.
+  std::vector<std::pair<std::string, std::string>> recorded;
+  std::vector<std::pair<std::string, std::string>> replayed;
+  broker.onDeliver = [&replayed](const std::string &_address,
+                                 const subt::msgs::Datagram &_msg)
+  {
+    replayed.emplace_back(_msg.src_address(), _address);
+  };
+
+  std::map<drop_reason, uint64_t> recordedDrops;
+  uint64_t messages = 0;
+  uint64_t dispatches = 0;
+  uint64_t gaps = 0;
+  bool queued = false;
+  std::chrono::duration<double> elapsed(0);
+
+  auto dispatch = [&]()
+  {
+    if (!queued)
+      return;
+    const auto start = std::chrono::steady_clock::now();
+    broker.DispatchMessages();
+    elapsed += std::chrono::steady_clock::now() - start;
+    ++dispatches;
+    queued = false;
+  };
+
+  TraceRecord record;
+  while (reader.Next(record))
+  {
+    switch (record.type)
+    {
+      // Changes of the team were recorded after the previous dispatch.
+      case TraceRecordType::kRegister:
+        dispatch();
+        broker.Register(record.address);
+        break;
+      case TraceRecordType::kUnregister:
+        dispatch();
+        broker.Unregister(record.address);
+        break;
+      case TraceRecordType::kBind:
+        dispatch();
+        broker.BindEndPoint(record.address, record.endpoint);
+        break;
+      case TraceRecordType::kDispatch:
+        // The messages of the previous dispatch go out with its poses.
+        dispatch();
+        stamp = record.stamp;
+        break;
+      case TraceRecordType::kPose:
+        poses[record.address] = record.pose;
+        break;
+      case TraceRecordType::kMessage:
+      {
+        subt::msgs::Datagram msg;
+        msg.set_src_address(record.address);
+        msg.set_dst_address(record.dstAddress);
+        msg.set_dst_port(record.port);
+        if (record.payload.size() == record.size)
+          msg.set_data(record.payload);
+        else
+          msg.set_data(std::string(record.size, '\0'));
+        broker.Push(msg);
+        queued = true;
+        ++messages;
+        break;
+      }
+      case TraceRecordType::kDelivery:
+        if (record.delivered)
+          recorded.emplace_back(record.address, record.dstAddress);
+        else
+          ++recordedDrops[record.reason];
+        break;
+      case TraceRecordType::kGap:
+        std::cerr << "Warning: " << record.lostBytes << " bytes of records "
+                  << "are missing after " << messages << " messages, the "
+                  << "replay may differ from the recording" << std::endl;
+        ++gaps;
+        break;
+    }
+  }
+  dispatch();
+
+  std::cout << "Messages: " << messages << std::endl
+            << "Dispatches: " << dispatches << std::endl
+            << "Elapsed [s]: " << elapsed.count() << std::endl
+            << "Recorded deliveries: " << recorded.size() << std::endl
+            << "Replayed deliveries: " << replayed.size() << std::endl
+            << "Same decisions: " << (recorded == replayed ? "yes" : "no")
+            << std::endl
+            << "Gaps: " << gaps << std::endl;
+
+  for (const auto &drops : recordedDrops)
+  {
+    std::cout << "Recorded drops (" << drop_reason_name(drops.first) << "): "
+              << drops.second << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef SUBT_IGN_HEADLESS_BROKER_HH_
+#define SUBT_IGN_HEADLESS_BROKER_HH_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <subt_communication_broker/subt_communication_broker.h>
+
+namespace subt
+{
+  /// \brief A broker that takes its messages from the caller instead of
+  /// from the clients, and counts the deliveries instead of sending them,
+  /// so that it runs without a simulation or any client.
+  class HeadlessBroker : public communication_broker::Broker
+  {
+    /// \brief Queue a message as if a client had sent it.
+    /// \param[in] _msg The message.
+    public: void Push(const subt::msgs::Datagram &_msg)
+    {
+      this->incomingMsgs.push_back(_msg);
+    }
+
+    /// \brief Bind a client to an end point.
+    /// \param[in] _address Address of the client.
+    /// \param[in] _endpoint End point.
+    /// \return True if the client wasn't bound to the end point yet.
+    public: bool BindEndPoint(const std::string &_address,
+                              const std::string &_endpoint)
+    {
+      return this->Bind(_address, _endpoint);
+    }
+
+    // Documentation inherited.
+    protected: bool Deliver(const std::string &_address,
+                            const subt::msgs::Datagram &_msg) override
+    {
+      ++this->delivered;
+      this->deliveredBytes += _msg.data().size();
+      if (this->onDeliver)
+        this->onDeliver(_address, _msg);
+      return true;
+    }
+
+    /// \brief Number of delivered messages.
+    public: uint64_t delivered = 0;
+
+    /// \brief Number of delivered payload bytes.
+    public: uint64_t deliveredBytes = 0;
+
+    /// \brief Optional function called for each delivered message, with
+    /// the address of the client and the message.
+    public: std::function<void(const std::string &,
+                               const subt::msgs::Datagram &)> onDeliver;
+  };
+}
+
+#endif
@@ -0,0 +1,684 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <ignition/common/Filesystem.hh>
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+#include <ignition/msgs/Utility.hh>
+#include <sdf/Model.hh>
+#include <sdf/Root.hh>
+#include <sdf/World.hh>
+
+#include "subt_ign/ArtifactScorer.hh"
+#include "subt_ign/Common.hh"
+#include "subt_ign/ScoringEngine.hh"
+
+/// \brief Scoring data of a world.
+struct WorldData
+{
+  /// \brief Name of the world.
+  std::string name;
+
+  /// \brief Type, name and model pose of each artifact.
+  std::vector<std::tuple<subt::ArtifactType, std::string,
+    ignition::math::Pose3d>> artifacts;
+
+  /// \brief Pose of the artifact origin.
+  ignition::math::Pose3d origin;
+
+  /// \brief Elevation step size of the run statistics.
+  double elevationStepSize = 5.0;
+};
+
+/// \brief A report read from an events.yml file.
+struct Report
+{
+  /// \brief Sim time of the report.
+  int timeSec = 0;
+
+  /// \brief Reported type.
+  subt::ArtifactType type;
+
+  /// \brief Reported position in the artifact origin frame.
+  ignition::math::Vector3d artifactFramePos;
+
+  /// \brief Reported position in world coordinates.
+  ignition::math::Vector3d worldFramePos;
+};
+
+/// \brief A time-ordered item of a recorded run.
+struct RunItem
+{
+  /// \brief Sim time of the item.
+  ignition::msgs::Time time;
+
+  /// \brief Index of the event, -1 for poses. YAML nodes are not stored
+  /// in the items because assigning a node modifies the node it refers to.
+  int event = -1;
+
+  /// \brief Robot name, set for poses.
+  std::string robot;
+
+  /// \brief Robot position, set for poses.
+  ignition::math::Vector3d pos;
+};
+
+/////////////////////////////////////////////////
+void usage()
+{
+  std::cout << "./score_replay [OPTION] [RUN_DIR]...\n\n";
+  std::cout << "Re-score the artifact reports stored in an events.yml file "
+            << "against the artifacts of a world.\n\n";
+  std::cout << "When run directories are given, the events and pos-data of "
+            << "each run are replayed through the scoring engine and new "
+            << "score.yml, summary.yml, run.yml and events.yml files are "
+            << "written. Robot orientations are not logged, so flips are "
+            << "taken from the recorded events.\n\n";
+  std::cout << "Required options:\n\n";
+  std::cout << "  --world=<FILENAME>   World SDF file.\n\n";
+  std::cout << "  --events=<FILENAME>  events.yml file of a run. Not needed "
+            << "when run directories are given.\n\n";
+  std::cout << "Optional options:\n\n";
+  std::cout << "  --limit=<VALUE>      Report count limit. Defaults to 25 for"
+            << " final worlds, 40 otherwise.\n\n";
+  std::cout << "  --repeat=<VALUE>     Number of times to score the reports,"
+            << " used for benchmarking. Defaults to 1.\n\n";
+  std::cout << "  --output=<DIR>       Directory where the re-scored runs are"
+            << " written, one sub-directory per run. Defaults to"
+            << " RUN_DIR/rescored.\n\n";
+  std::cout << "  --jobs=<VALUE>       Number of runs re-scored in parallel."
+            << " Defaults to the number of cores.\n\n";
+  std::cout << "  --elevation_step=<VALUE>  Elevation step size of the run"
+            << " statistics. Defaults to 5.\n\n";
+  std::cout << "  --verbose            Print the outcome of each report.\n\n";
+  std::cout << "Example: ./score_replay --world=finals_qual.sdf "
+            << "--events=/tmp/logs/events.yml\n\n";
+  std::cout << "Example: ./score_replay --world=finals_qual.sdf "
+            << "--output=/tmp/rescored /tmp/runs/*\n\n";
+}
+
+/////////////////////////////////////////////////
+std::string cmdLineArg(int _argc, char **_argv, const std::string &_option)
+{
+  for (int i = 0; i < _argc; ++i)
+  {
+    std::string arg = _argv[i];
+    if (arg.find(_option) == 0)
+      return arg.substr(_option.size());
+  }
+  return "";
+}
+
+/////////////////////////////////////////////////
+bool hasFlag(int _argc, char **_argv, const std::string &_flag)
+{
+  for (int i = 0; i < _argc; ++i)
+  {
+    if (_flag == _argv[i])
+      return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+bool loadWorld(const std::string &_worldFile, WorldData &_world)
+{
+  sdf::Root root;
+  sdf::Errors errors = root.Load(_worldFile);
+  if (!errors.empty())
+  {
+    for (const auto &e : errors)
+      std::cerr << e << std::endl;
+    return false;
+  }
+
+  // Assuming 1 world per SDF, which is true for SubT.
+  const sdf::World *world = root.WorldByIndex(0);
+  if (!world)
+  {
+    std::cerr << "No world found in [" << _worldFile << "]" << std::endl;
+    return false;
+  }
+
+  _world.name = world->Name();
+  for (uint64_t i = 0; i < world->ModelCount(); ++i)
+  {
+    const sdf::Model *model = world->ModelByIndex(i);
+    if (model->Name() == subt::kArtifactOriginName)
+      _world.origin = model->RawPose();
+
+    for (const auto &[prefix, type] : subt::kArtifactNames)
+    {
+      if (model->Name().find(prefix) == 0)
+      {
+        _world.artifacts.emplace_back(type, model->Name(),
+            model->RawPose());
+      }
+    }
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool loadReports(const std::string &_eventsFile, std::vector<Report> &_reports)
+{
+  YAML::Node events;
+  try
+  {
+    events = YAML::LoadFile(_eventsFile);
+  }
+  catch (const YAML::Exception &_e)
+  {
+    std::cerr << "Unable to parse [" << _eventsFile << "]: " << _e.what()
+              << std::endl;
+    return false;
+  }
+
+  // Each event is a map that starts with an empty "event" key.
+  for (const YAML::Node &event : events)
+  {
+    if (!event["type"])
+      continue;
+
+    // Duplicates were reports too, their outcome is computed again.
+    const std::string type = event["type"].as<std::string>();
+    if (type != "artifact_report_attempt" &&
+        type != "duplicate_artifact_report")
+    {
+      continue;
+    }
+
+    Report report;
+    if (!subt::ArtifactFromString(
+          event["reported_artifact_type"].as<std::string>(), report.type))
+    {
+      continue;
+    }
+    report.timeSec = event["time_sec"].as<int>();
+    std::istringstream(event["reported_pose_artifact_frame"].as<std::string>())
+      >> report.artifactFramePos;
+    std::istringstream(event["reported_pose_world_frame"].as<std::string>())
+      >> report.worldFramePos;
+    _reports.push_back(report);
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+ignition::msgs::Time toTime(int64_t _sec, int64_t _nsec)
+{
+  ignition::msgs::Time time;
+  time.set_sec(_sec);
+  time.set_nsec(_nsec);
+  return time;
+}
+
+/////////////////////////////////////////////////
+bool loadRun(const std::string &_runDir, YAML::Node &_runStats,
+    std::vector<YAML::Node> &_events, std::vector<RunItem> &_items)
+{
+  std::string eventsFile = ignition::common::joinPaths(_runDir, "events.yml");
+  YAML::Node events;
+  try
+  {
+    events = YAML::LoadFile(eventsFile);
+  }
+  catch (const YAML::Exception &_e)
+  {
+    std::cerr << "Unable to parse [" << eventsFile << "]: " << _e.what()
+              << std::endl;
+    return false;
+  }
+
+  // run.yml is only used for the robot configurations, older runs may not
+  // have it.
+  std::string runFile = ignition::common::joinPaths(_runDir, "run.yml");
+  if (ignition::common::exists(runFile))
+  {
+    try
+    {
+      _runStats = YAML::LoadFile(runFile);
+    }
+    catch (const YAML::Exception &_e)
+    {
+      std::cerr << "Unable to parse [" << runFile << "]: " << _e.what()
+                << std::endl;
+    }
+  }
+
+  // Events are added first so that they are replayed before the poses
+  // logged at the same time.
+  for (const YAML::Node &event : events)
+  {
+    if (!event["type"] || !event["time_sec"])
+      continue;
+
+    RunItem runItem;
+    runItem.time = toTime(event["time_sec"].as<int64_t>(), 0);
+    runItem.event = static_cast<int>(_events.size());
+    _events.push_back(event);
+    _items.push_back(runItem);
+  }
+
+  std::string posDir = ignition::common::joinPaths(_runDir, "pos-data");
+  if (ignition::common::isDirectory(posDir))
+  {
+    const std::string suffix = "-pos.data";
+    for (ignition::common::DirIter file(posDir);
+         file != ignition::common::DirIter(); ++file)
+    {
+      std::string name = ignition::common::basename(*file);
+      if (name.size() <= suffix.size() ||
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix))
+      {
+        continue;
+      }
+
+      RunItem runItem;
+      runItem.robot = name.substr(0, name.size() - suffix.size());
+
+      // sec nsec x y z
+      std::ifstream posStream(*file);
+      int64_t sec, nsec;
+      while (posStream >> sec >> nsec >> runItem.pos)
+      {
+        runItem.time = toTime(sec, nsec);
+        _items.push_back(runItem);
+      }
+    }
+  }
+
+  std::stable_sort(_items.begin(), _items.end(),
+      [](const RunItem &_a, const RunItem &_b)
+      {
+        return std::make_tuple(_a.time.sec(), _a.time.nsec()) <
+          std::make_tuple(_b.time.sec(), _b.time.nsec());
+      });
+
+  return true;
+}
+
+/////////////////////////////////////////////////
+std::string eventBody(const YAML::Node &_event)
+{
+  std::ostringstream stream;
+  for (const auto &pair : _event)
+  {
+    const std::string key = pair.first.as<std::string>();
+    if (key == "event" || key == "id")
+      continue;
+
+    if (pair.second.IsMap())
+    {
+      stream << "  " << key << ":\n";
+      for (const auto &extra : pair.second)
+      {
+        stream << "    " << extra.first.as<std::string>() << ": "
+               << extra.second.as<std::string>() << "\n";
+      }
+    }
+    else
+    {
+      stream << "  " << key << ": " << pair.second.as<std::string>() << "\n";
+    }
+  }
+  return stream.str();
+}
+
+/////////////////////////////////////////////////
+bool rescoreRun(const std::string &_runDir, const std::string &_outputDir,
+    const WorldData &_world, int _limit, double &_score)
+{
+  YAML::Node runStats;
+  std::vector<YAML::Node> events;
+  std::vector<RunItem> items;
+  if (!loadRun(_runDir, runStats, events, items))
+    return false;
+
+  if (!ignition::common::createDirectories(_outputDir))
+  {
+    std::cerr << "Unable to create [" << _outputDir << "]" << std::endl;
+    return false;
+  }
+
+  subt::ScoringEngine engine;
+  engine.Load(_outputDir, "score_replay", _world.name);
+  engine.SetElevationStepSize(_world.elevationStepSize);
+  if (_limit > 0)
+    engine.SetReportCountLimit(_limit);
+
+  engine.SetArtifactOrigin(_world.origin);
+  for (const auto &[type, name, pose] : _world.artifacts)
+    engine.SetArtifact(type, name, pose);
+
+  if (runStats["robots"])
+  {
+    for (const auto &robot : runStats["robots"])
+    {
+      const std::string name = robot.first.as<std::string>();
+      engine.AddRobot(name);
+      engine.SetRobotType(name, robot.second["platform"].as<std::string>(""),
+          robot.second["config"].as<std::string>(""));
+    }
+  }
+  if (runStats["marsupials"])
+  {
+    for (const auto &pair : runStats["marsupials"])
+    {
+      engine.SetMarsupialPair(pair.first.as<std::string>(),
+          pair.second.as<std::string>());
+    }
+  }
+
+  for (const RunItem &item : items)
+  {
+    if (item.event < 0)
+    {
+      // Orientations are not logged, so flips are replayed from the events.
+      ignition::math::Pose3d pose(item.pos,
+          ignition::math::Quaterniond::Identity);
+      engine.AddRobot(item.robot);
+      engine.UpdateRobotPose(item.time, item.robot, pose);
+      continue;
+    }
+
+    const YAML::Node &event = events[item.event];
+    const std::string type = event["type"].as<std::string>();
+    if (type == "started")
+    {
+      engine.Start(item.time);
+    }
+    else if (type == "finished")
+    {
+      engine.Finish(item.time);
+    }
+    else if (type == "recording_complete")
+    {
+      engine.LogRecordingComplete(item.time);
+    }
+    else if (type == "artifact_report_attempt" ||
+             type == "duplicate_artifact_report" ||
+             type == "artifact_report_not_started" ||
+             type == "artifact_report_score_finished" ||
+             type == "artifact_report_limit_exceeded" ||
+             type == "artifact_report_unknown_artifact")
+    {
+      // The outcome of every report is computed again, only the reported
+      // type and position are taken from the log. They are not logged for
+      // rejected reports, whose status does not depend on them.
+      uint32_t reportType = subt::kArtifactTypes.size();
+      ignition::math::Vector3d pos;
+      subt::ArtifactType artifactType;
+      if (event["reported_artifact_type"] && subt::ArtifactFromString(
+            event["reported_artifact_type"].as<std::string>(), artifactType))
+      {
+        reportType = static_cast<uint32_t>(artifactType);
+      }
+      if (event["reported_pose_artifact_frame"])
+      {
+        std::istringstream(
+            event["reported_pose_artifact_frame"].as<std::string>()) >> pos;
+      }
+
+      ignition::msgs::Pose pose;
+      ignition::msgs::Set(&pose, ignition::math::Pose3d(pos,
+            ignition::math::Quaterniond::Identity));
+      subt::ArtifactReportOutcome outcome =
+        engine.ReportArtifact(item.time, reportType, pose);
+      if (outcome.finish)
+        engine.Finish(item.time);
+    }
+    else if (type == "artifact_report_limit_reached")
+    {
+      // Generated by the engine when a report reaches the limit.
+      continue;
+    }
+    else if (type == "collision" || type == "detach" || type == "flip" ||
+             type == "dead_battery" || type == "breadcrumb_deploy")
+    {
+      engine.RobotEvent(item.time, type, event["robot"].as<std::string>());
+    }
+    else if (type == "detect")
+    {
+      std::map<std::string, std::string> extraData;
+      for (const auto &extra : event["extra"])
+      {
+        extraData[extra.first.as<std::string>()] =
+          extra.second.as<std::string>();
+      }
+      engine.DetectorEvent(item.time, item.time.sec(),
+          event["detector"].as<std::string>(),
+          event["robot"].as<std::string>(),
+          event["state"].as<std::string>(), extraData);
+    }
+    else
+    {
+      // Events that do not affect the score are logged as they are.
+      engine.LogEvent(eventBody(event));
+    }
+  }
+
+  // Runs that were not finished, e.g. because the recording was cut short,
+  // are finished at the time of the last item.
+  if (!items.empty())
+    engine.Finish(items.back().time);
+
+  _score = engine.TotalScore();
+  return true;
+}
+
+/////////////////////////////////////////////////
+int rescoreRuns(const std::vector<std::string> &_runDirs,
+    const std::string &_output, unsigned int _jobs,
+    const WorldData &_world, int _limit)
+{
+  std::vector<double> scores(_runDirs.size(), 0);
+  std::vector<char> success(_runDirs.size(), 0);
+  std::atomic<size_t> next{0};
+
+  // Each run has its own engine, so runs are scored independently.
+  auto worker = [&]()
+  {
+    for (size_t i = next++; i < _runDirs.size(); i = next++)
+    {
+      std::string runDir = _runDirs[i];
+      while (runDir.size() > 1 && runDir.back() == '/')
+        runDir.pop_back();
+
+      std::string outputDir = _output.empty() ?
+        ignition::common::joinPaths(runDir, "rescored") :
+        ignition::common::joinPaths(_output,
+            ignition::common::basename(runDir));
+
+      success[i] = rescoreRun(runDir, outputDir, _world, _limit, scores[i]);
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < std::min<size_t>(_jobs, _runDirs.size()); ++i)
+    threads.emplace_back(worker);
+  for (std::thread &thread : threads)
+    thread.join();
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  int result = 0;
+  for (size_t i = 0; i < _runDirs.size(); ++i)
+  {
+    if (success[i])
+    {
+      std::cout << _runDirs[i] << ": total_score: " << scores[i] << "\n";
+    }
+    else
+    {
+      std::cout << _runDirs[i] << ": failed\n";
+      result = -1;
+    }
+  }
+  std::cout << "runs: " << _runDirs.size() << "\n"
+            << "elapsed_ms: " << elapsed.count() << std::endl;
+
+  return result;
+}
+
+/////////////////////////////////////////////////
+int scoreReports(const std::string &_eventsFile, const WorldData &_world,
+    unsigned int _limit, int _repeat, bool _verbose)
+{
+  subt::ArtifactScorer artifacts;
+  for (const auto &[type, name, pose] : _world.artifacts)
+  {
+    artifacts.SetArtifact(type, name,
+        subt::ArtifactLocalizationPoint(type, pose));
+  }
+
+  std::vector<Report> reports;
+  if (!loadReports(_eventsFile, reports))
+    return -1;
+
+  double totalScore = 0;
+  unsigned int reportCount = 0;
+  unsigned int duplicateCount = 0;
+  size_t found = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < _repeat; ++r)
+  {
+    subt::ArtifactScorer scorer = artifacts;
+    totalScore = 0;
+    reportCount = 0;
+    duplicateCount = 0;
+
+    for (const Report &report : reports)
+    {
+      if (reportCount >= _limit)
+        break;
+
+      subt::ArtifactReportResult result = scorer.Score(report.type,
+          report.artifactFramePos, report.worldFramePos);
+
+      if (result.duplicate)
+      {
+        duplicateCount++;
+      }
+      else
+      {
+        reportCount++;
+        totalScore += result.score;
+      }
+
+      if (_verbose && r == 0)
+      {
+        std::string typeStr;
+        subt::StringFromArtifact(report.type, typeStr);
+        std::cout << report.timeSec << " " << typeStr << " ["
+                  << report.worldFramePos << "] closest["
+                  << result.match.name << "] distance["
+                  << result.match.distance << "] duplicate["
+                  << result.duplicate << "] score[" << result.score << "]\n";
+      }
+    }
+    found = scorer.FoundCount();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  double scored = static_cast<double>(reports.size()) * _repeat;
+  std::cout << "artifacts: " << artifacts.ArtifactCount() << "\n"
+            << "reports: " << reports.size() << "\n"
+            << "artifact_report_count: " << reportCount << "\n"
+            << "duplicate_report_count: " << duplicateCount << "\n"
+            << "artifacts_found: " << found << "\n"
+            << "total_score: " << totalScore << "\n"
+            << "reports_per_second: "
+            << (elapsed.count() > 0 ? scored * 1e6 / elapsed.count() : 0.0)
+            << std::endl;
+
+  return 0;
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  std::string worldFile = cmdLineArg(_argc, _argv, "--world=");
+  std::string eventsFile = cmdLineArg(_argc, _argv, "--events=");
+
+  // Arguments that are not options are run directories.
+  std::vector<std::string> runDirs;
+  for (int i = 1; i < _argc; ++i)
+  {
+    if (std::string(_argv[i]).find("--") != 0)
+      runDirs.push_back(_argv[i]);
+  }
+
+  if (worldFile.empty() || (eventsFile.empty() && runDirs.empty()))
+  {
+    usage();
+    return -1;
+  }
+
+  std::string limitStr = cmdLineArg(_argc, _argv, "--limit=");
+
+  int repeat = 1;
+  std::string repeatStr = cmdLineArg(_argc, _argv, "--repeat=");
+  if (!repeatStr.empty())
+    repeat = std::max(1, std::stoi(repeatStr));
+
+  unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+  std::string jobsStr = cmdLineArg(_argc, _argv, "--jobs=");
+  if (!jobsStr.empty())
+    jobs = std::max(1, std::stoi(jobsStr));
+
+  bool verbose = hasFlag(_argc, _argv, "--verbose");
+
+  WorldData world;
+  if (!loadWorld(worldFile, world))
+    return -1;
+
+  std::string elevationStr = cmdLineArg(_argc, _argv, "--elevation_step=");
+  if (!elevationStr.empty())
+    world.elevationStepSize = std::stod(elevationStr);
+
+  if (!runDirs.empty())
+  {
+    // The engine derives the default limit from the world name.
+    int limit = limitStr.empty() ? 0 : std::stoi(limitStr);
+    return rescoreRuns(runDirs, cmdLineArg(_argc, _argv, "--output="), jobs,
+        world, limit);
+  }
+
+  unsigned int limit =
+    worldFile.find("final") != std::string::npos ? 25u : 40u;
+  if (!limitStr.empty())
+    limit = std::stoul(limitStr);
+
+  return scoreReports(eventsFile, world, limit, repeat, verbose);
+}
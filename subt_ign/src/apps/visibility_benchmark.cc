@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <ignition/math/Vector3.hh>
+
+#include "subt_ign/VisibilityRfModel.hh"
+#include "subt_ign/VisibilityTable.hh"
+
+using namespace subt;
+using namespace rf_interface;
+
+/// \brief Measures how many times per second the visibility model computes
+/// the received power between two radios, which the comms broker does for
+/// every pair of radios and every packet.
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argc > 4)
+  {
+    std::cerr << "Usage visibility_benchmark <world> [iterations] [relays]"
+              << std::endl << std::endl;
+    std::cerr << "Example: ./visibility_benchmark simple_cave_02 1000000 10"
+              << std::endl;
+    return -1;
+  }
+
+  const std::string world = argv[1];
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 1000000;
+  const int relays = argc > 3 ? std::atoi(argv[3]) : 10;
+
+  visibilityModel::VisibilityModel model(
+    visibilityModel::RfConfiguration(), range_model::rf_configuration(),
+    world);
+  if (!model.Initialized())
+    return -1;
+
+  // Sample the radio positions among the vertices of the table.
+  VisibilityTable table;
+  if (!table.Load(world, true))
+    return -1;
+
+  std::vector<ignition::math::Vector3d> positions;
+  for (auto const &vertex : table.Vertices())
+  {
+    positions.emplace_back(std::get<0>(vertex.first),
+      std::get<1>(vertex.first), std::get<2>(vertex.first));
+  }
+  if (positions.empty())
+  {
+    std::cerr << "No vertices in the visibility table" << std::endl;
+    return -1;
+  }
+
+  // Always the same sequence, so that runs are comparable.
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<size_t> pick(0, positions.size() - 1);
+
+  std::set<ignition::math::Vector3d> relayPoses;
+  for (int i = 0; i < relays; ++i)
+    relayPoses.insert(positions[pick(gen)]);
+  model.PopulateVisibilityInfo(relayPoses);
+
+  const size_t kPairs = 4096;
+  std::vector<radio_state> txStates(kPairs);
+  std::vector<radio_state> rxStates(kPairs);
+  for (size_t i = 0; i < kPairs; ++i)
+  {
+    txStates[i].pose.Pos() = positions[pick(gen)];
+    rxStates[i].pose.Pos() = positions[pick(gen)];
+  }
+
+  const double txPower = 20.0;
+  double sum = 0;
+  int reachable = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+  {
+    const size_t p = i % kPairs;
+    const rf_power rx =
+      model.ComputeReceivedPower(txPower, txStates[p], rxStates[p]);
+    if (std::isfinite(rx.mean))
+    {
+      sum += rx.mean;
+      ++reachable;
+    }
+  }
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  std::cout << "World: " << world << std::endl
+            << "Vertices: " << positions.size() << std::endl
+            << "Relays: " << relayPoses.size() << std::endl
+            << "Calls: " << iterations << std::endl
+            << "Reachable: " << reachable << std::endl
+            << "Elapsed [s]: " << elapsed.count() << std::endl
+            << "Calls per second: " << iterations / elapsed.count()
+            << std::endl;
+
+  // Use the results so that the calls aren't optimized out.
+  if (reachable > 0)
+    std::cout << "Mean RX power [dBm]: " << sum / reachable << std::endl;
+
+  return 0;
+}
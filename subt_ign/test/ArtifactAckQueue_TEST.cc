@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+
+#include <subt_ign/ArtifactAckQueue.hh>
+
+using Queue = subt::ArtifactAckQueue<std::string, std::string>;
+
+/////////////////////////////////////////////////
+Queue::Report MakeReport(const std::string &_address,
+                         const std::string &_artifact)
+{
+  return {_address, _artifact, Queue::Clock::now()};
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ArtifactAckQueue, RequestsInFlight)
+{
+  Queue queue(2, std::chrono::seconds(10));
+  for (const char *artifact : {"a", "b", "c", "d"})
+    queue.AddReport(MakeReport("X1", artifact));
+  EXPECT_EQ(4u, queue.Pending());
+
+  // Only two requests may be in flight.
+  Queue::Batch batch;
+  ASSERT_TRUE(queue.Next(batch));
+  ASSERT_EQ(2u, batch.reports.size());
+  EXPECT_EQ("a", batch.reports[0].second.artifact);
+  EXPECT_EQ("b", batch.reports[1].second.artifact);
+  EXPECT_TRUE(batch.acks.empty());
+  EXPECT_EQ(2u, queue.InFlight());
+  EXPECT_EQ(2u, queue.Pending());
+
+  // A reply frees a slot, and its score is taken with the next report.
+  const uint64_t firstId = batch.reports[0].first;
+  const uint64_t secondId = batch.reports[1].first;
+  EXPECT_NE(firstId, secondId);
+  EXPECT_TRUE(queue.OnScore(firstId, "score a", true));
+  ASSERT_TRUE(queue.Next(batch));
+  ASSERT_EQ(1u, batch.reports.size());
+  EXPECT_EQ("c", batch.reports[0].second.artifact);
+  ASSERT_EQ(1u, batch.acks.size());
+  EXPECT_EQ("X1", batch.acks[0].address);
+  EXPECT_EQ("score a", batch.acks[0].score);
+  EXPECT_EQ(2u, queue.InFlight());
+  EXPECT_EQ(1u, queue.Pending());
+
+  // Replies to unknown requests are ignored.
+  EXPECT_FALSE(queue.OnScore(firstId, "score a", true));
+  EXPECT_EQ(2u, queue.InFlight());
+
+  // Nothing changed until the acks are sent.
+  std::map<std::string, subt::AckMetrics> metrics;
+  EXPECT_FALSE(queue.TakeMetrics(metrics));
+  queue.AcksSent({{"X1", 0.5}});
+  ASSERT_TRUE(queue.TakeMetrics(metrics));
+  EXPECT_EQ(1u, metrics["X1"].acks);
+  EXPECT_EQ(0u, metrics["X1"].failures);
+  EXPECT_DOUBLE_EQ(0.5, metrics["X1"].totalLatency);
+  EXPECT_DOUBLE_EQ(0.5, metrics["X1"].maxLatency);
+  EXPECT_FALSE(queue.TakeMetrics(metrics));
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ArtifactAckQueue, FailureChangesMetrics)
+{
+  Queue queue(1, std::chrono::seconds(10));
+  queue.AddReport(MakeReport("X1", "a"));
+  queue.AddReport(MakeReport("X2", "b"));
+
+  Queue::Batch batch;
+  ASSERT_TRUE(queue.Next(batch));
+  ASSERT_EQ(1u, batch.reports.size());
+
+  // A failed request frees its slot and changes the metrics without any
+  // ack being sent.
+  EXPECT_TRUE(queue.OnScore(batch.reports[0].first, "", false));
+  ASSERT_TRUE(queue.Next(batch));
+  EXPECT_TRUE(batch.acks.empty());
+  ASSERT_EQ(1u, batch.reports.size());
+  EXPECT_EQ("X2", batch.reports[0].second.address);
+
+  std::map<std::string, subt::AckMetrics> metrics;
+  ASSERT_TRUE(queue.TakeMetrics(metrics));
+  EXPECT_EQ(0u, metrics["X1"].acks);
+  EXPECT_EQ(1u, metrics["X1"].failures);
+
+  // A failure alone wakes Next() up, so that the metrics are published.
+  EXPECT_TRUE(queue.OnScore(batch.reports[0].first, "", false));
+  ASSERT_TRUE(queue.Next(batch));
+  EXPECT_TRUE(batch.reports.empty());
+  EXPECT_TRUE(batch.acks.empty());
+  ASSERT_TRUE(queue.TakeMetrics(metrics));
+  EXPECT_EQ(1u, metrics["X2"].failures);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ArtifactAckQueue, Timeout)
+{
+  Queue queue(1, std::chrono::milliseconds(20));
+  queue.AddReport(MakeReport("X1", "a"));
+  queue.AddReport(MakeReport("X1", "b"));
+
+  Queue::Batch batch;
+  ASSERT_TRUE(queue.Next(batch));
+  ASSERT_EQ(1u, batch.reports.size());
+  const uint64_t id = batch.reports[0].first;
+
+  // The next call waits for the deadline of the request, which frees the
+  // slot for the second report.
+  auto start = Queue::Clock::now();
+  ASSERT_TRUE(queue.Next(batch));
+  EXPECT_GE(Queue::Clock::now() - start, std::chrono::milliseconds(20));
+  EXPECT_EQ(1u, batch.timedOut);
+  ASSERT_EQ(1u, batch.reports.size());
+  EXPECT_EQ("b", batch.reports[0].second.artifact);
+
+  std::map<std::string, subt::AckMetrics> metrics;
+  ASSERT_TRUE(queue.TakeMetrics(metrics));
+  EXPECT_EQ(0u, metrics["X1"].acks);
+  EXPECT_EQ(1u, metrics["X1"].failures);
+
+  // A late reply is ignored.
+  EXPECT_FALSE(queue.OnScore(id, "score a", true));
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ArtifactAckQueue, Stop)
+{
+  Queue queue(1, std::chrono::seconds(10));
+  std::thread thread([&queue]
+  {
+    Queue::Batch batch;
+    while (queue.Next(batch))
+    {
+    }
+  });
+
+  queue.AddReport(MakeReport("X1", "a"));
+  queue.Stop();
+  thread.join();
+
+  Queue::Batch batch;
+  EXPECT_FALSE(queue.Next(batch));
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+
+#include <subt_ign/ArtifactScorer.hh>
+
+using namespace subt;
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ArtifactScorer, ClosestMatchesLinearScan)
+{
+  std::mt19937 gen(1234);
+  std::uniform_real_distribution<double> dist(-300.0, 300.0);
+
+  std::map<std::string, ignition::math::Vector3d> points;
+  for (int i = 0; i < 500; ++i)
+  {
+    points["backpack_" + std::to_string(i)] =
+      ignition::math::Vector3d(dist(gen), dist(gen), dist(gen) * 0.1);
+  }
+  // An artifact whose pose has not been received yet.
+  points["backpack_unknown"] = ignition::math::Vector3d(
+      ignition::math::INF_D, ignition::math::INF_D, ignition::math::INF_D);
+
+  ArtifactIndex index;
+  index.Build(points);
+  EXPECT_EQ(500u, index.Size());
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    ignition::math::Vector3d query(dist(gen), dist(gen), dist(gen) * 0.1);
+
+    std::string expectedName;
+    double expectedDist = std::numeric_limits<double>::infinity();
+    for (const auto &point : points)
+    {
+      if (std::isinf(point.second.X()))
+        continue;
+      double d = query.Distance(point.second);
+      if (d < expectedDist)
+      {
+        expectedName = point.first;
+        expectedDist = d;
+      }
+    }
+
+    ArtifactMatch match;
+    ASSERT_TRUE(index.Closest(query, match));
+    EXPECT_EQ(expectedName, match.name);
+    EXPECT_DOUBLE_EQ(expectedDist, match.distance);
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ArtifactScorer, TieGoesToSmallestName)
+{
+  std::map<std::string, ignition::math::Vector3d> points =
+  {
+    {"drill_b", ignition::math::Vector3d(1, 0, 0)},
+    {"drill_a", ignition::math::Vector3d(-1, 0, 0)},
+    {"drill_c", ignition::math::Vector3d(0, 1, 0)}
+  };
+
+  ArtifactIndex index;
+  index.Build(points);
+
+  ArtifactMatch match;
+  ASSERT_TRUE(index.Closest(ignition::math::Vector3d::Zero, match));
+  EXPECT_EQ("drill_a", match.name);
+  EXPECT_DOUBLE_EQ(1.0, match.distance);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ArtifactScorer, Score)
+{
+  ArtifactScorer scorer;
+  EXPECT_TRUE(scorer.SetArtifact(ArtifactType::TYPE_PHONE, "phone_1",
+      ignition::math::Vector3d(10, 0, 0)));
+  EXPECT_TRUE(scorer.SetArtifact(ArtifactType::TYPE_PHONE, "phone_2",
+      ignition::math::Vector3d(30, 0, 0)));
+  EXPECT_FALSE(scorer.SetArtifact(ArtifactType::TYPE_PHONE, "phone_2",
+      ignition::math::Vector3d(20, 0, 0)));
+  EXPECT_EQ(2u, scorer.ArtifactCount());
+  EXPECT_TRUE(scorer.HasArtifact(ArtifactType::TYPE_PHONE, "phone_1"));
+  EXPECT_FALSE(scorer.HasArtifact(ArtifactType::TYPE_ROPE, "phone_1"));
+
+  // No artifact of the reported type.
+  ArtifactReportResult result = scorer.Score(ArtifactType::TYPE_ROPE,
+      ignition::math::Vector3d(1, 2, 3), ignition::math::Vector3d(10, 0, 0));
+  EXPECT_FALSE(result.duplicate);
+  EXPECT_DOUBLE_EQ(0.0, result.score);
+  EXPECT_TRUE(std::isinf(result.match.distance));
+  EXPECT_TRUE(result.match.name.empty());
+
+  // Too far.
+  result = scorer.Score(ArtifactType::TYPE_PHONE,
+      ignition::math::Vector3d(1, 0, 0), ignition::math::Vector3d(15, 0, 0));
+  EXPECT_DOUBLE_EQ(0.0, result.score);
+  EXPECT_EQ("phone_1", result.match.name);
+  EXPECT_DOUBLE_EQ(5.0, result.match.distance);
+
+  // Scores, the updated pose of phone_2 is used.
+  result = scorer.Score(ArtifactType::TYPE_PHONE,
+      ignition::math::Vector3d(2, 0, 0), ignition::math::Vector3d(21, 0, 0));
+  EXPECT_DOUBLE_EQ(1.0, result.score);
+  EXPECT_EQ("phone_2", result.match.name);
+  EXPECT_EQ(1u, scorer.FoundCount());
+
+  // Duplicate report, up to the key resolution.
+  result = scorer.Score(ArtifactType::TYPE_PHONE,
+      ignition::math::Vector3d(2.0000001, 0, 0),
+      ignition::math::Vector3d(21, 0, 0));
+  EXPECT_TRUE(result.duplicate);
+  EXPECT_DOUBLE_EQ(1.0, result.score);
+
+  // Artifact already found.
+  result = scorer.Score(ArtifactType::TYPE_PHONE,
+      ignition::math::Vector3d(3, 0, 0), ignition::math::Vector3d(20, 0, 0));
+  EXPECT_FALSE(result.duplicate);
+  EXPECT_DOUBLE_EQ(0.0, result.score);
+  EXPECT_EQ(1u, scorer.FoundCount());
+}
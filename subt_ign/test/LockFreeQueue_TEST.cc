@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <subt_ign/LockFreeQueue.hh>
+
+/////////////////////////////////////////////////
+TEST(subt_ign_LockFreeQueue, FifoAndFull)
+{
+  subt::LockFreeQueue<std::string> queue(3);
+  EXPECT_EQ(4u, queue.Capacity());
+
+  std::string value;
+  EXPECT_FALSE(queue.Pop(value));
+
+  // Wrap around a few times.
+  for (int round = 0; round < 3; ++round)
+  {
+    for (int i = 0; i < 4; ++i)
+      EXPECT_TRUE(queue.Push(std::to_string(round * 10 + i)));
+    EXPECT_FALSE(queue.Push("full"));
+
+    for (int i = 0; i < 4; ++i)
+    {
+      ASSERT_TRUE(queue.Pop(value));
+      EXPECT_EQ(std::to_string(round * 10 + i), value);
+    }
+    EXPECT_FALSE(queue.Pop(value));
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_LockFreeQueue, ManyProducers)
+{
+  const int producers = 4;
+  const int perProducer = 20000;
+  subt::LockFreeQueue<int> queue(64);
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p)
+  {
+    threads.emplace_back([&queue, p]()
+    {
+      for (int i = 0; i < perProducer; ++i)
+      {
+        while (!queue.Push(p * perProducer + i))
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  // Every element arrives exactly once, and in order per producer.
+  std::vector<int> last(producers, -1);
+  int received = 0;
+  int value;
+  while (received < producers * perProducer)
+  {
+    if (!queue.Pop(value))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    const int p = value / perProducer;
+    const int i = value % perProducer;
+    ASSERT_EQ(last[p] + 1, i);
+    last[p] = i;
+    ++received;
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+  EXPECT_FALSE(queue.Pop(value));
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+
+#include <subt_ign/PoseCache.hh>
+
+/// \brief Add a pose to a pose message.
+/// \param[in] _id Entity id.
+/// \param[in] _name Name of the entity.
+/// \param[in] _x X coordinate of the pose.
+/// \param[out] _msg The message.
+static void addPose(uint32_t _id, const std::string &_name, double _x,
+    ignition::msgs::Pose_V &_msg)
+{
+  ignition::msgs::Pose *pose = _msg.add_pose();
+  pose->set_id(_id);
+  pose->set_name(_name);
+  ignition::msgs::Set(pose, ignition::math::Pose3d(_x, 0, 0, 0, 0, 0));
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_PoseCache, Intern)
+{
+  subt::PoseCache cache;
+  EXPECT_EQ(subt::PoseCache::kInvalidId, cache.Id("X1"));
+
+  const int x1 = cache.Intern("X1");
+  const int x2 = cache.Intern("X2");
+  EXPECT_NE(x1, x2);
+  EXPECT_EQ(x1, cache.Intern("X1"));
+  EXPECT_EQ(x2, cache.Id("X2"));
+
+  ignition::math::Pose3d pose;
+  EXPECT_FALSE(cache.Pose(x1, pose));
+  EXPECT_FALSE(cache.Pose(subt::PoseCache::kInvalidId, pose));
+
+  ignition::msgs::Pose_V msg;
+  msg.mutable_header()->mutable_stamp()->set_sec(12);
+  addPose(10, "X1", 1.0, msg);
+  addPose(11, "tile_1", 2.0, msg);
+  addPose(12, "X2", 3.0, msg);
+  cache.OnPoses(msg);
+
+  EXPECT_DOUBLE_EQ(12.0, cache.SimTime().Double());
+  ASSERT_TRUE(cache.Pose(x1, pose));
+  EXPECT_DOUBLE_EQ(1.0, pose.Pos().X());
+  ASSERT_TRUE(cache.Pose("X2", pose));
+  EXPECT_DOUBLE_EQ(3.0, pose.Pos().X());
+
+  // Entities are matched by id once they are known.
+  msg.Clear();
+  addPose(10, "", 4.0, msg);
+  cache.OnPoses(msg);
+  ASSERT_TRUE(cache.Pose(x1, pose));
+  EXPECT_DOUBLE_EQ(4.0, pose.Pos().X());
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_PoseCache, LateIntern)
+{
+  subt::PoseCache cache;
+  ignition::msgs::Pose_V msg;
+  addPose(10, "X1", 1.0, msg);
+  cache.OnPoses(msg);
+
+  // The entity was seen before its name was interned.
+  ignition::math::Pose3d pose;
+  EXPECT_FALSE(cache.Pose("X1", pose));
+  const int x1 = cache.Intern("X1");
+  EXPECT_FALSE(cache.Pose(x1, pose));
+  cache.OnPoses(msg);
+  ASSERT_TRUE(cache.Pose("X1", pose));
+  EXPECT_DOUBLE_EQ(1.0, pose.Pos().X());
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_PoseCache, Breadcrumbs)
+{
+  EXPECT_TRUE(subt::PoseCache::IsStaticBreadcrumb(
+    "X1__breadcrumb__1__static__"));
+  EXPECT_FALSE(subt::PoseCache::IsStaticBreadcrumb("X1__breadcrumb__1"));
+  EXPECT_FALSE(subt::PoseCache::IsStaticBreadcrumb("X1"));
+
+  subt::PoseCache cache;
+  std::set<ignition::math::Vector3d> breadcrumbs;
+  EXPECT_FALSE(cache.NewBreadcrumbs(breadcrumbs));
+
+  ignition::msgs::Scene scene;
+  ignition::msgs::Model *model = scene.add_model();
+  model->set_name("X1__breadcrumb__1");
+  model = scene.add_model();
+  model->set_name("X1__breadcrumb__1__static__");
+  ignition::msgs::Set(model->mutable_pose(),
+    ignition::math::Pose3d(1, 2, 3, 0, 0, 0));
+  cache.OnScene(scene);
+
+  ASSERT_TRUE(cache.NewBreadcrumbs(breadcrumbs));
+  ASSERT_EQ(1u, breadcrumbs.size());
+  EXPECT_EQ(ignition::math::Vector3d(1, 2, 3), *breadcrumbs.begin());
+  EXPECT_FALSE(cache.NewBreadcrumbs(breadcrumbs));
+
+  // The same breadcrumb again isn't new.
+  cache.OnScene(scene);
+  EXPECT_FALSE(cache.NewBreadcrumbs(breadcrumbs));
+
+  model = scene.add_model();
+  model->set_name("X2__breadcrumb__1__static__");
+  ignition::msgs::Set(model->mutable_pose(),
+    ignition::math::Pose3d(4, 5, 6, 0, 0, 0));
+  cache.OnScene(scene);
+  ASSERT_TRUE(cache.NewBreadcrumbs(breadcrumbs));
+  EXPECT_EQ(2u, breadcrumbs.size());
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_PoseCache, Watch)
+{
+  subt::PoseCache cache;
+  EXPECT_FALSE(cache.Watch("tile_0"));
+
+  ignition::msgs::Pose_V msg;
+  for (size_t i = 0; i <= subt::PoseCache::kMaxWatched + 1; ++i)
+    addPose(10 + i, "tile_" + std::to_string(i), i, msg);
+  cache.OnPoses(msg);
+
+  // Watching doesn't intern.
+  ignition::math::Pose3d pose;
+  ASSERT_TRUE(cache.Watch("tile_0"));
+  EXPECT_EQ(subt::PoseCache::kInvalidId, cache.Id("tile_0"));
+  EXPECT_FALSE(cache.Pose("tile_0", pose));
+  cache.OnPoses(msg);
+  ASSERT_TRUE(cache.Pose("tile_0", pose));
+  EXPECT_DOUBLE_EQ(0.0, pose.Pos().X());
+
+  // Interning a watched model keeps its pose.
+  const int tile0 = cache.Intern("tile_0");
+  ASSERT_TRUE(cache.Pose(tile0, pose));
+  EXPECT_DOUBLE_EQ(0.0, pose.Pos().X());
+
+  // Watching too many models forgets the first one.
+  for (size_t i = 1; i <= subt::PoseCache::kMaxWatched + 1; ++i)
+    ASSERT_TRUE(cache.Watch("tile_" + std::to_string(i)));
+  cache.OnPoses(msg);
+  EXPECT_FALSE(cache.Pose("tile_1", pose));
+  ASSERT_TRUE(cache.Pose("tile_2", pose));
+  EXPECT_DOUBLE_EQ(2.0, pose.Pos().X());
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_PoseCache, BreadcrumbPoses)
+{
+  // Breadcrumbs are found in the poses when their creation event is missed.
+  subt::PoseCache cache;
+  ignition::msgs::Pose_V msg;
+  addPose(10, "X1", 1.0, msg);
+  addPose(11, "X1__breadcrumb__1__static__", 2.0, msg);
+  cache.OnPoses(msg);
+
+  std::set<ignition::math::Vector3d> breadcrumbs;
+  ASSERT_TRUE(cache.NewBreadcrumbs(breadcrumbs));
+  ASSERT_EQ(1u, breadcrumbs.size());
+  EXPECT_EQ(ignition::math::Vector3d(2, 0, 0), *breadcrumbs.begin());
+
+  cache.OnPoses(msg);
+  EXPECT_FALSE(cache.NewBreadcrumbs(breadcrumbs));
+}
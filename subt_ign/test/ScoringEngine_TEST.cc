@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <yaml-cpp/yaml.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ignition/common/Filesystem.hh>
+#include <ignition/math/Pose3.hh>
+#include <ignition/msgs/Utility.hh>
+
+#include <subt_ign/ScoringEngine.hh>
+
+using namespace subt;
+
+/////////////////////////////////////////////////
+ignition::msgs::Time simTime(int64_t _sec, int32_t _nsec = 0)
+{
+  ignition::msgs::Time time;
+  time.set_sec(_sec);
+  time.set_nsec(_nsec);
+  return time;
+}
+
+/////////////////////////////////////////////////
+ignition::msgs::Pose reportPose(double _x, double _y, double _z)
+{
+  ignition::msgs::Pose pose;
+  ignition::msgs::Set(&pose, ignition::math::Pose3d(_x, _y, _z, 0, 0, 0));
+  return pose;
+}
+
+/////////////////////////////////////////////////
+std::string tempLogPath(const std::string &_name)
+{
+  std::string path = ignition::common::joinPaths(
+      ::testing::TempDir(), "scoring_engine_" + _name);
+  ignition::common::removeAll(path);
+  ignition::common::createDirectory(path);
+  return path;
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ScoringEngine, Reports)
+{
+  std::string logPath = tempLogPath("reports");
+
+  ScoringEngine engine;
+  engine.Load(logPath, "test", "simple_tunnel_01");
+  EXPECT_EQ(40u, engine.ReportCountLimit());
+
+  // Reports are relative to the artifact origin.
+  engine.SetArtifactOrigin(ignition::math::Pose3d(100, 0, 0, 0, 0, 0));
+  // The gas localization point has no offset from the model pose.
+  EXPECT_TRUE(engine.SetArtifact(ArtifactType::TYPE_GAS, "gas_1",
+      ignition::math::Pose3d(110, 0, 0, 0, 0, 0)));
+  EXPECT_TRUE(engine.SetArtifact(ArtifactType::TYPE_GAS, "gas_2",
+      ignition::math::Pose3d(150, 0, 0, 0, 0, 0)));
+  EXPECT_FALSE(engine.SetArtifact(ArtifactType::TYPE_GAS, "gas_1",
+      ignition::math::Pose3d(110, 0, 0, 0, 0, 0)));
+
+  uint32_t gas = static_cast<uint32_t>(ArtifactType::TYPE_GAS);
+
+  // Not started yet.
+  ArtifactReportOutcome outcome =
+    engine.ReportArtifact(simTime(1), gas, reportPose(10, 0, 0));
+  EXPECT_EQ("run not started", outcome.status);
+  EXPECT_FALSE(outcome.scored);
+  EXPECT_EQ(0u, engine.ReportCount());
+
+  EXPECT_TRUE(engine.Start(simTime(2)));
+  EXPECT_FALSE(engine.Start(simTime(3)));
+  EXPECT_TRUE(engine.Started());
+
+  // Scores.
+  outcome = engine.ReportArtifact(simTime(10), gas, reportPose(11, 0, 0));
+  EXPECT_EQ("scored", outcome.status);
+  EXPECT_TRUE(outcome.scored);
+  EXPECT_DOUBLE_EQ(1.0, outcome.scoreChange);
+  EXPECT_EQ(1u, outcome.reportId);
+  EXPECT_EQ("gas_1", outcome.closestArtifactName);
+  EXPECT_DOUBLE_EQ(1.0, outcome.distance);
+  EXPECT_FALSE(outcome.finish);
+
+  // Duplicate, does not count towards the limit.
+  outcome = engine.ReportArtifact(simTime(11), gas, reportPose(11, 0, 0));
+  EXPECT_FALSE(outcome.scored);
+  EXPECT_DOUBLE_EQ(1.0, outcome.scoreChange);
+  EXPECT_EQ(1u, outcome.reportId);
+
+  // Too far.
+  outcome = engine.ReportArtifact(simTime(12), gas, reportPose(40, 0, 0));
+  EXPECT_TRUE(outcome.scored);
+  EXPECT_EQ("gas_2", outcome.closestArtifactName);
+  EXPECT_DOUBLE_EQ(0.0, outcome.scoreChange);
+  EXPECT_DOUBLE_EQ(10.0, outcome.distance);
+
+  // Unknown type.
+  outcome = engine.ReportArtifact(simTime(13), 1000u, reportPose(0, 0, 0));
+  EXPECT_FALSE(outcome.scored);
+
+  EXPECT_EQ(2u, engine.ReportCount());
+  EXPECT_DOUBLE_EQ(1.0, engine.TotalScore());
+
+  EXPECT_TRUE(engine.Finish(simTime(20)));
+  EXPECT_FALSE(engine.Finish(simTime(21)));
+  EXPECT_TRUE(engine.Finished());
+
+  outcome = engine.ReportArtifact(simTime(22), gas, reportPose(10, 0, 0));
+  EXPECT_EQ("scoring finished", outcome.status);
+
+  // Run files.
+  YAML::Node score = YAML::LoadFile(logPath + "/score.yml");
+  EXPECT_DOUBLE_EQ(1.0, score.as<double>());
+
+  YAML::Node summary = YAML::LoadFile(logPath + "/summary.yml");
+  EXPECT_EQ(1, summary["was_started"].as<int>());
+  EXPECT_EQ(18, summary["sim_time_duration_sec"].as<int>());
+
+  YAML::Node run = YAML::LoadFile(logPath + "/run.yml");
+  EXPECT_EQ("simple_tunnel_01", run["world_name"].as<std::string>());
+  EXPECT_EQ(1, run["artifacts_found"].as<int>());
+  EXPECT_EQ(2, run["artifact_report_count"].as<int>());
+  EXPECT_EQ(1, run["duplicate_report_count"].as<int>());
+  EXPECT_EQ("gas_1",
+      run["closest_artifact_report"]["name"].as<std::string>());
+
+  YAML::Node events = YAML::LoadFile(logPath + "/events.yml");
+  std::vector<std::string> types;
+  for (const auto &item : events)
+    types.push_back(item["type"].as<std::string>());
+  std::vector<std::string> expectedTypes =
+  {
+    "artifact_report_not_started",
+    "started",
+    "artifact_report_attempt",
+    "duplicate_artifact_report",
+    "artifact_report_attempt",
+    "artifact_report_unknown_artifact",
+    "finished",
+    "artifact_report_score_finished"
+  };
+  EXPECT_EQ(expectedTypes, types);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ScoringEngine, ReportLimit)
+{
+  std::string logPath = tempLogPath("limit");
+
+  ScoringEngine engine;
+  engine.Load(logPath, "test", "finals_qual");
+  EXPECT_EQ(25u, engine.ReportCountLimit());
+  engine.SetReportCountLimit(2);
+
+  uint32_t phone = static_cast<uint32_t>(ArtifactType::TYPE_PHONE);
+  engine.Start(simTime(0));
+
+  ArtifactReportOutcome outcome =
+    engine.ReportArtifact(simTime(1), phone, reportPose(1, 0, 0));
+  EXPECT_FALSE(outcome.finish);
+
+  // The run is not finished by the engine, the caller decides when.
+  outcome = engine.ReportArtifact(simTime(2), phone, reportPose(2, 0, 0));
+  EXPECT_EQ("report limit reached", outcome.status);
+  EXPECT_TRUE(outcome.finish);
+  EXPECT_FALSE(engine.Finished());
+
+  outcome = engine.ReportArtifact(simTime(3), phone, reportPose(3, 0, 0));
+  EXPECT_EQ("report limit exceeded", outcome.status);
+  EXPECT_TRUE(outcome.finish);
+  EXPECT_EQ(2u, engine.ReportCount());
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ScoringEngine, RobotStatistics)
+{
+  std::string logPath = tempLogPath("statistics");
+
+  ScoringEngine engine;
+  engine.Load(logPath, "test", "simple_cave_01");
+  engine.SetElevationStepSize(1.0);
+  EXPECT_TRUE(engine.AddRobot("x1"));
+  EXPECT_FALSE(engine.AddRobot("x1"));
+  EXPECT_TRUE(engine.AddRobot("x2"));
+  engine.SetRobotType("x1", "X1", "X1 SENSOR CONFIG 1");
+  engine.SetRobotType("x2", "X1", "X1 SENSOR CONFIG 2");
+  engine.SetMarsupialPair("x1", "x2");
+  EXPECT_EQ("X1", engine.RobotPlatform("x1"));
+
+  int kinematicStates = 0;
+  engine.SetKinematicStateCallback(
+      [&](const ignition::msgs::Time &, const std::string &_robot,
+          const KinematicState &_state)
+      {
+        EXPECT_EQ("x1", _robot);
+        EXPECT_LE(2.0, _state.speed);
+        kinematicStates++;
+      });
+
+  engine.Start(simTime(0));
+
+  // x1 drives 2 m/s along x and climbs 2 m on the way, x2 does not move.
+  EXPECT_TRUE(engine.UpdateRobotPose(simTime(0), "x1",
+      ignition::math::Pose3d(0, 0, 0, 0, 0, 0)));
+  EXPECT_TRUE(engine.UpdateRobotPose(simTime(0), "x2",
+      ignition::math::Pose3d(5, 0, 0, 0, 0, 0)));
+  for (int i = 1; i <= 10; ++i)
+  {
+    double z = i >= 8 ? 2.0 : 0.0;
+
+    // Samples closer than 1 m and 1 s are skipped.
+    EXPECT_FALSE(engine.UpdateRobotPose(simTime(i - 1, 500000000), "x1",
+        ignition::math::Pose3d(i * 2.0 - 1.5, 0, i > 8 ? z : 0, 0, 0, 0)));
+    EXPECT_FALSE(engine.UpdateRobotPose(simTime(i), "x1",
+        ignition::math::Pose3d(i * 2.0, 0, z, 0, 0, 0)));
+  }
+  EXPECT_EQ(10, kinematicStates);
+
+  engine.Finish(simTime(10));
+
+  YAML::Node run = YAML::LoadFile(logPath + "/run.yml");
+  EXPECT_EQ(2, run["robot_count"].as<int>());
+  EXPECT_EQ(1, run["unique_robot_count"].as<int>());
+  EXPECT_EQ("X1 SENSOR CONFIG 2",
+      run["robots"]["x2"]["config"].as<std::string>());
+  EXPECT_EQ("x2", run["marsupials"]["x1"].as<std::string>());
+  EXPECT_EQ("x1", run["greatest_distance_traveled_robot"].as<std::string>());
+  EXPECT_NEAR(18.0 + std::sqrt(8.0),
+      run["greatest_distance_traveled"].as<double>(), 1e-6);
+  EXPECT_NEAR(18.0 + std::sqrt(8.0),
+      run["total_distance_traveled"].as<double>(), 1e-6);
+  EXPECT_NEAR(std::sqrt(404.0),
+      run["greatest_euclidean_distance_from_start"].as<double>(), 1e-6);
+  EXPECT_DOUBLE_EQ(2.0, run["greatest_elevation_gain"].as<double>());
+  EXPECT_DOUBLE_EQ(2.0, run["max_elevation_reached"].as<double>());
+
+  // Only the samples used for the statistics are logged.
+  std::ifstream posData(logPath + "/pos-data/x1-pos.data");
+  int lines = 0;
+  for (std::string line; std::getline(posData, line);)
+    lines++;
+  EXPECT_EQ(11, lines);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ScoringEngine, RobotPosesBatch)
+{
+  // The same trajectories fed one robot at a time and all robots at once.
+  std::string singlePath = tempLogPath("single");
+  std::string batchPath = tempLogPath("batch");
+
+  ScoringEngine single;
+  ScoringEngine batch;
+  single.Load(singlePath, "test", "simple_cave_01");
+  batch.Load(batchPath, "test", "simple_cave_01");
+
+  int singleFlips = 0;
+  int batchFlips = 0;
+  single.SetRobotEventCallback(
+      [&](const ignition::msgs::Time &, const std::string &_type,
+          const std::string &_robot, int)
+      {
+        EXPECT_EQ("flip", _type);
+        EXPECT_EQ("x2", _robot);
+        singleFlips++;
+      });
+  batch.SetRobotEventCallback(
+      [&](const ignition::msgs::Time &, const std::string &_type,
+          const std::string &_robot, int)
+      {
+        EXPECT_EQ("flip", _type);
+        EXPECT_EQ("x2", _robot);
+        batchFlips++;
+      });
+
+  single.Start(simTime(0));
+  batch.Start(simTime(0));
+
+  // Robots are registered in a different order than their names.
+  std::vector<std::string> names{"x3", "x1", "x2"};
+  for (std::size_t r = 0; r < names.size(); ++r)
+    EXPECT_EQ(r, batch.RobotIndex(names[r]));
+  RobotPoses poses;
+  poses.Resize(names.size());
+  EXPECT_EQ(1u, batch.RobotIndex("x1"));
+
+  for (int i = 0; i <= 100; ++i)
+  {
+    const double t = i * 0.1;
+    const auto time = simTime(i / 10, (i % 10) * 100000000);
+
+    // x1 drives at 3 m/s, x2 lies upside down and x3 has no pose yet.
+    std::vector<ignition::math::Pose3d> robotPoses{
+        ignition::math::Pose3d(),
+        ignition::math::Pose3d(3.0 * t, 0, 0.5 * t, 0, 0, 0),
+        ignition::math::Pose3d(5, 0, 0, 0, 1, 0, 0)};
+    for (std::size_t r = 1; r < names.size(); ++r)
+    {
+      single.UpdateRobotPose(time, names[r], robotPoses[r]);
+      poses.Set(r, robotPoses[r]);
+    }
+    batch.UpdateRobotPoses(time, poses);
+
+    single.CheckRobotFlip(time);
+    batch.CheckRobotFlip(time);
+  }
+  EXPECT_EQ(1, singleFlips);
+  EXPECT_EQ(1, batchFlips);
+
+  single.Finish(simTime(10));
+  batch.Finish(simTime(10));
+
+  YAML::Node singleRun = YAML::LoadFile(singlePath + "/run.yml");
+  YAML::Node batchRun = YAML::LoadFile(batchPath + "/run.yml");
+  for (const std::string key : {"greatest_distance_traveled",
+      "total_distance_traveled", "greatest_avg_vel", "greatest_max_vel",
+      "greatest_euclidean_distance_from_start", "greatest_elevation_gain"})
+  {
+    EXPECT_DOUBLE_EQ(singleRun[key].as<double>(), batchRun[key].as<double>())
+      << key;
+  }
+  EXPECT_LT(0.0, batchRun["total_distance_traveled"].as<double>());
+}
+
+/////////////////////////////////////////////////
+TEST(subt_ign_ScoringEngine, IncrementalStatistics)
+{
+  std::string logPath = tempLogPath("incremental");
+
+  ScoringEngine engine;
+  engine.Load(logPath, "test", "simple_urban_01");
+
+  int snapshots = 0;
+  RunStatistics last;
+  engine.SetStatisticsCallback([&](const RunStatistics &_stats)
+      {
+        last = _stats;
+        snapshots++;
+      });
+
+  engine.Start(simTime(0));
+  EXPECT_EQ(1, snapshots);
+
+  // Nothing changed, only the elapsed time.
+  engine.UpdateScoreFiles(simTime(5));
+  EXPECT_EQ(1, snapshots);
+
+  // The average velocity does not depend on when the pos data is written.
+  engine.UpdateRobotPose(simTime(0), "x1",
+      ignition::math::Pose3d(0, 0, 0, 0, 0, 0));
+  engine.UpdateRobotPose(simTime(1), "x1",
+      ignition::math::Pose3d(3, 0, 0, 0, 0, 0));
+  engine.UpdateScoreFiles(simTime(1));
+  EXPECT_EQ(2, snapshots);
+  EXPECT_DOUBLE_EQ(1.5, last.greatestAvgVel.second);
+
+  engine.UpdateRobotPose(simTime(2), "x1",
+      ignition::math::Pose3d(6, 0, 0, 0, 0, 0));
+  engine.UpdateScoreFiles(simTime(2));
+  EXPECT_EQ(3, snapshots);
+  EXPECT_DOUBLE_EQ(2.0, last.greatestAvgVel.second);
+  EXPECT_DOUBLE_EQ(3.0, last.greatestMaxVel.second);
+  EXPECT_DOUBLE_EQ(6.0, last.totalDistanceTraveled);
+
+  engine.UpdateScoreFiles(simTime(3));
+  EXPECT_EQ(3, snapshots);
+
+  // The final snapshot is always taken, and written before Finish returns.
+  engine.Finish(simTime(4));
+  EXPECT_EQ(4, snapshots);
+  EXPECT_EQ(4, last.simTimeElapsed);
+
+  YAML::Node run = YAML::LoadFile(logPath + "/run.yml");
+  EXPECT_EQ(4, run["sim_time"].as<int>());
+  EXPECT_DOUBLE_EQ(2.0, run["greatest_avg_vel"].as<double>());
+}
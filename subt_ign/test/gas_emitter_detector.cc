@@ -61,6 +61,11 @@ const std::string worldSdf = R"(
         <pose>30 0 0 0 0 0</pose>
         <geometry><box><size>1.0 1.0 1.0</size></box></geometry>
       </emitter>
+      <emitter>
+        <type>co</type>
+        <pose>300 0 0 0 0 0</pose>
+        <geometry><box><size>100.0 1.0 1.0</size></box></geometry>
+      </emitter>
     </plugin>
 
     <model name="gas_emitter_model">
@@ -217,6 +222,18 @@ TEST(GasEmitterDetector, GasEmitterDetector)
   EXPECT_FALSE(oxygen);
   EXPECT_FALSE(propane);
   EXPECT_FALSE(any);
+
+  // An emitter spanning several cells of the emitter index.
+  move_detector(260.0);
+  EXPECT_FALSE(methane);
+  EXPECT_TRUE(any);
+
+  move_detector(340.0);
+  EXPECT_FALSE(methane);
+  EXPECT_TRUE(any);
+
+  move_detector(360.0);
+  EXPECT_FALSE(any);
 }
 
 int main(int argc, char **argv)
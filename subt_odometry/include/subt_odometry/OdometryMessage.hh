@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef SUBT_ODOMETRY_ODOMETRYMESSAGE_HH_
+#define SUBT_ODOMETRY_ODOMETRYMESSAGE_HH_
+
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include <ignition/msgs/odometry.pb.h>
+
+#include "subt_odometry/WheelOdometry.hh"
+
+namespace subt
+{
+namespace odometry
+{
+  /// \brief An odometry message that is built once and then only updated.
+  /// The frame ids are stored in the header when the message is created, so
+  /// filling it in allocates nothing.
+  class OdometryMessage
+  {
+    /// \brief Set the frame ids.
+    /// \param[in] _frameId Frame of the pose, e.g. "X1/odom".
+    /// \param[in] _childFrameId Frame of the vehicle, e.g. "X1/base_link".
+    /// Nothing is stored if empty.
+    public: void SetFrames(const std::string &_frameId,
+      const std::string &_childFrameId)
+    {
+      auto header = this->msg.mutable_header();
+      header->clear_data();
+
+      auto frame = header->add_data();
+      frame->set_key("frame_id");
+      frame->add_value(_frameId);
+
+      if (!_childFrameId.empty())
+      {
+        auto childFrame = header->add_data();
+        childFrame->set_key("child_frame_id");
+        childFrame->add_value(_childFrameId);
+      }
+    }
+
+    /// \brief Fill in the message.
+    /// \param[in] _time Simulation time of the odometry.
+    /// \param[in] _pose The pose.
+    /// \param[in] _linear Forward velocity.
+    /// \param[in] _angular Angular velocity around z.
+    /// \return The message, valid until the next call.
+    public: const ignition::msgs::Odometry &Fill(
+      const std::chrono::steady_clock::duration &_time, const Pose2 &_pose,
+      const double _linear, const double _angular)
+    {
+      const auto sec = std::chrono::duration_cast<std::chrono::seconds>(_time);
+      auto stamp = this->msg.mutable_header()->mutable_stamp();
+      stamp->set_sec(sec.count());
+      stamp->set_nsec(static_cast<int32_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          _time - sec).count()));
+
+      auto position = this->msg.mutable_pose()->mutable_position();
+      position->set_x(_pose.x);
+      position->set_y(_pose.y);
+      position->set_z(0.0);
+
+      auto orientation = this->msg.mutable_pose()->mutable_orientation();
+      orientation->set_x(0.0);
+      orientation->set_y(0.0);
+      orientation->set_z(std::sin(0.5 * _pose.yaw));
+      orientation->set_w(std::cos(0.5 * _pose.yaw));
+
+      this->msg.mutable_twist()->mutable_linear()->set_x(_linear);
+      this->msg.mutable_twist()->mutable_angular()->set_z(_angular);
+
+      return this->msg;
+    }
+
+    /// \brief Fill in the message from wheel odometry.
+    /// \param[in] _time Simulation time of the odometry.
+    /// \param[in] _odometry The odometry.
+    /// \return The message, valid until the next call.
+    public: const ignition::msgs::Odometry &Fill(
+      const std::chrono::steady_clock::duration &_time,
+      const WheelOdometry &_odometry)
+    {
+      return this->Fill(_time, _odometry.Pose(), _odometry.LinearVelocity(),
+          _odometry.AngularVelocity());
+    }
+
+    /// \brief The reused message.
+    private: ignition::msgs::Odometry msg;
+  };
+}
+}
+
+#endif
@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef SUBT_ODOMETRY_WHEELODOMETRY_HH_
+#define SUBT_ODOMETRY_WHEELODOMETRY_HH_
+
+#include <chrono>
+#include <cmath>
+
+namespace subt
+{
+namespace odometry
+{
+  /// \brief Planar pose of a vehicle.
+  struct Pose2
+  {
+    /// \brief X position.
+    double x{0.0};
+
+    /// \brief Y position.
+    double y{0.0};
+
+    /// \brief Heading, normalized to [-pi, pi].
+    double yaw{0.0};
+  };
+
+  /// \brief Wrap an angle to [-pi, pi].
+  /// \param[in] _angle Angle in radians.
+  /// \return The wrapped angle.
+  inline double NormalizeAngle(const double _angle)
+  {
+    return std::atan2(std::sin(_angle), std::cos(_angle));
+  }
+
+  /// \brief Move a pose along a circular arc.
+  /// The arc is exact for any curvature, including straight lines, so the
+  /// result does not depend on how finely the motion is sampled.
+  /// \param[in,out] _pose The pose to move.
+  /// \param[in] _distance Length of the arc.
+  /// \param[in] _deltaYaw Heading change along the arc.
+  inline void IntegrateArc(Pose2 &_pose, const double _distance,
+      const double _deltaYaw)
+  {
+    // sin(x)/x computed without the division near zero.
+    const double halfYaw = 0.5 * _deltaYaw;
+    const double sinc = (std::abs(halfYaw) < 1e-6) ?
+      1.0 - halfYaw * halfYaw / 6.0 : std::sin(halfYaw) / halfYaw;
+
+    // The chord of the arc points halfway between the start and end heading.
+    const double chord = _distance * sinc;
+    const double chordYaw = _pose.yaw + halfYaw;
+    _pose.x += chord * std::cos(chordYaw);
+    _pose.y += chord * std::sin(chordYaw);
+    _pose.yaw = NormalizeAngle(_pose.yaw + _deltaYaw);
+  }
+
+  /// \brief Heading change of a bicycle-model vehicle.
+  /// Uses the curvature tan(phi) / wheelBase, so that straight motion needs
+  /// no special case.
+  /// \param[in] _distance Distance traveled by the rear axle center.
+  /// \param[in] _steeringAngle Steering angle of the virtual center wheel.
+  /// \param[in] _wheelBase Distance between the front and rear axles.
+  /// \return The heading change.
+  inline double AckermannDeltaYaw(const double _distance,
+      const double _steeringAngle, const double _wheelBase)
+  {
+    return _distance * std::tan(_steeringAngle) / _wheelBase;
+  }
+
+  /// \brief Heading change of a differential drive vehicle.
+  /// \param[in] _leftDistance Distance traveled by the left wheels.
+  /// \param[in] _rightDistance Distance traveled by the right wheels.
+  /// \param[in] _wheelSeparation Distance between the left and right wheels.
+  /// \return The heading change.
+  inline double DifferentialDeltaYaw(const double _leftDistance,
+      const double _rightDistance, const double _wheelSeparation)
+  {
+    return (_rightDistance - _leftDistance) / _wheelSeparation;
+  }
+
+  /// \brief Wheel odometry integrated along exact arcs.
+  ///
+  /// The wheel joint positions are read every simulation step and the pose is
+  /// integrated every step. The velocities are averaged over the time since
+  /// the last call to ResetVelocityWindow(), which is typically the last
+  /// publication, so they are not dominated by the noise of single steps.
+  ///
+  /// Only the models that carry their own drive plugin use it, i.e. the
+  /// AckermannSteering plugins of CoRo Karen and Rocky. The other wheeled
+  /// models load the DiffDrive system of ign-gazebo, whose odometry lives
+  /// upstream and would have to be forked to use this class.
+  class WheelOdometry
+  {
+    /// \brief Forget the pose and the wheel positions.
+    public: void Reset()
+    {
+      *this = WheelOdometry();
+    }
+
+    /// \brief Update from the wheels of an Ackermann-steered vehicle.
+    /// \param[in] _time Simulation time of the wheel positions.
+    /// \param[in] _leftWheel Position of the left rear wheel joint.
+    /// \param[in] _rightWheel Position of the right rear wheel joint.
+    /// \param[in] _steeringAngle Mean angle of the steering joints.
+    /// \param[in] _wheelRadius Radius of the wheels.
+    /// \param[in] _wheelBase Distance between the front and rear axles.
+    public: void UpdateAckermann(
+      const std::chrono::steady_clock::duration &_time,
+      const double _leftWheel, const double _rightWheel,
+      const double _steeringAngle, const double _wheelRadius,
+      const double _wheelBase)
+    {
+      double left, right;
+      if (!this->WheelDistances(_time, _leftWheel, _rightWheel, _wheelRadius,
+            left, right))
+        return;
+
+      const double distance = 0.5 * (left + right);
+      this->Integrate(_time, distance,
+          AckermannDeltaYaw(distance, _steeringAngle, _wheelBase));
+    }
+
+    /// \brief Update from the wheels of a differential drive vehicle.
+    /// \param[in] _time Simulation time of the wheel positions.
+    /// \param[in] _leftWheel Position of the left wheel joint.
+    /// \param[in] _rightWheel Position of the right wheel joint.
+    /// \param[in] _wheelRadius Radius of the wheels.
+    /// \param[in] _wheelSeparation Distance between the left and right wheels.
+    public: void UpdateDifferential(
+      const std::chrono::steady_clock::duration &_time,
+      const double _leftWheel, const double _rightWheel,
+      const double _wheelRadius, const double _wheelSeparation)
+    {
+      double left, right;
+      if (!this->WheelDistances(_time, _leftWheel, _rightWheel, _wheelRadius,
+            left, right))
+        return;
+
+      this->Integrate(_time, 0.5 * (left + right),
+          DifferentialDeltaYaw(left, right, _wheelSeparation));
+    }
+
+    /// \brief Whether the first wheel positions were received.
+    public: bool Initialized() const
+    {
+      return this->initialized;
+    }
+
+    /// \brief The integrated pose.
+    public: const Pose2 &Pose() const
+    {
+      return this->pose;
+    }
+
+    /// \brief Mean linear velocity in the current velocity window.
+    public: double LinearVelocity() const
+    {
+      const double duration = this->WindowDuration();
+      return duration > 0.0 ? this->windowDistance / duration : 0.0;
+    }
+
+    /// \brief Mean angular velocity in the current velocity window.
+    public: double AngularVelocity() const
+    {
+      const double duration = this->WindowDuration();
+      return duration > 0.0 ? this->windowDeltaYaw / duration : 0.0;
+    }
+
+    /// \brief Start a new window for averaging the velocities.
+    public: void ResetVelocityWindow()
+    {
+      this->windowStart = this->lastTime;
+      this->windowDistance = 0.0;
+      this->windowDeltaYaw = 0.0;
+    }
+
+    /// \brief Compute the distances traveled by the wheels since the last
+    /// update.
+    /// \return False on the first update, which only stores the positions.
+    private: bool WheelDistances(
+      const std::chrono::steady_clock::duration &_time,
+      const double _leftWheel, const double _rightWheel,
+      const double _wheelRadius, double &_left, double &_right)
+    {
+      _left = _wheelRadius * (_leftWheel - this->lastLeftWheel);
+      _right = _wheelRadius * (_rightWheel - this->lastRightWheel);
+      this->lastLeftWheel = _leftWheel;
+      this->lastRightWheel = _rightWheel;
+
+      if (!this->initialized)
+      {
+        this->initialized = true;
+        this->lastTime = _time;
+        this->windowStart = _time;
+        return false;
+      }
+      return true;
+    }
+
+    /// \brief Move the pose and accumulate the velocity window.
+    private: void Integrate(const std::chrono::steady_clock::duration &_time,
+      const double _distance, const double _deltaYaw)
+    {
+      IntegrateArc(this->pose, _distance, _deltaYaw);
+      this->windowDistance += _distance;
+      this->windowDeltaYaw += _deltaYaw;
+      this->lastTime = _time;
+    }
+
+    private: double WindowDuration() const
+    {
+      return std::chrono::duration<double>(
+          this->lastTime - this->windowStart).count();
+    }
+
+    /// \brief The integrated pose.
+    private: Pose2 pose;
+
+    /// \brief Whether the wheel positions below are valid.
+    private: bool initialized{false};
+
+    /// \brief Left wheel joint position at the last update.
+    private: double lastLeftWheel{0.0};
+
+    /// \brief Right wheel joint position at the last update.
+    private: double lastRightWheel{0.0};
+
+    /// \brief Time of the last update.
+    private: std::chrono::steady_clock::duration lastTime{0};
+
+    /// \brief Start of the velocity window.
+    private: std::chrono::steady_clock::duration windowStart{0};
+
+    /// \brief Distance traveled in the velocity window.
+    private: double windowDistance{0.0};
+
+    /// \brief Heading change in the velocity window.
+    private: double windowDeltaYaw{0.0};
+  };
+
+  /// \brief Geometry of an Ackermann-steered vehicle.
+  struct AckermannGeometry
+  {
+    /// \brief Distance between left and right wheels.
+    double wheelSeparation{1.0};
+
+    /// \brief Distance between left and right wheel kingpins.
+    double kingpinWidth{0.8};
+
+    /// \brief Distance between front and back wheels.
+    double wheelBase{1.0};
+
+    /// \brief Maximum turning angle to limit steering to.
+    double steeringLimit{0.5};
+
+    /// \brief Wheel radius.
+    double wheelRadius{0.2};
+  };
+
+  /// \brief Wheel commands of an Ackermann-steered vehicle.
+  struct AckermannCommand
+  {
+    /// \brief Angular velocity of the left rear wheel(s).
+    double leftWheelSpeed{0.0};
+
+    /// \brief Angular velocity of the right rear wheel(s).
+    double rightWheelSpeed{0.0};
+
+    /// \brief Angle of the left steering joint(s).
+    double leftSteeringAngle{0.0};
+
+    /// \brief Angle of the right steering joint(s).
+    double rightSteeringAngle{0.0};
+  };
+
+  /// \brief Convert a body velocity to wheel speeds and steering angles.
+  /// The turning radius is limited by the steering limit of the geometry.
+  /// \param[in] _geometry The vehicle geometry.
+  /// \param[in] _linear Linear velocity.
+  /// \param[in] _angular Angular velocity.
+  /// \return The wheel commands.
+  inline AckermannCommand AckermannInverseKinematics(
+      const AckermannGeometry &_geometry, const double _linear,
+      const double _angular)
+  {
+    AckermannCommand cmd;
+
+    // The wheels go straight, which also avoids dividing by a zero angular
+    // velocity.
+    if (std::abs(_angular) < 0.001)
+    {
+      cmd.leftWheelSpeed = _linear / _geometry.wheelRadius;
+      cmd.rightWheelSpeed = cmd.leftWheelSpeed;
+      return cmd;
+    }
+
+    double turningRadius = _linear / _angular;
+    const double minimumTurningRadius =
+      _geometry.wheelBase / std::sin(_geometry.steeringLimit);
+    if ((turningRadius >= 0.0) && (turningRadius < minimumTurningRadius))
+      turningRadius = minimumTurningRadius;
+    if ((turningRadius <= 0.0) && (turningRadius > -minimumTurningRadius))
+      turningRadius = -minimumTurningRadius;
+
+    const double halfKingpin = 0.5 * _geometry.kingpinWidth;
+    cmd.leftSteeringAngle =
+      std::atan(_geometry.wheelBase / (turningRadius - halfKingpin));
+    cmd.rightSteeringAngle =
+      std::atan(_geometry.wheelBase / (turningRadius + halfKingpin));
+
+    // Partially simulate a simple differential. tan(phi) of the virtual
+    // center wheel is wheelBase / turningRadius.
+    const double differential =
+      _geometry.wheelSeparation / (2.0 * turningRadius);
+    cmd.rightWheelSpeed =
+      _linear * (1.0 + differential) / _geometry.wheelRadius;
+    cmd.leftWheelSpeed =
+      _linear * (1.0 - differential) / _geometry.wheelRadius;
+    return cmd;
+  }
+
+  /// \brief Triggers at a fixed rate of simulation time.
+  /// The schedule does not drift: when an update comes late, the next trigger
+  /// still happens at the next multiple of the period.
+  class FixedRateTrigger
+  {
+    /// \brief Set the rate.
+    /// \param[in] _rate Rate in Hz. Zero or less triggers on every update.
+    public: void SetRate(const double _rate)
+    {
+      this->period = std::chrono::steady_clock::duration::zero();
+      if (_rate > 0)
+      {
+        this->period =
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / _rate));
+      }
+      this->Reset();
+    }
+
+    /// \brief Trigger on the next update.
+    public: void Reset()
+    {
+      this->started = false;
+    }
+
+    /// \brief Tell whether to trigger at the given time.
+    /// \param[in] _time Current simulation time.
+    /// \return True if the next trigger time has been reached.
+    public: bool Check(const std::chrono::steady_clock::duration &_time)
+    {
+      if (!this->started || _time < this->last)
+      {
+        // First update, or time went back.
+        this->started = true;
+        this->last = _time;
+        this->next = _time + this->period;
+        return true;
+      }
+
+      if (_time < this->next)
+        return false;
+
+      this->last = _time;
+      if (this->period > std::chrono::steady_clock::duration::zero())
+      {
+        this->next += this->period;
+        // Skip the triggers missed during a long step.
+        if (this->next <= _time)
+          this->next = _time + this->period;
+      }
+      return true;
+    }
+
+    /// \brief Period of the triggers.
+    private: std::chrono::steady_clock::duration period{0};
+
+    /// \brief Time of the last trigger.
+    private: std::chrono::steady_clock::duration last{0};
+
+    /// \brief Time of the next trigger.
+    private: std::chrono::steady_clock::duration next{0};
+
+    /// \brief Whether there was a trigger yet.
+    private: bool started{false};
+  };
+}
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/// \file Micro-benchmark of the odometry kernel. It compares one simulation
+/// step of odometry (integration plus a message filled in at 50 Hz) with the
+/// Euler integration and per-publication message building it replaced, and
+/// reports the pose error of both after driving a circle.
+///
+/// Usage: odometry_benchmark [steps]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <ignition/msgs/odometry.pb.h>
+
+#include "subt_odometry/OdometryMessage.hh"
+#include "subt_odometry/WheelOdometry.hh"
+
+using namespace subt::odometry;
+
+namespace
+{
+  /// \brief Simulation step, 1 kHz.
+  const std::chrono::steady_clock::duration kStep =
+    std::chrono::milliseconds(1);
+
+  /// \brief Steps between publications, 50 Hz.
+  const int kPublishEvery = 20;
+
+  const double kWheelRadius = 0.2;
+  const double kWheelBase = 1.0;
+
+  /// \brief Steering angle driving a circle of 2 m radius.
+  const double kSteering = std::atan(kWheelBase / 2.0);
+
+  /// \brief Wheel angle per step, 1 m/s.
+  const double kWheelStep = 0.001 / kWheelRadius;
+
+  /// \brief The odometry the kernel replaced.
+  struct LegacyOdometry
+  {
+    double x{0.0};
+    double y{0.0};
+    double yaw{0.0};
+    double oldLeft{0.0};
+    double oldRight{0.0};
+
+    void Update(const double _left, const double _right, const double _phi,
+        const std::chrono::steady_clock::duration &_time,
+        const std::string &_modelName, const std::string &_linkName,
+        const bool _publish, double &_checksum)
+    {
+      double radius = kWheelBase / std::tan(_phi);
+      double dist = 0.5 * kWheelRadius *
+        ((_left - this->oldLeft) + (_right - this->oldRight));
+      double deltaAngle = dist / radius;
+      this->yaw = std::atan2(std::sin(this->yaw + deltaAngle),
+          std::cos(this->yaw + deltaAngle));
+      this->x += dist * std::cos(this->yaw);
+      this->y += dist * std::sin(this->yaw);
+      this->oldLeft = _left;
+      this->oldRight = _right;
+
+      if (!_publish)
+        return;
+
+      ignition::msgs::Odometry msg;
+      msg.mutable_pose()->mutable_position()->set_x(this->x);
+      msg.mutable_pose()->mutable_position()->set_y(this->y);
+      msg.mutable_pose()->mutable_orientation()->set_z(
+          std::sin(0.5 * this->yaw));
+      msg.mutable_pose()->mutable_orientation()->set_w(
+          std::cos(0.5 * this->yaw));
+      msg.mutable_twist()->mutable_linear()->set_x(dist / 0.001);
+      msg.mutable_twist()->mutable_angular()->set_z(deltaAngle / 0.001);
+      const auto sec = std::chrono::duration_cast<std::chrono::seconds>(_time);
+      msg.mutable_header()->mutable_stamp()->set_sec(sec.count());
+      auto frame = msg.mutable_header()->add_data();
+      frame->set_key("frame_id");
+      frame->add_value(_modelName + "/odom");
+      auto childFrame = msg.mutable_header()->add_data();
+      childFrame->set_key("child_frame_id");
+      childFrame->add_value(_modelName + "/" + _linkName);
+      _checksum += msg.pose().position().x();
+    }
+  };
+
+  /// \brief Print the results of one run.
+  void Report(const char *_name, const int _steps,
+      const std::chrono::steady_clock::duration &_elapsed, const double _x,
+      const double _y)
+  {
+    // The circle is centered at (0, 2) m.
+    const double error = std::abs(std::hypot(_x, _y - 2.0) - 2.0);
+    std::printf("%-8s %8.1f ns/step  radius error after %.0f m: %.3g m\n",
+        _name,
+        std::chrono::duration<double, std::nano>(_elapsed).count() / _steps,
+        _steps * 0.001, error);
+  }
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  const int steps = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  if (steps <= 0)
+  {
+    std::fprintf(stderr, "Usage: %s [steps]\n", argv[0]);
+    return 1;
+  }
+
+  const std::string modelName = "X1";
+  const std::string linkName = "base_link";
+  double checksum = 0.0;
+
+  {
+    LegacyOdometry odometry;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 1; i <= steps; ++i)
+    {
+      odometry.Update(i * kWheelStep, i * kWheelStep, kSteering, i * kStep,
+          modelName, linkName, i % kPublishEvery == 0, checksum);
+    }
+    Report("legacy", steps, std::chrono::steady_clock::now() - start,
+        odometry.x, odometry.y);
+  }
+
+  {
+    WheelOdometry odometry;
+    FixedRateTrigger trigger;
+    OdometryMessage msg;
+    trigger.SetRate(1000.0 / kPublishEvery);
+    msg.SetFrames(modelName + "/odom", modelName + "/" + linkName);
+
+    const auto start = std::chrono::steady_clock::now();
+    odometry.UpdateAckermann(std::chrono::steady_clock::duration::zero(), 0.0,
+        0.0, kSteering, kWheelRadius, kWheelBase);
+    for (int i = 1; i <= steps; ++i)
+    {
+      odometry.UpdateAckermann(i * kStep, i * kWheelStep, i * kWheelStep,
+          kSteering, kWheelRadius, kWheelBase);
+      if (trigger.Check(i * kStep))
+      {
+        checksum += msg.Fill(i * kStep, odometry).pose().position().x();
+        odometry.ResetVelocityWindow();
+      }
+    }
+    Report("kernel", steps, std::chrono::steady_clock::now() - start,
+        odometry.Pose().x, odometry.Pose().y);
+  }
+
+  // Keeps the work from being optimized out.
+  std::printf("(checksum %g)\n", checksum);
+  return 0;
+}
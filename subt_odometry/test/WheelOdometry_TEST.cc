@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+
+#include <subt_odometry/WheelOdometry.hh>
+
+using namespace subt::odometry;
+using namespace std::chrono_literals;
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_WheelOdometry, FirstUpdateOnlyInitializes)
+{
+  WheelOdometry odometry;
+  EXPECT_FALSE(odometry.Initialized());
+
+  // Wheels that don't start at zero must not make the robot jump.
+  odometry.UpdateDifferential(1s, 10.0, 20.0, 0.1, 0.5);
+  EXPECT_TRUE(odometry.Initialized());
+  EXPECT_DOUBLE_EQ(0.0, odometry.Pose().x);
+  EXPECT_DOUBLE_EQ(0.0, odometry.Pose().y);
+  EXPECT_DOUBLE_EQ(0.0, odometry.Pose().yaw);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_WheelOdometry, Straight)
+{
+  WheelOdometry odometry;
+  odometry.UpdateAckermann(0s, 0.0, 0.0, 0.0, 0.5, 1.0);
+  for (int i = 1; i <= 100; ++i)
+  {
+    odometry.UpdateAckermann(i * 10ms, 0.02 * i, 0.02 * i, 0.0, 0.5, 1.0);
+  }
+  EXPECT_NEAR(1.0, odometry.Pose().x, 1e-12);
+  EXPECT_NEAR(0.0, odometry.Pose().y, 1e-12);
+  EXPECT_NEAR(0.0, odometry.Pose().yaw, 1e-12);
+  EXPECT_NEAR(1.0, odometry.LinearVelocity(), 1e-12);
+  EXPECT_NEAR(0.0, odometry.AngularVelocity(), 1e-12);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_WheelOdometry, ArcDoesNotDependOnSteps)
+{
+  // A quarter circle with radius 2 m driven in 1 and in 1000 steps.
+  const double wheelBase = 1.0;
+  const double radius = 2.0;
+  const double steering = std::atan(wheelBase / radius);
+  const double wheelRadius = 0.25;
+  const double wheelAngle = radius * M_PI / 2.0 / wheelRadius;
+
+  for (const int steps : {1, 1000})
+  {
+    WheelOdometry odometry;
+    odometry.UpdateAckermann(0s, 0.0, 0.0, steering, wheelRadius, wheelBase);
+    for (int i = 1; i <= steps; ++i)
+    {
+      const double position = wheelAngle * i / steps;
+      odometry.UpdateAckermann(i * 1ms, position, position, steering,
+          wheelRadius, wheelBase);
+    }
+    EXPECT_NEAR(radius, odometry.Pose().x, 1e-9) << steps;
+    EXPECT_NEAR(radius, odometry.Pose().y, 1e-9) << steps;
+    EXPECT_NEAR(M_PI / 2.0, odometry.Pose().yaw, 1e-9) << steps;
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_WheelOdometry, Differential)
+{
+  WheelOdometry odometry;
+  odometry.UpdateDifferential(0s, 0.0, 0.0, 0.1, 0.5);
+
+  // Turn in place by 90 degrees.
+  const double wheelAngle = 0.25 * M_PI / 2.0 / 0.1;
+  odometry.UpdateDifferential(1s, -wheelAngle, wheelAngle, 0.1, 0.5);
+  EXPECT_NEAR(0.0, odometry.Pose().x, 1e-12);
+  EXPECT_NEAR(0.0, odometry.Pose().y, 1e-12);
+  EXPECT_NEAR(M_PI / 2.0, odometry.Pose().yaw, 1e-12);
+  EXPECT_NEAR(0.0, odometry.LinearVelocity(), 1e-12);
+  EXPECT_NEAR(M_PI / 2.0, odometry.AngularVelocity(), 1e-12);
+
+  // Then drive 1 m forward, along y.
+  odometry.ResetVelocityWindow();
+  odometry.UpdateDifferential(3s, -wheelAngle + 10.0, wheelAngle + 10.0, 0.1,
+      0.5);
+  EXPECT_NEAR(0.0, odometry.Pose().x, 1e-12);
+  EXPECT_NEAR(1.0, odometry.Pose().y, 1e-12);
+  EXPECT_NEAR(0.5, odometry.LinearVelocity(), 1e-12);
+  EXPECT_NEAR(0.0, odometry.AngularVelocity(), 1e-12);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_WheelOdometry, YawIsNormalized)
+{
+  Pose2 pose;
+  IntegrateArc(pose, 0.0, 3.0 * M_PI / 2.0);
+  EXPECT_NEAR(-M_PI / 2.0, pose.yaw, 1e-12);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_AckermannInverseKinematics, Straight)
+{
+  AckermannGeometry geometry;
+  const auto cmd = AckermannInverseKinematics(geometry, 1.0, 0.0);
+  EXPECT_DOUBLE_EQ(1.0 / geometry.wheelRadius, cmd.leftWheelSpeed);
+  EXPECT_DOUBLE_EQ(1.0 / geometry.wheelRadius, cmd.rightWheelSpeed);
+  EXPECT_DOUBLE_EQ(0.0, cmd.leftSteeringAngle);
+  EXPECT_DOUBLE_EQ(0.0, cmd.rightSteeringAngle);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_AckermannInverseKinematics, Turn)
+{
+  AckermannGeometry geometry;
+  geometry.wheelSeparation = 0.6;
+  geometry.kingpinWidth = 0.5;
+  geometry.wheelBase = 0.8;
+  geometry.steeringLimit = 0.6;
+  geometry.wheelRadius = 0.15;
+
+  // Turning radius of 4 m, to the left.
+  const auto cmd = AckermannInverseKinematics(geometry, 2.0, 0.5);
+  EXPECT_NEAR(std::atan(0.8 / (4.0 - 0.25)), cmd.leftSteeringAngle, 1e-12);
+  EXPECT_NEAR(std::atan(0.8 / (4.0 + 0.25)), cmd.rightSteeringAngle, 1e-12);
+  EXPECT_NEAR(2.0 * (1.0 - 0.6 / 8.0) / 0.15, cmd.leftWheelSpeed, 1e-12);
+  EXPECT_NEAR(2.0 * (1.0 + 0.6 / 8.0) / 0.15, cmd.rightWheelSpeed, 1e-12);
+
+  // Turning in place is limited to the minimum turning radius.
+  const double minimumRadius = 0.8 / std::sin(0.6);
+  const auto limited = AckermannInverseKinematics(geometry, 0.0, 1.0);
+  EXPECT_NEAR(std::atan(0.8 / (minimumRadius - 0.25)),
+      limited.leftSteeringAngle, 1e-12);
+  EXPECT_DOUBLE_EQ(0.0, limited.leftWheelSpeed);
+  EXPECT_DOUBLE_EQ(0.0, limited.rightWheelSpeed);
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_FixedRateTrigger, NoDrift)
+{
+  FixedRateTrigger trigger;
+  trigger.SetRate(50.0);
+
+  // Steps of 3 ms don't divide the period of 20 ms.
+  int count = 0;
+  for (int i = 0; i <= 3334; ++i)
+  {
+    if (trigger.Check(i * 3ms))
+      ++count;
+  }
+  // 10 s at 50 Hz, plus the first trigger.
+  EXPECT_EQ(501, count);
+
+  // Going back in time triggers immediately.
+  EXPECT_TRUE(trigger.Check(1s));
+  EXPECT_FALSE(trigger.Check(1s + 3ms));
+}
+
+/////////////////////////////////////////////////
+TEST(subt_odometry_FixedRateTrigger, EveryUpdate)
+{
+  FixedRateTrigger trigger;
+  trigger.SetRate(0.0);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_TRUE(trigger.Check(i * 1ms));
+}
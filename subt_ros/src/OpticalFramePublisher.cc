@@ -15,7 +15,11 @@
  *
 */
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
 
 // include ROS 1
 #ifdef __clang__
@@ -28,19 +32,41 @@
 #endif
 
 #include <geometry_msgs/TransformStamped.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
-#include <sensor_msgs/PointCloud2.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 
-/// \brief A class that converts data from robot frame to optical frame
+namespace subt
+{
+/// \brief A nodelet that converts data from robot frame to optical frame
 /// It subscribes to existing topic, modifies the frame_id of the message to
 /// a new optical frame, then republishes the updated data to a new topic.
-class OpticalFramePublisher
+///
+/// The input topics are only subscribed while the output topics have
+/// subscribers. When loaded into the same nodelet manager as the consumers
+/// of the output, messages are passed by pointer without being serialized
+/// or copied.
+///
+/// Subscribed topics:
+/// - input/image (sensor_msgs/Image)
+/// - input/camera_info (sensor_msgs/CameraInfo) Unless ~camera_info is false.
+///
+/// Published topics:
+/// - output/image (sensor_msgs/Image)
+/// - output/camera_info (sensor_msgs/CameraInfo) Unless ~camera_info is false.
+///
+/// ROS parameters:
+/// - ~camera_info bool Whether to relay camera info. Default is true. Passing
+///                     "depth" as the nodelet argument also sets it to false.
+/// - ~stats_period double Period (in s) of logging the relayed message rates
+///                        on debug level. Zero disables it. Default is 10.
+class OpticalFramePublisher : public nodelet::Nodelet
 {
   // Documentation inherited
-  public: void Init(bool _cameraInfo = true);
+  private: void onInit() override;
 
   /// \brief Subscriber callback which updates the frame id of the message
   /// and republishes the message.
@@ -52,6 +78,11 @@ class OpticalFramePublisher
   /// \param[in] _msg Message whose frame id is to be updated
   private: void UpdateCameraInfoFrame(const sensor_msgs::CameraInfo::Ptr &_msg);
 
+  /// \brief Get the optical frame id, publishing its static tf on first use.
+  /// \param[in] _frame Original message frame id
+  /// \return Optical frame id
+  private: const std::string &OpticalFrame(const std::string &_frame);
+
   /// \brief Publish static tf data between the original frame of the msg
   /// and the new optical frame
   /// \param[in] _frame Original message frame id
@@ -59,20 +90,22 @@ class OpticalFramePublisher
   private: void PublishTF(const std::string &_frame,
     const std::string &_childFrame);
 
-  /// \brief Callback when subscriber connects to the image topic
+  /// \brief Callback when the number of subscribers of the image topic
+  /// changes. Subscribes or unsubscribes the input image topic.
   private: void ImageConnect();
 
-  /// \brief Callback when subscriber connects to the camera info topic
+  /// \brief Callback when the number of subscribers of the camera info topic
+  /// changes. Subscribes or unsubscribes the input camera info topic.
   private: void CameraInfoConnect();
 
-  /// \brief ROS node handle
-  private: ros::NodeHandle node;
+  /// \brief Log the rates of relayed messages.
+  private: void LogStats(const ros::WallTimerEvent &_event);
 
   /// \brief ROS subscriber that subscribes to original image topic
-  private: std::unique_ptr<ros::Subscriber> sub;
+  private: ros::Subscriber sub;
 
   /// \brief ROS subscriber that subscribes to original camera info topic
-  private: std::unique_ptr<ros::Subscriber> ciSub;
+  private: ros::Subscriber ciSub;
 
   /// \brief ROS publisher that publishes image msg with the new optical frame
   private: ros::Publisher pub;
@@ -81,64 +114,94 @@ class OpticalFramePublisher
   /// frame
   private: ros::Publisher ciPub;
 
+  /// \brief Protects subscribing and unsubscribing.
+  private: std::mutex connectMutex;
+
+  /// \brief Protects the optical frame id.
+  private: std::mutex frameMutex;
+
   /// \brief Optical frame id
   private: std::string newFrameId;
+
+  /// \brief Timer for logging the rates.
+  private: ros::WallTimer statsTimer;
+
+  /// \brief Number of relayed images since the rates were last logged.
+  private: std::atomic<uint64_t> imageCount{0u};
+
+  /// \brief Number of relayed camera infos since the rates were last logged.
+  private: std::atomic<uint64_t> cameraInfoCount{0u};
 };
 
 //////////////////////////////////////////////////
-void OpticalFramePublisher::Init(bool _cameraInfo)
+void OpticalFramePublisher::onInit()
 {
-  this->pub = this->node.advertise<sensor_msgs::Image>("output/image", 10,
-      std::bind(&OpticalFramePublisher::ImageConnect, this));
+  ros::NodeHandle &node = this->getNodeHandle();
+  ros::NodeHandle &pnh = this->getPrivateNodeHandle();
+
+  bool cameraInfo = pnh.param("camera_info", true);
+  const auto &argv = this->getMyArgv();
+  if (std::find(argv.begin(), argv.end(), "depth") != argv.end())
+    cameraInfo = false;
+
+  // Holding the lock makes sure the connect callbacks, which may be called
+  // from within advertise(), see the publishers.
+  std::lock_guard<std::mutex> lock(this->connectMutex);
 
-  if (_cameraInfo)
+  const auto imageConnect =
+      std::bind(&OpticalFramePublisher::ImageConnect, this);
+  this->pub = node.advertise<sensor_msgs::Image>("output/image", 10,
+      imageConnect, imageConnect);
+
+  if (cameraInfo)
   {
-    this->ciPub = this->node.advertise<sensor_msgs::CameraInfo>(
-        "output/camera_info", 10,
-        std::bind(&OpticalFramePublisher::CameraInfoConnect, this));
+    const auto cameraInfoConnect =
+        std::bind(&OpticalFramePublisher::CameraInfoConnect, this);
+    this->ciPub = node.advertise<sensor_msgs::CameraInfo>(
+        "output/camera_info", 10, cameraInfoConnect, cameraInfoConnect);
   }
 
-  ROS_INFO("Optical Frame Publisher Ready");
+  const double statsPeriod = pnh.param("stats_period", 10.0);
+  if (statsPeriod > 0.0)
+  {
+    this->statsTimer = node.createWallTimer(ros::WallDuration(statsPeriod),
+        &OpticalFramePublisher::LogStats, this);
+  }
+
+  NODELET_INFO("Optical Frame Publisher Ready");
 }
 
 //////////////////////////////////////////////////
 void OpticalFramePublisher::UpdateImageFrame(
     const sensor_msgs::Image::Ptr &_msg)
 {
-  if (this->pub.getNumSubscribers() == 0u && this->sub)
-  {
-    this->sub.reset();
-    return;
-  }
-
-  if (this->newFrameId.empty())
-  {
-    this->newFrameId = _msg->header.frame_id + "_optical";
-    this->PublishTF(_msg->header.frame_id, this->newFrameId);
-  }
-
-  _msg->header.frame_id = this->newFrameId;
+  // The message is not shared with anybody else (roscpp copies it if it is),
+  // so it can be modified and passed on.
+  _msg->header.frame_id = this->OpticalFrame(_msg->header.frame_id);
   this->pub.publish(_msg);
+  ++this->imageCount;
 }
 
 //////////////////////////////////////////////////
 void OpticalFramePublisher::UpdateCameraInfoFrame(
     const sensor_msgs::CameraInfo::Ptr &_msg)
 {
-  if (this->ciPub.getNumSubscribers() == 0u && this->ciSub)
-  {
-    this->ciSub.reset();
-    return;
-  }
+  _msg->header.frame_id = this->OpticalFrame(_msg->header.frame_id);
+  this->ciPub.publish(_msg);
+  ++this->cameraInfoCount;
+}
 
+//////////////////////////////////////////////////
+const std::string &OpticalFramePublisher::OpticalFrame(
+    const std::string &_frame)
+{
+  std::lock_guard<std::mutex> lock(this->frameMutex);
   if (this->newFrameId.empty())
   {
-    this->newFrameId = _msg->header.frame_id + "_optical";
-    this->PublishTF(_msg->header.frame_id, this->newFrameId);
+    this->newFrameId = _frame + "_optical";
+    this->PublishTF(_frame, this->newFrameId);
   }
-
-  _msg->header.frame_id = this->newFrameId;
-  this->ciPub.publish(_msg);
+  return this->newFrameId;
 }
 
 //////////////////////////////////////////////////
@@ -166,41 +229,48 @@ void OpticalFramePublisher::PublishTF(const std::string &_frame,
 //////////////////////////////////////////////////
 void OpticalFramePublisher::ImageConnect()
 {
-  if (this->sub)
-    return;
-  this->sub = std::make_unique<ros::Subscriber>(
-      this->node.subscribe("input/image", 10,
-      &OpticalFramePublisher::UpdateImageFrame, this));
+  std::lock_guard<std::mutex> lock(this->connectMutex);
+  if (this->pub.getNumSubscribers() == 0u)
+  {
+    this->sub.shutdown();
+  }
+  else if (!this->sub)
+  {
+    this->sub = this->getNodeHandle().subscribe("input/image", 10,
+        &OpticalFramePublisher::UpdateImageFrame, this);
+  }
 }
 
 //////////////////////////////////////////////////
 void OpticalFramePublisher::CameraInfoConnect()
 {
-  if (this->ciSub)
-    return;
-  this->ciSub = std::make_unique<ros::Subscriber>(
-      this->node.subscribe("input/camera_info", 10,
-      &OpticalFramePublisher::UpdateCameraInfoFrame, this));
+  std::lock_guard<std::mutex> lock(this->connectMutex);
+  if (this->ciPub.getNumSubscribers() == 0u)
+  {
+    this->ciSub.shutdown();
+  }
+  else if (!this->ciSub)
+  {
+    this->ciSub = this->getNodeHandle().subscribe("input/camera_info", 10,
+        &OpticalFramePublisher::UpdateCameraInfoFrame, this);
+  }
 }
 
 //////////////////////////////////////////////////
-int main(int _argc, char **_argv)
+void OpticalFramePublisher::LogStats(const ros::WallTimerEvent &_event)
 {
-  std::string type;
-  if (_argc == 2)
-  {
-    type = _argv[2];
-  }
-
-  ros::init(_argc, _argv, "optical_frame_publisher");
-
-  OpticalFramePublisher pub;
-  if (type == "depth")
-    pub.Init(false);
-  else
-    pub.Init();
-
-  ros::spin();
+  const double period =
+      (_event.current_real - _event.last_real).toSec();
+  if (period <= 0.0)
+    return;
 
-  return 0;
+  const uint64_t images = this->imageCount.exchange(0u);
+  const uint64_t cameraInfos = this->cameraInfoCount.exchange(0u);
+  NODELET_DEBUG("Relaying image at %.1f Hz (%u subscribers), camera info at "
+      "%.1f Hz (%u subscribers)", images / period,
+      this->pub.getNumSubscribers(), cameraInfos / period,
+      this->ciPub ? this->ciPub.getNumSubscribers() : 0u);
+}
 }
+
+PLUGINLIB_EXPORT_CLASS(subt::OpticalFramePublisher, nodelet::Nodelet)
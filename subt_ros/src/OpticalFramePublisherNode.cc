@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <string>
+#include <vector>
+
+#include <nodelet/loader.h>
+#include <ros/ros.h>
+
+/// \brief Runs the subt_ros/OpticalFramePublisher nodelet as a standalone
+/// node. Pass "depth" as an argument to relay only the image.
+int main(int _argc, char **_argv)
+{
+  ros::init(_argc, _argv, "optical_frame_publisher");
+
+  std::vector<std::string> myArgv;
+  ros::removeROSArgs(_argc, _argv, myArgv);
+  // Drop the program name.
+  myArgv.erase(myArgv.begin());
+
+  nodelet::Loader loader(false);
+  const nodelet::M_string remappings;
+  if (!loader.load(ros::this_node::getName(),
+      "subt_ros/OpticalFramePublisher", remappings, myArgv))
+  {
+    return 1;
+  }
+
+  ros::spin();
+
+  return 0;
+}
@@ -14,7 +14,17 @@
  * limitations under the License.
  *
 */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+
 #include <boost/lockfree/spsc_queue.hpp>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <ros/ros.h>
 #include <std_srvs/SetBool.h>
 #include <std_msgs/Int32.h>
@@ -108,10 +118,78 @@ class SubtRosRelay
   public: void OnMessage(const subt::msgs::Datagram &_msg);
 
   /// \brief Process messages in consumed from the message queue
-  /// The message is forwarded via a ROS service call.
+  /// The message is handed to the worker of each destination, which forwards
+  /// it via a ROS service call.
   /// \param[in] _req The message.
   public: void ProcessMessage(const subt::msgs::Datagram &_req);
 
+  /// \brief A message waiting to be delivered to one destination.
+  public: struct Delivery
+  {
+    /// \brief Address of the destination.
+    std::string address;
+
+    /// \brief The message, shared by all the destinations of a broadcast.
+    std::shared_ptr<const subt_msgs::DatagramRos::Request> req;
+
+    /// \brief Time at which the message was taken from the message queue.
+    std::chrono::steady_clock::time_point queued;
+  };
+
+  /// \brief A thread delivering messages to a fixed set of destinations.
+  /// Every destination is served by a single worker in FIFO order, so the
+  /// messages sent to a robot keep their order.
+  public: struct Worker
+  {
+    /// \brief The delivery thread.
+    std::thread thread;
+
+    /// \brief Messages waiting to be delivered.
+    std::deque<Delivery> queue;
+
+    /// \brief Max length reached by the queue.
+    size_t maxDepth = 0u;
+
+    /// \brief Mutex to protect the queue.
+    std::mutex mutex;
+
+    /// \brief Condition variable to signal new messages and termination.
+    std::condition_variable cv;
+
+    /// \brief Persistent service clients, by destination. Only used by the
+    /// delivery thread.
+    std::map<std::string, ros::ServiceClient> clients;
+  };
+
+  /// \brief Delivery statistics of a destination.
+  public: struct DeliveryStats
+  {
+    /// \brief Number of messages delivered.
+    uint64_t delivered = 0u;
+
+    /// \brief Number of failed service calls.
+    uint64_t failed = 0u;
+
+    /// \brief Sum of the queue-to-delivery latencies, in seconds.
+    double totalLatency = 0.0;
+
+    /// \brief Max queue-to-delivery latency, in seconds.
+    double maxLatency = 0.0;
+  };
+
+  /// \brief Deliver the messages queued in a worker until shutdown.
+  /// \param[in] _worker The worker.
+  public: void RunWorker(Worker &_worker);
+
+  /// \brief Get the worker serving a destination.
+  /// \param[in] _address Address of the destination.
+  /// \return The worker.
+  public: Worker &WorkerFor(const std::string &_address);
+
+  /// \brief Timer callback that publishes the delivery statistics.
+  /// \param[in] _event The timer event.
+  public: void OnDiagnosticsTimer(const ros::TimerEvent &_event);
+
   /// \brief Creates an AsyncSpinner and handles received messages
   public: void Spin();
 
@@ -173,6 +251,30 @@ class SubtRosRelay
 
   /// \brief Pointer to the ROS bag recorder.
   public: std::unique_ptr<rosbag::Recorder> rosRecorder;
+
+  /// \brief Workers delivering messages to the robots.
+  public: std::vector<std::unique_ptr<Worker>> workers;
+
+  /// \brief Index of the worker serving each robot.
+  public: std::map<std::string, size_t> workerIndex;
+
+  /// \brief Flag to terminate the workers.
+  public: std::atomic<bool> running{true};
+
+  /// \brief Number of messages dropped because the message queue was full.
+  public: std::atomic<uint64_t> droppedMessages{0u};
+
+  /// \brief Delivery statistics, by destination.
+  public: std::map<std::string, DeliveryStats> deliveryStats;
+
+  /// \brief Mutex to protect deliveryStats.
+  public: std::mutex statsMutex;
+
+  /// \brief ROS publisher for the delivery statistics.
+  public: ros::Publisher diagnosticsPub;
+
+  /// \brief Timer to publish the delivery statistics.
+  public: ros::Timer diagnosticsTimer;
 };
 
 //////////////////////////////////////////////////
@@ -191,6 +293,35 @@ SubtRosRelay::SubtRosRelay()
   }
   this->robotNames = ignition::common::split(stringNames, ",");
 
+  // Spread the robots over the workers. A broadcast is delivered to all
+  // robots in parallel, while the messages to a single robot stay ordered.
+  ros::NodeHandle pn("~");
+  int workerCount = 4;
+  pn.param("workers", workerCount, workerCount);
+  workerCount = std::max(1, std::min(workerCount,
+        static_cast<int>(this->robotNames.size())));
+  for (size_t i = 0; i < this->robotNames.size(); ++i)
+    this->workerIndex[this->robotNames[i]] = i % workerCount;
+  for (int i = 0; i < workerCount; ++i)
+  {
+    this->workers.emplace_back(new Worker);
+    Worker *worker = this->workers.back().get();
+    worker->thread = std::thread([this, worker]()
+    {
+      this->RunWorker(*worker);
+    });
+  }
+
+  double diagnosticsPeriod = 1.0;
+  pn.param("diagnostics_period", diagnosticsPeriod, diagnosticsPeriod);
+  this->diagnosticsPub =
+    pn.advertise<diagnostic_msgs::DiagnosticArray>("diagnostics", 10);
+  if (diagnosticsPeriod > 0)
+  {
+    this->diagnosticsTimer = n.createTimer(ros::Duration(diagnosticsPeriod),
+        &SubtRosRelay::OnDiagnosticsTimer, this);
+  }
+
   // ROS service to receive a command to finish the game.
   this->finishService = n.advertiseService(
       "/subt/finish", &SubtRosRelay::OnFinishCall, this);
@@ -264,6 +395,19 @@ SubtRosRelay::SubtRosRelay()
 //////////////////////////////////////////////////
 SubtRosRelay::~SubtRosRelay()
 {
+  this->running = false;
+  for (auto &worker : this->workers)
+  {
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+    }
+    worker->cv.notify_all();
+  }
+  for (auto &worker : this->workers)
+  {
+    if (worker->thread.joinable())
+      worker->thread.join();
+  }
 }
 
 /////////////////////////////////////////////////
@@ -494,7 +638,8 @@ bool SubtRosRelay::OnUnregister(subt_msgs::Unregister::Request &_req,
 //////////////////////////////////////////////////
 void SubtRosRelay::OnMessage(const subt::msgs::Datagram &_req)
 {
-  this->msgQueue.push(_req);
+  if (!this->msgQueue.push(_req))
+    this->droppedMessages++;
   // Notify the main thread
   this->notifyCond.notify_one();
 }
@@ -502,25 +647,168 @@ void SubtRosRelay::OnMessage(const subt::msgs::Datagram &_req)
 //////////////////////////////////////////////////
 void SubtRosRelay::ProcessMessage(const subt::msgs::Datagram &_req)
 {
-  subt_msgs::DatagramRos::Request req;
-  subt_msgs::DatagramRos::Response res;
-  req.src_address = _req.src_address();
-  req.dst_address = _req.dst_address();
-  req.dst_port = _req.dst_port();
-  req.data = _req.data();
-  req.rssi = _req.rssi();
+  std::shared_ptr<subt_msgs::DatagramRos::Request> req(
+      new subt_msgs::DatagramRos::Request);
+  req->src_address = _req.src_address();
+  req->dst_address = _req.dst_address();
+  req->dst_port = _req.dst_port();
+  req->data = _req.data();
+  req->rssi = _req.rssi();
+
+  Delivery delivery;
+  delivery.req = req;
+  delivery.queued = std::chrono::steady_clock::now();
+
+  // Don't wait for the service calls here, so that a broadcast does not
+  // hold up the messages behind it.
+  auto enqueue = [this, &delivery](const std::string &_dest)
+  {
+    Worker &worker = this->WorkerFor(_dest);
+    delivery.address = _dest;
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.queue.push_back(delivery);
+      worker.maxDepth = std::max(worker.maxDepth, worker.queue.size());
+    }
+    worker.cv.notify_one();
+  };
 
   if (_req.dst_address() == subt::communication_broker::kBroadcast)
   {
     for (const std::string &dest : this->robotNames)
+      enqueue(dest);
+  }
+  else
+  {
+    enqueue(_req.dst_address());
+  }
+}
+
+//////////////////////////////////////////////////
+SubtRosRelay::Worker &SubtRosRelay::WorkerFor(const std::string &_address)
+{
+  auto iter = this->workerIndex.find(_address);
+  if (iter != this->workerIndex.end())
+    return *this->workers[iter->second];
+
+  // Unknown destinations are still mapped to a fixed worker.
+  return *this->workers[
+    std::hash<std::string>()(_address) % this->workers.size()];
+}
+
+//////////////////////////////////////////////////
+void SubtRosRelay::RunWorker(Worker &_worker)
+{
+  ros::NodeHandle n;
+  const std::string md5sum =
+    ros::service_traits::md5sum<subt_msgs::DatagramRos>();
+
+  while (this->running)
+  {
+    Delivery delivery;
     {
-      ros::service::call(dest, req, res);
+      std::unique_lock<std::mutex> lock(_worker.mutex);
+      _worker.cv.wait(lock, [this, &_worker]
+      {
+        return !this->running || !_worker.queue.empty();
+      });
+      if (!this->running)
+        break;
+      delivery = std::move(_worker.queue.front());
+      _worker.queue.pop_front();
+    }
+
+    // Reuse the connection to the destination instead of setting up a new
+    // one for each message. The client is recreated after a failure, e.g.
+    // when the robot restarted its service.
+    ros::ServiceClient &client = _worker.clients[delivery.address];
+    if (!client.isValid())
+    {
+      client = n.serviceClient<subt_msgs::DatagramRos>(
+          delivery.address, true);
+    }
+
+    subt_msgs::DatagramRos::Response res;
+    bool delivered = client.call(*delivery.req, res, md5sum);
+    if (!delivered)
+      client = ros::ServiceClient();
+
+    double latency = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - delivery.queued).count();
+
+    std::lock_guard<std::mutex> lock(this->statsMutex);
+    DeliveryStats &stats = this->deliveryStats[delivery.address];
+    if (delivered)
+    {
+      stats.delivered++;
+      stats.totalLatency += latency;
+      stats.maxLatency = std::max(stats.maxLatency, latency);
+    }
+    else
+    {
+      stats.failed++;
     }
   }
-  else
+}
+
+//////////////////////////////////////////////////
+void SubtRosRelay::OnDiagnosticsTimer(const ros::TimerEvent &/*_event*/)
+{
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "subt_ros_relay: message delivery";
+  status.hardware_id = ros::this_node::getName();
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = "OK";
+
+  auto addValue = [&status](const std::string &_key, const std::string &_value)
+  {
+    diagnostic_msgs::KeyValue keyValue;
+    keyValue.key = _key;
+    keyValue.value = _value;
+    status.values.push_back(keyValue);
+  };
+
+  uint64_t dropped = this->droppedMessages;
+  addValue("dropped", std::to_string(dropped));
+  if (dropped > 0)
   {
-    ros::service::call(_req.dst_address(), req, res);
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Messages dropped";
   }
+
+  for (size_t i = 0; i < this->workers.size(); ++i)
+  {
+    Worker &worker = *this->workers[i];
+    size_t depth;
+    size_t maxDepth;
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      depth = worker.queue.size();
+      maxDepth = worker.maxDepth;
+    }
+    const std::string prefix = "worker" + std::to_string(i);
+    addValue(prefix + "/queue_depth", std::to_string(depth));
+    addValue(prefix + "/max_queue_depth", std::to_string(maxDepth));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->statsMutex);
+    for (const auto &entry : this->deliveryStats)
+    {
+      const DeliveryStats &stats = entry.second;
+      addValue(entry.first + "/delivered", std::to_string(stats.delivered));
+      addValue(entry.first + "/failed", std::to_string(stats.failed));
+      addValue(entry.first + "/mean_latency", std::to_string(
+            stats.delivered > 0 ? stats.totalLatency / stats.delivered : 0.0));
+      addValue(entry.first + "/max_latency",
+          std::to_string(stats.maxLatency));
+    }
+  }
+
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  msg.status.push_back(status);
+  this->diagnosticsPub.publish(msg);
 }
 
 //////////////////////////////////////////////////